@@ -121,6 +121,19 @@ namespace omnidir
      */
     CV_EXPORTS_W void undistortPoints(InputArray distorted, OutputArray undistorted, InputArray K, InputArray D, InputArray xi, InputArray R);
 
+    /** @brief Undistort several sets of 2D image points sharing the same camera, see omnidir::undistortPoints
+
+    @param distorted Vector of point sets, each one a vector of Vec2f/Vec2d or 1xN/Nx1 2-channel Mat of depth CV_32F or CV_64F
+    @param undistorted Output vector of normalized object points, every set with the size and depth of its input set.
+    @param K Camera matrix \f$K = \vecthreethree{f_x}{s}{c_x}{0}{f_y}{c_y}{0}{0}{_1}\f$.
+    @param D Distortion coefficients \f$(k_1, k_2, p_1, p_2)\f$.
+    @param xi The parameter xi for CMei's model
+    @param R Rotation trainsform between the original and object space : 3x3 1-channel, or vector: 3x1/1x3
+    1-channel or 1x1 3-channel
+     */
+    CV_EXPORTS_W void undistortPointsBatch(InputArrayOfArrays distorted, OutputArrayOfArrays undistorted, InputArray K, InputArray D,
+        InputArray xi, InputArray R);
+
     /** @brief Computes undistortion and rectification maps for omnidirectional camera image transform by a rotation R.
     It output two maps that are used for cv::remap(). If D is empty then zero distortion is used,
     if R or P is empty then identity matrices are used.
@@ -257,6 +270,21 @@ namespace internal
     void computeJacobian(InputArrayOfArrays objectPoints, InputArrayOfArrays imagePoints, InputArray parameters, Mat& JTJ_inv, Mat& JTE, int flags,
 							double epsilon);
 
+    /* Builds the block-sparse normal equations of the mono calibration: the 6x6 extrinsic blocks U,
+    the 6 x m coupling blocks W between every view and the m free intrinsics, the m x m intrinsic block V
+    and the right-hand side JTE with the same parameter ordering as computeJacobian. */
+    void computeNormalBlocks(InputArrayOfArrays objectPoints, InputArrayOfArrays imagePoints, InputArray parameters, int flags,
+        std::vector<Matx66d>& U, std::vector<Mat>& W, Mat& V, Mat& JTE);
+
+    /* Solves (A + epsilon) x = b for the block-arrow normal matrix A = [diag(U) W; W^T V] by eliminating
+    the 6x6 blocks through the Schur complement. invDiag optionally receives the diagonal of A^-1. */
+    void solveSchurNormalEquations(const std::vector<Matx66d>& U, const std::vector<Mat>& W, const Mat& V, const Mat& b,
+        double epsilon, Mat& x, OutputArray invDiag = noArray());
+
+    /* Gauss-Newton step JTJ_inv * JTE of computeJacobian without forming the dense normal matrix */
+    void computeGaussNewtonStep(InputArrayOfArrays objectPoints, InputArrayOfArrays imagePoints, InputArray parameters, Mat& G, int flags,
+        double epsilon);
+
     void computeJacobianStereo(InputArrayOfArrays objectPoints, InputArrayOfArrays imagePoints1, InputArrayOfArrays imagePoints2,
         InputArray parameters, Mat& JTJ_inv, Mat& JTE, int flags, double epsilon);
 
@@ -365,9 +365,9 @@ double MultiCameraCalibration::optimizeExtrinsics()
             (_criteria.type == 3 && (change <= _criteria.epsilon || iter >= _criteria.maxCount)))
             break;
         double alpha_smooth2 = 1 - std::pow(1 - alpha_smooth, (double)iter + 1.0);
-        Mat JTJ_inv, JTError;
-        this->computeJacobianExtrinsic(extrinParam, JTJ_inv, JTError);
-        Mat G = alpha_smooth2*JTJ_inv * JTError;
+        Mat G;
+        this->computeExtrinsicStep(extrinParam, G);
+        G = alpha_smooth2*G;
         if (G.depth() == CV_64F)
         {
             G.convertTo(G, CV_32F);
@@ -400,71 +400,111 @@ double MultiCameraCalibration::optimizeExtrinsics()
     return error;
 }
 
-void MultiCameraCalibration::computeJacobianExtrinsic(const Mat& extrinsicParams, Mat& JTJ_inv, Mat& JTE)
+void MultiCameraCalibration::computeExtrinsicStep(const Mat& extrinsicParams, Mat& G)
 {
     int nParam = (int)extrinsicParams.total();
     int nEdge = (int)_edgeList.size();
-    std::vector<int> pointsLocation(nEdge+1, 0);
-
-    for (int edgeIdx = 0; edgeIdx < nEdge; ++edgeIdx)
+    // the pose of camera vertex 0 is fixed, the photo vertices follow the other cameras
+    int m = 6*(_nCamera - 1);
+    int nPhoto = (nParam - m) / 6;
+    CV_Assert(nPhoto >= 0 && m + 6*nPhoto == nParam);
+
+    // every edge couples one photo with one camera, so the per-edge products are evaluated
+    // independently and accumulated afterwards in edge order
+    std::vector<Matx66d> JPTJP(nEdge), JPTJC(nEdge), JCTJC(nEdge);
+    std::vector<Vec6d> JPTE(nEdge), JCTE(nEdge);
+    parallel_for_(Range(0, nEdge), [&](const Range& range)
     {
-        int nPoints = (int)_objectPointsForEachCamera[_edgeList[edgeIdx].cameraVertex][_edgeList[edgeIdx].photoIndex].total();
-        pointsLocation[edgeIdx+1] = pointsLocation[edgeIdx] + nPoints*2;
-    }
-
-    JTJ_inv = Mat(nParam, nParam, CV_64F);
-    JTE = Mat(nParam, 1, CV_64F);
+        for (int edgeIdx = range.start; edgeIdx < range.end; ++edgeIdx)
+        {
+            int photoVertex = _edgeList[edgeIdx].photoVertex;
+            int photoIndex = _edgeList[edgeIdx].photoIndex;
+            int cameraVertex = _edgeList[edgeIdx].cameraVertex;
 
-    Mat J = Mat::zeros(pointsLocation[nEdge], nParam, CV_64F);
-    Mat E = Mat::zeros(pointsLocation[nEdge], 1, CV_64F);
+            Mat objectPoints = _objectPointsForEachCamera[cameraVertex][photoIndex];
+            Mat imagePoints = _imagePointsForEachCamera[cameraVertex][photoIndex];
 
-    for (int edgeIdx = 0; edgeIdx < nEdge; ++edgeIdx)
-    {
-        int photoVertex = _edgeList[edgeIdx].photoVertex;
-        int photoIndex = _edgeList[edgeIdx].photoIndex;
-        int cameraVertex = _edgeList[edgeIdx].cameraVertex;
+            Mat rvecTran, tvecTran;
+            Mat R = _edgeList[edgeIdx].transform.rowRange(0, 3).colRange(0, 3);
+            tvecTran = _edgeList[edgeIdx].transform.rowRange(0, 3).col(3);
+            cv::Rodrigues(R, rvecTran);
 
-        Mat objectPoints = _objectPointsForEachCamera[cameraVertex][photoIndex];
-        Mat imagePoints = _imagePointsForEachCamera[cameraVertex][photoIndex];
+            Mat rvecPhoto = extrinsicParams.colRange((photoVertex-1)*6, (photoVertex-1)*6 + 3);
+            Mat tvecPhoto = extrinsicParams.colRange((photoVertex-1)*6 + 3, (photoVertex-1)*6 + 6);
 
-        Mat rvecTran, tvecTran;
-        Mat R = _edgeList[edgeIdx].transform.rowRange(0, 3).colRange(0, 3);
-        tvecTran = _edgeList[edgeIdx].transform.rowRange(0, 3).col(3);
-        cv::Rodrigues(R, rvecTran);
+            Mat rvecCamera, tvecCamera;
+            if (cameraVertex > 0)
+            {
+                rvecCamera = extrinsicParams.colRange((cameraVertex-1)*6, (cameraVertex-1)*6 + 3);
+                tvecCamera = extrinsicParams.colRange((cameraVertex-1)*6 + 3, (cameraVertex-1)*6 + 6);
+            }
+            else
+            {
+                rvecCamera = Mat::zeros(3, 1, CV_32F);
+                tvecCamera = Mat::zeros(3, 1, CV_32F);
+            }
 
-        Mat rvecPhoto = extrinsicParams.colRange((photoVertex-1)*6, (photoVertex-1)*6 + 3);
-        Mat tvecPhoto = extrinsicParams.colRange((photoVertex-1)*6 + 3, (photoVertex-1)*6 + 6);
+            Mat jacobianPhoto, jacobianCamera, error;
+            computePhotoCameraJacobian(rvecPhoto, tvecPhoto, rvecCamera, tvecCamera, rvecTran, tvecTran,
+                objectPoints, imagePoints, this->_cameraMatrix[cameraVertex], this->_distortCoeffs[cameraVertex],
+                this->_xi[cameraVertex], jacobianPhoto, jacobianCamera, error);
 
-        Mat rvecCamera, tvecCamera;
-        if (cameraVertex > 0)
-        {
-            rvecCamera = extrinsicParams.colRange((cameraVertex-1)*6, (cameraVertex-1)*6 + 3);
-            tvecCamera = extrinsicParams.colRange((cameraVertex-1)*6 + 3, (cameraVertex-1)*6 + 6);
+            gemm(jacobianPhoto, jacobianPhoto, 1, noArray(), 0, JPTJP[edgeIdx], GEMM_1_T);
+            gemm(jacobianPhoto, error, 1, noArray(), 0, JPTE[edgeIdx], GEMM_1_T);
+            if (cameraVertex > 0)
+            {
+                gemm(jacobianPhoto, jacobianCamera, 1, noArray(), 0, JPTJC[edgeIdx], GEMM_1_T);
+                gemm(jacobianCamera, jacobianCamera, 1, noArray(), 0, JCTJC[edgeIdx], GEMM_1_T);
+                gemm(jacobianCamera, error, 1, noArray(), 0, JCTE[edgeIdx], GEMM_1_T);
+            }
         }
-        else
+    });
+
+    // photo poses are eliminated through the Schur complement, the camera poses form the reduced system
+    std::vector<Matx66d> U(nPhoto, Matx66d::zeros());
+    std::vector<Mat> W(nPhoto);
+    for (int i = 0; i < nPhoto; ++i)
+    {
+        W[i] = Mat::zeros(6, m, CV_64F);
+    }
+    Mat V = Mat::zeros(m, m, CV_64F);
+    Mat b = Mat::zeros(6*nPhoto + m, 1, CV_64F);
+    double* bptr = b.ptr<double>();
+    for (int edgeIdx = 0; edgeIdx < nEdge; ++edgeIdx)
+    {
+        int photo = _edgeList[edgeIdx].photoVertex - _nCamera;
+        int camera = _edgeList[edgeIdx].cameraVertex - 1;
+
+        U[photo] += JPTJP[edgeIdx];
+        for (int k = 0; k < 6; ++k)
         {
-            rvecCamera = Mat::zeros(3, 1, CV_32F);
-            tvecCamera = Mat::zeros(3, 1, CV_32F);
+            bptr[6*photo + k] += JPTE[edgeIdx][k];
         }
-
-        Mat jacobianPhoto, jacobianCamera, error;
-        computePhotoCameraJacobian(rvecPhoto, tvecPhoto, rvecCamera, tvecCamera, rvecTran, tvecTran,
-            objectPoints, imagePoints, this->_cameraMatrix[cameraVertex], this->_distortCoeffs[cameraVertex],
-            this->_xi[cameraVertex], jacobianPhoto, jacobianCamera, error);
-        if (cameraVertex > 0)
+        if (camera >= 0)
         {
-            jacobianCamera.copyTo(J.rowRange(pointsLocation[edgeIdx], pointsLocation[edgeIdx+1]).
-                colRange((cameraVertex-1)*6, cameraVertex*6));
+            Mat Wblock = W[photo](Rect(6*camera, 0, 6, 6));
+            Wblock += Mat(JPTJC[edgeIdx]);
+            Mat Vblock = V(Rect(6*camera, 6*camera, 6, 6));
+            Vblock += Mat(JCTJC[edgeIdx]);
+            for (int k = 0; k < 6; ++k)
+            {
+                bptr[6*nPhoto + 6*camera + k] += JCTE[edgeIdx][k];
+            }
         }
-        jacobianPhoto.copyTo(J.rowRange(pointsLocation[edgeIdx], pointsLocation[edgeIdx+1]).
-            colRange((photoVertex-1)*6, photoVertex*6));
-        error.copyTo(E.rowRange(pointsLocation[edgeIdx], pointsLocation[edgeIdx+1]));
     }
-    //std::cout << J.t() * J << std::endl;
-    JTJ_inv = (J.t() * J + 1e-10).inv();
-    JTE = J.t() * E;
 
+    Mat x;
+    cv::omnidir::internal::solveSchurNormalEquations(U, W, V, b, 1e-10, x);
+
+    // back to the vertex order: camera poses first, then the photo poses
+    G.create(nParam, 1, CV_64F);
+    if (m > 0)
+    {
+        x.rowRange(6*nPhoto, 6*nPhoto + m).copyTo(G.rowRange(0, m));
+    }
+    x.rowRange(0, 6*nPhoto).copyTo(G.rowRange(m, nParam));
 }
+
 void MultiCameraCalibration::computePhotoCameraJacobian(const Mat& rvecPhoto, const Mat& tvecPhoto, const Mat& rvecCamera,
     const Mat& tvecCamera, Mat& rvecTran, Mat& tvecTran, const Mat& objectPoints, const Mat& imagePoints, const Mat& K,
     const Mat& distort, const Mat& xi, Mat& jacobianPhoto, Mat& jacobianCamera, Mat& E)
@@ -58,6 +58,7 @@
  */
 #include "precomp.hpp"
 #include "opencv2/ccalib/omnidir.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <fstream>
 #include <iostream>
 namespace cv { namespace
@@ -71,6 +72,231 @@ namespace cv { namespace
         double dxi;
         Matx14d dkp;    // distortion k1,k2,p1,p2
     };
+
+    // intrinsic and rectification parameters shared by the point and map undistortion
+    struct UndistortParams
+    {
+        Vec2d f, c;
+        double s;
+        Vec2d k, p;
+        double xi;
+        Matx33d R;
+    };
+
+    void readUndistortParams(InputArray K, InputArray D, InputArray xi, InputArray R, UndistortParams& params)
+    {
+        if (K.depth() == CV_32F)
+        {
+            Matx33f camMat = K.getMat();
+            params.f = Vec2f(camMat(0, 0), camMat(1, 1));
+            params.c = Vec2f(camMat(0, 2), camMat(1, 2));
+            params.s = (double)camMat(0,1);
+        }
+        else
+        {
+            Matx33d camMat = K.getMat();
+            params.f = Vec2d(camMat(0, 0), camMat(1, 1));
+            params.c = Vec2d(camMat(0, 2), camMat(1, 2));
+            params.s = camMat(0,1);
+        }
+
+        Vec4d kp = Vec4d::all(0);
+        if (!D.empty())
+            kp = D.depth() == CV_32F ? (Vec4d)*D.getMat().ptr<Vec4f>(): *D.getMat().ptr<Vec4d>();
+        params.k = Vec2d(kp[0], kp[1]);
+        params.p = Vec2d(kp[2], kp[3]);
+        params.xi = xi.depth() == CV_32F ? (double)*xi.getMat().ptr<float>() : *xi.getMat().ptr<double>();
+
+        params.R = Matx33d::eye();
+        if (!R.empty() && R.total() * R.channels() == 3)
+        {
+            Vec3d rvec;
+            R.getMat().convertTo(rvec, CV_64F);
+            Rodrigues(rvec, params.R);
+        }
+        else if (!R.empty() && R.size() == Size(3, 3))
+            R.getMat().convertTo(params.R, CV_64F);
+    }
+
+    // removes the distortion of n interleaved (x, y) image points and maps them through R
+    void undistortPointsBlock(const double* src, double* dst, int n, const UndistortParams& params)
+    {
+        const double f0 = params.f[0], f1 = params.f[1], c0 = params.c[0], c1 = params.c[1], s = params.s;
+        const double k0 = params.k[0], k1 = params.k[1], p0 = params.p[0], p1 = params.p[1], xi = params.xi;
+        const Matx33d& RR = params.R;
+        int i = 0;
+#if (CV_SIMD_64F || CV_SIMD_SCALABLE_64F)
+        const int vl = VTraits<v_float64>::vlanes();
+        const v_float64 vone = vx_setall_f64(1.0), vtwo = vx_setall_f64(2.0), vfour = vx_setall_f64(4.0);
+        const v_float64 vk0 = vx_setall_f64(k0), vk1 = vx_setall_f64(k1);
+        const v_float64 vp0 = vx_setall_f64(p0), vp1 = vx_setall_f64(p1), vxi = vx_setall_f64(xi);
+        const v_float64 vc0 = vx_setall_f64(c0), vc1 = vx_setall_f64(c1);
+        const v_float64 vif0 = vx_setall_f64(1.0/f0), vif1 = vx_setall_f64(1.0/f1), vs = vx_setall_f64(s);
+        for (; i <= n - vl; i += vl)
+        {
+            v_float64 x, y;
+            v_load_deinterleave(src + 2*i, x, y);
+            v_float64 pp1 = v_mul(v_sub(y, vc1), vif1);
+            v_float64 pp0 = v_mul(v_sub(v_sub(x, vc0), v_mul(vs, pp1)), vif0);
+            v_float64 pu0 = pp0, pu1 = pp1;
+
+            // remove distortion iteratively
+            for (int j = 0; j < 20; j++)
+            {
+                v_float64 r2 = v_fma(pu0, pu0, v_mul(pu1, pu1));
+                v_float64 iradial = v_div(vone, v_fma(r2, v_fma(vk1, r2, vk0), vone));
+                pu0 = v_mul(v_sub(v_sub(pp0, v_mul(v_mul(vtwo, vp0), v_mul(pu0, pu1))),
+                                  v_mul(vp1, v_fma(vtwo, v_mul(pu0, pu0), r2))), iradial);
+                pu1 = v_mul(v_sub(v_sub(pp1, v_mul(v_mul(vtwo, vp1), v_mul(pu0, pu1))),
+                                  v_mul(vp0, v_fma(vtwo, v_mul(pu1, pu1), r2))), iradial);
+            }
+
+            // project to unit sphere
+            v_float64 r2 = v_fma(pu0, pu0, v_mul(pu1, pu1));
+            v_float64 a = v_add(r2, vone);
+            v_float64 b = v_mul(v_mul(vtwo, vxi), r2);
+            v_float64 cc = v_sub(v_mul(r2, v_mul(vxi, vxi)), vone);
+            v_float64 Zs = v_div(v_sub(v_sqrt(v_sub(v_mul(b, b), v_mul(vfour, v_mul(a, cc)))), b), v_mul(vtwo, a));
+            v_float64 Xw0 = v_mul(pu0, v_add(Zs, vxi)), Xw1 = v_mul(pu1, v_add(Zs, vxi));
+
+            // rotate and reproject to camera plane, the normalization to the sphere cancels out
+            v_float64 X = v_fma(vx_setall_f64(RR(0,0)), Xw0, v_fma(vx_setall_f64(RR(0,1)), Xw1, v_mul(vx_setall_f64(RR(0,2)), Zs)));
+            v_float64 Y = v_fma(vx_setall_f64(RR(1,0)), Xw0, v_fma(vx_setall_f64(RR(1,1)), Xw1, v_mul(vx_setall_f64(RR(1,2)), Zs)));
+            v_float64 Z = v_fma(vx_setall_f64(RR(2,0)), Xw0, v_fma(vx_setall_f64(RR(2,1)), Xw1, v_mul(vx_setall_f64(RR(2,2)), Zs)));
+            v_float64 iZ = v_div(vone, Z);
+            v_store_interleave(dst + 2*i, v_mul(X, iZ), v_mul(Y, iZ));
+        }
+#endif
+        for (; i < n; i++)
+        {
+            Vec2d pp(((src[2*i] - c0) - s*(src[2*i+1] - c1)/f1)/f0, (src[2*i+1] - c1)/f1); //plane
+            Vec2d pu = pp;    // points without distortion
+
+            // remove distortion iteratively
+            for (int j = 0; j < 20; j++)
+            {
+                double r2 = pu[0]*pu[0] + pu[1]*pu[1];
+                double r4 = r2*r2;
+                pu[0] = (pp[0] - 2*p0*pu[0]*pu[1] - p1*(r2+2*pu[0]*pu[0])) / (1 + k0*r2 + k1*r4);
+                pu[1] = (pp[1] - 2*p1*pu[0]*pu[1] - p0*(r2+2*pu[1]*pu[1])) / (1 + k0*r2 + k1*r4);
+            }
+
+            // project to unit sphere
+            double r2 = pu[0]*pu[0] + pu[1]*pu[1];
+            double a = (r2 + 1);
+            double b = 2*xi*r2;
+            double cc = r2*xi*xi-1;
+            double Zs = (-b + sqrt(b*b - 4*a*cc))/(2*a);
+            Vec3d Xw = RR * Vec3d(pu[0]*(Zs + xi), pu[1]*(Zs + xi), Zs);
+
+            // reproject to camera plane
+            dst[2*i] = Xw[0]/Xw[2];
+            dst[2*i+1] = Xw[1]/Xw[2];
+        }
+    }
+
+    // projects the rays (X, Y, W) of one map row to distorted pixel coordinates (U, V)
+    void projectMapRow(const double* X, const double* Y, const double* W, double* U, double* V, int width,
+                       const UndistortParams& params)
+    {
+        const double f0 = params.f[0], f1 = params.f[1], c0 = params.c[0], c1 = params.c[1], s = params.s;
+        const double k0 = params.k[0], k1 = params.k[1], p0 = params.p[0], p1 = params.p[1], xi = params.xi;
+        int j = 0;
+#if (CV_SIMD_64F || CV_SIMD_SCALABLE_64F)
+        const int vl = VTraits<v_float64>::vlanes();
+        const v_float64 vone = vx_setall_f64(1.0), vtwo = vx_setall_f64(2.0), vxi = vx_setall_f64(xi);
+        const v_float64 vk0 = vx_setall_f64(k0), vk1 = vx_setall_f64(k1);
+        const v_float64 vp0 = vx_setall_f64(p0), vp1 = vx_setall_f64(p1);
+        const v_float64 vp0x2 = vx_setall_f64(2*p0), vp1x2 = vx_setall_f64(2*p1);
+        const v_float64 vf0 = vx_setall_f64(f0), vf1 = vx_setall_f64(f1), vs = vx_setall_f64(s);
+        const v_float64 vc0 = vx_setall_f64(c0), vc1 = vx_setall_f64(c1);
+        for (; j <= width - vl; j += vl)
+        {
+            v_float64 x = vx_load(X + j), y = vx_load(Y + j), w = vx_load(W + j);
+            // project to unit sphere and then to the image plane
+            v_float64 r = v_sqrt(v_fma(x, x, v_fma(y, y, v_mul(w, w))));
+            v_float64 iz = v_div(vone, v_fma(vxi, r, w));
+            v_float64 xu = v_mul(x, iz), yu = v_mul(y, iz);
+            // add distortion
+            v_float64 xx = v_mul(xu, xu), yy = v_mul(yu, yu), xy = v_mul(xu, yu);
+            v_float64 r2 = v_add(xx, yy);
+            v_float64 radial = v_fma(r2, v_fma(vk1, r2, vk0), vone);
+            v_float64 xd = v_fma(radial, xu, v_fma(vp0x2, xy, v_mul(vp1, v_fma(vtwo, xx, r2))));
+            v_float64 yd = v_fma(radial, yu, v_fma(vp1x2, xy, v_mul(vp0, v_fma(vtwo, yy, r2))));
+            // to image pixel
+            v_store(U + j, v_fma(vf0, xd, v_fma(vs, yd, vc0)));
+            v_store(V + j, v_fma(vf1, yd, vc1));
+        }
+#endif
+        for (; j < width; ++j)
+        {
+            double r = std::sqrt(X[j]*X[j] + Y[j]*Y[j] + W[j]*W[j]);
+            double iz = 1.0 / (W[j] + xi*r);
+            double xu = X[j]*iz, yu = Y[j]*iz;
+            double r2 = xu*xu + yu*yu;
+            double r4 = r2*r2;
+            double xd = (1+k0*r2+k1*r4)*xu + 2*p0*xu*yu + p1*(r2+2*xu*xu);
+            double yd = (1+k0*r2+k1*r4)*yu + p0*(r2+2*yu*yu) + 2*p1*xu*yu;
+            U[j] = f0*xd + s*yd + c0;
+            V[j] = f1*yd + c1;
+        }
+    }
+
+    // writes one map row either as CV_32FC1 pair or as CV_16SC2 + CV_16UC1 fixed-point maps
+    void storeMapRow(const double* U, const double* V, int width, int m1type, float* m1f, float* m2f)
+    {
+        int j = 0;
+        if (m1type == CV_16SC2)
+        {
+            short*  m1 = (short*)m1f;
+            ushort* m2 = (ushort*)m2f;
+#if (CV_SIMD_64F || CV_SIMD_SCALABLE_64F)
+            const int vl = VTraits<v_int16>::vlanes();
+            const int dl = VTraits<v_float64>::vlanes();
+            const v_float64 vtab = vx_setall_f64(INTER_TAB_SIZE);
+            const v_int32 vmask = vx_setall_s32(INTER_TAB_SIZE - 1);
+            for (; j <= width - vl; j += vl)
+            {
+                v_int32 iu0 = v_round(v_mul(vx_load(U + j), vtab), v_mul(vx_load(U + j + dl), vtab));
+                v_int32 iu1 = v_round(v_mul(vx_load(U + j + 2*dl), vtab), v_mul(vx_load(U + j + 3*dl), vtab));
+                v_int32 iv0 = v_round(v_mul(vx_load(V + j), vtab), v_mul(vx_load(V + j + dl), vtab));
+                v_int32 iv1 = v_round(v_mul(vx_load(V + j + 2*dl), vtab), v_mul(vx_load(V + j + 3*dl), vtab));
+                v_int32 t0 = v_add(v_shl<INTER_BITS>(v_and(iv0, vmask)), v_and(iu0, vmask));
+                v_int32 t1 = v_add(v_shl<INTER_BITS>(v_and(iv1, vmask)), v_and(iu1, vmask));
+                // sign-extending the low 16 bits before packing truncates like the (short) cast below
+                v_store_interleave(m1 + 2*j,
+                        v_pack(v_shr<16>(v_shl<16>(v_shr<INTER_BITS>(iu0))), v_shr<16>(v_shl<16>(v_shr<INTER_BITS>(iu1)))),
+                        v_pack(v_shr<16>(v_shl<16>(v_shr<INTER_BITS>(iv0))), v_shr<16>(v_shl<16>(v_shr<INTER_BITS>(iv1)))));
+                v_store(m2 + j, v_pack_u(t0, t1));
+            }
+#endif
+            for (; j < width; ++j)
+            {
+                int iu = saturate_cast<int>(U[j]*INTER_TAB_SIZE);
+                int iv = saturate_cast<int>(V[j]*INTER_TAB_SIZE);
+                m1[j*2+0] = (short)(iu >> INTER_BITS);
+                m1[j*2+1] = (short)(iv >> INTER_BITS);
+                m2[j] = (ushort)((iv & (INTER_TAB_SIZE-1))*INTER_TAB_SIZE + (iu & (INTER_TAB_SIZE-1)));
+            }
+        }
+        else
+        {
+#if (CV_SIMD_64F || CV_SIMD_SCALABLE_64F)
+            const int vl = VTraits<v_float32>::vlanes();
+            const int dl = VTraits<v_float64>::vlanes();
+            for (; j <= width - vl; j += vl)
+            {
+                v_store(m1f + j, v_cvt_f32(vx_load(U + j), vx_load(U + j + dl)));
+                v_store(m2f + j, v_cvt_f32(vx_load(V + j), vx_load(V + j + dl)));
+            }
+#endif
+            for (; j < width; ++j)
+            {
+                m1f[j] = (float)U[j];
+                m2f[j] = (float)V[j];
+            }
+        }
+    }
 }}
 
 /////////////////////////////////////////////////////////////////////////////
@@ -258,88 +484,91 @@ void cv::omnidir::undistortPoints( InputArray distorted, OutputArray undistorted
 
     undistorted.create(distorted.size(), distorted.type());
 
-    cv::Vec2d f, c;
-    double s = 0.0;
-    if (K.depth() == CV_32F)
-    {
-        Matx33f camMat = K.getMat();
-        f = Vec2f(camMat(0,0), camMat(1,1));
-        c = Vec2f(camMat(0,2), camMat(1,2));
-        s = (double)camMat(0,1);
-    }
-    else if (K.depth() == CV_64F)
-    {
-        Matx33d camMat = K.getMat();
-        f = Vec2d(camMat(0,0), camMat(1,1));
-        c = Vec2d(camMat(0,2), camMat(1,2));
-        s = camMat(0,1);
-    }
+    UndistortParams params;
+    readUndistortParams(K, D, xi, R, params);
 
-    Vec4d kp = D.depth()==CV_32F ? (Vec4d)*D.getMat().ptr<Vec4f>():(Vec4d)*D.getMat().ptr<Vec4d>();
-    Vec2d k = Vec2d(kp[0], kp[1]);
-    Vec2d p = Vec2d(kp[2], kp[3]);
+    Mat src = distorted.getMat(), dst = undistorted.getMat();
+    if (!src.isContinuous())
+        src = src.clone();
+    CV_Assert(dst.isContinuous());
+    int n = (int)src.total();
 
-    double _xi = xi.depth() == CV_32F ? (double)*xi.getMat().ptr<float>() : *xi.getMat().ptr<double>();
-    cv::Matx33d RR = cv::Matx33d::eye();
-    // R is om
-    if(!R.empty() && R.total()*R.channels() == 3)
+    const int blockSize = 1024;
+    parallel_for_(Range(0, (n + blockSize - 1) / blockSize), [&](const Range& range)
     {
-        cv::Vec3d rvec;
-        R.getMat().convertTo(rvec, CV_64F);
-        cv::Rodrigues(rvec, RR);
-    }
-    else if (!R.empty() && R.size() == Size(3,3))
-    {
-        R.getMat().convertTo(RR, CV_64F);
-    }
-
-    const cv::Vec2d *srcd = distorted.getMat().ptr<cv::Vec2d>();
-    const cv::Vec2f *srcf = distorted.getMat().ptr<cv::Vec2f>();
-
-    cv::Vec2d *dstd = undistorted.getMat().ptr<cv::Vec2d>();
-    cv::Vec2f *dstf = undistorted.getMat().ptr<cv::Vec2f>();
-
-    int n = (int)distorted.total();
-    for (int i = 0; i < n; i++)
-    {
-        Vec2d pi = distorted.depth() == CV_32F ? (Vec2d)srcf[i]:(Vec2d)srcd[i];    // image point
-        Vec2d pp((pi[0]*f[1]-c[0]*f[1]-s*(pi[1]-c[1]))/(f[0]*f[1]), (pi[1]-c[1])/f[1]); //plane
-        Vec2d pu = pp;    // points without distortion
-
-        // remove distortion iteratively
-        for (int j = 0; j < 20; j++)
+        AutoBuffer<double> buf;
+        for (int blk = range.start; blk < range.end; ++blk)
         {
-            double r2 = pu[0]*pu[0] + pu[1]*pu[1];
-            double r4 = r2*r2;
-            pu[0] = (pp[0] - 2*p[0]*pu[0]*pu[1] - p[1]*(r2+2*pu[0]*pu[0])) / (1 + k[0]*r2 + k[1]*r4);
-            pu[1] = (pp[1] - 2*p[1]*pu[0]*pu[1] - p[0]*(r2+2*pu[1]*pu[1])) / (1 + k[0]*r2 + k[1]*r4);
+            int start = blk*blockSize, len = std::min(blockSize, n - start);
+            if (src.depth() == CV_64F)
+            {
+                undistortPointsBlock(src.ptr<double>() + 2*start, dst.ptr<double>() + 2*start, len, params);
+            }
+            else
+            {
+                buf.allocate(2*len);
+                const float* srcf = src.ptr<float>() + 2*start;
+                float* dstf = dst.ptr<float>() + 2*start;
+                for (int i = 0; i < 2*len; i++)
+                    buf[i] = srcf[i];
+                undistortPointsBlock(buf.data(), buf.data(), len, params);
+                for (int i = 0; i < 2*len; i++)
+                    dstf[i] = (float)buf[i];
+            }
         }
+    });
+}
 
-        // project to unit sphere
-        double r2 = pu[0]*pu[0] + pu[1]*pu[1];
-        double a = (r2 + 1);
-        double b = 2*_xi*r2;
-        double cc = r2*_xi*_xi-1;
-        double Zs = (-b + sqrt(b*b - 4*a*cc))/(2*a);
-        Vec3d Xw = Vec3d(pu[0]*(Zs + _xi), pu[1]*(Zs +_xi), Zs);
+/////////////////////////////////////////////////////////////////////////////
+//////// undistortPointsBatch
+void cv::omnidir::undistortPointsBatch(InputArrayOfArrays distorted, OutputArrayOfArrays undistorted,
+    InputArray K, InputArray D, InputArray xi, InputArray R)
+{
+    CV_Assert(R.empty() || (!R.empty() && (R.size() == Size(3, 3) || R.total() * R.channels() == 3)
+        && (R.depth() == CV_64F || R.depth() == CV_32F)));
+    CV_Assert((D.depth() == CV_64F || D.depth() == CV_32F) && D.total() == 4);
+    CV_Assert(K.size() == Size(3, 3) && (K.depth() == CV_64F || K.depth() == CV_32F));
+    CV_Assert(xi.total() == 1 && (xi.depth() == CV_64F || xi.depth() == CV_32F));
 
-        // rotate
-        Xw = RR * Xw;
+    int nSets = (int)distorted.total();
+    UndistortParams params;
+    readUndistortParams(K, D, xi, R, params);
 
-        // project back to sphere
-        Vec3d Xs = Xw / cv::norm(Xw);
+    std::vector<Mat> src(nSets), dst(nSets);
+    undistorted.create(nSets, 1, nSets > 0 ? distorted.type(0) : CV_64FC2, -1, true);
+    for (int i = 0; i < nSets; i++)
+    {
+        src[i] = distorted.getMat(i);
+        CV_Assert(src[i].type() == CV_64FC2 || src[i].type() == CV_32FC2);
+        if (!src[i].isContinuous())
+            src[i] = src[i].clone();
+        undistorted.create(src[i].size(), src[i].type(), i, true);
+        dst[i] = undistorted.getMat(i);
+    }
 
-        // reproject to camera plane
-        Vec3d ppu = Vec3d(Xs[0]/Xs[2], Xs[1]/Xs[2], 1.0);
-        if (undistorted.depth() == CV_32F)
-        {
-            dstf[i] = Vec2f((float)ppu[0], (float)ppu[1]);
-        }
-        else if (undistorted.depth() == CV_64F)
+    parallel_for_(Range(0, nSets), [&](const Range& range)
+    {
+        AutoBuffer<double> buf;
+        for (int i = range.start; i < range.end; ++i)
         {
-            dstd[i] = Vec2d(ppu[0], ppu[1]);
+            int n = (int)src[i].total();
+            if (src[i].depth() == CV_64F)
+            {
+                undistortPointsBlock(src[i].ptr<double>(), dst[i].ptr<double>(), n, params);
+            }
+            else
+            {
+                buf.allocate(2*n);
+                const float* srcf = src[i].ptr<float>();
+                float* dstf = dst[i].ptr<float>();
+                for (int j = 0; j < 2*n; j++)
+                    buf[j] = srcf[j];
+                undistortPointsBlock(buf.data(), buf.data(), n, params);
+                for (int j = 0; j < 2*n; j++)
+                    dstf[j] = (float)buf[j];
+            }
         }
-    }
+    });
 }
 
 
@@ -362,38 +591,9 @@ void cv::omnidir::initUndistortRectifyMap(InputArray K, InputArray D, InputArray
         || flags == RECTIFY_STEREOGRAPHIC);
     CV_Assert(xi.total() == 1 && (xi.depth() == CV_32F || xi.depth() == CV_64F));
 
-    cv::Vec2d f, c;
-    double s;
-    if (K.depth() == CV_32F)
-    {
-        Matx33f camMat = K.getMat();
-        f = Vec2f(camMat(0, 0), camMat(1, 1));
-        c = Vec2f(camMat(0, 2), camMat(1, 2));
-        s = (double)camMat(0,1);
-    }
-    else
-    {
-        Matx33d camMat = K.getMat();
-        f = Vec2d(camMat(0, 0), camMat(1, 1));
-        c = Vec2d(camMat(0, 2), camMat(1, 2));
-        s = camMat(0,1);
-    }
-
-    Vec4d kp = Vec4d::all(0);
-    if (!D.empty())
-        kp = D.depth() == CV_32F ? (Vec4d)*D.getMat().ptr<Vec4f>(): *D.getMat().ptr<Vec4d>();
-    double _xi = xi.depth() == CV_32F ? (double)*xi.getMat().ptr<float>() : *xi.getMat().ptr<double>();
-    Vec2d k = Vec2d(kp[0], kp[1]);
-    Vec2d p = Vec2d(kp[2], kp[3]);
-    cv::Matx33d RR  = cv::Matx33d::eye();
-    if (!R.empty() && R.total() * R.channels() == 3)
-    {
-        cv::Vec3d rvec;
-        R.getMat().convertTo(rvec, CV_64F);
-        cv::Rodrigues(rvec, RR);
-    }
-    else if (!R.empty() && R.size() == Size(3, 3))
-        R.getMat().convertTo(RR, CV_64F);
+    UndistortParams params;
+    readUndistortParams(K, D, xi, R, params);
+    m1type = map1.type();
 
     cv::Matx33d PP = cv::Matx33d::eye();
     if (!P.empty())
@@ -401,135 +601,96 @@ void cv::omnidir::initUndistortRectifyMap(InputArray K, InputArray D, InputArray
     else
         PP = K.getMat();
 
-    cv::Matx33d iKR = (PP*RR).inv(cv::DECOMP_SVD);
+    cv::Matx33d iKR = (PP*params.R).inv(cv::DECOMP_SVD);
     cv::Matx33d iK = PP.inv(cv::DECOMP_SVD);
-    cv::Matx33d iR = RR.inv(cv::DECOMP_SVD);
-
-    if (flags == omnidir::RECTIFY_PERSPECTIVE)
-    {
-        for (int i = 0; i < size.height; ++i)
+    cv::Matx33d iR = params.R.inv(cv::DECOMP_SVD);
+
+    // for RECTIFY_LONGLATI, theta and h are longittude and latitude; without skew theta only
+    // depends on the column and h on the row, so the trigonometry is tabulated once per column
+    const int width = size.width;
+    const bool separable = iK(0, 1) == 0 && iK(1, 0) == 0;
+    std::vector<double> cosTheta, sinTheta;
+    if (separable && (flags == omnidir::RECTIFY_CYLINDRICAL || flags == omnidir::RECTIFY_LONGLATI))
+    {
+        cosTheta.resize(width);
+        sinTheta.resize(width);
+        for (int j = 0; j < width; ++j)
         {
-            float* m1f = map1.getMat().ptr<float>(i);
-            float* m2f = map2.getMat().ptr<float>(i);
-            short*  m1 = (short*)m1f;
-            ushort* m2 = (ushort*)m2f;
-
-            double _x = i*iKR(0, 1) + iKR(0, 2),
-                   _y = i*iKR(1, 1) + iKR(1, 2),
-                   _w = i*iKR(2, 1) + iKR(2, 2);
-            for(int j = 0; j < size.width; ++j, _x+=iKR(0,0), _y+=iKR(1,0), _w+=iKR(2,0))
-            {
-                // project back to unit sphere
-                double r = sqrt(_x*_x + _y*_y + _w*_w);
-                double Xs = _x / r;
-                double Ys = _y / r;
-                double Zs = _w / r;
-                // project to image plane
-                double xu = Xs / (Zs + _xi),
-                    yu = Ys / (Zs + _xi);
-                // add distortion
-                double r2 = xu*xu + yu*yu;
-                double r4 = r2*r2;
-                double xd = (1+k[0]*r2+k[1]*r4)*xu + 2*p[0]*xu*yu + p[1]*(r2+2*xu*xu);
-                double yd = (1+k[0]*r2+k[1]*r4)*yu + p[0]*(r2+2*yu*yu) + 2*p[1]*xu*yu;
-                // to image pixel
-                double u = f[0]*xd + s*yd + c[0];
-                double v = f[1]*yd + c[1];
-
-                if( m1type == CV_16SC2 )
-                {
-                    int iu = cv::saturate_cast<int>(u*cv::INTER_TAB_SIZE);
-                    int iv = cv::saturate_cast<int>(v*cv::INTER_TAB_SIZE);
-                    m1[j*2+0] = (short)(iu >> cv::INTER_BITS);
-                    m1[j*2+1] = (short)(iv >> cv::INTER_BITS);
-                    m2[j] = (ushort)((iv & (cv::INTER_TAB_SIZE-1))*cv::INTER_TAB_SIZE + (iu & (cv::INTER_TAB_SIZE-1)));
-                }
-                else if( m1type == CV_32FC1 )
-                {
-                    m1f[j] = (float)u;
-                    m2f[j] = (float)v;
-                }
-            }
+            double theta = j*iK(0, 0) + iK(0, 2);
+            cosTheta[j] = std::cos(theta);
+            sinTheta[j] = std::sin(theta);
         }
     }
-    else if(flags == omnidir::RECTIFY_CYLINDRICAL || flags == omnidir::RECTIFY_LONGLATI ||
-        flags == omnidir::RECTIFY_STEREOGRAPHIC)
+
+    Mat _map1 = map1.getMat(), _map2 = map2.getMat();
+    parallel_for_(Range(0, size.height), [&](const Range& range)
     {
-        for (int i = 0; i < size.height; ++i)
+        AutoBuffer<double> buf(5*width);
+        double *X = buf.data(), *Y = X + width, *W = Y + width, *U = W + width, *V = U + width;
+        for (int i = range.start; i < range.end; ++i)
         {
-            float* m1f = map1.getMat().ptr<float>(i);
-            float* m2f = map2.getMat().ptr<float>(i);
-            short*  m1 = (short*)m1f;
-            ushort* m2 = (ushort*)m2f;
-
-            // for RECTIFY_LONGLATI, theta and h are longittude and latitude
-            double theta = i*iK(0, 1) + iK(0, 2),
-                   h     = i*iK(1, 1) + iK(1, 2);
-
-            for (int j = 0; j < size.width; ++j, theta+=iK(0,0), h+=iK(1,0))
+            if (flags == omnidir::RECTIFY_PERSPECTIVE)
             {
-                double _xt = 0.0, _yt = 0.0, _wt = 0.0;
-                if (flags == omnidir::RECTIFY_CYLINDRICAL)
-                {
-                    //_xt = std::sin(theta);
-                    //_yt = h;
-                    //_wt = std::cos(theta);
-                    _xt = std::cos(theta);
-                    _yt = std::sin(theta);
-                    _wt = h;
-                }
-                else if (flags == omnidir::RECTIFY_LONGLATI)
+                double _x = i*iKR(0, 1) + iKR(0, 2),
+                       _y = i*iKR(1, 1) + iKR(1, 2),
+                       _w = i*iKR(2, 1) + iKR(2, 2);
+                for (int j = 0; j < width; ++j)
                 {
-                    _xt = -std::cos(theta);
-                    _yt = -std::sin(theta) * std::cos(h);
-                    _wt = std::sin(theta) * std::sin(h);
+                    X[j] = _x + j*iKR(0, 0);
+                    Y[j] = _y + j*iKR(1, 0);
+                    W[j] = _w + j*iKR(2, 0);
                 }
-                else if (flags == omnidir::RECTIFY_STEREOGRAPHIC)
+            }
+            else
+            {
+                double theta0 = i*iK(0, 1) + iK(0, 2),
+                       h0     = i*iK(1, 1) + iK(1, 2);
+                const double cosH = std::cos(h0), sinH = std::sin(h0);
+                for (int j = 0; j < width; ++j)
                 {
-                    double a = theta*theta + h*h + 4;
-                    double b = -2*theta*theta - 2*h*h;
-                    double c2 = theta*theta + h*h -4;
-
-                    _yt = (-b-std::sqrt(b*b - 4*a*c2))/(2*a);
-                    _xt = theta*(1 - _yt) / 2;
-                    _wt = h*(1 - _yt) / 2;
-                }
-                double _x = iR(0,0)*_xt + iR(0,1)*_yt + iR(0,2)*_wt;
-                double _y = iR(1,0)*_xt + iR(1,1)*_yt + iR(1,2)*_wt;
-                double _w = iR(2,0)*_xt + iR(2,1)*_yt + iR(2,2)*_wt;
-
-                double r = sqrt(_x*_x + _y*_y + _w*_w);
-                double Xs = _x / r;
-                double Ys = _y / r;
-                double Zs = _w / r;
-                // project to image plane
-                double xu = Xs / (Zs + _xi),
-                       yu = Ys / (Zs + _xi);
-                // add distortion
-                double r2 = xu*xu + yu*yu;
-                double r4 = r2*r2;
-                double xd = (1+k[0]*r2+k[1]*r4)*xu + 2*p[0]*xu*yu + p[1]*(r2+2*xu*xu);
-                double yd = (1+k[0]*r2+k[1]*r4)*yu + p[0]*(r2+2*yu*yu) + 2*p[1]*xu*yu;
-                // to image pixel
-                double u = f[0]*xd + s*yd + c[0];
-                double v = f[1]*yd + c[1];
+                    double theta = theta0 + j*iK(0, 0), h = h0 + j*iK(1, 0);
+                    double _xt = 0.0, _yt = 0.0, _wt = 0.0;
+                    if (flags == omnidir::RECTIFY_CYLINDRICAL)
+                    {
+                        _xt = separable ? cosTheta[j] : std::cos(theta);
+                        _yt = separable ? sinTheta[j] : std::sin(theta);
+                        _wt = h;
+                    }
+                    else if (flags == omnidir::RECTIFY_LONGLATI)
+                    {
+                        if (separable)
+                        {
+                            _xt = -cosTheta[j];
+                            _yt = -sinTheta[j] * cosH;
+                            _wt = sinTheta[j] * sinH;
+                        }
+                        else
+                        {
+                            _xt = -std::cos(theta);
+                            _yt = -std::sin(theta) * std::cos(h);
+                            _wt = std::sin(theta) * std::sin(h);
+                        }
+                    }
+                    else // RECTIFY_STEREOGRAPHIC
+                    {
+                        double a = theta*theta + h*h + 4;
+                        double b = -2*theta*theta - 2*h*h;
+                        double c2 = theta*theta + h*h -4;
 
-                if( m1type == CV_16SC2 )
-                {
-                    int iu = cv::saturate_cast<int>(u*cv::INTER_TAB_SIZE);
-                    int iv = cv::saturate_cast<int>(v*cv::INTER_TAB_SIZE);
-                    m1[j*2+0] = (short)(iu >> cv::INTER_BITS);
-                    m1[j*2+1] = (short)(iv >> cv::INTER_BITS);
-                    m2[j] = (ushort)((iv & (cv::INTER_TAB_SIZE-1))*cv::INTER_TAB_SIZE + (iu & (cv::INTER_TAB_SIZE-1)));
-                }
-                else if( m1type == CV_32FC1 )
-                {
-                    m1f[j] = (float)u;
-                    m2f[j] = (float)v;
+                        _yt = (-b-std::sqrt(b*b - 4*a*c2))/(2*a);
+                        _xt = theta*(1 - _yt) / 2;
+                        _wt = h*(1 - _yt) / 2;
+                    }
+                    X[j] = iR(0,0)*_xt + iR(0,1)*_yt + iR(0,2)*_wt;
+                    Y[j] = iR(1,0)*_xt + iR(1,1)*_yt + iR(1,2)*_wt;
+                    W[j] = iR(2,0)*_xt + iR(2,1)*_yt + iR(2,2)*_wt;
                 }
             }
+
+            projectMapRow(X, Y, W, U, V, width, params);
+            storeMapRow(U, V, width, m1type, _map1.ptr<float>(i), _map2.ptr<float>(i));
         }
-    }
+    });
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -846,94 +1007,275 @@ void cv::omnidir::internal::initializeStereoCalibration(InputArrayOfArrays objec
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
-/// cv::omnidir::internal::computeJacobian
+/// cv::omnidir::internal::computeNormalBlocks
 
-void cv::omnidir::internal::computeJacobian(InputArrayOfArrays objectPoints, InputArrayOfArrays imagePoints,
-    InputArray parameters, Mat& JTJ_inv, Mat& JTE, int flags, double epsilon)
+void cv::omnidir::internal::computeNormalBlocks(InputArrayOfArrays objectPoints, InputArrayOfArrays imagePoints,
+    InputArray parameters, int flags, std::vector<Matx66d>& U, std::vector<Mat>& W, Mat& V, Mat& JTE)
 {
     CV_Assert(!objectPoints.empty() && objectPoints.type() == CV_64FC3);
     CV_Assert(!imagePoints.empty() && imagePoints.type() == CV_64FC2);
 
     int n = (int)objectPoints.total();
+    Mat _parameters = parameters.getMat().reshape(1, 1);
+    CV_Assert(_parameters.type() == CV_64F && (int)_parameters.total() == 6*n + 10);
 
-    Mat JTJ = Mat::zeros(10 + 6*n, 10 + 6*n, CV_64F);
-    JTJ_inv = Mat::zeros(10 + 6*n, 10 + 6*n, CV_64F);
-    JTE = Mat::zeros(10 + 6*n, 1, CV_64F);
-
-    int nPointsAll = 0;
-    for (int i = 0; i < n; ++i)
-    {
-        nPointsAll += (int)objectPoints.getMat(i).total();
-    }
-
-    Mat J = Mat::zeros(2*nPointsAll, 10+6*n, CV_64F);
-    Mat exAll = Mat::zeros(2*nPointsAll, 10+6*n, CV_64F);
-    double *para = parameters.getMat().ptr<double>();
+    const double *para = _parameters.ptr<double>();
     Matx33d K(para[6*n], para[6*n+2], para[6*n+3],
         0,    para[6*n+1], para[6*n+4],
         0,    0,  1);
     Matx14d D(para[6*n+6], para[6*n+7], para[6*n+8], para[6*n+9]);
     double xi = para[6*n+5];
-    for (int i = 0; i < n; i++)
+
+    std::vector<int> _idx;
+    flags2idx(flags, _idx, n);
+    std::vector<int> freeIn;
+    for (int k = 0; k < 10; ++k)
     {
-        Mat objPoints, imgPoints, om, T;
-		objectPoints.getMat(i).copyTo(objPoints);
-		imagePoints.getMat(i).copyTo(imgPoints);
-		objPoints = objPoints.reshape(3, objPoints.rows*objPoints.cols);
-		imgPoints = imgPoints.reshape(2, imgPoints.rows*imgPoints.cols);
+        if (_idx[6*n + k])
+            freeIn.push_back(k);
+    }
+    int m = (int)freeIn.size();
 
-        om = parameters.getMat().colRange(i*6, i*6+3);
-        T = parameters.getMat().colRange(i*6+3, (i+1)*6);
-        Mat imgProj, jacobian;
-        omnidir::projectPoints(objPoints, imgProj, om, T, K, xi, D, jacobian);
-        Mat projError = imgPoints - imgProj;
+    std::vector<Mat> objPoints(n), imgPoints(n);
+    for (int i = 0; i < n; ++i)
+    {
+        objectPoints.getMat(i).copyTo(objPoints[i]);
+        imagePoints.getMat(i).copyTo(imgPoints[i]);
+        objPoints[i] = objPoints[i].reshape(3, objPoints[i].rows*objPoints[i].cols);
+        imgPoints[i] = imgPoints[i].reshape(2, imgPoints[i].rows*imgPoints[i].cols);
+    }
 
-        // The intrinsic part of Jacobian
-        Mat JIn(jacobian.rows, 10, CV_64F);
-        Mat JEx(jacobian.rows, 6, CV_64F);
+    // every view only touches its own extrinsic block and the shared intrinsics, so the
+    // views are evaluated independently and their intrinsic parts are summed afterwards
+    U.resize(n);
+    std::vector<Matx<double, 6, 10> > WAll(n);
+    std::vector<Matx<double, 10, 10> > VAll(n);
+    std::vector<Vec<double, 10> > bIn(n);
+    JTE = Mat::zeros(6*n + m, 1, CV_64F);
+    double* JTEptr = JTE.ptr<double>();
 
-        jacobian.colRange(6, 16).copyTo(JIn);
-        jacobian.colRange(0, 6).copyTo(JEx);
+    parallel_for_(Range(0, n), [&](const Range& range)
+    {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            Mat om = _parameters.colRange(i*6, i*6+3);
+            Mat T = _parameters.colRange(i*6+3, (i+1)*6);
+            Mat imgProj, jacobian;
+            omnidir::projectPoints(objPoints[i], imgProj, om, T, K, xi, D, jacobian);
+            Mat projError = imgPoints[i] - imgProj;
+            projError = projError.reshape(1, 2*(int)projError.total());
+
+            Matx66d Ui = Matx66d::zeros();
+            Matx<double, 6, 10> Wi = Matx<double, 6, 10>::zeros();
+            Matx<double, 10, 10> Vi = Matx<double, 10, 10>::zeros();
+            Vec<double, 10> bi;
+            double* bEx = JTEptr + 6*i;
+            for (int r = 0; r < jacobian.rows; ++r)
+            {
+                const double* JEx = jacobian.ptr<double>(r);
+                const double* JIn = JEx + 6;
+                const double e = projError.at<double>(r);
+                for (int a = 0; a < 6; ++a)
+                {
+                    for (int c = 0; c < 6; ++c)
+                        Ui(a, c) += JEx[a]*JEx[c];
+                    for (int c = 0; c < 10; ++c)
+                        Wi(a, c) += JEx[a]*JIn[c];
+                    bEx[a] += JEx[a]*e;
+                }
+                for (int a = 0; a < 10; ++a)
+                {
+                    for (int c = 0; c < 10; ++c)
+                        Vi(a, c) += JIn[a]*JIn[c];
+                    bi[a] += JIn[a]*e;
+                }
+            }
+            U[i] = Ui;
+            WAll[i] = Wi;
+            VAll[i] = Vi;
+            bIn[i] = bi;
+        }
+    });
 
-        JTJ(Rect(6*n, 6*n, 10, 10)) = JTJ(Rect(6*n, 6*n, 10, 10)) + JIn.t()*JIn;
+    // reduce in view order so that the result does not depend on the number of threads
+    Matx<double, 10, 10> VSum = Matx<double, 10, 10>::zeros();
+    Vec<double, 10> bSum;
+    for (int i = 0; i < n; ++i)
+    {
+        VSum += VAll[i];
+        bSum += bIn[i];
+    }
 
-        JTJ(Rect(i*6, i*6, 6, 6)) = JEx.t() * JEx;
+    V.create(m, m, CV_64F);
+    W.resize(n);
+    for (int a = 0; a < m; ++a)
+    {
+        for (int c = 0; c < m; ++c)
+            V.at<double>(a, c) = VSum(freeIn[a], freeIn[c]);
+        JTEptr[6*n + a] = bSum[freeIn[a]];
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        W[i].create(6, m, CV_64F);
+        for (int a = 0; a < 6; ++a)
+        {
+            for (int c = 0; c < m; ++c)
+                W[i].at<double>(a, c) = WAll[i](a, freeIn[c]);
+        }
+    }
+}
 
-        Mat JExTIn = JEx.t() * JIn;
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// cv::omnidir::internal::solveSchurNormalEquations
 
-        JExTIn.copyTo(JTJ(Rect(6*n, i*6, 10, 6)));
+void cv::omnidir::internal::solveSchurNormalEquations(const std::vector<Matx66d>& U, const std::vector<Mat>& W, const Mat& V,
+    const Mat& b, double epsilon, Mat& x, OutputArray invDiag)
+{
+    int n = (int)U.size();
+    int m = V.rows;
+    int N = 6*n + m;
+    CV_Assert(W.size() == U.size());
+    CV_Assert(V.type() == CV_64F && V.rows == V.cols);
+    CV_Assert(b.type() == CV_64F && (int)b.total() == N);
+
+    // epsilon is added to every element of the normal matrix, which is the rank-one update
+    // epsilon*1*1^T; it is applied exactly with the Sherman-Morrison formula by solving for [b, 1]
+    int nrhs = epsilon != 0 ? 2 : 1;
+    Mat B(N, nrhs, CV_64F);
+    b.reshape(1, N).copyTo(B.col(0));
+    if (nrhs > 1)
+        B.col(1).setTo(1.0);
+
+    std::vector<Matx66d> Uinv(n);
+    std::vector<Mat> Y(n), SParts(n), rParts(n);
+    parallel_for_(Range(0, n), [&](const Range& range)
+    {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            bool ok = false;
+            Uinv[i] = U[i].inv(DECOMP_LU, &ok);
+            if (!ok)
+                Uinv[i] = U[i].inv(DECOMP_SVD);
+            if (m > 0)
+            {
+                CV_Assert(W[i].type() == CV_64F && W[i].rows == 6 && W[i].cols == m);
+                Y[i] = Mat(Uinv[i]) * W[i];
+                SParts[i] = W[i].t() * Y[i];
+                rParts[i] = Y[i].t() * B.rowRange(6*i, 6*i + 6);
+            }
+        }
+    });
 
-        Mat(JIn.t()*JEx).copyTo(JTJ(Rect(i*6, 6*n, 6, 10)));
+    Mat X(N, nrhs, CV_64F);
+    Mat S, xc;
+    if (m > 0)
+    {
+        // reduced camera system S = V - sum(W_i^T U_i^-1 W_i), summed in view order
+        S = V.clone();
+        Mat r = B.rowRange(6*n, N).clone();
+        for (int i = 0; i < n; ++i)
+        {
+            S -= SParts[i];
+            r -= rParts[i];
+        }
+        if (!solve(S, r, xc, DECOMP_LU))
+            solve(S, r, xc, DECOMP_SVD);
+        xc.copyTo(X.rowRange(6*n, N));
+    }
 
-        JTE(Rect(0, 6*n, 1, 10)) = JTE(Rect(0, 6*n,1, 10)) + JIn.t() * projError.reshape(1, 2*(int)projError.total());
-        JTE(Rect(0, i*6, 1, 6)) = JEx.t() * projError.reshape(1, 2*(int)projError.total());
+    parallel_for_(Range(0, n), [&](const Range& range)
+    {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            Mat Bi = B.rowRange(6*i, 6*i + 6);
+            if (m > 0)
+                Bi = Mat(Bi - W[i] * xc);
+            Mat Xi = Mat(Uinv[i]) * Bi;
+            Xi.copyTo(X.rowRange(6*i, 6*i + 6));
+        }
+    });
 
-        //int nPoints = objectPoints.getMat(i).total();
-        //JIn.copyTo(J(Rect(6*n, i*nPoints*2, 10, nPoints*2)));
-        //JEx.copyTo(J(Rect(6*i, i*nPoints*2, 6, nPoints*2)));
-        //projError.reshape(1, 2*projError.rows).copyTo(exAll.rowRange(i*2*nPoints, (i+1)*2*nPoints));
+    if (nrhs > 1)
+    {
+        double sy = sum(X.col(0))[0], sz = sum(X.col(1))[0];
+        x = X.col(0) - X.col(1) * (epsilon * sy / (1.0 + epsilon * sz));
+    }
+    else
+    {
+        x = X.col(0).clone();
     }
-    //JTJ = J.t()*J;
-    //JTE = J.t()*exAll;
-    std::vector<int> _idx(6*n+10, 1);
-    flags2idx(flags, _idx, n);
 
-    subMatrix(JTJ, JTJ, _idx, _idx);
-    subMatrix(JTE, JTE, std::vector<int>(1, 1), _idx);
-    // in case JTJ is singular
-	//SVD svd(JTJ, SVD::NO_UV);
-	//double cond = svd.w.at<double>(0)/svd.w.at<double>(5);
+    if (invDiag.needed())
+    {
+        // diagonal of the inverse normal matrix without the epsilon term
+        invDiag.create(N, 1, CV_64F);
+        Mat d = invDiag.getMat();
+        Mat Sinv;
+        if (m > 0)
+        {
+            if (!invert(S, Sinv, DECOMP_LU))
+                invert(S, Sinv, DECOMP_SVD);
+            for (int k = 0; k < m; ++k)
+                d.at<double>(6*n + k) = Sinv.at<double>(k, k);
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            Mat YS;
+            if (m > 0)
+                YS = Y[i] * Sinv;
+            for (int k = 0; k < 6; ++k)
+            {
+                double v = Uinv[i](k, k);
+                if (m > 0)
+                    v += YS.row(k).dot(Y[i].row(k));
+                d.at<double>(6*i + k) = v;
+            }
+        }
+    }
+}
 
-	//if (cond_JTJ.needed())
-	//{
-	//	cond_JTJ.create(1, 1, CV_64F);
-	//	cond_JTJ.getMat().at<double>(0) = cond;
-	//}
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// cv::omnidir::internal::computeJacobian
+
+void cv::omnidir::internal::computeJacobian(InputArrayOfArrays objectPoints, InputArrayOfArrays imagePoints,
+    InputArray parameters, Mat& JTJ_inv, Mat& JTE, int flags, double epsilon)
+{
+    std::vector<Matx66d> U;
+    std::vector<Mat> W;
+    Mat V;
+    computeNormalBlocks(objectPoints, imagePoints, parameters, flags, U, W, V, JTE);
+
+    int n = (int)U.size();
+    int m = V.rows;
+    Mat JTJ = Mat::zeros(6*n + m, 6*n + m, CV_64F);
+    for (int i = 0; i < n; ++i)
+    {
+        Mat(U[i]).copyTo(JTJ(Rect(6*i, 6*i, 6, 6)));
+        if (m > 0)
+        {
+            W[i].copyTo(JTJ(Rect(6*n, 6*i, m, 6)));
+            Mat(W[i].t()).copyTo(JTJ(Rect(6*i, 6*n, 6, m)));
+        }
+    }
+    if (m > 0)
+        V.copyTo(JTJ(Rect(6*n, 6*n, m, m)));
 
-    //double epsilon = 1e-4*std::exp(cond);
     JTJ_inv = Mat(JTJ+epsilon).inv();
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/// cv::omnidir::internal::computeGaussNewtonStep
+
+void cv::omnidir::internal::computeGaussNewtonStep(InputArrayOfArrays objectPoints, InputArrayOfArrays imagePoints,
+    InputArray parameters, Mat& G, int flags, double epsilon)
+{
+    std::vector<Matx66d> U;
+    std::vector<Mat> W;
+    Mat V, JTE;
+    computeNormalBlocks(objectPoints, imagePoints, parameters, flags, U, W, V, JTE);
+    solveSchurNormalEquations(U, W, V, JTE, epsilon, G);
+}
+
 void cv::omnidir::internal::computeJacobianStereo(InputArrayOfArrays objectPoints, InputArrayOfArrays imagePoints1, InputArrayOfArrays imagePoints2,
     InputArray parameters, Mat& JTJ_inv, Mat& JTE, int flags, double epsilon)
 {
@@ -1127,12 +1469,12 @@ double cv::omnidir::calibrate(InputArrayOfArrays patternPoints, InputArrayOfArra
             (criteria.type == 3 && (change <= criteria.epsilon || iter >= criteria.maxCount)))
             break;
         double alpha_smooth2 = 1 - std::pow(1 - alpha_smooth, (double)iter + 1.0);
-        Mat JTJ_inv, JTError;
 		double epsilon = 0.01 * std::pow(0.9, (double)iter/10);
-        cv::omnidir::internal::computeJacobian(_patternPoints, _imagePoints, currentParam, JTJ_inv, JTError, flags, epsilon);
 
-        // Gauss - Newton
-        Mat G = alpha_smooth2*JTJ_inv * JTError;
+        // Gauss - Newton, solved on the Schur complement of the extrinsic blocks
+        Mat G;
+        cv::omnidir::internal::computeGaussNewtonStep(_patternPoints, _imagePoints, currentParam, G, flags, epsilon);
+        G = alpha_smooth2*G;
 
         omnidir::internal::fillFixed(G, flags, n);
 
@@ -1783,15 +2125,18 @@ void cv::omnidir::internal::estimateUncertainties(InputArrayOfArrays objectPoint
     Mat sigma_x;
     meanStdDev(reprojError.reshape(1,1), noArray(), sigma_x);
 
-    Mat _JTJ_inv, _JTE;
-    computeJacobian(objectPoints, imagePoints, parameters, _JTJ_inv, _JTE, flags, 0.0);
-    sqrt(_JTJ_inv, _JTJ_inv);
+    std::vector<Matx66d> U;
+    std::vector<Mat> W;
+    Mat V, JTE, G, JTJ_inv_diag;
+    computeNormalBlocks(objectPoints, imagePoints, parameters, flags, U, W, V, JTE);
+    solveSchurNormalEquations(U, W, V, JTE, 0.0, G, JTJ_inv_diag);
+    sqrt(JTJ_inv_diag, JTJ_inv_diag);
 
-    int nParams = _JTJ_inv.rows;
+    int nParams = JTJ_inv_diag.rows;
     sigma_x *= sqrt(2.0*(double)reprojError.total()/(2.0*(double)reprojError.total() - nParams));
     double s = sigma_x.at<double>(0);
 
-    errors = 3 * s * _JTJ_inv.diag();
+    errors = 3 * s * JTJ_inv_diag;
 
     rms = 0;
     const Vec2d* ptr_ex = reprojError.ptr<Vec2d>();
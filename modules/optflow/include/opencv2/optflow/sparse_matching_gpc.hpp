@@ -170,8 +170,16 @@ private:
   std::vector< Node > nodes;
   GPCTrainingParams params;
 
+  // Flat node-array layout used for the batched traversal. Coefficients of the node n are stored at
+  // flatCoef[n * flatStride], children of the node n are flatChildren[2 * n] (left) and flatChildren[2 * n + 1] (right).
+  std::vector< double > flatCoef;
+  std::vector< double > flatRhs;
+  std::vector< unsigned > flatChildren;
+
   bool trainNode( size_t nodeId, SIter begin, SIter end, unsigned depth );
 
+  void buildFlatLayout();
+
 public:
   void train( GPCTrainingSamples &samples, const GPCTrainingParams params = GPCTrainingParams() );
 
@@ -179,8 +187,29 @@ public:
 
   void read( const FileNode &fn ) CV_OVERRIDE;
 
+  /** @brief Append the tree to the buffer in the binary format.
+   * The binary format stores the raw node array and is much faster to load than FileStorage.
+   * Data is written in the native byte order.
+   */
+  void writeBinary( std::vector< uchar > &buf ) const;
+
+  /** @brief Read the tree stored by writeBinary.
+   * @return Number of bytes consumed from the buffer.
+   */
+  size_t readBinary( const uchar *data, size_t size );
+
   unsigned findLeafForPatch( const GPCPatchDescriptor &descr ) const;
 
+  /** @brief Find leaves for a batch of patches at once.
+   * Traverses the tree for several descriptors simultaneously using SIMD. The dot products are summed in
+   * feature order, while findLeafForPatch sums them pairwise, so a descriptor lying within rounding error of
+   * a split may end in a different leaf than with findLeafForPatch.
+   * @param[in] descr Pointer to the first descriptor.
+   * @param[in] count Number of descriptors.
+   * @param[out] leaves Output array of at least count elements.
+   */
+  void findLeavesForPatches( const GPCPatchDescriptor *descr, size_t count, unsigned *leaves ) const;
+
   static Ptr< GPCTree > create() { return makePtr< GPCTree >(); }
 
   bool operator==( const GPCTree &t ) const { return nodes == t.nodes; }
@@ -188,6 +217,21 @@ public:
   int getDescriptorType() const { return params.descriptorType; }
 };
 
+class CV_EXPORTS_W GPCDetails
+{
+public:
+  static void writeTreesBinary( const String &filename, const GPCTree *trees, int ntrees );
+
+  static void readTreesBinary( const String &filename, GPCTree *trees, int ntrees );
+
+  static void dropOutliers( std::vector< std::pair< Point2i, Point2i > > &corr );
+
+  static void getAllDescriptorsForImage( const Mat *imgCh, std::vector< GPCPatchDescriptor > &descr, const GPCMatchingParams &mp,
+                                         int type );
+
+  static void getCoordinatesFromIndex( size_t index, Size sz, int &x, int &y );
+};
+
 template < int T > class GPCForest : public Algorithm
 {
 private:
@@ -210,6 +254,8 @@ private:
   class ParallelTrailsFilling : public ParallelLoopBody
   {
   private:
+    enum { blockSize = 256 };
+
     const GPCForest *forest;
     const std::vector< GPCPatchDescriptor > *descr;
     std::vector< Trail > *trails;
@@ -222,15 +268,46 @@ private:
 
     void operator()( const Range &range ) const CV_OVERRIDE
     {
-      for ( int t = range.start; t < range.end; ++t )
-        for ( size_t i = 0; i < descr->size(); ++i )
-          trails->at( i ).leaf[t] = forest->tree[t].findLeafForPatch( descr->at( i ) );
+      unsigned leaves[blockSize];
+      for ( int b = range.start * blockSize; b < range.end * blockSize && b < (int)descr->size(); b += blockSize )
+      {
+        const int n = std::min( (int)blockSize, (int)descr->size() - b );
+        for ( int t = 0; t < T; ++t )
+        {
+          forest->tree[t].findLeavesForPatches( &descr->at( b ), n, leaves );
+          for ( int i = 0; i < n; ++i )
+            trails->at( b + i ).leaf[t] = leaves[i];
+        }
+      }
     }
+
+    static Range blocks( size_t n ) { return Range( 0, (int)( ( n + blockSize - 1 ) / blockSize ) ); }
   };
 
   GPCTree tree[T];
 
+  void computeTrails( const Mat &img, std::vector< Trail > &trails, const GPCMatchingParams &params ) const;
+
+  static void matchTrails( const std::vector< Trail > &trailsFrom, const std::vector< Trail > &trailsTo,
+                           std::vector< std::pair< Point2i, Point2i > > &corr );
+
 public:
+  /** @brief State of the sequence matching.
+   * Keeps the sorted leaf trails of the last frame passed to findCorrespondences so they are computed only once
+   * for every frame of a sequence.
+   */
+  class SequenceState
+  {
+  private:
+    friend class GPCForest;
+    std::vector< Trail > trails;
+
+  public:
+    void reset() { trails.clear(); }
+
+    bool empty() const { return trails.empty(); }
+  };
+
   /** @brief Train the forest using one sample set for every tree.
    * Please, consider using the next method instead of this one for better quality.
    */
@@ -286,6 +363,15 @@ public:
       tree[i].read( *it );
   }
 
+  /** @brief Store the forest to a file in the binary format.
+   * It is considerably faster to load than the FileStorage representation.
+   */
+  void writeBinary( const String &filename ) const { GPCDetails::writeTreesBinary( filename, tree, T ); }
+
+  /** @brief Load the forest stored by writeBinary.
+   */
+  void readBinary( const String &filename ) { GPCDetails::readTreesBinary( filename, tree, T ); }
+
   /** @brief Find correspondences between two images.
    * @param[in] imgFrom First image in a sequence.
    * @param[in] imgTo Second image in a sequence.
@@ -295,19 +381,78 @@ public:
   void findCorrespondences( InputArray imgFrom, InputArray imgTo, std::vector< std::pair< Point2i, Point2i > > &corr,
                             const GPCMatchingParams params = GPCMatchingParams() ) const;
 
+  /** @brief Find correspondences between the previous and the next frames of a sequence.
+   * Leaf trails of the frame are computed once and kept in the state, so every frame is processed only one time.
+   * The first call after reset of the state produces no correspondences.
+   * @param[in] imgNext Next image in a sequence.
+   * @param[in,out] state Sequence state shared between the consecutive calls.
+   * @param[out] corr Output vector with pairs of corresponding points.
+   * @param[in] params Additional matching parameters for fine-tuning.
+   */
+  void findCorrespondences( InputArray imgNext, SequenceState &state, std::vector< std::pair< Point2i, Point2i > > &corr,
+                            const GPCMatchingParams params = GPCMatchingParams() ) const;
+
   static Ptr< GPCForest > create() { return makePtr< GPCForest >(); }
 };
 
-class CV_EXPORTS_W GPCDetails
+
+template < int T >
+void GPCForest< T >::computeTrails( const Mat &img, std::vector< Trail > &trails, const GPCMatchingParams &params ) const
 {
-public:
-  static void dropOutliers( std::vector< std::pair< Point2i, Point2i > > &corr );
+  CV_Assert( img.channels() == 3 );
 
-  static void getAllDescriptorsForImage( const Mat *imgCh, std::vector< GPCPatchDescriptor > &descr, const GPCMatchingParams &mp,
-                                         int type );
+  Mat ycrcb;
+  img.convertTo( ycrcb, CV_32FC3 );
+  cvtColor( ycrcb, ycrcb, COLOR_BGR2YCrCb );
 
-  static void getCoordinatesFromIndex( size_t index, Size sz, int &x, int &y );
-};
+  Mat ch[3];
+  split( ycrcb, ch );
+
+  std::vector< GPCPatchDescriptor > descr;
+  GPCDetails::getAllDescriptorsForImage( ch, descr, params, tree[0].getDescriptorType() );
+  trails.resize( descr.size() );
+
+  for ( size_t i = 0; i < descr.size(); ++i )
+    GPCDetails::getCoordinatesFromIndex( i, img.size(), trails[i].coord.x, trails[i].coord.y );
+  parallel_for_( ParallelTrailsFilling::blocks( descr.size() ), ParallelTrailsFilling( this, &descr, &trails ) );
+
+  std::sort( trails.begin(), trails.end() );
+}
+
+template < int T >
+void GPCForest< T >::matchTrails( const std::vector< Trail > &trailsFrom, const std::vector< Trail > &trailsTo,
+                                  std::vector< std::pair< Point2i, Point2i > > &corr )
+{
+  // Both sequences are sorted, so unique trails are matched in a single merge pass.
+  size_t i = 0, j = 0;
+  while ( i < trailsFrom.size() && j < trailsTo.size() )
+  {
+    size_t iEnd = i + 1, jEnd = j + 1;
+    if ( trailsFrom[i] < trailsTo[j] )
+    {
+      while ( iEnd < trailsFrom.size() && trailsFrom[iEnd] == trailsFrom[i] )
+        ++iEnd;
+      i = iEnd;
+    }
+    else if ( trailsTo[j] < trailsFrom[i] )
+    {
+      while ( jEnd < trailsTo.size() && trailsTo[jEnd] == trailsTo[j] )
+        ++jEnd;
+      j = jEnd;
+    }
+    else
+    {
+      while ( iEnd < trailsFrom.size() && trailsFrom[iEnd] == trailsFrom[i] )
+        ++iEnd;
+      while ( jEnd < trailsTo.size() && trailsTo[jEnd] == trailsTo[j] )
+        ++jEnd;
+      if ( iEnd == i + 1 && jEnd == j + 1 )
+        corr.push_back( std::make_pair( trailsFrom[i].coord, trailsTo[j].coord ) );
+      i = iEnd;
+      j = jEnd;
+    }
+  }
+}
 
 template < int T >
 void GPCForest< T >::findCorrespondences( InputArray imgFrom, InputArray imgTo, std::vector< std::pair< Point2i, Point2i > > &corr,
@@ -316,48 +461,31 @@ void GPCForest< T >::findCorrespondences( InputArray imgFrom, InputArray imgTo,
   CV_Assert( imgFrom.channels() == 3 );
   CV_Assert( imgTo.channels() == 3 );
 
-  Mat from, to;
-  imgFrom.getMat().convertTo( from, CV_32FC3 );
-  imgTo.getMat().convertTo( to, CV_32FC3 );
-  cvtColor( from, from, COLOR_BGR2YCrCb );
-  cvtColor( to, to, COLOR_BGR2YCrCb );
-
-  Mat fromCh[3], toCh[3];
-  split( from, fromCh );
-  split( to, toCh );
-
-  std::vector< GPCPatchDescriptor > descr;
-  GPCDetails::getAllDescriptorsForImage( fromCh, descr, params, tree[0].getDescriptorType() );
-  std::vector< Trail > trailsFrom( descr.size() ), trailsTo( descr.size() );
+  std::vector< Trail > trailsFrom, trailsTo;
+  computeTrails( imgFrom.getMat(), trailsFrom, params );
+  computeTrails( imgTo.getMat(), trailsTo, params );
 
-  for ( size_t i = 0; i < descr.size(); ++i )
-    GPCDetails::getCoordinatesFromIndex( i, from.size(), trailsFrom[i].coord.x, trailsFrom[i].coord.y );
-  parallel_for_( Range( 0, T ), ParallelTrailsFilling( this, &descr, &trailsFrom ) );
+  matchTrails( trailsFrom, trailsTo, corr );
 
-  descr.clear();
-  GPCDetails::getAllDescriptorsForImage( toCh, descr, params, tree[0].getDescriptorType() );
+  GPCDetails::dropOutliers( corr );
+}
 
-  for ( size_t i = 0; i < descr.size(); ++i )
-    GPCDetails::getCoordinatesFromIndex( i, to.size(), trailsTo[i].coord.x, trailsTo[i].coord.y );
-  parallel_for_( Range( 0, T ), ParallelTrailsFilling( this, &descr, &trailsTo ) );
+template < int T >
+void GPCForest< T >::findCorrespondences( InputArray imgNext, SequenceState &state, std::vector< std::pair< Point2i, Point2i > > &corr,
+                                          const GPCMatchingParams params ) const
+{
+  CV_Assert( imgNext.channels() == 3 );
 
-  std::sort( trailsFrom.begin(), trailsFrom.end() );
-  std::sort( trailsTo.begin(), trailsTo.end() );
+  std::vector< Trail > trailsNext;
+  computeTrails( imgNext.getMat(), trailsNext, params );
 
-  for ( size_t i = 0; i < trailsFrom.size(); ++i )
+  if ( !state.trails.empty() )
   {
-    bool uniq = true;
-    while ( i + 1 < trailsFrom.size() && trailsFrom[i] == trailsFrom[i + 1] )
-      ++i, uniq = false;
-    if ( uniq )
-    {
-      typename std::vector< Trail >::const_iterator lb = std::lower_bound( trailsTo.begin(), trailsTo.end(), trailsFrom[i] );
-      if ( lb != trailsTo.end() && *lb == trailsFrom[i] && ( ( lb + 1 ) == trailsTo.end() || !( *lb == *( lb + 1 ) ) ) )
-        corr.push_back( std::make_pair( trailsFrom[i].coord, lb->coord ) );
-    }
+    matchTrails( state.trails, trailsNext, corr );
+    GPCDetails::dropOutliers( corr );
   }
 
-  GPCDetails::dropOutliers( corr );
+  state.trails.swap( trailsNext );
 }
 
 //! @}
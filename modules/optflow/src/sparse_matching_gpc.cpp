@@ -47,6 +47,7 @@
 #include "opencv2/imgcodecs.hpp"
 #include "opencl_kernels_optflow.hpp"
 #include "opencv2/core/hal/intrin.hpp"
+#include <fstream>
 #ifdef CV_CXX11
 #include <random>  // std::mt19937
 #endif
@@ -84,6 +85,9 @@ const unsigned scoreGainNeg = 1;
 const unsigned negSearchKNN = 5;
 const double simulatedAnnealingTemperatureCoef = 200.0;
 const double sigmaGrowthRate = 0.2;
+const unsigned flatStride = GPCPatchDescriptor::nFeatures; // Coefficients per node in the flat layout, see buildFlatLayout()
+const char binaryMagic[4] = { 'G', 'P', 'C', 'F' };
+const int binaryVersion = 1;
 
 RNG rng;
 
@@ -634,6 +638,22 @@ bool GPCTree::trainNode( size_t nodeId, SIter begin, SIter end, unsigned depth )
   return true;
 }
 
+void GPCTree::buildFlatLayout()
+{
+  flatCoef.assign( nodes.size() * flatStride, 0.0 );
+  flatRhs.resize( nodes.size() );
+  flatChildren.resize( nodes.size() * 2 );
+
+  for ( size_t n = 0; n < nodes.size(); ++n )
+  {
+    for ( unsigned k = 0; k < GPCPatchDescriptor::nFeatures; ++k )
+      flatCoef[n * flatStride + k] = nodes[n].coef[k];
+    flatRhs[n] = nodes[n].rhs;
+    flatChildren[2 * n] = nodes[n].left;
+    flatChildren[2 * n + 1] = nodes[n].right;
+  }
+}
+
 void GPCTree::train( GPCTrainingSamples &samples, const GPCTrainingParams _params )
 {
   if ( _params.descriptorType != samples.type() )
@@ -643,6 +663,7 @@ void GPCTree::train( GPCTrainingSamples &samples, const GPCTrainingParams _param
   params = _params;
   GPCSamplesVector &sv = samples;
   trainNode( 0, sv.begin(), sv.end(), 0 );
+  buildFlatLayout();
 }
 
 void GPCTree::write( FileStorage &fs ) const
@@ -657,6 +678,60 @@ void GPCTree::read( const FileNode &fn )
 {
   fn["nodes"] >> nodes;
   fn["dtype"] >> (int &)params.descriptorType;
+  CV_Assert( params.descriptorType == GPC_DESCRIPTOR_DCT || params.descriptorType == GPC_DESCRIPTOR_WHT );
+  buildFlatLayout();
+}
+
+void GPCTree::writeBinary( std::vector< uchar > &buf ) const
+{
+  if ( nodes.empty() )
+    CV_Error( Error::StsBadArg, "Tree have not been trained" );
+
+  const int header[2] = { params.descriptorType, (int)nodes.size() };
+  const uchar *headerPtr = reinterpret_cast< const uchar * >( header );
+  buf.insert( buf.end(), headerPtr, headerPtr + sizeof( header ) );
+
+  for ( size_t n = 0; n < nodes.size(); ++n )
+  {
+    const uchar *coefPtr = reinterpret_cast< const uchar * >( nodes[n].coef.val );
+    buf.insert( buf.end(), coefPtr, coefPtr + sizeof( nodes[n].coef.val ) );
+    const uchar *rhsPtr = reinterpret_cast< const uchar * >( &nodes[n].rhs );
+    buf.insert( buf.end(), rhsPtr, rhsPtr + sizeof( double ) );
+    const unsigned children[2] = { nodes[n].left, nodes[n].right };
+    const uchar *childrenPtr = reinterpret_cast< const uchar * >( children );
+    buf.insert( buf.end(), childrenPtr, childrenPtr + sizeof( children ) );
+  }
+}
+
+size_t GPCTree::readBinary( const uchar *data, size_t size )
+{
+  const size_t nodeSize = sizeof( Node().coef.val ) + sizeof( double ) + 2 * sizeof( unsigned );
+  int header[2];
+  CV_Assert( size >= sizeof( header ) );
+  memcpy( header, data, sizeof( header ) );
+  CV_Assert( header[0] == GPC_DESCRIPTOR_DCT || header[0] == GPC_DESCRIPTOR_WHT );
+  CV_Assert( header[1] > 0 && ( size - sizeof( header ) ) / nodeSize >= (size_t)header[1] );
+
+  params.descriptorType = header[0];
+  nodes.resize( header[1] );
+  const uchar *ptr = data + sizeof( header );
+
+  for ( size_t n = 0; n < nodes.size(); ++n )
+  {
+    memcpy( nodes[n].coef.val, ptr, sizeof( nodes[n].coef.val ) );
+    ptr += sizeof( nodes[n].coef.val );
+    memcpy( &nodes[n].rhs, ptr, sizeof( double ) );
+    ptr += sizeof( double );
+    unsigned children[2];
+    memcpy( children, ptr, sizeof( children ) );
+    ptr += sizeof( children );
+    CV_Assert( children[0] < nodes.size() && children[1] < nodes.size() );
+    nodes[n].left = children[0];
+    nodes[n].right = children[1];
+  }
+
+  buildFlatLayout();
+  return ptr - data;
 }
 
 unsigned GPCTree::findLeafForPatch( const GPCPatchDescriptor &descr ) const
@@ -673,6 +748,83 @@ unsigned GPCTree::findLeafForPatch( const GPCPatchDescriptor &descr ) const
   return prevId;
 }
 
+void GPCTree::findLeavesForPatches( const GPCPatchDescriptor *descr, size_t count, unsigned *leaves ) const
+{
+  CV_Assert( !nodes.empty() && flatRhs.size() == nodes.size() );
+  const double *coef = flatCoef.data();
+  const double *rhs = flatRhs.data();
+  const unsigned *children = flatChildren.data();
+  size_t i = 0;
+
+#if ( CV_SIMD_64F || CV_SIMD_SCALABLE_64F )
+  const int vlanes = VTraits< v_float64 >::vlanes();
+  const int nFeatures = GPCPatchDescriptor::nFeatures;
+  // Descriptors are transposed so that every lane of a vector register walks its own path in the tree.
+  AutoBuffer< double > features( nFeatures * vlanes );
+  AutoBuffer< double > dots( vlanes );
+  AutoBuffer< int > offsets( vlanes );
+  AutoBuffer< unsigned > ids( vlanes );
+  AutoBuffer< uchar > done( vlanes );
+
+  for ( ; i + vlanes <= count; i += vlanes )
+  {
+    for ( int l = 0; l < vlanes; ++l )
+    {
+      for ( int k = 0; k < nFeatures; ++k )
+        features[k * vlanes + l] = descr[i + l].feature[k];
+      ids[l] = 0;
+      offsets[l] = 0;
+      done[l] = 0;
+    }
+
+    int active = vlanes;
+    while ( active > 0 )
+    {
+      // mul+add rather than fma, so every lane sums exactly like the scalar loop below
+      v_float64 sum = vx_setzero_f64();
+      for ( int k = 0; k < nFeatures; ++k )
+        sum = v_add( sum, v_mul( vx_load( features.data() + k * vlanes ), v_lut( coef + k, offsets.data() ) ) );
+      v_store( dots.data(), sum );
+
+      for ( int l = 0; l < vlanes; ++l )
+      {
+        if ( done[l] )
+          continue;
+        const unsigned id = ids[l];
+        const unsigned next = children[2 * id + ( dots[l] < rhs[id] ? 1 : 0 )];
+        if ( next )
+        {
+          ids[l] = next;
+          offsets[l] = int( next * flatStride );
+        }
+        else
+        {
+          // Finished lanes keep gathering the root node, their results are ignored.
+          leaves[i + l] = id;
+          offsets[l] = 0;
+          done[l] = 1;
+          --active;
+        }
+      }
+    }
+  }
+#endif
+
+  for ( ; i < count; ++i )
+  {
+    unsigned id = 0, prevId;
+    do
+    {
+      prevId = id;
+      double dot = 0;
+      for ( unsigned k = 0; k < GPCPatchDescriptor::nFeatures; ++k )
+        dot += descr[i].feature[k] * coef[id * flatStride + k];
+      id = children[2 * id + ( dot < rhs[id] ? 1 : 0 )];
+    } while ( id );
+    leaves[i] = prevId;
+  }
+}
+
 Ptr< GPCTrainingSamples > GPCTrainingSamples::create( const std::vector< String > &imagesFrom, const std::vector< String > &imagesTo,
                                                       const std::vector< String > &gt, int _descriptorType )
 {
@@ -737,6 +889,41 @@ Ptr< GPCTrainingSamples > GPCTrainingSamples::create( InputArrayOfArrays imagesF
   return ts;
 }
 
+void GPCDetails::writeTreesBinary( const String &filename, const GPCTree *trees, int ntrees )
+{
+  std::vector< uchar > buf( binaryMagic, binaryMagic + sizeof( binaryMagic ) );
+  const int header[2] = { binaryVersion, ntrees };
+  const uchar *headerPtr = reinterpret_cast< const uchar * >( header );
+  buf.insert( buf.end(), headerPtr, headerPtr + sizeof( header ) );
+
+  for ( int i = 0; i < ntrees; ++i )
+    trees[i].writeBinary( buf );
+
+  std::ofstream file( filename.c_str(), std::ios::binary );
+  if ( !file.write( reinterpret_cast< const char * >( buf.data() ), buf.size() ) )
+    CV_Error( Error::StsError, "Can't write the forest to " + filename );
+}
+
+void GPCDetails::readTreesBinary( const String &filename, GPCTree *trees, int ntrees )
+{
+  std::ifstream file( filename.c_str(), std::ios::binary );
+  if ( !file )
+    CV_Error( Error::StsObjectNotFound, "Can't open " + filename );
+  std::vector< uchar > buf( ( std::istreambuf_iterator< char >( file ) ), std::istreambuf_iterator< char >() );
+
+  int header[2];
+  if ( buf.size() < sizeof( binaryMagic ) + sizeof( header ) || memcmp( buf.data(), binaryMagic, sizeof( binaryMagic ) ) != 0 )
+    CV_Error( Error::StsParseError, "Not a binary GPC forest: " + filename );
+  memcpy( header, buf.data() + sizeof( binaryMagic ), sizeof( header ) );
+  if ( header[0] != binaryVersion )
+    CV_Error( Error::StsParseError, "Unsupported version of the binary GPC forest" );
+  CV_Assert( ntrees <= header[1] );
+
+  size_t offset = sizeof( binaryMagic ) + sizeof( header );
+  for ( int i = 0; i < ntrees; ++i )
+    offset += trees[i].readBinary( buf.data() + offset, buf.size() - offset );
+}
+
 void GPCDetails::dropOutliers( std::vector< std::pair< Point2i, Point2i > > &corr )
 {
   if ( corr.size() == 0 )
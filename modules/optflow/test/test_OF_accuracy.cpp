@@ -350,4 +350,60 @@ TEST(DenseOpticalFlow_GlobalPatchColliderWHT, ReferenceAccuracy)
 }
 
 
+TEST(DenseOpticalFlow_GlobalPatchCollider, BinaryFormatAndSequence)
+{
+    Mat frame1, frame2, GT;
+    ASSERT_TRUE(readRubberWhale(frame1, frame2, GT));
+
+    const Size sz = frame1.size() / 2;
+    frame1 = frame1(Rect(0, 0, sz.width, sz.height));
+    frame2 = frame2(Rect(0, 0, sz.width, sz.height));
+    GT = GT(Rect(0, 0, sz.width, sz.height));
+
+    vector<Mat> img1, img2, gt;
+    img1.push_back(frame1);
+    img2.push_back(frame2);
+    gt.push_back(GT);
+
+    Ptr< GPCForest<5> > forest = GPCForest<5>::create();
+    forest->train(img1, img2, gt, GPCTrainingParams(8, 3, GPC_DESCRIPTOR_WHT, false));
+
+    const String fileName = cv::tempfile(".gpc");
+    forest->writeBinary(fileName);
+    Ptr< GPCForest<5> > loaded = GPCForest<5>::create();
+    loaded->readBinary(fileName);
+    remove(fileName.c_str());
+
+    vector< pair<Point2i, Point2i> > corr, corrLoaded, corrSequence;
+    forest->findCorrespondences(frame1, frame2, corr);
+    loaded->findCorrespondences(frame1, frame2, corrLoaded);
+
+    GPCForest<5>::SequenceState state;
+    loaded->findCorrespondences(frame1, state, corrSequence);
+    ASSERT_TRUE(corrSequence.empty());
+    ASSERT_FALSE(state.empty());
+    loaded->findCorrespondences(frame2, state, corrSequence);
+
+    ASSERT_LE(7000U, corr.size());
+    ASSERT_TRUE(corr == corrLoaded);
+    ASSERT_TRUE(corr == corrSequence);
+}
+
+TEST(DenseOpticalFlow_GlobalPatchCollider, BinaryFormatDescriptorType)
+{
+    // header { descriptor type, number of nodes } followed by one leaf node
+    const size_t nodeSize = GPCPatchDescriptor::nFeatures * sizeof(double) + sizeof(double) + 2 * sizeof(unsigned);
+    vector<uchar> buf(2 * sizeof(int) + nodeSize, 0);
+    int header[2] = { GPC_DESCRIPTOR_WHT, 1 };
+    memcpy(&buf[0], header, sizeof(header));
+
+    GPCTree tree;
+    EXPECT_EQ(buf.size(), tree.readBinary(&buf[0], buf.size()));
+    EXPECT_EQ((int)GPC_DESCRIPTOR_WHT, tree.getDescriptorType());
+
+    header[0] = 7;
+    memcpy(&buf[0], header, sizeof(header));
+    EXPECT_THROW(tree.readBinary(&buf[0], buf.size()), cv::Exception);
+}
+
 }} // namespace
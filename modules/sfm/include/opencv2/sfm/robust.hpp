@@ -61,6 +61,8 @@ namespace sfm
          The more this value is high, the less the function selects ramdom samples.
 
 The fundamental solver relies on the 8 point solution. Returns the best error (in pixels), associated to the solution F.
+The hypotheses are scored in parallel, with an early exit as soon as they cannot beat the best one; the results do not
+depend on the number of threads.
  */
 CV_EXPORTS_W
 double
@@ -94,6 +96,30 @@ fundamentalFromCorrespondences7PointRobust( InputArray x1,
                                             OutputArray inliers,
                                             double outliers_probability = 1e-2 );
 
+/** @brief Estimate robustly the fundamental matrices of many pairs of views at once.
+  @param x1 Input vector of 2xN arrays of 2D points in the first view of each pair.
+  @param x2 Input vector of 2xN arrays of 2D points in the second view of each pair.
+  @param max_error maximum error (in pixels).
+  @param F Output vector of 3x3 fundamental matrices such that \f$x_2^T F x_1=0\f$, one per pair.
+  @param inliers Output vector of the indexes of the detected inliers of each pair.
+  @param errors Output vector of the best error (in pixels) of each pair.
+  @param num_points number of points of the minimal solver, 7 or 8.
+  @param outliers_probability outliers probability (in ]0,1[), see fundamentalFromCorrespondences8PointRobust.
+
+The pairs are processed in parallel. The results are the same as the ones of fundamentalFromCorrespondences7PointRobust
+or fundamentalFromCorrespondences8PointRobust called on each pair.
+ */
+CV_EXPORTS_W
+void
+fundamentalFromCorrespondencesRobust( InputArrayOfArrays x1,
+                                      InputArrayOfArrays x2,
+                                      double max_error,
+                                      OutputArrayOfArrays F,
+                                      CV_OUT std::vector<std::vector<int> > &inliers,
+                                      CV_OUT std::vector<double> &errors,
+                                      int num_points = 7,
+                                      double outliers_probability = 1e-2 );
+
 //! @} sfm
 
 } /* namespace cv */
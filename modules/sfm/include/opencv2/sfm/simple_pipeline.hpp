@@ -134,6 +134,9 @@ enum { SFM_REFINE_FOCAL_LENGTH         = (1 << 0),  // libmv::BUNDLE_FOCAL_LENGT
   @param _refine_intrinsics camera parameter or combination of parameters to refine.
   @param _select_keyframes allows to select automatically the initial keyframes. If 1 then autoselection is enabled. If 0 then is disabled.
   @param _verbosity_level verbosity logs level for Glog. If -1 then logs are disabled, otherwise the log level will be the input integer.
+  @param _num_threads number of threads used to resect and intersect independent views and by the bundle adjustment. If -1 then cv::getNumThreads() is used.
+  @param _matching_candidates when reconstructing from images, number of most similar images (by bag of visual words) each image is matched with, in addition to the previous image. If 0 then all the pairs of images are matched.
+  @param _matching_cache_dir when reconstructing from images, directory where the features and matches are stored and reused by the next runs. If empty then nothing is stored.
  */
 class CV_EXPORTS_W_SIMPLE libmv_ReconstructionOptions
 {
@@ -143,16 +146,25 @@ public:
                               const int _keyframe2=2,
                               const int _refine_intrinsics=1,
                               const int _select_keyframes=1,
-                              const int _verbosity_level=-1)
+                              const int _verbosity_level=-1,
+                              const int _num_threads=-1,
+                              const int _matching_candidates=0,
+                              const String &_matching_cache_dir=String())
     : keyframe1(_keyframe1), keyframe2(_keyframe2),
       refine_intrinsics(_refine_intrinsics),
       select_keyframes(_select_keyframes),
-      verbosity_level(_verbosity_level) {}
+      verbosity_level(_verbosity_level),
+      num_threads(_num_threads),
+      matching_candidates(_matching_candidates),
+      matching_cache_dir(_matching_cache_dir) {}
 
   CV_PROP_RW int keyframe1, keyframe2;
   CV_PROP_RW int refine_intrinsics;
   CV_PROP_RW int select_keyframes;
   CV_PROP_RW int verbosity_level;
+  CV_PROP_RW int num_threads;
+  CV_PROP_RW int matching_candidates;
+  CV_PROP_RW String matching_cache_dir;
 };
 
 
@@ -44,6 +44,7 @@
 
 #include <memory>
 
+#include "libmv/base/parallel.h"
 #include "libmv/logging/logging.h"
 
 #include "libmv/correspondence/feature.h"
@@ -375,6 +376,11 @@ std::shared_ptr<libmv_Reconstruction> libmv_solveReconstruction(
   EuclideanReconstruction &reconstruction =
     libmv_reconstruction->reconstruction;
 
+  /* Threads used by the resection, intersection and bundle adjustment. */
+  libmv::SetNumThreads(libmv_reconstruction_options->num_threads > 0 ?
+                       libmv_reconstruction_options->num_threads :
+                       cv::getNumThreads());
+
   /* Retrieve reconstruction options from C-API to libmv API. */
   std::shared_ptr<CameraIntrinsics> camera_intrinsics;
   camera_intrinsics = libmv_reconstruction->intrinsics =
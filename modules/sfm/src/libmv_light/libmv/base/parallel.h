@@ -0,0 +1,107 @@
+// Copyright (c) 2007, 2008 libmv authors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Thread count shared by the pipeline (bundle adjustment, resection and
+// intersection) and a minimal parallel loop over independent work items.
+
+#ifndef LIBMV_BASE_PARALLEL_H
+#define LIBMV_BASE_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libmv {
+
+namespace internal {
+inline std::atomic<int> &NumThreadsStorage() {
+  static std::atomic<int> num_threads(0);
+  return num_threads;
+}
+}  // namespace internal
+
+// Sets the number of threads used by the pipeline, zero or a negative value
+// means all the hardware threads.
+inline void SetNumThreads(int num_threads) {
+  internal::NumThreadsStorage() = num_threads;
+}
+
+// Returns the number of threads used by the pipeline, at least one.
+inline int NumThreads() {
+  int num_threads = internal::NumThreadsStorage();
+  if (num_threads <= 0) {
+    num_threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  return std::max(num_threads, 1);
+}
+
+// Calls f(i) for every i in [begin, end) using up to NumThreads() threads,
+// the caller being one of them. The calls must be independent of each other.
+// An exception thrown by f is rethrown on the caller once all threads are
+// done.
+template <typename Function>
+void ParallelFor(int begin, int end, const Function &f) {
+  const int num_threads = std::min(NumThreads(), end - begin);
+  if (num_threads <= 1) {
+    for (int i = begin; i < end; ++i) {
+      f(i);
+    }
+    return;
+  }
+
+  std::atomic<int> next(begin);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  auto worker = [&]() {
+    try {
+      for (int i = next++; i < end; i = next++) {
+        f(i);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+      next = end;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (int i = 1; i < num_threads; ++i) {
+    threads.push_back(std::thread(worker));
+  }
+  worker();
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+}  // namespace libmv
+
+#endif  // LIBMV_BASE_PARALLEL_H
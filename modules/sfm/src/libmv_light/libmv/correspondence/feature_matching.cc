@@ -85,31 +85,43 @@ void FindCandidateMatches_Ratio(const FeatureSet &left,
   if (left.features.empty() || right.features.empty())
     return;
 
-  cv::FlannBasedMatcher matcherA;
-
   // Paste the necessary data in contiguous arrays.
   cv::Mat arrayA = FeatureSet::FeatureSetDescriptorsToContiguousArray(left);
   cv::Mat arrayB = FeatureSet::FeatureSetDescriptorsToContiguousArray(right);
 
-  matcherA.add(std::vector<cv::Mat>(1, arrayB));
+  std::vector<cv::DMatch> matchesA;
+  FindCandidateMatches_Ratio(arrayA, arrayB, &matchesA, fRatio);
+
+  for (size_t i = 0; i < matchesA.size(); ++i)
+  {
+    matches->Insert(0, (int)i, &left.features[matchesA[i].queryIdx]);
+    matches->Insert(1, (int)i, &right.features[matchesA[i].trainIdx]);
+  }
+}
+
+// Compute candidate matches between 2 arrays of descriptors with a ratio.
+void FindCandidateMatches_Ratio(const cv::Mat &descriptorsLeft,
+                                const cv::Mat &descriptorsRight,
+                                std::vector<cv::DMatch> *matches,
+                                float fRatio) {
+  matches->clear();
+  if (descriptorsLeft.empty() || descriptorsRight.empty())
+    return;
+
+  cv::FlannBasedMatcher matcherA;
+  matcherA.add(std::vector<cv::Mat>(1, descriptorsRight));
   std::vector < std::vector<cv::DMatch> > matchesA;
-  matcherA.knnMatch(arrayA, matchesA, 2);
+  matcherA.knnMatch(descriptorsLeft, matchesA, 2);
 
   // From putative matches get matches that fit the "Ratio" heuristic.
-  int max_track_number = 0;
   for (size_t i = 0; i < matchesA.size(); ++i)
   {
+    if (matchesA[i].size() < 2)
+      continue;
     float distance0 = matchesA[i][0].distance;
     float distance1 = matchesA[i][1].distance;
-    // Add the match only if we have a symmetric result.
     if (distance0 < fRatio * distance1)
-    {
-      {
-        matches->Insert(0, max_track_number, &left.features[i]);
-        matches->Insert(1, max_track_number, &right.features[matchesA[i][0].trainIdx]);
-        ++max_track_number;
-      }
-    }
+      matches->push_back(matchesA[i][0]);
   }
 }
 
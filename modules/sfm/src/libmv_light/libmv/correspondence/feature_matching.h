@@ -85,6 +85,14 @@ void FindCandidateMatches_Ratio(const FeatureSet &left,
                           const FeatureSet &right,
                           Matches *matches,
                           float fRatio = 0.8f);
+
+// Same as above on the contiguous descriptor arrays of the two sets: the
+// queryIdx and trainIdx of the matches index the rows of descriptorsLeft and
+// descriptorsRight.
+void FindCandidateMatches_Ratio(const cv::Mat &descriptorsLeft,
+                                const cv::Mat &descriptorsRight,
+                                std::vector<cv::DMatch> *matches,
+                                float fRatio = 0.8f);
 // TODO(pmoulon) Add Lowe's ratio symmetric match method.
 // Compute correspondences that match between 2 sets of features with a ratio.
 
@@ -18,6 +18,14 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
 // IN THE SOFTWARE.
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <set>
+
+#include <opencv2/core/utils/filesystem.hpp>
+#include <opencv2/features2d.hpp>
 #include <opencv2/imgcodecs.hpp>
 
 #include "libmv/base/vector_utils.h"
@@ -30,7 +38,128 @@ using namespace libmv;
 using namespace correspondence;
 using namespace std;
 
-nRobustViewMatching::nRobustViewMatching(){
+namespace {
+
+// Name of the cache entries of an image (64 bits FNV-1a hash of its name).
+string CacheKey(const string & filename) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < filename.size(); ++i) {
+    hash ^= (unsigned char)filename[i];
+    hash *= 1099511628211ULL;
+  }
+  char key[17];
+  snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+  return key;
+}
+
+string Feature2DName(const std::shared_ptr<cv::Feature2D> & feature2D) {
+  return feature2D ? feature2D->getDefaultName() : string();
+}
+
+}  // namespace
+
+namespace libmv {
+namespace correspondence {
+
+std::vector<std::pair<int, int> > SelectCandidatePairs(
+    const std::vector<cv::Mat> & descriptors,
+    int num_candidates) {
+  const int kVocabularySize = 128;
+  const int kSamplesPerView = 100;
+
+  const int n = (int)descriptors.size();
+  bool exhaustive = num_candidates <= 0 || num_candidates >= n - 1;
+  for (int i = 0; i < n && !exhaustive; ++i) {
+    exhaustive = descriptors[i].empty() || descriptors[i].type() != CV_32F;
+  }
+
+  std::vector<std::pair<int, int> > pairs;
+  if (exhaustive) {
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < i; ++j) {
+        pairs.push_back(make_pair(i, j));
+      }
+    }
+    return pairs;
+  }
+
+  // Learn a small visual vocabulary on a subsample of the descriptors.
+  cv::Mat samples;
+  for (int i = 0; i < n; ++i) {
+    const int step = max(1, descriptors[i].rows / kSamplesPerView);
+    for (int r = 0; r < descriptors[i].rows; r += step) {
+      samples.push_back(descriptors[i].row(r));
+    }
+  }
+  const int num_words = min(kVocabularySize, samples.rows);
+  cv::Mat labels, vocabulary;
+  const cv::RNG rng = cv::theRNG();
+  cv::theRNG() = cv::RNG(0x12345);
+  cv::kmeans(samples, num_words, labels,
+             cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS,
+                              10, 1e-3),
+             1, cv::KMEANS_PP_CENTERS, vocabulary);
+  cv::theRNG() = rng;
+
+  // Histogram of the visual words of each view.
+  cv::Mat histograms(n, num_words, CV_32F, cv::Scalar::all(0));
+  cv::parallel_for_(cv::Range(0, n), [&](const cv::Range & range) {
+    cv::BFMatcher matcher(cv::NORM_L2);
+    std::vector<cv::DMatch> words;
+    for (int i = range.start; i < range.end; ++i) {
+      matcher.match(descriptors[i], vocabulary, words);
+      float * histogram = histograms.ptr<float>(i);
+      for (size_t k = 0; k < words.size(); ++k) {
+        histogram[words[k].trainIdx] += 1.f;
+      }
+    }
+  });
+
+  // Weight the words by their inverse document frequency, so the words seen
+  // in every view do not make all the views similar.
+  std::vector<float> idf(num_words);
+  for (int w = 0; w < num_words; ++w) {
+    const int df = cv::countNonZero(histograms.col(w));
+    idf[w] = std::log((float)n / max(df, 1));
+  }
+  for (int i = 0; i < n; ++i) {
+    float * histogram = histograms.ptr<float>(i);
+    for (int w = 0; w < num_words; ++w) {
+      histogram[w] *= idf[w];
+    }
+    cv::Mat row = histograms.row(i);
+    cv::normalize(row, row);
+  }
+  cv::Mat similarity = histograms * histograms.t();
+
+  std::set<std::pair<int, int> > selected;
+  std::vector<std::pair<float, int> > scores;
+  for (int i = 0; i < n; ++i) {
+    scores.clear();
+    for (int j = 0; j < n; ++j) {
+      if (j != i) {
+        scores.push_back(make_pair(-similarity.at<float>(i, j), j));
+      }
+    }
+    partial_sort(scores.begin(), scores.begin() + num_candidates,
+                 scores.end());
+    for (int k = 0; k < num_candidates; ++k) {
+      const int j = scores[k].second;
+      selected.insert(make_pair(max(i, j), min(i, j)));
+    }
+    if (i > 0) {
+      selected.insert(make_pair(i, i - 1));
+    }
+  }
+  pairs.assign(selected.begin(), selected.end());
+  return pairs;
+}
+
+}  // namespace correspondence
+}  // namespace libmv
+
+nRobustViewMatching::nRobustViewMatching()
+  : m_numCandidates(0) {
 #ifdef CV_VERSION_EPOCH
   m_pDescriber = NULL;
 #endif
@@ -38,11 +167,70 @@ nRobustViewMatching::nRobustViewMatching(){
 
 nRobustViewMatching::nRobustViewMatching(
     cv::Ptr<cv::FeatureDetector> pDetector,
-    cv::Ptr<cv::DescriptorExtractor> pDescriber){
+    cv::Ptr<cv::DescriptorExtractor> pDescriber)
+  : m_numCandidates(0) {
   m_pDetector = pDetector;
   m_pDescriber = pDescriber;
 }
 
+void nRobustViewMatching::setCacheDirectory(const string & directory)
+{
+  m_cacheDirectory = directory;
+  if (!m_cacheDirectory.empty() &&
+      !cv::utils::fs::createDirectories(m_cacheDirectory)) {
+    LOG(ERROR) << "Could not create the cache directory "
+               << m_cacheDirectory << ", the cache is disabled.";
+    m_cacheDirectory.clear();
+  }
+}
+
+bool nRobustViewMatching::loadData(const string & filename,
+                                   std::vector<cv::KeyPoint> * keypoints,
+                                   cv::Mat * descriptors) const
+{
+  if (m_cacheDirectory.empty())
+    return false;
+  const string path = cv::utils::fs::join(m_cacheDirectory,
+                                          CacheKey(filename) + ".features.yml.gz");
+  if (!cv::utils::fs::exists(path))
+    return false;
+  try {
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if (!fs.isOpened() ||
+        (string)fs["image"] != filename ||
+        (string)fs["detector"] != Feature2DName(m_pDetector) ||
+        (string)fs["describer"] != Feature2DName(m_pDescriber))
+      return false;
+    fs["keypoints"] >> *keypoints;
+    fs["descriptors"] >> *descriptors;
+  } catch (const cv::Exception & e) {
+    LOG(INFO) << "Ignoring the cached features of " << filename
+              << ": " << e.what();
+    return false;
+  }
+  return descriptors->rows == (int)keypoints->size();
+}
+
+void nRobustViewMatching::saveData(const string & filename,
+                                   const std::vector<cv::KeyPoint> & keypoints,
+                                   const cv::Mat & descriptors) const
+{
+  if (m_cacheDirectory.empty())
+    return;
+  const string path = cv::utils::fs::join(m_cacheDirectory,
+                                          CacheKey(filename) + ".features.yml.gz");
+  cv::FileStorage fs(path, cv::FileStorage::WRITE);
+  if (!fs.isOpened()) {
+    LOG(ERROR) << "Could not write " << path;
+    return;
+  }
+  fs << "image" << filename;
+  fs << "detector" << Feature2DName(m_pDetector);
+  fs << "describer" << Feature2DName(m_pDescriber);
+  fs << "keypoints" << keypoints;
+  fs << "descriptors" << descriptors;
+}
+
 /**
  * Compute the data and store it in the class map<string,T>
  *
@@ -52,40 +240,152 @@ nRobustViewMatching::nRobustViewMatching(
  */
 bool nRobustViewMatching::computeData(const string & filename)
 {
-  cv::Mat im_cv = cv::imread(filename, 0);
-  if (im_cv.empty()) {
-    LOG(FATAL) << "Failed loading image: " << filename;
+  std::vector<cv::KeyPoint> features_cv;
+  cv::Mat descriptors;
+  if (!loadData(filename, &features_cv, &descriptors))
+  {
+    cv::Mat im_cv = cv::imread(filename, 0);
+    if (im_cv.empty()) {
+      LOG(FATAL) << "Failed loading image: " << filename;
+      return false;
+    }
+    m_pDetector->detect( im_cv, features_cv );
+    // The describer may drop keypoints: keep the ones of the descriptors.
+    m_pDescriber->compute(im_cv, features_cv, descriptors);
+    saveData(filename, features_cv, descriptors);
+  }
+
+  // Copy data.
+  FeatureSet & KeypointData = m_ViewData[filename];
+  KeypointData.features.resize(descriptors.rows);
+  for(int i = 0;i < descriptors.rows; ++i)
+  {
+    KeypointFeature & feat = KeypointData.features[i];
+    descriptors.row(i).copyTo(feat.descriptor);
+    static_cast<PointFeature &>(feat) = PointFeature(features_cv[i]);
+  }
+  m_ViewDescriptors[filename] = descriptors;
+
+  return true;
+}
+
+bool nRobustViewMatching::computePutativeMatches(
+    int dataAindex,
+    int dataBindex,
+    std::vector<cv::DMatch> * putativeMatches) const
+{
+  const string & dataA = m_vec_InputNames[dataAindex];
+  const string & dataB = m_vec_InputNames[dataBindex];
+  map<string,cv::Mat>::const_iterator iterA = m_ViewDescriptors.find(dataA);
+  map<string,cv::Mat>::const_iterator iterB = m_ViewDescriptors.find(dataB);
+  if (iterA == m_ViewDescriptors.end() || iterB == m_ViewDescriptors.end())
+  {
+    LOG(INFO) << "[nViewMatching::MatchData] "
+              << "Could not identify data for one of the input name.";
     return false;
   }
-  else
+  const cv::Mat & descriptorsA = iterA->second;
+  const cv::Mat & descriptorsB = iterB->second;
+
+  string path;
+  if (!m_cacheDirectory.empty())
   {
-    libmv::vector<libmv::Feature *> features;
-    std::vector<cv::KeyPoint> features_cv;
-    m_pDetector->detect( im_cv, features_cv );
-    features.resize(features_cv.size());
-    for(size_t i=0; i<features_cv.size(); ++i)
-      features[i] = new libmv::PointFeature(features_cv[i]);
+    path = cv::utils::fs::join(m_cacheDirectory,
+        CacheKey(dataA) + "_" + CacheKey(dataB) + ".matches.yml.gz");
+    if (cv::utils::fs::exists(path))
+    {
+      try {
+        cv::FileStorage fs(path, cv::FileStorage::READ);
+        if (fs.isOpened() &&
+            (string)fs["imageA"] == dataA && (int)fs["featuresA"] == descriptorsA.rows &&
+            (string)fs["imageB"] == dataB && (int)fs["featuresB"] == descriptorsB.rows &&
+            (string)fs["detector"] == Feature2DName(m_pDetector) &&
+            (string)fs["describer"] == Feature2DName(m_pDescriber))
+        {
+          fs["matches"] >> *putativeMatches;
+          return true;
+        }
+      } catch (const cv::Exception & e) {
+        LOG(INFO) << "Ignoring the cached matches of " << dataA << " and "
+                  << dataB << ": " << e.what();
+      }
+    }
+  }
 
-    cv::Mat descriptors;
-    m_pDescriber->compute(im_cv, features_cv, descriptors);
+  //TODO(pmoulon) make FindCandidatesMatches a parameter.
+  FindCandidateMatches_Ratio(descriptorsA, descriptorsB, putativeMatches);
 
-    // Copy data.
-    m_ViewData.insert( make_pair(filename,FeatureSet()) );
-    FeatureSet & KeypointData = m_ViewData[filename];
-    KeypointData.features.resize(descriptors.rows);
-    for(int i = 0;i < descriptors.rows; ++i)
+  if (!path.empty())
+  {
+    cv::FileStorage fs(path, cv::FileStorage::WRITE);
+    if (fs.isOpened())
     {
-      KeypointFeature & feat = KeypointData.features[i];
-      descriptors.row(i).copyTo(feat.descriptor);
-      *(PointFeature*)(&feat) = *(PointFeature*)features[i];
+      fs << "imageA" << dataA << "featuresA" << descriptorsA.rows;
+      fs << "imageB" << dataB << "featuresB" << descriptorsB.rows;
+      fs << "detector" << Feature2DName(m_pDetector);
+      fs << "describer" << Feature2DName(m_pDescriber);
+      fs << "matches" << *putativeMatches;
     }
+    else
+      LOG(ERROR) << "Could not write " << path;
+  }
+  return true;
+}
 
-    DeleteElements(&features);
+void nRobustViewMatching::addMatches(
+    int dataAindex,
+    int dataBindex,
+    const std::vector<cv::DMatch> & putativeMatches)
+{
+  const FeatureSet & featuresA = m_ViewData[m_vec_InputNames[dataAindex]];
+  const FeatureSet & featuresB = m_ViewData[m_vec_InputNames[dataBindex]];
 
-    return true;
+  Matches matches;
+  for (size_t i = 0; i < putativeMatches.size(); ++i)
+  {
+    matches.Insert(0, (int)i, &featuresA.features[putativeMatches[i].queryIdx]);
+    matches.Insert(1, (int)i, &featuresB.features[putativeMatches[i].trainIdx]);
+  }
+  Matches consistent_matches;
+  if (computeConstrainMatches(matches,dataAindex,dataBindex,&consistent_matches))
+  {
+    matches = consistent_matches;
+  }
+  if (matches.NumTracks() > 0)
+  {
+    m_sharedData.insert(
+      make_pair(
+        make_pair(m_vec_InputNames[dataAindex],m_vec_InputNames[dataBindex]),
+        matches)
+      );
   }
 }
 
+bool nRobustViewMatching::matchPairs(
+    const std::vector<std::pair<int, int> > & pairs)
+{
+  // The putative matching of the pairs is independent, the geometric
+  // filtering updates the tracks and its random sampling is not thread safe,
+  // so it is done in the order of the pairs afterwards.
+  std::vector<std::vector<cv::DMatch> > putativeMatches(pairs.size());
+  std::vector<uchar> computed(pairs.size(), 0);
+  cv::parallel_for_(cv::Range(0, (int)pairs.size()), [&](const cv::Range & range) {
+    for (int k = range.start; k < range.end; ++k)
+      computed[k] = computePutativeMatches(pairs[k].first, pairs[k].second,
+                                           &putativeMatches[k]);
+  });
+
+  bool bRes = true;
+  for (size_t k = 0; k < pairs.size(); ++k)
+  {
+    if (computed[k])
+      addMatches(pairs[k].first, pairs[k].second, putativeMatches[k]);
+    else
+      bRes = false;
+  }
+  return bRes;
+}
+
 /**
 * Compute the putative match between data computed from element A and B
 *  Store the match data internally in the class
@@ -108,38 +408,16 @@ bool nRobustViewMatching::MatchData(const string & dataA, const string & dataB)
               << "Could not identify one of the input name.";
     return false;
   }
-  if (m_ViewData.find(dataA) == m_ViewData.end() ||
-      m_ViewData.find(dataB) == m_ViewData.end())
-  {
-    LOG(INFO) << "[nViewMatching::MatchData] "
-              << "Could not identify data for one of the input name.";
-    return false;
-  }
 
-  // Computed data exist for the given name
   int iDataA = find(m_vec_InputNames.begin(), m_vec_InputNames.end(), dataA)
                 - m_vec_InputNames.begin();
   int iDataB = find(m_vec_InputNames.begin(), m_vec_InputNames.end(), dataB)
                 - m_vec_InputNames.begin();
 
-  Matches matches;
-  //TODO(pmoulon) make FindCandidatesMatches a parameter.
-  FindCandidateMatches_Ratio(m_ViewData[dataA],
-                       m_ViewData[dataB],
-                       &matches);
-  Matches consistent_matches;
-  if (computeConstrainMatches(matches,iDataA,iDataB,&consistent_matches))
-  {
-    matches = consistent_matches;
-  }
-  if (matches.NumTracks() > 0)
-  {
-    m_sharedData.insert(
-      make_pair(
-        make_pair(m_vec_InputNames[iDataA],m_vec_InputNames[iDataB]),
-        matches)
-      );
-  }
+  std::vector<cv::DMatch> putativeMatches;
+  if (!computePutativeMatches(iDataA, iDataB, &putativeMatches))
+    return false;
+  addMatches(iDataA, iDataB, putativeMatches);
 
   return true;
 }
@@ -164,18 +442,26 @@ bool nRobustViewMatching::computeCrossMatch( const std::vector<string> & vec_dat
     bRes &= computeData(vec_data[i]);
   }
 
-  bool bRes2 = true;
+  // Select the pairs among the views with data.
+  std::vector<int> views;
+  std::vector<cv::Mat> descriptors;
   for (int i=0; i < vec_data.size(); ++i) {
-    for (int j=0; j < i; ++j)
-    {
-      if (m_ViewData.find(vec_data[i]) != m_ViewData.end() &&
-        m_ViewData.find(vec_data[j]) != m_ViewData.end())
-      {
-        bRes2 &= this->MatchData( vec_data[i], vec_data[j]);
-      }
+    map<string,cv::Mat>::const_iterator iter =
+      m_ViewDescriptors.find(vec_data[i]);
+    if (iter != m_ViewDescriptors.end()) {
+      views.push_back(i);
+      descriptors.push_back(iter->second);
     }
   }
-  return bRes2;
+  std::vector<std::pair<int, int> > pairs =
+    SelectCandidatePairs(descriptors, m_numCandidates);
+  for (size_t k = 0; k < pairs.size(); ++k) {
+    pairs[k] = make_pair(views[pairs[k].first], views[pairs[k].second]);
+  }
+  LOG(INFO) << "[nViewMatching::computeCrossMatch] Matching "
+            << pairs.size() << " pairs of " << views.size() << " views.";
+
+  return matchPairs(pairs);
 }
 
 bool nRobustViewMatching::computeRelativeMatch(
@@ -191,17 +477,18 @@ bool nRobustViewMatching::computeRelativeMatch(
     bRes &= computeData(vec_data[i]);
   }
 
-  bool bRes2 = true;
+  std::vector<std::pair<int, int> > pairs;
   for (int i=1; i < vec_data.size(); ++i) {
     if (m_ViewData.find(vec_data[i-1]) != m_ViewData.end() &&
         m_ViewData.find(vec_data[i])   != m_ViewData.end())
     {
-      bRes2 &= this->MatchData(vec_data[i-1], vec_data[i]);
+      pairs.push_back(make_pair(i-1, i));
     }
   }
   // Match the first and the last images (in order to detect loop)
-  bRes2 &= this->MatchData(vec_data[0], vec_data[vec_data.size() - 1]);
-  return bRes2;
+  if (vec_data.size() > 1)
+    pairs.push_back(make_pair(0, (int)vec_data.size() - 1));
+  return matchPairs(pairs);
 }
 
 /**
@@ -23,6 +23,8 @@
 
 struct FeatureSet;
 #include <map>
+#include <utility>
+#include <vector>
 
 #include "libmv/correspondence/feature.h"
 #include "libmv/correspondence/matches.h"
@@ -33,6 +35,24 @@ namespace correspondence  {
 
 using namespace std;
 
+/**
+ * Select the pairs (i, j), j < i, of views to match.
+ *
+ * Each view is paired with the num_candidates views whose tf-idf weighted
+ * bag of visual words is the most similar, and with the previous view since
+ * the images are often a sequence.
+ *
+ * \param[in] descriptors The descriptors of each view.
+ * \param[in] num_candidates Number of candidates per view. All the pairs are
+ *            returned if it is zero or negative, if it is at least the number
+ *            of views minus one, or if the descriptors are not CV_32F.
+ *
+ * \return The pairs, sorted.
+ */
+std::vector<std::pair<int, int> > SelectCandidatePairs(
+    const std::vector<cv::Mat> & descriptors,
+    int num_candidates);
+
 class nRobustViewMatching :public nViewMatchingInterface  {
 
   public:
@@ -69,6 +89,10 @@ class nRobustViewMatching :public nViewMatchingInterface  {
   /**
   * From a series of element it computes the cross putative match list.
   *
+  * Only the candidate pairs selected by setNumCandidates() are matched. The
+  * pairs are matched concurrently, the geometric filtering and the track
+  * building are then done in the order of the pairs.
+  *
   * \param[in] vec_data The data on which we want compute cross matches.
   *
   * \return True if success (and any matches was found).
@@ -101,6 +125,33 @@ class nRobustViewMatching :public nViewMatchingInterface  {
                                int dataBindex,
                                Matches * matchesOut);
 
+  /**
+  * Limit the pairs matched by computeCrossMatch().
+  *
+  * Each view is matched with the num_candidates views whose bag of visual
+  * words is the most similar and with the previous view, instead of with
+  * all the other views.
+  *
+  * \param[in] num_candidates Number of candidates per view, zero (the
+  *            default) or a negative value matches all the pairs.
+  */
+  void setNumCandidates(int num_candidates)
+    { m_numCandidates = num_candidates; }
+
+  /**
+  * Store the keypoints, descriptors and putative matches in a directory
+  * and reuse them on the next runs, so only the new images and the new
+  * pairs are processed.
+  *
+  * The cache entries are identified by the image filenames and the
+  * detector and describer names: the directory must be cleared when the
+  * images or the detector parameters change.
+  *
+  * \param[in] directory The cache directory, created if needed. An empty
+  *            string (the default) disables the cache.
+  */
+  void setCacheDirectory(const string & directory);
+
   /// Return pairwise correspondence ( geometrically filtered )
   const map< pair<string,string>, Matches> & getSharedData() const
     { return m_sharedData;  }
@@ -112,10 +163,31 @@ class nRobustViewMatching :public nViewMatchingInterface  {
     { return m_tracks;  }
 
 private :
+  /// Load the keypoints and descriptors of an image from the cache.
+  bool loadData(const string & filename,
+                std::vector<cv::KeyPoint> * keypoints,
+                cv::Mat * descriptors) const;
+  /// Store the keypoints and descriptors of an image in the cache.
+  void saveData(const string & filename,
+                const std::vector<cv::KeyPoint> & keypoints,
+                const cv::Mat & descriptors) const;
+  /// Compute (or load from the cache) the putative matches of a pair.
+  bool computePutativeMatches(int dataAindex,
+                              int dataBindex,
+                              std::vector<cv::DMatch> * putativeMatches) const;
+  /// Filter the putative matches of a pair and update the tracks.
+  void addMatches(int dataAindex,
+                  int dataBindex,
+                  const std::vector<cv::DMatch> & putativeMatches);
+  /// Match the given pairs, see computeCrossMatch().
+  bool matchPairs(const std::vector<std::pair<int, int> > & pairs);
+
   /// Input data names
   std::vector<string> m_vec_InputNames;
   /// Data that represent each named element.
   map<string,FeatureSet> m_ViewData;
+  /// Contiguous descriptors of each named element.
+  map<string,cv::Mat> m_ViewDescriptors;
   /// Matches between element named element <A,B>.
   map< pair<string,string>, Matches> m_sharedData;
 
@@ -130,6 +202,11 @@ private :
   std::shared_ptr<cv::FeatureDetector> m_pDetector;
   /// Interface to describe Keypoint.
   std::shared_ptr<cv::DescriptorExtractor> m_pDescriber;
+
+  /// Number of candidate pairs per view, see setNumCandidates().
+  int m_numCandidates;
+  /// Directory of the cached data, see setCacheDirectory().
+  string m_cacheDirectory;
 };
 
 } // using namespace correspondence
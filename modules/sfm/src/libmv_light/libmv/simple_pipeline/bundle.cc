@@ -25,6 +25,7 @@
 #include "ceres/ceres.h"
 #include "ceres/rotation.h"
 #include "ceres/version.h"
+#include "libmv/base/parallel.h"
 #include "libmv/base/vector.h"
 #include "libmv/logging/logging.h"
 #include "libmv/multiview/fundamental.h"
@@ -35,10 +36,6 @@
 #include "libmv/simple_pipeline/tracks.h"
 #include "libmv/simple_pipeline/distortion_models.h"
 
-#ifdef _OPENMP
-#  include <omp.h>
-#endif
-
 namespace libmv {
 
 // The intrinsics need to get combined into a single parameter block; use these
@@ -429,12 +426,10 @@ void EuclideanBundlePointsOnly(const DistortionModelType distortion_model,
   options.use_inner_iterations = true;
   options.max_num_iterations = 100;
 
-#ifdef _OPENMP
-  options.num_threads = omp_get_max_threads();
+  options.num_threads = NumThreads();
 #if CERES_VERSION_MAJOR <= 1 && CERES_VERSION_MINOR <= 13
   // deprecated since Ceres 1.14.0
-  options.num_linear_solver_threads = omp_get_max_threads();
-#endif
+  options.num_linear_solver_threads = NumThreads();
 #endif
 
   // Solve!
@@ -623,12 +618,10 @@ void EuclideanBundleCommonIntrinsics(
   options.use_inner_iterations = true;
   options.max_num_iterations = 100;
 
-#ifdef _OPENMP
-  options.num_threads = omp_get_max_threads();
+  options.num_threads = NumThreads();
 #if CERES_VERSION_MAJOR <= 1 && CERES_VERSION_MINOR <= 13
   // deprecated since Ceres 1.14.0
-  options.num_linear_solver_threads = omp_get_max_threads();
-#endif
+  options.num_linear_solver_threads = NumThreads();
 #endif
 
   // Solve!
@@ -68,6 +68,17 @@ class EuclideanIntersectCostFunctor {
 
 bool EuclideanIntersect(const vector<Marker> &markers,
                         EuclideanReconstruction *reconstruction) {
+  Vec3 X;
+  if (!EuclideanIntersect(markers, *reconstruction, &X)) {
+    return false;
+  }
+  reconstruction->InsertPoint(markers[0].track, X);
+  return true;
+}
+
+bool EuclideanIntersect(const vector<Marker> &markers,
+                        const EuclideanReconstruction &reconstruction,
+                        Vec3 *point) {
   if (markers.size() < 2) {
     return false;
   }
@@ -78,7 +89,8 @@ bool EuclideanIntersect(const vector<Marker> &markers,
   vector<Mat34> cameras;
   Mat34 P;
   for (int i = 0; i < markers.size(); ++i) {
-    EuclideanCamera *camera = reconstruction->CameraForImage(markers[i].image);
+    const EuclideanCamera *camera =
+        reconstruction.CameraForImage(markers[i].image);
     P_From_KRt(K, camera->R, camera->t, &P);
     cameras.push_back(P);
   }
@@ -106,7 +118,7 @@ bool EuclideanIntersect(const vector<Marker> &markers,
     const Marker &marker = markers[i];
     if (marker.weight != 0.0) {
       const EuclideanCamera &camera =
-          *reconstruction->CameraForImage(marker.image);
+          *reconstruction.CameraForImage(marker.image);
 
       problem.AddResidualBlock(
           new ceres::AutoDiffCostFunction<
@@ -130,8 +142,7 @@ bool EuclideanIntersect(const vector<Marker> &markers,
     // optimized or not. If track is a constant zero it'll use
     // algebraic intersection result as a 3D coordinate.
 
-    Vec3 point = X.head<3>();
-    reconstruction->InsertPoint(markers[0].track, point);
+    *point = X.head<3>();
 
     return true;
   }
@@ -153,7 +164,7 @@ bool EuclideanIntersect(const vector<Marker> &markers,
   // Try projecting the point; make sure it's in front of everyone.
   for (int i = 0; i < cameras.size(); ++i) {
     const EuclideanCamera &camera =
-        *reconstruction->CameraForImage(markers[i].image);
+        *reconstruction.CameraForImage(markers[i].image);
     Vec3 x = camera.R * X + camera.t;
     if (x(2) < 0) {
       LOG(ERROR) << "POINT BEHIND CAMERA " << markers[i].image
@@ -162,8 +173,7 @@ bool EuclideanIntersect(const vector<Marker> &markers,
     }
   }
 
-  Vec3 point = X.head<3>();
-  reconstruction->InsertPoint(markers[0].track, point);
+  *point = X.head<3>();
 
   // TODO(keir): Add proper error checking.
   return true;
@@ -202,6 +212,17 @@ struct ProjectiveIntersectCostFunction {
 
 bool ProjectiveIntersect(const vector<Marker> &markers,
                          ProjectiveReconstruction *reconstruction) {
+  Vec4 X;
+  if (!ProjectiveIntersect(markers, *reconstruction, &X)) {
+    return false;
+  }
+  reconstruction->InsertPoint(markers[0].track, X);
+  return true;
+}
+
+bool ProjectiveIntersect(const vector<Marker> &markers,
+                         const ProjectiveReconstruction &reconstruction,
+                         Vec4 *point) {
   if (markers.size() < 2) {
     return false;
   }
@@ -209,7 +230,8 @@ bool ProjectiveIntersect(const vector<Marker> &markers,
   // Get the cameras to use for the intersection.
   vector<Mat34> cameras;
   for (int i = 0; i < markers.size(); ++i) {
-    ProjectiveCamera *camera = reconstruction->CameraForImage(markers[i].image);
+    const ProjectiveCamera *camera =
+        reconstruction.CameraForImage(markers[i].image);
     cameras.push_back(camera->P);
   }
 
@@ -227,7 +249,7 @@ bool ProjectiveIntersect(const vector<Marker> &markers,
 
   typedef LevenbergMarquardt<ProjectiveIntersectCostFunction> Solver;
 
-  ProjectiveIntersectCostFunction triangulate_cost(markers, *reconstruction);
+  ProjectiveIntersectCostFunction triangulate_cost(markers, reconstruction);
   Solver::SolverParameters params;
   Solver solver(triangulate_cost);
 
@@ -237,7 +259,7 @@ bool ProjectiveIntersect(const vector<Marker> &markers,
   // Try projecting the point; make sure it's in front of everyone.
   for (int i = 0; i < cameras.size(); ++i) {
     const ProjectiveCamera &camera =
-        *reconstruction->CameraForImage(markers[i].image);
+        *reconstruction.CameraForImage(markers[i].image);
     Vec3 x = camera.P * X;
     if (x(2) < 0) {
       LOG(ERROR) << "POINT BEHIND CAMERA " << markers[i].image
@@ -245,7 +267,7 @@ bool ProjectiveIntersect(const vector<Marker> &markers,
     }
   }
 
-  reconstruction->InsertPoint(markers[0].track, X);
+  *point = X;
 
   // TODO(keir): Add proper error checking.
   return true;
@@ -49,6 +49,17 @@ namespace libmv {
 bool EuclideanIntersect(const vector<Marker> &markers,
                         EuclideanReconstruction *reconstruction);
 
+/*!
+    Same as the above, but the intersected point is returned in \a point
+    instead of being inserted in \a reconstruction.
+
+    As \a reconstruction is not modified, independent tracks can be
+    intersected concurrently.
+*/
+bool EuclideanIntersect(const vector<Marker> &markers,
+                        const EuclideanReconstruction &reconstruction,
+                        Vec3 *point);
+
 /*!
     Estimate the homogeneous coordinates of a track by intersecting rays.
 
@@ -72,6 +83,17 @@ bool EuclideanIntersect(const vector<Marker> &markers,
 bool ProjectiveIntersect(const vector<Marker> &markers,
                          ProjectiveReconstruction *reconstruction);
 
+/*!
+    Same as the above, but the intersected point is returned in \a point
+    instead of being inserted in \a reconstruction.
+
+    As \a reconstruction is not modified, independent tracks can be
+    intersected concurrently.
+*/
+bool ProjectiveIntersect(const vector<Marker> &markers,
+                         const ProjectiveReconstruction &reconstruction,
+                         Vec4 *point);
+
 }  // namespace libmv
 
 #endif  // LIBMV_SIMPLE_PIPELINE_INTERSECT_H
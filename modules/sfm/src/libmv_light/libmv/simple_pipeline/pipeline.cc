@@ -22,6 +22,7 @@
 
 #include <cstdio>
 
+#include "libmv/base/parallel.h"
 #include "libmv/logging/logging.h"
 #include "libmv/simple_pipeline/bundle.h"
 #include "libmv/simple_pipeline/intersect.h"
@@ -48,13 +49,29 @@ struct EuclideanPipelineRoutines {
   }
 
   static bool Resect(const vector<Marker> &markers,
-                     EuclideanReconstruction *reconstruction, bool final_pass) {
-    return EuclideanResect(markers, reconstruction, final_pass);
+                     const EuclideanReconstruction &reconstruction,
+                     bool final_pass,
+                     EuclideanCamera *camera) {
+    camera->image = markers[0].image;
+    return EuclideanResect(markers, reconstruction, final_pass,
+                           &camera->R, &camera->t);
   }
 
   static bool Intersect(const vector<Marker> &markers,
-                        EuclideanReconstruction *reconstruction) {
-    return EuclideanIntersect(markers, reconstruction);
+                        const EuclideanReconstruction &reconstruction,
+                        EuclideanPoint *point) {
+    point->track = markers[0].track;
+    return EuclideanIntersect(markers, reconstruction, &point->X);
+  }
+
+  static void Insert(const EuclideanCamera &camera,
+                     EuclideanReconstruction *reconstruction) {
+    reconstruction->InsertCamera(camera.image, camera.R, camera.t);
+  }
+
+  static void Insert(const EuclideanPoint &point,
+                     EuclideanReconstruction *reconstruction) {
+    reconstruction->InsertPoint(point.track, point.X);
   }
 
   static Marker ProjectMarker(const EuclideanPoint &point,
@@ -86,15 +103,30 @@ struct ProjectivePipelineRoutines {
   }
 
   static bool Resect(const vector<Marker> &markers,
-                     ProjectiveReconstruction *reconstruction, bool final_pass) {
+                     const ProjectiveReconstruction &reconstruction,
+                     bool final_pass,
+                     ProjectiveCamera *camera) {
     (void) final_pass;  // Ignored.
 
-    return ProjectiveResect(markers, reconstruction);
+    camera->image = markers[0].image;
+    return ProjectiveResect(markers, reconstruction, &camera->P);
   }
 
   static bool Intersect(const vector<Marker> &markers,
-                        ProjectiveReconstruction *reconstruction) {
-    return ProjectiveIntersect(markers, reconstruction);
+                        const ProjectiveReconstruction &reconstruction,
+                        ProjectivePoint *point) {
+    point->track = markers[0].track;
+    return ProjectiveIntersect(markers, reconstruction, &point->X);
+  }
+
+  static void Insert(const ProjectiveCamera &camera,
+                     ProjectiveReconstruction *reconstruction) {
+    reconstruction->InsertCamera(camera.image, camera.P);
+  }
+
+  static void Insert(const ProjectivePoint &point,
+                     ProjectiveReconstruction *reconstruction) {
+    reconstruction->InsertPoint(point.track, point.X);
   }
 
   static Marker ProjectMarker(const ProjectivePoint &point,
@@ -135,6 +167,116 @@ static void CompleteReconstructionLogProgress(
   }
 }
 
+// Intersects all the tracks which are not reconstructed yet and are seen by at
+// least two reconstructed cameras. Intersection only reads the cameras, so the
+// tracks are intersected concurrently; the points are then inserted in track
+// order, which keeps the reconstruction independent of the number of threads.
+template<typename PipelineRoutines>
+int IntersectTracks(const Tracks &tracks,
+                    int max_track,
+                    typename PipelineRoutines::Reconstruction *reconstruction) {
+  typedef typename PipelineRoutines::Point Point;
+
+  vector<int> candidates;
+  for (int track = 0; track <= max_track; ++track) {
+    if (reconstruction->PointForTrack(track)) {
+      LG << "Skipping point: " << track;
+      continue;
+    }
+    candidates.push_back(track);
+  }
+
+  // Zero if the track has not enough reconstructed markers, positive if it
+  // was intersected and negative if the intersection failed.
+  vector<int> status(candidates.size(), 0);
+  vector<Point> points(candidates.size());
+  const typename PipelineRoutines::Reconstruction &current = *reconstruction;
+  ParallelFor(0, candidates.size(), [&](int i) {
+    const int track = candidates[i];
+    vector<Marker> all_markers = tracks.MarkersForTrack(track);
+    LG << "Got " << all_markers.size() << " markers for track " << track;
+
+    vector<Marker> reconstructed_markers;
+    for (int j = 0; j < all_markers.size(); ++j) {
+      if (current.CameraForImage(all_markers[j].image)) {
+        reconstructed_markers.push_back(all_markers[j]);
+      }
+    }
+    LG << "Got " << reconstructed_markers.size()
+       << " reconstructed markers for track " << track;
+    if (reconstructed_markers.size() >= 2) {
+      status[i] = PipelineRoutines::Intersect(reconstructed_markers, current,
+                                              &points[i]) ? 1 : -1;
+    }
+  });
+
+  int num_intersects = 0;
+  for (int i = 0; i < candidates.size(); ++i) {
+    if (status[i] > 0) {
+      PipelineRoutines::Insert(points[i], reconstruction);
+      num_intersects++;
+      LG << "Ran Intersect() for track " << candidates[i];
+    } else if (status[i] < 0) {
+      LG << "Failed Intersect() for track " << candidates[i];
+    }
+  }
+  return num_intersects;
+}
+
+// Same as IntersectTracks() for the images which are not reconstructed yet and
+// see at least five reconstructed points. Resection only reads the points.
+template<typename PipelineRoutines>
+int ResectImages(const Tracks &tracks,
+                 int max_image,
+                 bool final_pass,
+                 typename PipelineRoutines::Reconstruction *reconstruction) {
+  typedef typename PipelineRoutines::Camera Camera;
+
+  vector<int> candidates;
+  for (int image = 0; image <= max_image; ++image) {
+    if (reconstruction->CameraForImage(image)) {
+      LG << "Skipping frame: " << image;
+      continue;
+    }
+    candidates.push_back(image);
+  }
+
+  vector<int> status(candidates.size(), 0);
+  vector<Camera> cameras(candidates.size());
+  const typename PipelineRoutines::Reconstruction &current = *reconstruction;
+  ParallelFor(0, candidates.size(), [&](int i) {
+    const int image = candidates[i];
+    vector<Marker> all_markers = tracks.MarkersInImage(image);
+    LG << "Got " << all_markers.size() << " markers for image " << image;
+
+    vector<Marker> reconstructed_markers;
+    for (int j = 0; j < all_markers.size(); ++j) {
+      if (current.PointForTrack(all_markers[j].track)) {
+        reconstructed_markers.push_back(all_markers[j]);
+      }
+    }
+    LG << "Got " << reconstructed_markers.size()
+       << " reconstructed markers for image " << image;
+    if (reconstructed_markers.size() >= 5) {
+      status[i] = PipelineRoutines::Resect(reconstructed_markers, current,
+                                           final_pass, &cameras[i]) ? 1 : -1;
+    }
+  });
+
+  const char *pass = final_pass ? "final " : "";
+  int num_resects = 0;
+  for (int i = 0; i < candidates.size(); ++i) {
+    if (status[i] > 0) {
+      PipelineRoutines::Insert(cameras[i], reconstruction);
+      num_resects++;
+      LG << "Ran " << pass << "Resect() for image " << candidates[i];
+    } else if (status[i] < 0) {
+      LG << "Failed " << pass << "Resect() for image " << candidates[i];
+    }
+  }
+  return num_resects;
+}
+
 template<typename PipelineRoutines>
 void InternalCompleteReconstruction(
     const Tracks &tracks,
@@ -148,37 +290,13 @@ void InternalCompleteReconstruction(
   LG << "Max track: " << max_track;
   LG << "Max image: " << max_image;
   LG << "Number of markers: " << tracks.NumMarkers();
+  LG << "Number of threads: " << NumThreads();
   while (num_resects != 0 || num_intersects != 0) {
     // Do all possible intersections.
-    num_intersects = 0;
-    for (int track = 0; track <= max_track; ++track) {
-      if (reconstruction->PointForTrack(track)) {
-        LG << "Skipping point: " << track;
-        continue;
-      }
-      vector<Marker> all_markers = tracks.MarkersForTrack(track);
-      LG << "Got " << all_markers.size() << " markers for track " << track;
-
-      vector<Marker> reconstructed_markers;
-      for (int i = 0; i < all_markers.size(); ++i) {
-        if (reconstruction->CameraForImage(all_markers[i].image)) {
-          reconstructed_markers.push_back(all_markers[i]);
-        }
-      }
-      LG << "Got " << reconstructed_markers.size()
-         << " reconstructed markers for track " << track;
-      if (reconstructed_markers.size() >= 2) {
-        CompleteReconstructionLogProgress(update_callback,
-                                          (double)tot_resects/(max_image));
-        if (PipelineRoutines::Intersect(reconstructed_markers,
-                                        reconstruction)) {
-          num_intersects++;
-          LG << "Ran Intersect() for track " << track;
-        } else {
-          LG << "Failed Intersect() for track " << track;
-        }
-      }
-    }
+    CompleteReconstructionLogProgress(update_callback,
+                                      (double)tot_resects/(max_image));
+    num_intersects = IntersectTracks<PipelineRoutines>(tracks, max_track,
+                                                       reconstruction);
     if (num_intersects) {
       CompleteReconstructionLogProgress(update_callback,
                                         (double)tot_resects/(max_image),
@@ -189,36 +307,11 @@ void InternalCompleteReconstruction(
     LG << "Did " << num_intersects << " intersects.";
 
     // Do all possible resections.
-    num_resects = 0;
-    for (int image = 0; image <= max_image; ++image) {
-      if (reconstruction->CameraForImage(image)) {
-        LG << "Skipping frame: " << image;
-        continue;
-      }
-      vector<Marker> all_markers = tracks.MarkersInImage(image);
-      LG << "Got " << all_markers.size() << " markers for image " << image;
-
-      vector<Marker> reconstructed_markers;
-      for (int i = 0; i < all_markers.size(); ++i) {
-        if (reconstruction->PointForTrack(all_markers[i].track)) {
-          reconstructed_markers.push_back(all_markers[i]);
-        }
-      }
-      LG << "Got " << reconstructed_markers.size()
-         << " reconstructed markers for image " << image;
-      if (reconstructed_markers.size() >= 5) {
-        CompleteReconstructionLogProgress(update_callback,
-                                          (double)tot_resects/(max_image));
-        if (PipelineRoutines::Resect(reconstructed_markers,
-                                     reconstruction, false)) {
-          num_resects++;
-          tot_resects++;
-          LG << "Ran Resect() for image " << image;
-        } else {
-          LG << "Failed Resect() for image " << image;
-        }
-      }
-    }
+    CompleteReconstructionLogProgress(update_callback,
+                                      (double)tot_resects/(max_image));
+    num_resects = ResectImages<PipelineRoutines>(tracks, max_image, false,
+                                                 reconstruction);
+    tot_resects += num_resects;
     if (num_resects) {
       CompleteReconstructionLogProgress(update_callback,
                                         (double)tot_resects/(max_image),
@@ -229,32 +322,10 @@ void InternalCompleteReconstruction(
   }
 
   // One last pass...
-  num_resects = 0;
-  for (int image = 0; image <= max_image; ++image) {
-    if (reconstruction->CameraForImage(image)) {
-      LG << "Skipping frame: " << image;
-      continue;
-    }
-    vector<Marker> all_markers = tracks.MarkersInImage(image);
-
-    vector<Marker> reconstructed_markers;
-    for (int i = 0; i < all_markers.size(); ++i) {
-      if (reconstruction->PointForTrack(all_markers[i].track)) {
-        reconstructed_markers.push_back(all_markers[i]);
-      }
-    }
-    if (reconstructed_markers.size() >= 5) {
-      CompleteReconstructionLogProgress(update_callback,
-                                        (double)tot_resects/(max_image));
-      if (PipelineRoutines::Resect(reconstructed_markers,
-                                   reconstruction, true)) {
-        num_resects++;
-        LG << "Ran final Resect() for image " << image;
-      } else {
-        LG << "Failed final Resect() for image " << image;
-      }
-    }
-  }
+  CompleteReconstructionLogProgress(update_callback,
+                                    (double)tot_resects/(max_image));
+  num_resects = ResectImages<PipelineRoutines>(tracks, max_image, true,
+                                               reconstruction);
   if (num_resects) {
     CompleteReconstructionLogProgress(update_callback,
                                       (double)tot_resects/(max_image),
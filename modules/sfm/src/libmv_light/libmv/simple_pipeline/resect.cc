@@ -93,13 +93,27 @@ struct EuclideanResectCostFunction {
 
 bool EuclideanResect(const vector<Marker> &markers,
                      EuclideanReconstruction *reconstruction, bool final_pass) {
+  Mat3 R;
+  Vec3 t;
+  if (!EuclideanResect(markers, *reconstruction, final_pass, &R, &t)) {
+    return false;
+  }
+  reconstruction->InsertCamera(markers[0].image, R, t);
+  return true;
+}
+
+bool EuclideanResect(const vector<Marker> &markers,
+                     const EuclideanReconstruction &reconstruction,
+                     bool final_pass,
+                     Mat3 *camera_R,
+                     Vec3 *camera_t) {
   if (markers.size() < 5) {
     return false;
   }
   Mat2X points_2d = PointMatrixFromMarkers(markers);
   Mat3X points_3d(3, markers.size());
   for (int i = 0; i < markers.size(); i++) {
-    points_3d.col(i) = reconstruction->PointForTrack(markers[i].track)->X;
+    points_3d.col(i) = reconstruction.PointForTrack(markers[i].track)->X;
   }
   LG << "Points for resect:\n" << points_2d;
 
@@ -154,7 +168,7 @@ bool EuclideanResect(const vector<Marker> &markers,
   typedef LevenbergMarquardt<EuclideanResectCostFunction> Solver;
 
   // Give the cost our initial guess for R.
-  EuclideanResectCostFunction resect_cost(markers, *reconstruction, R);
+  EuclideanResectCostFunction resect_cost(markers, reconstruction, R);
 
   // Encode the initial parameters: start with zero delta rotation, and the
   // guess for t obtained from resection.
@@ -174,7 +188,8 @@ bool EuclideanResect(const vector<Marker> &markers,
 
   LG << "Resection for image " << markers[0].image << " got:\n"
      << "R:\n" << R << "\nt:\n" << t;
-  reconstruction->InsertCamera(markers[0].image, R, t);
+  *camera_R = R;
+  *camera_t = t;
   return true;
 }
 
@@ -220,6 +235,17 @@ struct ProjectiveResectCostFunction {
 
 bool ProjectiveResect(const vector<Marker> &markers,
                       ProjectiveReconstruction *reconstruction) {
+  Mat34 P;
+  if (!ProjectiveResect(markers, *reconstruction, &P)) {
+    return false;
+  }
+  reconstruction->InsertCamera(markers[0].image, P);
+  return true;
+}
+
+bool ProjectiveResect(const vector<Marker> &markers,
+                      const ProjectiveReconstruction &reconstruction,
+                      Mat34 *camera_P) {
   if (markers.size() < 5) {
     return false;
   }
@@ -229,7 +255,7 @@ bool ProjectiveResect(const vector<Marker> &markers,
   Mat4X points_3d_homogeneous(4, markers.size());
   for (int i = 0; i < markers.size(); i++) {
     points_3d_homogeneous.col(i) =
-        reconstruction->PointForTrack(markers[i].track)->X;
+        reconstruction.PointForTrack(markers[i].track)->X;
   }
   LG << "Points for resect:\n" << points_2d;
 
@@ -248,7 +274,7 @@ bool ProjectiveResect(const vector<Marker> &markers,
   // Refine the resulting projection matrix using geometric error.
   typedef LevenbergMarquardt<ProjectiveResectCostFunction> Solver;
 
-  ProjectiveResectCostFunction resect_cost(markers, *reconstruction);
+  ProjectiveResectCostFunction resect_cost(markers, reconstruction);
 
   // Pack the initial P matrix into a size-12 vector..
   Vec12 vector_P = Map<Vec12>(P.data());
@@ -264,7 +290,7 @@ bool ProjectiveResect(const vector<Marker> &markers,
 
   LG << "Resection for image " << markers[0].image << " got:\n"
      << "P:\n" << P;
-  reconstruction->InsertCamera(markers[0].image, P);
+  *camera_P = P;
   return true;
 }
 }  // namespace libmv
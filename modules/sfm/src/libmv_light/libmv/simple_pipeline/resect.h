@@ -54,6 +54,19 @@ namespace libmv {
 bool EuclideanResect(const vector<Marker> &markers,
                      EuclideanReconstruction *reconstruction, bool final_pass);
 
+/*!
+    Same as the above, but the camera pose is returned in \a R and \a t
+    instead of being inserted in \a reconstruction.
+
+    As \a reconstruction is not modified, independent frames can be
+    resectioned concurrently.
+*/
+bool EuclideanResect(const vector<Marker> &markers,
+                     const EuclideanReconstruction &reconstruction,
+                     bool final_pass,
+                     Mat3 *R,
+                     Vec3 *t);
+
 /*!
     Estimate the projective pose of a camera from 2D to 3D correspondences.
 
@@ -81,6 +94,17 @@ bool EuclideanResect(const vector<Marker> &markers,
 bool ProjectiveResect(const vector<Marker> &markers,
                       ProjectiveReconstruction *reconstruction);
 
+/*!
+    Same as the above, but the projection matrix is returned in \a P instead
+    of being inserted in \a reconstruction.
+
+    As \a reconstruction is not modified, independent frames can be
+    resectioned concurrently.
+*/
+bool ProjectiveResect(const vector<Marker> &markers,
+                      const ProjectiveReconstruction &reconstruction,
+                      Mat34 *P);
+
 }  // namespace libmv
 
 #endif  // LIBMV_SIMPLE_PIPELINE_RESECT_H
@@ -28,21 +28,58 @@
 
 namespace libmv {
 
-Tracks::Tracks(const vector<Marker> &markers) : markers_(markers) {}
+Tracks::Tracks(const vector<Marker> &markers) : markers_(markers) {
+  RebuildIndex();
+}
 
-void Tracks::Insert(int image, int track, double x, double y, double weight) {
-  // TODO(keir): Wow, this is quadratic for repeated insertions. Fix this by
-  // adding a smarter data structure like a set<>.
+void Tracks::AddToIndex(int marker) {
+  const int image = markers_[marker].image;
+  const int track = markers_[marker].track;
+  if (image >= 0) {
+    if (image >= image_markers_.size()) {
+      image_markers_.resize(image + 1);
+    }
+    image_markers_[image].push_back(marker);
+  }
+  if (track >= 0) {
+    if (track >= track_markers_.size()) {
+      track_markers_.resize(track + 1);
+    }
+    track_markers_[track].push_back(marker);
+  }
+}
+
+void Tracks::RebuildIndex() {
+  image_markers_.clear();
+  track_markers_.clear();
   for (int i = 0; i < markers_.size(); ++i) {
-    if (markers_[i].image == image &&
-        markers_[i].track == track) {
-      markers_[i].x = x;
-      markers_[i].y = y;
-      return;
+    AddToIndex(i);
+  }
+}
+
+int Tracks::FindMarker(int image, int track) const {
+  if (track < 0 || track >= track_markers_.size()) {
+    return -1;
+  }
+  const std::vector<int> &markers = track_markers_[track];
+  for (int i = 0; i < markers.size(); ++i) {
+    if (markers_[markers[i]].image == image) {
+      return markers[i];
     }
   }
+  return -1;
+}
+
+void Tracks::Insert(int image, int track, double x, double y, double weight) {
+  const int existing = FindMarker(image, track);
+  if (existing >= 0) {
+    markers_[existing].x = x;
+    markers_[existing].y = y;
+    return;
+  }
   Marker marker = { image, track, x, y, weight };
   markers_.push_back(marker);
+  AddToIndex(markers_.size() - 1);
 }
 
 vector<Marker> Tracks::AllMarkers() const {
@@ -51,9 +88,10 @@ vector<Marker> Tracks::AllMarkers() const {
 
 vector<Marker> Tracks::MarkersInImage(int image) const {
   vector<Marker> markers;
-  for (int i = 0; i < markers_.size(); ++i) {
-    if (image == markers_[i].image) {
-      markers.push_back(markers_[i]);
+  if (image >= 0 && image < image_markers_.size()) {
+    const std::vector<int> &indices = image_markers_[image];
+    for (int i = 0; i < indices.size(); ++i) {
+      markers.push_back(markers_[indices[i]]);
     }
   }
   return markers;
@@ -61,36 +99,59 @@ vector<Marker> Tracks::MarkersInImage(int image) const {
 
 vector<Marker> Tracks::MarkersForTrack(int track) const {
   vector<Marker> markers;
-  for (int i = 0; i < markers_.size(); ++i) {
-    if (track == markers_[i].track) {
-      markers.push_back(markers_[i]);
+  if (track >= 0 && track < track_markers_.size()) {
+    const std::vector<int> &indices = track_markers_[track];
+    for (int i = 0; i < indices.size(); ++i) {
+      markers.push_back(markers_[indices[i]]);
     }
   }
   return markers;
 }
 
+namespace {
+
+const std::vector<int> &IndicesOf(const std::vector<std::vector<int> > &index,
+                                  int key) {
+  static const std::vector<int> empty;
+  return key >= 0 && key < index.size() ? index[key] : empty;
+}
+
+}  // namespace
+
 vector<Marker> Tracks::MarkersInBothImages(int image1, int image2) const {
+  const std::vector<int> &indices1 = IndicesOf(image_markers_, image1);
+  const std::vector<int> &indices2 =
+      image1 == image2 ? IndicesOf(image_markers_, -1)
+                       : IndicesOf(image_markers_, image2);
+
+  // Merge both lists to keep the order of the markers.
+  std::vector<int> indices;
+  std::merge(indices1.begin(), indices1.end(),
+             indices2.begin(), indices2.end(),
+             std::back_inserter(indices));
+
   vector<Marker> markers;
-  for (int i = 0; i < markers_.size(); ++i) {
-    int image = markers_[i].image;
-    if (image == image1 || image == image2)
-      markers.push_back(markers_[i]);
+  for (int i = 0; i < indices.size(); ++i) {
+    markers.push_back(markers_[indices[i]]);
   }
   return markers;
 }
 
 vector<Marker> Tracks::MarkersForTracksInBothImages(int image1,
                                                     int image2) const {
+  const std::vector<int> &indices1 = IndicesOf(image_markers_, image1);
+  const std::vector<int> &indices2 =
+      image1 == image2 ? IndicesOf(image_markers_, -1)
+                       : IndicesOf(image_markers_, image2);
+
   std::vector<int> image1_tracks;
   std::vector<int> image2_tracks;
 
-  for (int i = 0; i < markers_.size(); ++i) {
-    int image = markers_[i].image;
-    if (image == image1) {
-      image1_tracks.push_back(markers_[i].track);
-    } else if (image == image2) {
-      image2_tracks.push_back(markers_[i].track);
-    }
+  for (int i = 0; i < indices1.size(); ++i) {
+    image1_tracks.push_back(markers_[indices1[i]].track);
+  }
+  for (int i = 0; i < indices2.size(); ++i) {
+    image2_tracks.push_back(markers_[indices2[i]].track);
   }
 
   std::sort(image1_tracks.begin(), image1_tracks.end());
@@ -101,22 +162,26 @@ vector<Marker> Tracks::MarkersForTracksInBothImages(int image1,
                         image2_tracks.begin(), image2_tracks.end(),
                         std::back_inserter(intersection));
 
+  std::vector<int> indices;
+  std::merge(indices1.begin(), indices1.end(),
+             indices2.begin(), indices2.end(),
+             std::back_inserter(indices));
+
   vector<Marker> markers;
-  for (int i = 0; i < markers_.size(); ++i) {
-    if ((markers_[i].image == image1 || markers_[i].image == image2) &&
-        std::binary_search(intersection.begin(), intersection.end(),
-                           markers_[i].track)) {
-      markers.push_back(markers_[i]);
+  for (int i = 0; i < indices.size(); ++i) {
+    const Marker &marker = markers_[indices[i]];
+    if (std::binary_search(intersection.begin(), intersection.end(),
+                           marker.track)) {
+      markers.push_back(marker);
     }
   }
   return markers;
 }
 
 Marker Tracks::MarkerInImageForTrack(int image, int track) const {
-  for (int i = 0; i < markers_.size(); ++i) {
-    if (markers_[i].image == image && markers_[i].track == track) {
-      return markers_[i];
-    }
+  const int marker = FindMarker(image, track);
+  if (marker >= 0) {
+    return markers_[marker];
   }
   Marker null = { -1, -1, -1, -1, 0.0 };
   return null;
@@ -130,6 +195,7 @@ void Tracks::RemoveMarkersForTrack(int track) {
     }
   }
   markers_.resize(size);
+  RebuildIndex();
 }
 
 void Tracks::RemoveMarker(int image, int track) {
@@ -140,24 +206,23 @@ void Tracks::RemoveMarker(int image, int track) {
     }
   }
   markers_.resize(size);
+  RebuildIndex();
 }
 
 int Tracks::MaxImage() const {
-  // TODO(MatthiasF): maintain a max_image_ member (updated on Insert)
-  int max_image = 0;
-  for (int i = 0; i < markers_.size(); ++i) {
-    max_image = std::max(markers_[i].image, max_image);
+  int max_image = static_cast<int>(image_markers_.size()) - 1;
+  while (max_image > 0 && image_markers_[max_image].empty()) {
+    --max_image;
   }
-  return max_image;
+  return std::max(max_image, 0);
 }
 
 int Tracks::MaxTrack() const {
-  // TODO(MatthiasF): maintain a max_track_ member (updated on Insert)
-  int max_track = 0;
-  for (int i = 0; i < markers_.size(); ++i) {
-    max_track = std::max(markers_[i].track, max_track);
+  int max_track = static_cast<int>(track_markers_.size()) - 1;
+  while (max_track > 0 && track_markers_[max_track].empty()) {
+    --max_track;
   }
-  return max_track;
+  return std::max(max_track, 0);
 }
 
 int Tracks::NumMarkers() const {
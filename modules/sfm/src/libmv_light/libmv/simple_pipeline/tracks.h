@@ -21,6 +21,8 @@
 #ifndef LIBMV_SIMPLE_PIPELINE_TRACKS_H_
 #define LIBMV_SIMPLE_PIPELINE_TRACKS_H_
 
+#include <vector>
+
 #include "libmv/base/vector.h"
 #include "libmv/numeric/numeric.h"
 
@@ -57,6 +59,9 @@ struct Marker {
 
     The container has several fast lookups for queries typically needed for
     structure from motion algorithms, such as \l MarkersForTracksInBothImages().
+    Markers are indexed by image and by track, so the lookups only touch the
+    markers of the requested images or tracks. Images and tracks are expected
+    to be small non-negative numbers.
 
     \sa Marker
 */
@@ -126,7 +131,16 @@ class Tracks {
   int NumMarkers() const;
 
  private:
+  void AddToIndex(int marker);
+  void RebuildIndex();
+  int FindMarker(int image, int track) const;
+
   vector<Marker> markers_;
+
+  // Indices into markers_ of the markers of every image and every track, in
+  // the order of markers_.
+  std::vector<std::vector<int> > image_markers_;
+  std::vector<std::vector<int> > track_markers_;
 };
 
 void CoordinatesForMarkersInImage(const vector<Marker> &markers,
@@ -62,6 +62,8 @@ namespace sfm
     const int keyframe1 = 1, keyframe2 = 2;
     const int select_keyframes = 1; // enable automatic keyframes selection
     const int verbosity_level = -1; // mute libmv logs
+    const int num_threads = -1; // cv::getNumThreads()
+    const int matching_candidates = 0; // match all the pairs of images
 
     // Refinement parameters
     const int refine_intrinsics = ( !refinement ) ? 0 :
@@ -74,7 +76,8 @@ namespace sfm
     const double principal_x = Ka(0,2), principal_y = Ka(1,2), k1 = 0, k2 = 0, k3 = 0;
 
     // Set reconstruction options
-    libmv_ReconstructionOptions reconstruction_options(keyframe1, keyframe2, refine_intrinsics, select_keyframes, verbosity_level);
+    libmv_ReconstructionOptions reconstruction_options(keyframe1, keyframe2, refine_intrinsics, select_keyframes, verbosity_level,
+                                                       num_threads, matching_candidates);
 
     libmv_CameraIntrinsicsOptions camera_instrinsic_options =
       libmv_CameraIntrinsicsOptions(SFM_DISTORTION_MODEL_POLYNOMIAL,
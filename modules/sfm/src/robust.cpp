@@ -40,11 +40,12 @@
 
 // OpenCV
 #include <opencv2/core/eigen.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 #include <opencv2/sfm/robust.hpp>
 #include <opencv2/sfm/numeric.hpp>
 
 // libmv headers
-#include "libmv/multiview/robust_fundamental.h"
+#include "libmv/multiview/fundamental_kernel.h"
 
 using namespace std;
 
@@ -53,110 +54,246 @@ namespace cv
 namespace sfm
 {
 
-// TODO: unify algorithms
-template<typename T>
-double
-fundamentalFromCorrespondences8PointRobust( const Mat_<T> &_x1,
-                                            const Mat_<T> &_x2,
-                                            const double max_error,
-                                            Mat_<T> _F,
-                                            std::vector<int> &_inliers,
-                                            const double outliers_probability )
+namespace
 {
-  libmv::Mat x1, x2;
-  libmv::Mat3 F;
-  libmv::vector<int> inliers;
 
-  cv2eigen( _x1, x1 );
-  cv2eigen( _x2, x2 );
+// The hypotheses are drawn, fitted and scored by batches of this size. It does
+// not depend on the number of threads, so neither do the results.
+const int HYPOTHESES_PER_BATCH = 16;
 
-  T solution_error =
-    libmv::FundamentalFromCorrespondences8PointRobust( x1, x2, max_error, &F, &inliers, outliers_probability );
+// The correspondences are scored by blocks of this size, the scoring of a
+// hypothesis stops after the first block which makes it worse than the best one.
+const int SCORING_BLOCK_SIZE = 64;
 
-  eigen2cv( F, _F );
-
-  // transform from libmv::vector to std::vector
-  int n = inliers.size();
-  _inliers.resize(n);
-  for( int i=0; i < n; ++i )
+// Correspondences as a structure of arrays, for the vectorized scoring.
+struct Correspondences
+{
+  Correspondences( const libmv::Mat &x1, const libmv::Mat &x2 )
+    : n(static_cast<int>(x1.cols())), x(n), y(n), u(n), v(n)
   {
-    _inliers[i] = inliers.at(i);
+    for( int i = 0; i < n; ++i )
+    {
+      x[i] = x1(0, i); y[i] = x1(1, i);
+      u[i] = x2(0, i); v[i] = x2(1, i);
+    }
   }
 
-  return static_cast<double>(solution_error);
+  int n;
+  std::vector<double> x, y, u, v;
+};
+
+// Sampson errors of the correspondences [start, end) for F (row major), see
+// libmv::fundamental::kernel::SampsonError.
+static void
+sampsonErrors( const Correspondences &pts, const double *F, int start, int end, double *errors )
+{
+  int i = start;
+#if (CV_SIMD_64F || CV_SIMD_SCALABLE_64F)
+  const int nlanes = VTraits<v_float64>::vlanes();
+  const v_float64 f0 = vx_setall_f64(F[0]), f1 = vx_setall_f64(F[1]), f2 = vx_setall_f64(F[2]);
+  const v_float64 f3 = vx_setall_f64(F[3]), f4 = vx_setall_f64(F[4]), f5 = vx_setall_f64(F[5]);
+  const v_float64 f6 = vx_setall_f64(F[6]), f7 = vx_setall_f64(F[7]), f8 = vx_setall_f64(F[8]);
+  for( ; i <= end - nlanes; i += nlanes )
+  {
+    const v_float64 x = vx_load(&pts.x[i]), y = vx_load(&pts.y[i]);
+    const v_float64 u = vx_load(&pts.u[i]), v = vx_load(&pts.v[i]);
+    const v_float64 Fx0 = v_add(v_add(v_mul(f0, x), v_mul(f1, y)), f2);
+    const v_float64 Fx1 = v_add(v_add(v_mul(f3, x), v_mul(f4, y)), f5);
+    const v_float64 Fx2 = v_add(v_add(v_mul(f6, x), v_mul(f7, y)), f8);
+    const v_float64 Fty0 = v_add(v_add(v_mul(f0, u), v_mul(f3, v)), f6);
+    const v_float64 Fty1 = v_add(v_add(v_mul(f1, u), v_mul(f4, v)), f7);
+    const v_float64 yFx = v_add(v_add(v_mul(u, Fx0), v_mul(v, Fx1)), Fx2);
+    const v_float64 norm2 = v_add(v_add(v_mul(Fx0, Fx0), v_mul(Fx1, Fx1)),
+                                  v_add(v_mul(Fty0, Fty0), v_mul(Fty1, Fty1)));
+    v_store(errors + i - start, v_div(v_mul(yFx, yFx), norm2));
+  }
+#endif
+  for( ; i < end; ++i )
+  {
+    const double x = pts.x[i], y = pts.y[i], u = pts.u[i], v = pts.v[i];
+    const double Fx0 = F[0]*x + F[1]*y + F[2];
+    const double Fx1 = F[3]*x + F[4]*y + F[5];
+    const double Fx2 = F[6]*x + F[7]*y + F[8];
+    const double Fty0 = F[0]*u + F[3]*v + F[6];
+    const double Fty1 = F[1]*u + F[4]*v + F[7];
+    const double yFx = u*Fx0 + v*Fx1 + Fx2;
+    const double norm2 = (Fx0*Fx0 + Fx1*Fx1) + (Fty0*Fty0 + Fty1*Fty1);
+    errors[i - start] = yFx*yFx / norm2;
+  }
 }
 
+// Truncated cost sum(min(error, threshold)) of F over the correspondences, as
+// libmv::MLEScorer. The scoring stops as soon as the cost reaches bound, since
+// the hypothesis cannot replace the best one anymore: an exact early bailout
+// instead of the probabilistic SPRT test, so the best hypothesis is the same.
+static double
+sampsonCost( const Correspondences &pts, const libmv::Mat3 &F, double threshold, double bound,
+             std::vector<int> *inliers = 0 )
+{
+  double f[9];
+  for( int r = 0; r < 3; ++r )
+    for( int c = 0; c < 3; ++c )
+      f[3*r + c] = F(r, c);
+
+  double errors[SCORING_BLOCK_SIZE];
+  double cost = 0.0;
+  for( int start = 0; start < pts.n && cost < bound; start += SCORING_BLOCK_SIZE )
+  {
+    const int end = std::min(start + SCORING_BLOCK_SIZE, pts.n);
+    sampsonErrors(pts, f, start, end, errors);
+    for( int i = start; i < end; ++i )
+    {
+      const double error = errors[i - start];
+      if( error < threshold )
+      {
+        cost += error;
+        if( inliers )
+          inliers->push_back(i);
+      }
+      else
+        cost += threshold;
+    }
+  }
+  return cost;
+}
 
-double
-fundamentalFromCorrespondences8PointRobust( InputArray _x1,
-                                            InputArray _x2,
-                                            double max_error,
-                                            OutputArray _F,
-                                            OutputArray _inliers,
-                                            double outliers_probability )
+// RANSAC estimation of the fundamental matrix as libmv::Estimate() with
+// libmv::MLEScorer, the hypotheses of each batch being fitted and scored in
+// parallel. Returns the best cost, HUGE_VAL if there are not enough points.
+template<typename Kernel>
+static double
+estimateFundamentalRobust( const libmv::Mat &x1, const libmv::Mat &x2, double threshold,
+                           double outliers_probability, libmv::Mat3 &F, std::vector<int> &inliers )
 {
-  const Mat x1 = _x1.getMat(), x2 = _x2.getMat();
-  const int depth =  x1.depth();
-  CV_Assert(x1.size() == x2.size() && (depth == CV_32F || depth == CV_64F));
+  CV_Assert(outliers_probability > 0.0 && outliers_probability < 1.0);
 
-  _F.create(3, 3, depth);
+  const int min_samples = Kernel::MINIMUM_SAMPLES;
+  const size_t really_max_iterations = 1000;
+  size_t max_iterations = 100;
 
-  Mat F = _F.getMat();
-  std::vector<int>& inliers = *(std::vector<int>*)_inliers.getObj();
+  Kernel kernel(x1, x2);
+  const int total_samples = kernel.NumSamples();
 
-  double solution_error = 0.0;
+  F.setZero();
+  inliers.clear();
+  if( total_samples < min_samples )
+    return HUGE_VAL;
 
-  // type
-  if( depth == CV_32F )
-  {
-    solution_error =
-      fundamentalFromCorrespondences8PointRobust<float>(
-        x1, x2, max_error, F, inliers, outliers_probability);
-  }
-  else
+  const Correspondences pts(x1, x2);
+  RNG rng(0x5f3759df);
+  std::vector<int> samples(HYPOTHESES_PER_BATCH * min_samples);
+  std::vector<double> costs(HYPOTHESES_PER_BATCH);
+  std::vector<libmv::Mat3> models(HYPOTHESES_PER_BATCH);
+  double best_cost = HUGE_VAL;
+
+  size_t iteration = 0;
+  while( iteration < std::min(max_iterations, really_max_iterations) )
   {
-    solution_error =
-      fundamentalFromCorrespondences8PointRobust<double>(
-        x1, x2, max_error, F, inliers, outliers_probability);
+    const int nhypotheses = static_cast<int>(std::min<size_t>(HYPOTHESES_PER_BATCH,
+        std::min(max_iterations, really_max_iterations) - iteration));
+
+    // Draw the minimal samples serially, so they do not depend on the threads.
+    for( int h = 0; h < nhypotheses; ++h )
+    {
+      int *sample = &samples[h * min_samples];
+      for( int k = 0; k < min_samples; )
+      {
+        sample[k] = rng.uniform(0, total_samples);
+        if( std::find(sample, sample + k, sample[k]) == sample + k )
+          ++k;
+      }
+    }
+
+    const double bound = best_cost;
+    parallel_for_(Range(0, nhypotheses), [&](const Range &range)
+    {
+      libmv::vector<int> sample;
+      libmv::vector<libmv::Mat3> fitted;
+      for( int h = range.start; h < range.end; ++h )
+      {
+        sample.resize(min_samples);
+        for( int k = 0; k < min_samples; ++k )
+          sample[k] = samples[h * min_samples + k];
+        fitted.clear();
+        kernel.Fit(sample, &fitted);
+
+        costs[h] = HUGE_VAL;
+        for( int m = 0; m < fitted.size(); ++m )
+        {
+          const double cost = sampsonCost(pts, fitted[m], threshold, std::min(bound, costs[h]));
+          if( cost < costs[h] )
+          {
+            costs[h] = cost;
+            models[h] = fitted[m];
+          }
+        }
+      }
+    });
+
+    // Keep the first best hypothesis, as the serial loop does.
+    bool improved = false;
+    for( int h = 0; h < nhypotheses; ++h )
+    {
+      if( costs[h] < best_cost )
+      {
+        best_cost = costs[h];
+        F = models[h];
+        improved = true;
+      }
+    }
+    iteration += nhypotheses;
+
+    if( improved )
+    {
+      inliers.clear();
+      sampsonCost(pts, F, threshold, HUGE_VAL, &inliers);
+      const double inlier_ratio = inliers.size() / double(total_samples);
+      if( inlier_ratio > 0 )
+      {
+        const double required = std::log(outliers_probability) /
+                                std::log(1.0 - std::pow(inlier_ratio, min_samples));
+        max_iterations = required >= 0 && required < really_max_iterations ?
+                         static_cast<size_t>(required) : really_max_iterations;
+      }
+    }
   }
 
-  return solution_error;
+  return best_cost;
 }
 
-template<typename T>
-double
-fundamentalFromCorrespondences7PointRobust( const Mat_<T> &_x1,
-                                            const Mat_<T> &_x2,
-                                            const double max_error,
-                                            Mat_<T> _F,
-                                            std::vector<int> &_inliers,
-                                            const double outliers_probability )
+// Estimates F from 2xN float or double correspondences with the minimal
+// solver of num_points points. Returns the best error (in pixels).
+static double
+fundamentalFromCorrespondencesRobust( const Mat &_x1, const Mat &_x2, double max_error, int num_points,
+                                      double outliers_probability, libmv::Mat3 &F, std::vector<int> &inliers )
 {
-  libmv::Mat x1, x2;
-  libmv::Mat3 F;
-  libmv::vector<int> inliers;
+  const int depth = _x1.depth();
+  CV_Assert(_x1.size() == _x2.size() && _x1.type() == _x2.type() && (depth == CV_32F || depth == CV_64F));
+  CV_Assert(num_points == 7 || num_points == 8);
 
+  libmv::Mat x1, x2;
   cv2eigen( _x1, x1 );
   cv2eigen( _x2, x2 );
 
-  T solution_error =
-    libmv::FundamentalFromCorrespondences7PointRobust( x1, x2, max_error, &F, &inliers, outliers_probability );
-
-  eigen2cv( F, _F );
+  // The threshold is on the sum of the squared errors in the two images.
+  // Actually, Sampson's approximation of this error.
+  const double threshold = 2 * max_error * max_error;
 
-  // transform from libmv::vector to std::vector
-  int n = inliers.size();
-  _inliers.resize(n);
-  for( int i=0; i < n; ++i )
-  {
-    _inliers[i] = inliers.at(i);
-  }
+  double best_cost;
+  if( num_points == 8 )
+    best_cost = estimateFundamentalRobust<libmv::fundamental::kernel::NormalizedEightPointKernel>(
+                  x1, x2, threshold, outliers_probability, F, inliers);
+  else
+    best_cost = estimateFundamentalRobust<libmv::fundamental::kernel::NormalizedSevenPointKernel>(
+                  x1, x2, threshold, outliers_probability, F, inliers);
 
-  return static_cast<double>(solution_error);
+  return best_cost == HUGE_VAL ? HUGE_VAL : std::sqrt(best_cost / 2.0);
 }
 
+} // namespace
+
 double
-fundamentalFromCorrespondences7PointRobust( InputArray _x1,
+fundamentalFromCorrespondences8PointRobust( InputArray _x1,
                                             InputArray _x2,
                                             double max_error,
                                             OutputArray _F,
@@ -164,32 +301,77 @@ fundamentalFromCorrespondences7PointRobust( InputArray _x1,
                                             double outliers_probability )
 {
   const Mat x1 = _x1.getMat(), x2 = _x2.getMat();
-  const int depth =  x1.depth();
-  CV_Assert(x1.size() == x2.size() && (depth == CV_32F || depth == CV_64F));
+  std::vector<int>& inliers = *(std::vector<int>*)_inliers.getObj();
+
+  libmv::Mat3 F;
+  const double solution_error =
+    fundamentalFromCorrespondencesRobust(x1, x2, max_error, 8, outliers_probability, F, inliers);
 
-  _F.create(3, 3, depth);
+  Mat F_;
+  eigen2cv( F, F_ );
+  F_.convertTo(_F, x1.depth());
+  return solution_error;
+}
 
-  Mat F = _F.getMat();
+double
+fundamentalFromCorrespondences7PointRobust( InputArray _x1,
+                                            InputArray _x2,
+                                            double max_error,
+                                            OutputArray _F,
+                                            OutputArray _inliers,
+                                            double outliers_probability )
+{
+  const Mat x1 = _x1.getMat(), x2 = _x2.getMat();
   std::vector<int>& inliers = *(std::vector<int>*)_inliers.getObj();
 
-  double solution_error = 0.0;
+  libmv::Mat3 F;
+  const double solution_error =
+    fundamentalFromCorrespondencesRobust(x1, x2, max_error, 7, outliers_probability, F, inliers);
+
+  Mat F_;
+  eigen2cv( F, F_ );
+  F_.convertTo(_F, x1.depth());
+  return solution_error;
+}
 
-  // type
-  if( depth == CV_32F )
+void
+fundamentalFromCorrespondencesRobust( InputArrayOfArrays _x1,
+                                      InputArrayOfArrays _x2,
+                                      double max_error,
+                                      OutputArrayOfArrays _F,
+                                      std::vector<std::vector<int> > &inliers,
+                                      std::vector<double> &errors,
+                                      int num_points,
+                                      double outliers_probability )
+{
+  std::vector<Mat> x1, x2;
+  _x1.getMatVector(x1);
+  _x2.getMatVector(x2);
+  CV_Assert(x1.size() == x2.size());
+  CV_Assert(num_points == 7 || num_points == 8);
+
+  const int npairs = static_cast<int>(x1.size());
+  std::vector<libmv::Mat3> Fs(npairs);
+  inliers.resize(npairs);
+  errors.resize(npairs);
+
+  // One pair per task: the hypotheses of a pair are then scored serially.
+  parallel_for_(Range(0, npairs), [&](const Range &range)
   {
-    solution_error =
-      fundamentalFromCorrespondences7PointRobust<float>(
-        x1, x2, max_error, F, inliers, outliers_probability);
-  }
-  else
+    for( int i = range.start; i < range.end; ++i )
+      errors[i] = fundamentalFromCorrespondencesRobust(x1[i], x2[i], max_error, num_points,
+                                                       outliers_probability, Fs[i], inliers[i]);
+  });
+
+  _F.create(npairs, 1, CV_64F);
+  for( int i = 0; i < npairs; ++i )
   {
-    solution_error =
-      fundamentalFromCorrespondences7PointRobust<double>(
-        x1, x2, max_error, F, inliers, outliers_probability);
+    _F.create(3, 3, x1[i].depth(), i);
+    Mat F = _F.getMat(i), F_;
+    eigen2cv( Fs[i], F_ );
+    F_.convertTo(F, F.depth());
   }
-
-  return solution_error;
 }
 
 } /* namespace sfm */
-} /* namespace cv */
\ No newline at end of file
+} /* namespace cv */
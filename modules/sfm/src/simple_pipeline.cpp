@@ -132,6 +132,8 @@ std::shared_ptr<libmv_Reconstruction> libmv_solveReconstructionImpl(
       sImages.push_back(images[i].c_str());
   cout << "Initialize nViewMatcher ... ";
   libmv::correspondence::nRobustViewMatching nViewMatcher(edetector, edescriber);
+  nViewMatcher.setNumCandidates(libmv_reconstruction_options->matching_candidates);
+  nViewMatcher.setCacheDirectory(libmv_reconstruction_options->matching_cache_dir);
 
   cout << "OK" << endl << "Performing Cross Matching ... ";
   nViewMatcher.computeCrossMatch(sImages); cout << "OK" << endl;
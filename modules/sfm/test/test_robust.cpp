@@ -155,4 +155,74 @@ TEST(Sfm_robust, fundamentalFromCorrespondences7PointRealisticNoOutliers)
     expectFundamentalProperties( F_estimated, d.x1, d.x2, tolerance);
 }
 
+
+static void
+addOutliers(Mat_<double> &x2, int step)
+{
+    RNG rng(0);
+    for (int i = 0; i < x2.cols; i += step)
+    {
+        x2(0,i) += rng.uniform(20.0, 100.0);
+        x2(1,i) -= rng.uniform(20.0, 100.0);
+    }
+}
+
+TEST(Sfm_robust, fundamentalFromCorrespondences7PointRobust_threads_consistency)
+{
+    TwoViewDataSet d;
+    generateTwoViewRandomScene(d);
+    Mat_<double> x1 = d.x1, x2 = d.x2.clone();
+    addOutliers(x2, 3);
+
+    const int nThreads = getNumThreads();
+    Matx33d F[2];
+    vector<int> inliers[2];
+    double error[2];
+    for (int i = 0; i < 2; i++)
+    {
+        setNumThreads(i == 0 ? 1 : nThreads);
+        error[i] = fundamentalFromCorrespondences7PointRobust(x1, x2, 1.0, F[i], inliers[i]);
+    }
+    setNumThreads(nThreads);
+
+    EXPECT_EQ(error[0], error[1]);
+    EXPECT_EQ(0, cvtest::norm(F[0], F[1], NORM_INF));
+    EXPECT_EQ(inliers[0], inliers[1]);
+
+    // All the points but the outliers are inliers.
+    EXPECT_GE(inliers[0].size(), (size_t)(x1.cols - (x1.cols + 2) / 3));
+}
+
+TEST(Sfm_robust, fundamentalFromCorrespondencesRobust_batch)
+{
+    vector<Mat> x1, x2;
+    for (int i = 0; i < 4; i++)
+    {
+        TwoViewDataSet d;
+        generateTwoViewRandomScene(d);
+        Mat_<double> x2_ = d.x2.clone();
+        addOutliers(x2_, 4 + i);
+        x1.push_back(d.x1);
+        x2.push_back(x2_);
+    }
+
+    vector<Mat> Fs;
+    vector<vector<int> > inliers;
+    vector<double> errors;
+    fundamentalFromCorrespondencesRobust(x1, x2, 1.0, Fs, inliers, errors, 8);
+    ASSERT_EQ(x1.size(), Fs.size());
+    ASSERT_EQ(x1.size(), inliers.size());
+    ASSERT_EQ(x1.size(), errors.size());
+
+    for (size_t i = 0; i < x1.size(); i++)
+    {
+        Matx33d F;
+        vector<int> pair_inliers;
+        double error = fundamentalFromCorrespondences8PointRobust(x1[i], x2[i], 1.0, F, pair_inliers);
+        EXPECT_EQ(error, errors[i]);
+        EXPECT_EQ(0, cvtest::norm(Mat(F), Fs[i], NORM_INF));
+        EXPECT_EQ(pair_inliers, inliers[i]);
+    }
+}
+
 }} // namespace
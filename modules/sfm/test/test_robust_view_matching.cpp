@@ -0,0 +1,179 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+
+#include <opencv2/core/utils/filesystem.hpp>
+#include <opencv2/features2d.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "libmv/correspondence/nRobustViewMatching.h"
+
+namespace opencv_test { namespace {
+
+using libmv::correspondence::SelectCandidatePairs;
+using libmv::correspondence::nRobustViewMatching;
+
+typedef std::vector<std::pair<int, int> > Pairs;
+
+static Pairs allPairs(int n)
+{
+    Pairs pairs;
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < i; ++j)
+            pairs.push_back(std::make_pair(i, j));
+    return pairs;
+}
+
+// Descriptors of n views: the even views are drawn around one set of
+// centers and the odd views around another, so the most similar view of
+// each view is never the previous one.
+static std::vector<Mat> twoGroupsDescriptors(int n)
+{
+    RNG rng(0);
+    Mat centers[2] = { Mat(4, 32, CV_32F), Mat(4, 32, CV_32F) };
+    rng.fill(centers[0], RNG::UNIFORM, 0, 100);
+    rng.fill(centers[1], RNG::UNIFORM, 0, 100);
+
+    std::vector<Mat> descriptors(n);
+    for (int i = 0; i < n; ++i)
+    {
+        descriptors[i].create(200, 32, CV_32F);
+        rng.fill(descriptors[i], RNG::NORMAL, 0, 1);
+        for (int r = 0; r < descriptors[i].rows; ++r)
+            descriptors[i].row(r) += centers[i % 2].row(rng.uniform(0, 4));
+    }
+    return descriptors;
+}
+
+TEST(Sfm_robust_view_matching, candidate_pairs_all)
+{
+    const int n = 6;
+    const std::vector<Mat> descriptors = twoGroupsDescriptors(n);
+
+    EXPECT_EQ(allPairs(n), SelectCandidatePairs(descriptors, 0));
+    EXPECT_EQ(allPairs(n), SelectCandidatePairs(descriptors, -1));
+    EXPECT_EQ(allPairs(n), SelectCandidatePairs(descriptors, n - 1));
+    EXPECT_EQ(allPairs(n), SelectCandidatePairs(descriptors, 100));
+
+    // Binary descriptors cannot be clustered.
+    std::vector<Mat> binary(n);
+    for (int i = 0; i < n; ++i)
+        descriptors[i].convertTo(binary[i], CV_8U);
+    EXPECT_EQ(allPairs(n), SelectCandidatePairs(binary, 1));
+}
+
+TEST(Sfm_robust_view_matching, candidate_pairs_previous_view)
+{
+    const int n = 8;
+    const Pairs pairs = SelectCandidatePairs(twoGroupsDescriptors(n), 1);
+
+    EXPECT_LT(pairs.size(), allPairs(n).size());
+    for (size_t k = 0; k < pairs.size(); ++k)
+    {
+        const int i = pairs[k].first, j = pairs[k].second;
+        EXPECT_LT(j, i);
+        EXPECT_TRUE(j == i - 1 || i % 2 == j % 2) << "i=" << i << ", j=" << j;
+    }
+    for (int i = 1; i < n; ++i)
+    {
+        EXPECT_TRUE(std::find(pairs.begin(), pairs.end(), std::make_pair(i, i - 1)) != pairs.end())
+            << "i=" << i;
+    }
+    // The most similar view is in the same group.
+    for (int i = 0; i < n; ++i)
+    {
+        bool found = false;
+        for (size_t k = 0; k < pairs.size(); ++k)
+        {
+            const int a = pairs[k].first, b = pairs[k].second;
+            found |= (a == i || b == i) && a % 2 == b % 2;
+        }
+        EXPECT_TRUE(found) << "i=" << i;
+    }
+}
+
+typedef std::vector<std::vector<float> > TrackList;
+
+// The tracks as lists of (view, x, y), sorted.
+static TrackList trackList(const libmv::Matches &matches)
+{
+    std::map<int, std::map<int, Point2f> > features;
+    for (libmv::Matches::Points f = matches.All<libmv::PointFeature>(); f; ++f)
+        features[f.track()][f.image()] = Point2f(f.feature()->x(), f.feature()->y());
+
+    TrackList tracks;
+    for (std::map<int, std::map<int, Point2f> >::const_iterator t = features.begin(); t != features.end(); ++t)
+    {
+        std::vector<float> track;
+        for (std::map<int, Point2f>::const_iterator v = t->second.begin(); v != t->second.end(); ++v)
+        {
+            track.push_back((float)v->first);
+            track.push_back(v->second.x);
+            track.push_back(v->second.y);
+        }
+        tracks.push_back(track);
+    }
+    std::sort(tracks.begin(), tracks.end());
+    return tracks;
+}
+
+static TrackList matchImages(const std::vector<std::string> &images, const std::string &cacheDir,
+                             const Ptr<Feature2D> &describer)
+{
+    nRobustViewMatching matcher(SIFT::create(), describer);
+    matcher.setCacheDirectory(cacheDir);
+    srand(0);  // the geometric filtering samples with rand()
+    matcher.computeCrossMatch(images);
+    return trackList(matcher.getMatches());
+}
+
+TEST(Sfm_robust_view_matching, cache_round_trip)
+{
+    const std::string dir = tempfile("sfm_matching");
+    ASSERT_TRUE(utils::fs::createDirectories(dir));
+    const std::string cacheDir = utils::fs::join(dir, "cache");
+
+    // Views of a planar texture translated by multiples of the coarsest
+    // octave step, so that the matches fit any fundamental matrix sampled
+    // on them.
+    RNG rng(0);
+    Mat texture(360, 480, CV_8U);
+    rng.fill(texture, RNG::UNIFORM, 0, 256);
+    GaussianBlur(texture, texture, Size(5, 5), 1.5);
+    std::vector<std::string> images;
+    for (int i = 0; i < 3; ++i)
+    {
+        images.push_back(utils::fs::join(dir, cv::format("view%d.png", i)));
+        ASSERT_TRUE(imwrite(images.back(), texture(Rect(32 * i, 16 * i, 400, 300))));
+    }
+
+    const TrackList computed = matchImages(images, cacheDir, SIFT::create());
+    ASSERT_FALSE(computed.empty());
+
+    std::vector<cv::String> features, files;
+    utils::fs::glob(cacheDir, "*.features.yml.gz", features);
+    EXPECT_EQ(3u, features.size());
+    utils::fs::glob(cacheDir, "*.matches.yml.gz", files);
+    ASSERT_EQ(3u, files.size());
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        FileStorage fs(files[i], FileStorage::READ);
+        EXPECT_EQ(SIFT::create()->getDefaultName(), (std::string)fs["detector"]);
+        EXPECT_EQ(SIFT::create()->getDefaultName(), (std::string)fs["describer"]);
+    }
+
+    // Nothing is detected in the blank images: the tracks come from the cache.
+    for (size_t i = 0; i < images.size(); ++i)
+        ASSERT_TRUE(imwrite(images[i], Mat::zeros(300, 400, CV_8U)));
+    EXPECT_EQ(computed, matchImages(images, cacheDir, SIFT::create()));
+
+    // The cache of another describer is not used.
+    EXPECT_TRUE(matchImages(images, cacheDir, ORB::create()).empty());
+
+    utils::fs::remove_all(dir);
+}
+
+}} // namespace
@@ -83,5 +83,45 @@ TEST(Sfm_simple_pipeline, backyard)
                               // UPDATE:  1.38894
 }
 
+TEST(Sfm_simple_pipeline, backyard_threads_consistency)
+{
+    string trackFilename =
+      string(TS::ptr()->get_data_path()) + SFM_DIR + "/" + TRACK_FILENAME;
+
+    std::vector<Mat> points2d;
+    parser_2D_tracks( trackFilename, points2d );
+
+    double focal_length = 860.986572265625;
+    double principal_x = 400, principal_y = 225, k1 = -0.158, k2 = 0.131, k3 = 0;
+    int refine_intrinsics = SFM_REFINE_FOCAL_LENGTH | SFM_REFINE_PRINCIPAL_POINT | SFM_REFINE_RADIAL_DISTORTION_K1 | SFM_REFINE_RADIAL_DISTORTION_K2;
+
+    libmv_CameraIntrinsicsOptions camera_instrinsic_options =
+      libmv_CameraIntrinsicsOptions(SFM_DISTORTION_MODEL_POLYNOMIAL,
+                                    focal_length, principal_x, principal_y,
+                                    k1, k2, k3);
+
+    double error[2];
+    Mat points3d[2];
+    const int num_threads[2] = { 1, 4 };
+    for (int i = 0; i < 2; i++)
+    {
+        libmv_ReconstructionOptions reconstruction_options(1, 30, refine_intrinsics, 0, -1, num_threads[i]);
+        Ptr<SFMLibmvEuclideanReconstruction> euclidean_reconstruction =
+            SFMLibmvEuclideanReconstruction::create(camera_instrinsic_options, reconstruction_options);
+        euclidean_reconstruction->run(points2d);
+        error[i] = euclidean_reconstruction->getError();
+
+        std::vector<Mat> points;
+        euclidean_reconstruction->getPoints(points);
+        hconcat(points, points3d[i]);
+    }
+
+    // Views are resected and intersected in the same order whatever the number
+    // of threads, only the bundle adjustment sums may be reordered.
+    EXPECT_NEAR(error[0], error[1], 1e-3);
+    ASSERT_EQ(points3d[0].total(), points3d[1].total());
+    EXPECT_LE(cvtest::norm(points3d[0], points3d[1], NORM_INF), 1e-3);
+}
+
 }} // namespace
 #endif /* CERES_FOUND */
@@ -64,6 +64,9 @@ struct CV_EXPORTS_W_SIMPLE PropagationParameters
     CV_PROP_RW int gftMinSeperationDist;
     CV_PROP_RW int gftMaxNumFeatures;
 
+    // Parallel propagation.
+    CV_PROP_RW int tileSize;                // tile side in pixels, 0 disables tiled propagation
+
 };
 
 
@@ -85,6 +88,11 @@ struct CV_EXPORTS_W_SIMPLE PropagationParameters
  * that are not previously computed. New matches are stored in the seed priority queue and used as seeds.
  * The propagation process ends when no additional matches can be retrieved.
  *
+ * When PropagationParameters::tileSize is positive, the left image is split into square tiles and
+ * every tile grows its own seeds best-first in parallel. Matches that claim the same right image
+ * pixel from different tiles are resolved by keeping the one with the highest ZNCC, and a final
+ * sequential pass stitches the regions across tile borders and into tiles that had no seeds.
+ *
  *
  * @sa This code represents the work presented in @cite Stoyanov2010.
  * If this code is useful for your work please cite @cite Stoyanov2010.
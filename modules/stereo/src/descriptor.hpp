@@ -71,6 +71,19 @@ namespace cv
                 }
                 stop = num_images;
             }
+#if CV_SIMD // sizeless scalable vectors cannot form the array of accumulators
+            void operator()(int rrWidth,int w2, int rWidth, int jj, int j, v_int32 c[num_images]) const
+            {
+                CV_UNUSED(w2);
+                for (int i = 0; i < stop; i++)
+                {
+                    v_int32 center = v_reinterpret_as_s32(vx_load_expand_q(image[i] + rWidth + j));
+                    v_int32 val = v_reinterpret_as_s32(vx_load_expand_q(image[i] + rrWidth + jj));
+                    c[i] = v_shl<1>(v_sub(c[i], v_gt(val, center)));
+                    c[i] = v_shl<1>(v_sub(c[i], v_gt(vx_load(integralImage[i] + rrWidth + jj), center)));
+                }
+            }
+#endif
 
             void operator()(int rrWidth,int w2, int rWidth, int jj, int j, int c[num_images]) const
             {
@@ -108,6 +121,20 @@ namespace cv
                 imageStop = num_images;
                 t = threshold;
             }
+#if CV_SIMD
+            void operator()(int rrWidth,int w2, int rWidth, int jj, int j, v_int32 c[num_images]) const
+            {
+                CV_UNUSED(w2);
+                const v_int32 vt = vx_setall_s32(t), one = vx_setall_s32(1), three = vx_setall_s32(3);
+                for(int i = 0; i < imageStop; i++)
+                {
+                    v_int32 center = v_reinterpret_as_s32(vx_load_expand_q(image[i] + rWidth + j));
+                    v_int32 val = v_reinterpret_as_s32(vx_load_expand_q(image[i] + rrWidth + jj));
+                    v_int32 inc = v_select(v_gt(val, v_add(center, vt)), three, v_and(v_gt(val, v_sub(center, vt)), one));
+                    c[i] = v_add(v_shl<2>(c[i]), inc);
+                }
+            }
+#endif
 
             void operator()(int rrWidth,int w2, int rWidth, int jj, int j, int c[num_images]) const
             {
@@ -139,6 +166,19 @@ namespace cv
                 imageStop = num_images;
                 n2 = ker;
             }
+#if CV_SIMD
+            void operator()(int rrWidth,int w2, int rWidth, int jj, int j, v_int32 c[num_images]) const
+            {
+                CV_UNUSED(j);
+                CV_UNUSED(rWidth);
+                for(int i = 0; i < imageStop; i++)
+                {
+                    v_int32 val = v_reinterpret_as_s32(vx_load_expand_q(image[i] + rrWidth + jj));
+                    v_int32 sym = v_reinterpret_as_s32(vx_load_expand_q(image[i] + w2 + jj + n2));
+                    c[i] = v_shl<1>(v_sub(c[i], v_gt(val, sym)));
+                }
+            }
+#endif
 
             void operator()(int rrWidth,int w2, int rWidth, int jj, int j, int c[num_images]) const
             {
@@ -168,6 +208,18 @@ namespace cv
                     image[i] = images[i];
                 imageStop = num_images;
             }
+#if CV_SIMD
+            void operator()(int rrWidth,int w2, int rWidth, int jj, int j, v_int32 c[num_images]) const
+            {
+                CV_UNUSED(w2);
+                for(int i = 0; i < imageStop; i++)
+                {
+                    v_int32 center = v_reinterpret_as_s32(vx_load_expand_q(image[i] + rWidth + j));
+                    v_int32 val = v_reinterpret_as_s32(vx_load_expand_q(image[i] + rrWidth + jj));
+                    c[i] = v_shl<1>(v_sub(c[i], v_gt(val, center)));
+                }
+            }
+#endif
 
             void operator()(int rrWidth,int w2, int rWidth, int jj, int j, int c[num_images]) const
             {
@@ -211,36 +263,74 @@ namespace cv
                 for (int i = r.start; i < r.end ; i++)
                 {
                     int rWidth = i * stride_;
-                    for (int j = 0; j < width; j++)
+                    int j = 0;
+#if CV_SIMD // see MVKernel, the accumulators are an array of vectors
+                    // all the pixels of a vector are processed by the same sequence of comparisons,
+                    // so the interior of the row is handled VTraits<v_int32>::vlanes() pixels at a time
+                    const int vlanes = VTraits<v_int32>::vlanes();
+                    if (i >= n2 && i < height - n2)
                     {
-                        if (i < n2 || i >= height - n2 || j < n2 + 2 || j >= width - n2 - 2)
+                        for (; j < n2 + 2; j++)
+                            computePixel(i, j);
+                        for (; j <= width - n2 - 2 - vlanes; j += vlanes)
                         {
+                            v_int32 c[nr_img];
                             for(int l = 0; l < nr_img; l++)
-                                dst[l][rWidth + j] = 0;  // TODO out of range value?
-                            continue;
-                        }
-
-                        int c[nr_img];
-                        memset(c, 0, sizeof(c[0]) * nr_img);
-                        for(int step = step_start; step <= step_end; step += step_inc)
-                        {
-                            for (int ii = - n2; ii <= + n2_stop; ii += step)
+                                c[l] = vx_setzero_s32();
+                            for(int step = step_start; step <= step_end; step += step_inc)
                             {
-                                int rrWidth = (ii + i) * stride_;
-                                int rrWidthC = (ii + i + n2) * stride_;
-                                for (int jj = j - n2; jj <= j + n2; jj += step)
+                                for (int ii = - n2; ii <= + n2_stop; ii += step)
                                 {
-                                    if (ii != i || jj != j)
+                                    int rrWidth = (ii + i) * stride_;
+                                    int rrWidthC = (ii + i + n2) * stride_;
+                                    for (int dj = - n2; dj <= + n2; dj += step)
                                     {
-                                        kernel_(rrWidth,rrWidthC, rWidth, jj, j,c);
+                                        if (ii != i || dj != 0)
+                                        {
+                                            kernel_(rrWidth,rrWidthC, rWidth, j + dj, j,c);
+                                        }
                                     }
                                 }
                             }
+                            for(int l = 0; l < nr_img; l++)
+                                v_store(dst[l] + rWidth + j, c[l]);
+                        }
+                    }
+#endif
+                    for (; j < width; j++)
+                        computePixel(i, j);
+                }
+            }
+
+            void computePixel(int i, int j) const
+            {
+                int rWidth = i * stride_;
+                if (i < n2 || i >= height - n2 || j < n2 + 2 || j >= width - n2 - 2)
+                {
+                    for(int l = 0; l < nr_img; l++)
+                        dst[l][rWidth + j] = 0;  // TODO out of range value?
+                    return;
+                }
+
+                int c[nr_img];
+                memset(c, 0, sizeof(c[0]) * nr_img);
+                for(int step = step_start; step <= step_end; step += step_inc)
+                {
+                    for (int ii = - n2; ii <= + n2_stop; ii += step)
+                    {
+                        int rrWidth = (ii + i) * stride_;
+                        int rrWidthC = (ii + i + n2) * stride_;
+                        for (int jj = j - n2; jj <= j + n2; jj += step)
+                        {
+                            if (ii != i || jj != j)
+                            {
+                                kernel_(rrWidth,rrWidthC, rWidth, jj, j,c);
+                            }
                         }
-                        for(int l = 0; l < nr_img; l++)
-                            dst[l][rWidth + j] = c[l];
                     }
                 }
+                for(int l = 0; l < nr_img; l++)
+                    dst[l][rWidth + j] = c[l];
             }
         };
 
@@ -163,7 +163,18 @@ namespace cv
                         for (int j = kernelSize; j < width - kernelSize; j++)
                         {
                             int iwj = iw + j;
-                            for (int d = 0; d <= v; d++)
+                            int d = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                            const int vlanes = VTraits<v_uint32>::vlanes();
+                            const v_uint32 vleft = vx_setall_u32((unsigned)left[iwj]);
+                            // the right descriptors for d .. d + vlanes - 1 are stored in the reverse order
+                            for (; d + vlanes <= v + 1 && j - d - vlanes + 1 >= 0; d += vlanes)
+                            {
+                                v_uint32 vright = v_reverse(vx_load((const unsigned *)right + iw + j - d - vlanes + 1));
+                                v_pack_store(c + iwj * (v + 1) + d, v_reinterpret_as_s32(v_popcount(v_xor(vleft, vright))));
+                            }
+#endif
+                            for (; d <= v; d++)
                             {
                                 int j2 = std::max(0, j - d);
                                 int xorul = left[(iwj)] ^ right[(iw + j2)];
@@ -219,7 +230,17 @@ namespace cv
                             int w2 = ((i - win) * width + j - win - 1) * (maxDisp + 1);
                             int w3 = ((i + win + 1) * width + j - win - 1) * (maxDisp + 1);
                             int w4 = ((i - win) * width + j + win) * (maxDisp + 1);
-                            for (int d = 0; d <= maxDisp; d++)
+                            int d = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                            const int vlanes = VTraits<v_int16>::vlanes();
+                            for (; d <= maxDisp + 1 - vlanes; d += vlanes)
+                            {
+                                v_int16 s12 = v_add_wrap(vx_load(parSum + w1 + d), vx_load(parSum + w2 + d));
+                                v_int16 s34 = v_add_wrap(vx_load(parSum + w3 + d), vx_load(parSum + w4 + d));
+                                v_store(c + w + d, v_sub_wrap(s12, s34));
+                            }
+#endif
+                            for (; d <= maxDisp; d++)
                             {
                                 c[w + d] = parSum[w1 + d] + parSum[w2 + d]
                                 - parSum[w3 + d] - parSum[w4 + d];
@@ -228,6 +249,78 @@ namespace cv
                     }
                 }
             };
+            //!horizontal pass of the partial sums, the rows are independent
+            class horizontalPartialSums:public ParallelLoopBody
+            {
+            private:
+                short *c, *ham;
+                int maxDisp, width;
+            public:
+                horizontalPartialSums(const Mat &hammingDistanceCost, int maxDispa, Mat &cost)
+                {
+                    c = (short *)cost.data;
+                    ham = (short *)hammingDistanceCost.data;
+                    maxDisp = maxDispa;
+                    width = cost.cols / ( maxDisp + 1) - 1;
+                }
+                void operator()(const cv::Range &r) const CV_OVERRIDE {
+                    for (int i = r.start; i < r.end; i++)
+                    {
+                        int iw = i * width;
+                        int iwi = (i - 1) * width;
+                        for (int j = 1; j < width; j++)
+                        {
+                            int iwj = (iw + j) * (maxDisp + 1);
+                            int iwjmu = (iw + j - 1) * (maxDisp + 1);
+                            int iwijmu = (iwi + j - 1) * (maxDisp + 1);
+                            int d = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                            const int vlanes = VTraits<v_int16>::vlanes();
+                            for (; d <= maxDisp + 1 - vlanes; d += vlanes)
+                                v_store(c + iwj + d, v_add_wrap(vx_load(ham + iwijmu + d), vx_load(c + iwjmu + d)));
+#endif
+                            for (; d <= maxDisp; d++)
+                            {
+                                c[iwj + d] = ham[iwijmu + d] + c[iwjmu + d];
+                            }
+                        }
+                    }
+                }
+            };
+            //!vertical pass of the partial sums, the columns are independent
+            class verticalPartialSums:public ParallelLoopBody
+            {
+            private:
+                short *c;
+                int maxDisp, width, height;
+            public:
+                verticalPartialSums(int maxDispa, Mat &cost)
+                {
+                    c = (short *)cost.data;
+                    maxDisp = maxDispa;
+                    width = cost.cols / ( maxDisp + 1) - 1;
+                    height = cost.rows - 1;
+                }
+                //the range is given in elements of a row, starting from the column 1
+                void operator()(const cv::Range &r) const CV_OVERRIDE {
+                    const int rowSize = width * (maxDisp + 1);
+                    for (int i = 1; i < height; i++)
+                    {
+                        short *cur = c + i * rowSize;
+                        const short *prev = c + (i - 1) * rowSize;
+                        int k = r.start;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                        const int vlanes = VTraits<v_int16>::vlanes();
+                        for (; k <= r.end - vlanes; k += vlanes)
+                            v_store(cur + k, v_add_wrap(vx_load(cur + k), vx_load(prev + k)));
+#endif
+                        for (; k < r.end; k++)
+                        {
+                            cur[k] += prev[k];
+                        }
+                    }
+                }
+            };
             //!class that is responsable for generating the disparity map
             class makeMap:public ParallelLoopBody
             {
@@ -446,35 +539,9 @@ namespace cv
                 int width = cost.cols / ( maxDisp + 1) - 1;
                 int height = cost.rows - 1;
                 short *c = (short *)cost.data;
-                short *ham = (short *)hammingDistanceCost.data;
                 memset(c, 0, sizeof(c[0]) * (width + 1) * (height + 1) * (maxDisp + 1));
-                for (int i = 1; i < height; i++)
-                {
-                    int iw = i * width;
-                    int iwi = (i - 1) * width;
-                    for (int j = 1; j < width; j++)
-                    {
-                        int iwj = (iw + j) * (maxDisp + 1);
-                        int iwjmu = (iw + j - 1) * (maxDisp + 1);
-                        int iwijmu = (iwi + j - 1) * (maxDisp + 1);
-                        for (int d = 0; d <= maxDisp; d++)
-                        {
-                            c[iwj + d] = ham[iwijmu + d] + c[iwjmu + d];
-                        }
-                    }
-                }
-                for (int i = 1; i < height; i++)
-                {
-                    for (int j = 1; j < width; j++)
-                    {
-                        int iwj = (i * width + j) * (maxDisp + 1);
-                        int iwjmu = ((i - 1)  * width + j) * (maxDisp + 1);
-                        for (int d = 0; d <= maxDisp; d++)
-                        {
-                            c[iwj + d] += c[iwjmu + d];
-                        }
-                    }
-                }
+                parallel_for_(cv::Range(1, height), horizontalPartialSums(hammingDistanceCost, maxDisp, cost));
+                parallel_for_(cv::Range(maxDisp + 1, width * (maxDisp + 1)), verticalPartialSums(maxDisp, cost), 16);
             }
             //!The aggregation on the cost volume
             void blockAgregation(const Mat &partialSums, int windowSize, Mat &cost)
@@ -45,6 +45,7 @@
 #include "opencv2/core.hpp"
 #include "opencv2/imgproc.hpp"
 #include "opencv2/calib3d.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 #include "opencv2/stereo.hpp"
 
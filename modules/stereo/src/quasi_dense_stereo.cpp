@@ -6,6 +6,7 @@
 #include <opencv2/video/tracking.hpp>
 #include <opencv2/stereo/quasi_dense_stereo.hpp>
 #include <queue>
+#include <unordered_set>
 
 
 namespace cv {
@@ -37,6 +38,12 @@ public:
         // texture images.
         textureDescLeft = cv::Mat_<int> (monoImgSize);
         textureDescRight = cv::Mat_<int> (monoImgSize);
+        // patch statistics and ZNCC of the matches found by tiled propagation.
+        patchMean0 = cv::Mat_<float>(monoImgSize);
+        patchMean1 = cv::Mat_<float>(monoImgSize);
+        patchStd0 = cv::Mat_<float>(monoImgSize);
+        patchStd1 = cv::Mat_<float>(monoImgSize);
+        corrMap = cv::Mat_<float>(monoImgSize);
     }
 
     ~QuasiDenseStereoImpl()
@@ -57,6 +64,11 @@ public:
         // texture images.
         textureDescLeft.release();
         textureDescRight.release();
+        patchMean0.release();
+        patchMean1.release();
+        patchStd0.release();
+        patchStd1.release();
+        corrMap.release();
     }
 
 
@@ -151,12 +163,37 @@ public:
         cv::integral(grayLeft, sum0, ssum0);
         cv::integral(grayRight, sum1, ssum1);
 
+        // per pixel patch mean and standard deviation, so ZNCC only needs the cross term.
+        computePatchStatistics(sum0, ssum0, patchMean0, patchStd0);
+        computePatchStatistics(sum1, ssum1, patchMean1, patchStd1);
+
         // Seed priority queue. The algorithm wants to pop the best seed available in order to densify
         //the sparse set.
         t_matchPriorityQueue seeds = extractSparseSeeds(featuresLeft, featuresRight,
         refMap, mtcMap);
 
+        if (Param.tileSize > 0)
+            dMatchesLen = propagateTiled(seeds);
+        else
+            dMatchesLen = propagate(seeds, cv::Rect(0, 0, width, height), NULL);
+    }
+
 
+    /**
+     * @brief Best-first growth of the matches in the seed queue.
+     *
+     * Only left image points inside roi are considered. When claims is NULL, new matches are
+     * registered in both refMap and mtcMap. Otherwise mtcMap is only read and the right image
+     * points taken by this call are recorded in claims, which makes it safe to run several calls
+     * with disjoint regions concurrently. The ZNCC of every new match is then stored in corrMap.
+     * @param[in,out] seeds The seed queue. It is empty on return.
+     * @param[in] roi The region of the left image the growth is restricted to.
+     * @param[in,out] claims Local set of right image pixel indices, or NULL.
+     * @return The number of new matches.
+     */
+    int propagate(t_matchPriorityQueue &seeds, const cv::Rect &roi, std::unordered_set<int> *claims)
+    {
+        int added = 0;
         // Do the propagation part
         while(!seeds.empty())
         {
@@ -178,6 +215,9 @@ public:
                 {
                     cv::Point2i p0 = cv::Point2i(m.p0.x+x,m.p0.y+y);
 
+                    if(!roi.contains(p0))
+                        continue;
+
                     // Check if its unique in ref
                     if(refMap.at<cv::Point2i>(p0.y,p0.x) != NO_MATCH)
                         continue;
@@ -196,6 +236,8 @@ public:
                             // Check if its unique in ref
                             if(mtcMap.at<cv::Point2i>(p1.y, p1.x) != NO_MATCH)
                                 continue;
+                            if(claims && claims->count(p1.y*width + p1.x))
+                                continue;
 
                             // Check the texture descriptor for a boundary
                             if(textureDescRight.at<int>(p1.y, p1.x) > Param.textrureThreshold)
@@ -229,18 +271,167 @@ public:
                 if(mtcMap.at<cv::Point2i>(lm.p1.y, lm.p1.x) != NO_MATCH)
                     continue;
 
+                if(claims)
+                {
+                    if(!claims->insert(lm.p1.y*width + lm.p1.x).second)
+                        continue;
+                    corrMap.at<float>(lm.p0.y, lm.p0.x) = lm.corr;
+                }
+                else
+                {
+                    mtcMap.at<cv::Point2i>(lm.p1.y, lm.p1.x) = lm.p0;
+                }
 
                 // Unique match
                 refMap.at<cv::Point2i>(lm.p0.y, lm.p0.x) = lm.p1;
-                mtcMap.at<cv::Point2i>(lm.p1.y, lm.p1.x) = lm.p0;
-                dMatchesLen++;
+                added++;
                 // Add to the seed list
                 seeds.push(lm);
             }
         }
+        return added;
     }
 
 
+    /**
+     * @brief Grows every tile of the left image in parallel.
+     *
+     * Each tile owns the refMap entries of its pixels, so the only conflicts between tiles are
+     * right image pixels claimed by more than one tile. Those are resolved in favour of the match
+     * with the highest ZNCC and the losers are released. The matches near tile borders and around
+     * the released pixels then seed a sequential pass over the whole image, which also reaches
+     * tiles that did not contain any seed.
+     * @param[in,out] seeds The seed queue produced by extractSparseSeeds. It is empty on return.
+     * @return The number of matches added to the sparse seeds.
+     */
+    int propagateTiled(t_matchPriorityQueue &seeds)
+    {
+        const int tileSize = Param.tileSize;
+        const int tilesX = (width + tileSize - 1) / tileSize;
+        const int tilesY = (height + tileSize - 1) / tileSize;
+        const int N = Param.neighborhoodSize;
+
+        std::vector<t_matchPriorityQueue> tileSeeds(tilesX * tilesY);
+        while(!seeds.empty())
+        {
+            const MatchQuasiDense &m = seeds.top();
+            corrMap.at<float>(m.p0.y, m.p0.x) = m.corr;
+            tileSeeds[(m.p0.y / tileSize) * tilesX + m.p0.x / tileSize].push(m);
+            seeds.pop();
+        }
+
+        parallel_for_(Range(0, tilesX * tilesY), TilePropagationInvoker(*this, tileSeeds, tilesX));
+
+        // Right image pixels are not yet registered in mtcMap for matches found by the tiles,
+        // keep the best claim of each of them.
+        cv::Mat_<float> bestCorr(height, width, -FLT_MAX);
+        std::vector<cv::Point2i> tileMatches;
+        for(int row=0; row<height; row++)
+        {
+            for(int col=0; col<width; col++)
+            {
+                const cv::Point2i p1 = refMap.at<cv::Point2i>(row, col);
+                if(p1 == NO_MATCH || mtcMap.at<cv::Point2i>(p1.y, p1.x) != NO_MATCH)
+                    continue;
+                tileMatches.push_back(cv::Point2i(col, row));
+                float &best = bestCorr.at<float>(p1.y, p1.x);
+                best = std::max(best, corrMap.at<float>(row, col));
+            }
+        }
+
+        int added = 0;
+        std::vector<cv::Point2i> released;
+        for(size_t i=0; i<tileMatches.size(); i++)
+        {
+            const cv::Point2i p0 = tileMatches[i];
+            const cv::Point2i p1 = refMap.at<cv::Point2i>(p0.y, p0.x);
+            cv::Point2i &owner = mtcMap.at<cv::Point2i>(p1.y, p1.x);
+            if(owner == NO_MATCH && corrMap.at<float>(p0.y, p0.x) == bestCorr.at<float>(p1.y, p1.x))
+            {
+                owner = p0;
+                added++;
+            }
+            else
+            {
+                refMap.at<cv::Point2i>(p0.y, p0.x) = NO_MATCH;
+                released.push_back(p0);
+            }
+        }
+
+        // Stitch across tile borders and refill released pixels.
+        t_matchPriorityQueue stitch;
+        for(int row=0; row<height; row++)
+        {
+            const int ty = row % tileSize;
+            const bool nearY = (ty < N && row >= tileSize) ||
+                               (ty >= tileSize - N && row / tileSize < tilesY - 1);
+            for(int col=0; col<width; col++)
+            {
+                const int tx = col % tileSize;
+                const bool nearX = (tx < N && col >= tileSize) ||
+                                   (tx >= tileSize - N && col / tileSize < tilesX - 1);
+                if(!(nearX || nearY))
+                    continue;
+                pushMatch(stitch, cv::Point2i(col, row));
+            }
+        }
+        for(size_t i=0; i<released.size(); i++)
+        {
+            const cv::Point2i p = released[i];
+            for(int y=std::max(p.y-N, 0); y<=std::min(p.y+N, height-1); y++)
+                for(int x=std::max(p.x-N, 0); x<=std::min(p.x+N, width-1); x++)
+                    pushMatch(stitch, cv::Point2i(x, y));
+        }
+
+        added += propagate(stitch, cv::Rect(0, 0, width, height), NULL);
+        return added;
+    }
+
+
+    /**
+     * @brief Push the match registered for the left image point p0, if any, to the queue.
+     */
+    void pushMatch(t_matchPriorityQueue &queue, const cv::Point2i p0)
+    {
+        MatchQuasiDense m;
+        m.p0 = p0;
+        m.p1 = refMap.at<cv::Point2i>(p0.y, p0.x);
+        if(m.p1 == NO_MATCH)
+            return;
+        m.corr = corrMap.at<float>(p0.y, p0.x);
+        queue.push(m);
+    }
+
+
+    class TilePropagationInvoker : public ParallelLoopBody
+    {
+    public:
+        TilePropagationInvoker(QuasiDenseStereoImpl &_impl, std::vector<t_matchPriorityQueue> &_seeds,
+                               int _tilesX)
+            : impl(_impl), seeds(_seeds), tilesX(_tilesX)
+        {}
+
+        void operator()(const Range &range) const CV_OVERRIDE
+        {
+            const int tileSize = impl.Param.tileSize;
+            for(int t=range.start; t<range.end; t++)
+            {
+                if(seeds[t].empty())
+                    continue;
+                cv::Rect roi((t % tilesX) * tileSize, (t / tilesX) * tileSize, tileSize, tileSize);
+                roi &= cv::Rect(0, 0, impl.width, impl.height);
+                std::unordered_set<int> claims;
+                impl.propagate(seeds[t], roi, &claims);
+            }
+        }
+
+    private:
+        QuasiDenseStereoImpl &impl;
+        std::vector<t_matchPriorityQueue> &seeds;
+        int tilesX;
+    };
+
+
     /**
      * @brief Compute the disparity map based on the Euclidean distance of corresponding points.
      * @param[in] matchMap A matrix of points, the same size as the left channel. Each cell of this
@@ -278,82 +469,158 @@ public:
      *
      * Compare a patch in the left image, centered in point p0 with a patch in the right image,
      * centered in point p1. Patches are defined by wy, wx and the patch size is (2*wx+1) by
-     * (2*wy+1).
+     * (2*wy+1). The mean and standard deviation of both patches are read from the statistics
+     * computed by computePatchStatistics, so only the cross term is evaluated here.
      * @param [in] p0 The central point of the patch in the left image.
      * @param [in] p1 The central point of the patch in the right image.
      * @param [in] wx The distance from the center of the patch to the border in the x direction.
      * @param [in] wy The distance from the center of the patch to the border in the y direction.
      * @return The value of the the zero-mean normalized cross correlation.
-     * @note Default value for wx, wy is 1. in this case the patch is 3x3.
+     * @note wx and wy must be the window the statistics were computed with, i.e.
+     * Param.corrWinSizeX and Param.corrWinSizeY.
      */
     float iZNCC_c1(const cv::Point2i p0, const cv::Point2i p1, const int wx=1, const int wy=1)
     {
-        float m0=0.0 ,m1=0.0 ,s0=0.0 ,s1=0.0;
-        float wa = (float)(2*wy+1)*(2*wx+1);
-        float zncc=0.0;
-
-
-        patchSumSum2(p0, sum0, ssum0, m0, s0, wx, wy);
-        patchSumSum2(p1, sum1, ssum1, m1, s1, wx, wy);
+        const float wa = (float)(2*wy+1)*(2*wx+1);
+        const float m0 = patchMean0.at<float>(p0.y, p0.x);
+        const float m1 = patchMean1.at<float>(p1.y, p1.x);
+        const float s0 = patchStd0.at<float>(p0.y, p0.x);
+        const float s1 = patchStd1.at<float>(p1.y, p1.x);
 
-        m0 /= wa;
-        m1 /= wa;
-
-        // standard deviations
-        s0 = sqrt(s0-wa*m0*m0);
-        s1 = sqrt(s1-wa*m1*m1);
+        float zncc = (float)patchCrossSum(p0, p1, wx, wy);
+        zncc = (zncc-wa*m0*m1)/(s0*s1);
+        return zncc;
+    }
 
 
-        for (int col=-wy; col<=wy; col++)
+    /**
+     * @brief Sum of the products of corresponding pixels of the left patch centered in p0 and the
+     * right patch centered in p1.
+     */
+    int patchCrossSum(const cv::Point2i p0, const cv::Point2i p1, const int wx, const int wy) const
+    {
+        const int patchWidth = 2*wx+1;
+        int sum = 0;
+#if CV_SIMD128
+        v_int32x4 vsum = v_setzero_s32();
+#endif
+        for (int row=-wy; row<=wy; row++)
         {
-            for (int row=-wx; row<=wx; row++)
+            const uchar *r0 = grayLeft.ptr<uchar>(p0.y+row) + p0.x - wx;
+            const uchar *r1 = grayRight.ptr<uchar>(p1.y+row) + p1.x - wx;
+            int col = 0;
+#if CV_SIMD128
+            // correlation windows are small, 128-bit registers cover them best.
+            for (; col <= patchWidth - 8; col += 8)
             {
-                zncc += (float)grayLeft.at<uchar>(p0.y+row, p0.x+col) *
-                (float)grayRight.at<uchar>(p1.y+row, p1.x+col);
+                v_int16x8 a = v_reinterpret_as_s16(v_load_expand(r0 + col));
+                v_int16x8 b = v_reinterpret_as_s16(v_load_expand(r1 + col));
+                vsum = v_add(vsum, v_dotprod(a, b));
             }
+#endif
+            for (; col < patchWidth; col++)
+                sum += (int)r0[col] * (int)r1[col];
         }
-        zncc = (zncc-wa*m0*m1)/(s0*s1);
-        return zncc;
+#if CV_SIMD128
+        sum += v_reduce_sum(vsum);
+#endif
+        return sum;
     }
 
 
     /**
-     * @brief Compute the sum of values and the sum of squared values of a patch with dimensions
-     * 2*xWindow+1 by 2*yWindow+1 and centered in point p, using the integral image and integral
-     * image of squared pixel values.
-     * @param[in] p The center of the patch we want to calculate the sum and sum of squared values.
-     * @param[in] s The integral image
-     * @param[in] ss The integral image of squared values.
-     * @param[out] sum The sum of pixels inside the patch.
-     * @param[out] ssum The sum of squared values inside the patch.
-     * @param [in] xWindow The distance from the central pixel of the patch to the border in x
-     * direction.
-     * @param [in] yWindow The distance from the central pixel of the patch to the border in y
-     * direction.
-     * @note Default value for xWindow, yWindow is 1. in this case the patch is 3x3.
-     * @note integral images are very useful to sum values of patches in constant time independent
-     * of their size. For more information refer to the cv::Integral function OpenCV page.
+     * @brief Compute the mean and the standard deviation of the correlation window centered in
+     * every pixel of an image from its integral images.
+     *
+     * Pixels whose window does not fit in the image get zero statistics.
+     * @param[in] sum The integral image.
+     * @param[in] ssum The integral image of squared values.
+     * @param[out] mean The patch means.
+     * @param[out] stddev The square root of the patch sum of squared deviations.
      */
-    void patchSumSum2(const cv::Point2i p, const cv::Mat &sum, const cv::Mat &ssum,
-                        float &s, float &ss, const int xWindow=1, const int yWindow=1)
+    void computePatchStatistics(const cv::Mat &sum, const cv::Mat &ssum,
+                                cv::Mat_<float> &mean, cv::Mat_<float> &stddev)
     {
-      cv::Point2i otl(p.x-xWindow, p.y-yWindow);
-      //outer top right
-      cv::Point2i otr(p.x+xWindow+1, p.y-yWindow);
-      //outer bottom left
-      cv::Point2i obl(p.x-xWindow, p.y+yWindow+1);
-      //outer bottom right
-      cv::Point2i obr(p.x+xWindow+1, p.y+yWindow+1);
-
-      // sum and squared sum for right window
-      s = (float)(sum.at<int>(otl) - sum.at<int>(otr)
-          - sum.at<int>(obl) + sum.at<int>(obr));
-
-      ss = (float)(ssum.at<double>(otl) - ssum.at<double>(otr)
-           - ssum.at<double>(obl) + ssum.at<double>(obr));
+        mean.create(height, width);
+        stddev.create(height, width);
+        parallel_for_(Range(0, height), PatchStatisticsInvoker(sum, ssum, mean, stddev,
+                                                               Param.corrWinSizeX, Param.corrWinSizeY));
     }
 
 
+    class PatchStatisticsInvoker : public ParallelLoopBody
+    {
+    public:
+        PatchStatisticsInvoker(const cv::Mat &_sum, const cv::Mat &_ssum,
+                               cv::Mat_<float> &_mean, cv::Mat_<float> &_stddev, int _wx, int _wy)
+            : sum(_sum), ssum(_ssum), mean(_mean), stddev(_stddev), wx(_wx), wy(_wy)
+        {}
+
+        void operator()(const Range &range) const CV_OVERRIDE
+        {
+            const int w = mean.cols, h = mean.rows;
+            const float wa = (float)(2*wy+1)*(2*wx+1);
+            const float iwa = 1.f / wa;
+            for (int y = range.start; y < range.end; y++)
+            {
+                float *m = mean.ptr<float>(y);
+                float *sd = stddev.ptr<float>(y);
+                if (y < wy || y >= h - wy)
+                {
+                    std::fill(m, m + w, 0.f);
+                    std::fill(sd, sd + w, 0.f);
+                    continue;
+                }
+                // window rows y-wy .. y+wy and columns x-wx .. x+wx.
+                const int *sTop = sum.ptr<int>(y - wy) - wx;
+                const int *sBot = sum.ptr<int>(y + wy + 1) - wx;
+                const double *ssTop = ssum.ptr<double>(y - wy) - wx;
+                const double *ssBot = ssum.ptr<double>(y + wy + 1) - wx;
+                const int d = 2*wx + 1;
+
+                int x = 0;
+                for (; x < std::min(wx, w); x++)
+                    m[x] = sd[x] = 0.f;
+                const int xend = std::max(w - wx, x);
+#if (CV_SIMD_64F || CV_SIMD_SCALABLE_64F)
+                const int vl = VTraits<v_float32>::vlanes();
+                const int vl64 = VTraits<v_float64>::vlanes();
+                const v_float32 vwa = vx_setall_f32(wa), viwa = vx_setall_f32(iwa);
+                for (; x <= xend - vl; x += vl)
+                {
+                    v_int32 s = v_add(v_sub(v_sub(vx_load(sTop + x), vx_load(sTop + x + d)),
+                                            vx_load(sBot + x)), vx_load(sBot + x + d));
+                    v_float64 ss0 = v_add(v_sub(v_sub(vx_load(ssTop + x), vx_load(ssTop + x + d)),
+                                                vx_load(ssBot + x)), vx_load(ssBot + x + d));
+                    v_float64 ss1 = v_add(v_sub(v_sub(vx_load(ssTop + x + vl64), vx_load(ssTop + x + vl64 + d)),
+                                                vx_load(ssBot + x + vl64)), vx_load(ssBot + x + vl64 + d));
+                    v_float32 vm = v_mul(v_cvt_f32(s), viwa);
+                    v_float32 vss = v_cvt_f32(ss0, ss1);
+                    v_store(m + x, vm);
+                    v_store(sd + x, v_sqrt(v_sub(vss, v_mul(vwa, v_mul(vm, vm)))));
+                }
+#endif
+                for (; x < xend; x++)
+                {
+                    float s = (float)(sTop[x] - sTop[x + d] - sBot[x] + sBot[x + d]);
+                    float ss = (float)(ssTop[x] - ssTop[x + d] - ssBot[x] + ssBot[x + d]);
+                    m[x] = s * iwa;
+                    sd[x] = std::sqrt(ss - wa * m[x] * m[x]);
+                }
+                for (; x < w; x++)
+                    m[x] = sd[x] = 0.f;
+            }
+        }
+
+    private:
+        const cv::Mat &sum;
+        const cv::Mat &ssum;
+        cv::Mat_<float> &mean;
+        cv::Mat_<float> &stddev;
+        int wx, wy;
+    };
+
+
     /**
      * @brief Create a priority queue containing sparse Matches
      *
@@ -500,6 +767,7 @@ public:
             fs["gftQualityThres"] >> Param.gftQualityThres;
             fs["gftMinSeperationDist"] >> Param.gftMinSeperationDist;
             fs["gftMaxNumFeatures"] >> Param.gftMaxNumFeatures;
+            fs["tileSize"] >> Param.tileSize;
             fs.release();
             return 1;
         }
@@ -523,6 +791,8 @@ public:
         Param.gftQualityThres = (float)0.01;
         Param.gftMinSeperationDist = 10;
         Param.gftMaxNumFeatures = 500;
+
+        Param.tileSize = 0;
         // Return 0 if there was no filepath provides.
         // Return -1 if there was a problem opening the filepath provided.
         if(filepath.empty())
@@ -555,6 +825,7 @@ public:
             fs << "gftQualityThres" << Param.gftQualityThres;
             fs << "gftMinSeperationDist" << Param.gftMinSeperationDist;
             fs << "gftMaxNumFeatures" << Param.gftMaxNumFeatures;
+            fs << "tileSize" << Param.tileSize;
             fs.release();
         }
         return -1;
@@ -632,6 +903,13 @@ public:
     // Containers to store textures descriptors.
     cv::Mat_<int> textureDescLeft;
     cv::Mat_<int> textureDescRight;
+    // Mean and standard deviation of the correlation window around every pixel.
+    cv::Mat_<float> patchMean0;
+    cv::Mat_<float> patchMean1;
+    cv::Mat_<float> patchStd0;
+    cv::Mat_<float> patchStd1;
+    // ZNCC of the registered matches, used by tiled propagation.
+    cv::Mat_<float> corrMap;
 
 };
 
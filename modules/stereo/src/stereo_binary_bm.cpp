@@ -126,7 +126,19 @@ namespace cv
                 const uchar* curr = sptr + srcstep*y;
                 const uchar* next = sptr + srcstep*MIN(y + 1, size.height - 1);
                 uchar* dptr = dst.ptr<uchar>(y);
-                for (x = 0; x < size.width; x++)
+                x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                const int vlanes = VTraits<v_int32>::vlanes();
+                // the mask is the (ushort) truncation of the scalar loop below
+                const v_int32 vmask = vx_setall_s32(0xffff);
+                for (; x <= size.width - vlanes; x += vlanes)
+                {
+                    v_int32 diff = v_sub(v_reinterpret_as_s32(vx_load_expand_q(bottom + x)),
+                                         v_reinterpret_as_s32(vx_load_expand_q(top + x)));
+                    v_store(vsum + x, v_and(v_add(vx_load(vsum + x), diff), vmask));
+                }
+#endif
+                for (; x < size.width; x++)
                     vsum[x] = (ushort)(vsum[x] + bottom[x] - top[x]);
 
                 for (x = 0; x <= wsz2; x++)
@@ -165,9 +177,6 @@ namespace cv
                 tab[x] = (uchar)(x - OFS < -ftzero ? 0 : x - OFS > ftzero ? ftzero * 2 : x - OFS + ftzero);
             uchar val0 = tab[0 + OFS];
 
-#if CV_SSE2
-            volatile bool useSIMD = checkHardwareSupport(CV_CPU_SSE2);
-#endif
 
             for (y = 0; y < size.height - 1; y += 2)
             {
@@ -181,36 +190,32 @@ namespace cv
                 dptr0[0] = dptr0[size.width - 1] = dptr1[0] = dptr1[size.width - 1] = val0;
                 x = 1;
 
-#if CV_SSE2
-                if (useSIMD)
+#if (CV_SIMD || CV_SIMD_SCALABLE)
                 {
-                    __m128i z = _mm_setzero_si128(), ftz = _mm_set1_epi16((short)ftzero),
-                        ftz2 = _mm_set1_epi8(cv::saturate_cast<uchar>(ftzero * 2));
-                    for (; x <= size.width - 9; x += 8)
+                    const int vlanes = VTraits<v_int16>::vlanes();
+                    v_int16 ftz = vx_setall_s16((short)ftzero), ftz2 = vx_setall_s16((short)std::min(ftzero * 2, 255));
+                    for (; x <= size.width - 1 - vlanes; x += vlanes)
                     {
-                        __m128i c0 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(srow0 + x - 1)), z);
-                        __m128i c1 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(srow1 + x - 1)), z);
-                        __m128i d0 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(srow0 + x + 1)), z);
-                        __m128i d1 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(srow1 + x + 1)), z);
-
-                        d0 = _mm_sub_epi16(d0, c0);
-                        d1 = _mm_sub_epi16(d1, c1);
-
-                        __m128i c2 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(srow2 + x - 1)), z);
-                        __m128i c3 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(srow3 + x - 1)), z);
-                        __m128i d2 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(srow2 + x + 1)), z);
-                        __m128i d3 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(srow3 + x + 1)), z);
-
-                        d2 = _mm_sub_epi16(d2, c2);
-                        d3 = _mm_sub_epi16(d3, c3);
-
-                        __m128i v0 = _mm_add_epi16(d0, _mm_add_epi16(d2, _mm_add_epi16(d1, d1)));
-                        __m128i v1 = _mm_add_epi16(d1, _mm_add_epi16(d3, _mm_add_epi16(d2, d2)));
-                        v0 = _mm_packus_epi16(_mm_add_epi16(v0, ftz), _mm_add_epi16(v1, ftz));
-                        v0 = _mm_min_epu8(v0, ftz2);
-
-                        _mm_storel_epi64((__m128i*)(dptr0 + x), v0);
-                        _mm_storel_epi64((__m128i*)(dptr1 + x), _mm_unpackhi_epi64(v0, v0));
+                        v_int16 c0 = v_reinterpret_as_s16(vx_load_expand(srow0 + x - 1));
+                        v_int16 c1 = v_reinterpret_as_s16(vx_load_expand(srow1 + x - 1));
+                        v_int16 d0 = v_reinterpret_as_s16(vx_load_expand(srow0 + x + 1));
+                        v_int16 d1 = v_reinterpret_as_s16(vx_load_expand(srow1 + x + 1));
+
+                        d0 = v_sub(d0, c0);
+                        d1 = v_sub(d1, c1);
+
+                        v_int16 c2 = v_reinterpret_as_s16(vx_load_expand(srow2 + x - 1));
+                        v_int16 c3 = v_reinterpret_as_s16(vx_load_expand(srow3 + x - 1));
+                        v_int16 d2 = v_reinterpret_as_s16(vx_load_expand(srow2 + x + 1));
+                        v_int16 d3 = v_reinterpret_as_s16(vx_load_expand(srow3 + x + 1));
+
+                        d2 = v_sub(d2, c2);
+                        d3 = v_sub(d3, c3);
+
+                        v_int16 v0 = v_add(d0, v_add(d2, v_add(d1, d1)));
+                        v_int16 v1 = v_add(d1, v_add(d3, v_add(d2, d2)));
+                        v_pack_u_store(dptr0 + x, v_min(v_add(v0, ftz), ftz2));
+                        v_pack_u_store(dptr1 + x, v_min(v_add(v1, ftz), ftz2));
                     }
                 }
 #endif
@@ -626,6 +626,359 @@ namespace cv
                 }
             }
         }
+        /*
+        one step of the dynamic programming along a path:
+        L_r(p, d) = C(p, d) + min(L_r(p-r, d), L_r(p-r, d-1) + P1, L_r(p-r, d+1) + P1, min_k L_r(p-r, k) + P2) - min_k L_r(p-r, k)
+        Lprev and Lcur have one padding element on both sides that must contain MAX_COST.
+        The resulting L_r(p, .) is added to the summary cost Sp, the function returns min_k L_r(p, k).
+        */
+        static inline CostType aggregatePathStep( const CostType* Cp, const CostType* Lprev, int prevMin,
+            CostType* Lcur, CostType* Sp, int D, int P1, int P2 )
+        {
+            const int delta = prevMin + P2;
+            int minL = SHRT_MAX;
+            int d = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+            const int vlanes = VTraits<v_int16>::vlanes();
+            const v_int16 _P1 = vx_setall_s16((short)P1);
+            const v_int16 _delta = vx_setall_s16((short)std::min(delta, (int)SHRT_MAX));
+            const v_int16 _prevMin = vx_setall_s16((short)prevMin);
+            v_int16 _minL = vx_setall_s16(SHRT_MAX);
+            for( ; d <= D - vlanes; d += vlanes )
+            {
+                v_int16 L = v_min(vx_load(Lprev + d), v_add(vx_load(Lprev + d - 1), _P1));
+                L = v_min(L, v_add(vx_load(Lprev + d + 1), _P1));
+                L = v_add(v_sub(v_min(L, _delta), _prevMin), vx_load(Cp + d));
+                v_store(Lcur + d, L);
+                _minL = v_min(_minL, L);
+                v_store(Sp + d, v_add(vx_load(Sp + d), L));
+            }
+            minL = v_reduce_min(_minL);
+#endif
+            for( ; d < D; d++ )
+            {
+                const int L = Cp[d] + std::min((int)Lprev[d], std::min(Lprev[d-1] + P1, std::min(Lprev[d+1] + P1, delta))) - prevMin;
+                Lcur[d] = saturate_cast<CostType>(L);
+                minL = std::min(minL, (int)Lcur[d]);
+                Sp[d] = saturate_cast<CostType>(Sp[d] + Lcur[d]);
+            }
+            return (CostType)minL;
+        }
+
+        //computes the block cost C(y, x, d) as the sum of the hamming costs over the kernelSize x kernelSize window
+        class BinarySGBMBlockCostInvoker : public ParallelLoopBody
+        {
+        public:
+            BinarySGBMBlockCostInvoker( const Mat& _hamDist, CostType* _C, int _width1, int _height, int _D, int _SW2, int _SH2 ) :
+                ham((const short*)_hamDist.data), hamPixStep(_D + 1), hamRowWidth(_hamDist.cols / (_D + 1)),
+                C(_C), width1(_width1), height(_height), D(_D), SW2(_SW2), SH2(_SH2) {}
+
+            void operator()( const Range& range ) const CV_OVERRIDE
+            {
+                AutoBuffer<CostType> vsumBuf(width1*D);
+                CostType* vsum = vsumBuf.data();
+                for( int y = range.start; y < range.end; y++ )
+                {
+                    // vertical sums of the hamming costs with the replicated border
+                    memset(vsum, 0, width1*D*sizeof(CostType));
+                    for( int k = -SH2; k <= SH2; k++ )
+                    {
+                        const int yy = std::min(std::max(y + k, 0), height - 1);
+                        for( int x = 0; x < width1; x++ )
+                        {
+                            const short* h = ham + ((size_t)yy*hamRowWidth + x)*hamPixStep;
+                            CostType* v = vsum + x*D;
+                            int d = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                            const int vlanes = VTraits<v_int16>::vlanes();
+                            for( ; d <= D - vlanes; d += vlanes )
+                                v_store(v + d, v_add(vx_load(v + d), vx_load(h + d)));
+#endif
+                            for( ; d < D; d++ )
+                                v[d] = saturate_cast<CostType>(v[d] + h[d]);
+                        }
+                    }
+
+                    // horizontal sliding sums
+                    CostType* Cy = C + (size_t)y*width1*D;
+                    for( int d = 0; d < D; d++ )
+                    {
+                        int sum = vsum[d]*(SW2 + 1);
+                        for( int j = 1; j <= SW2; j++ )
+                            sum += vsum[std::min(j, width1 - 1)*D + d];
+                        Cy[d] = saturate_cast<CostType>(sum);
+                    }
+                    for( int x = 1; x < width1; x++ )
+                    {
+                        const CostType* pixAdd = vsum + std::min(x + SW2, width1 - 1)*D;
+                        const CostType* pixSub = vsum + std::max(x - SW2 - 1, 0)*D;
+                        const CostType* Cprev = Cy + (x - 1)*D;
+                        CostType* Cx = Cy + x*D;
+                        int d = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                        const int vlanes = VTraits<v_int16>::vlanes();
+                        for( ; d <= D - vlanes; d += vlanes )
+                            v_store(Cx + d, v_add(v_sub(vx_load(Cprev + d), vx_load(pixSub + d)), vx_load(pixAdd + d)));
+#endif
+                        for( ; d < D; d++ )
+                            Cx[d] = saturate_cast<CostType>(Cprev[d] - pixSub[d] + pixAdd[d]);
+                    }
+                }
+            }
+
+        private:
+            const short* ham;
+            int hamPixStep, hamRowWidth;
+            CostType* C;
+            int width1, height, D, SW2, SH2;
+        };
+
+        //aggregates the costs along the left-right and right-left paths, every row is independent
+        class BinarySGBMHorizontalPathsInvoker : public ParallelLoopBody
+        {
+        public:
+            BinarySGBMHorizontalPathsInvoker( const CostType* _C, CostType* _S, int _width1, int _D, int _P1, int _P2 ) :
+                C(_C), S(_S), width1(_width1), D(_D), P1(_P1), P2(_P2) {}
+
+            void operator()( const Range& range ) const CV_OVERRIDE
+            {
+                const int D2 = D + 2;
+                AutoBuffer<CostType> LrBuf(D2*2);
+                for( int y = range.start; y < range.end; y++ )
+                {
+                    const CostType* Cy = C + (size_t)y*width1*D;
+                    CostType* Sy = S + (size_t)y*width1*D;
+                    for( int dir = 0; dir < 2; dir++ )
+                    {
+                        CostType* Lprev = LrBuf.data() + 1;
+                        CostType* Lcur = Lprev + D2;
+                        for( int d = -1; d <= D; d++ )
+                            Lprev[d] = 0;
+                        Lprev[-1] = Lprev[D] = Lcur[-1] = Lcur[D] = SHRT_MAX;
+                        int minL = 0;
+                        for( int i = 0; i < width1; i++ )
+                        {
+                            const int x = dir == 0 ? i : width1 - 1 - i;
+                            minL = aggregatePathStep(Cy + x*D, Lprev, minL, Lcur, Sy + x*D, D, P1, P2);
+                            std::swap(Lprev, Lcur);
+                        }
+                    }
+                }
+            }
+
+        private:
+            const CostType* C;
+            CostType* S;
+            int width1, D, P1, P2;
+        };
+
+        //aggregates the costs along the top-bottom and bottom-top paths, the range is given in the columns
+        class BinarySGBMVerticalPathsInvoker : public ParallelLoopBody
+        {
+        public:
+            BinarySGBMVerticalPathsInvoker( const CostType* _C, CostType* _S, int _width1, int _height, int _D, int _P1, int _P2 ) :
+                C(_C), S(_S), width1(_width1), height(_height), D(_D), P1(_P1), P2(_P2) {}
+
+            void operator()( const Range& range ) const CV_OVERRIDE
+            {
+                const int D2 = D + 2;
+                const int ncols = range.end - range.start;
+                AutoBuffer<CostType> LrBuf(ncols*D2*2);
+                AutoBuffer<int> minLr(ncols);
+                for( int dir = 0; dir < 2; dir++ )
+                {
+                    CostType* Lprev = LrBuf.data() + 1;
+                    CostType* Lcur = Lprev + ncols*D2;
+                    for( int k = 0; k < ncols*D2*2; k++ )
+                        LrBuf[k] = 0;
+                    for( int c = 0; c < ncols; c++ )
+                    {
+                        Lprev[c*D2 - 1] = Lprev[c*D2 + D] = Lcur[c*D2 - 1] = Lcur[c*D2 + D] = SHRT_MAX;
+                        minLr[c] = 0;
+                    }
+                    for( int i = 0; i < height; i++ )
+                    {
+                        const int y = dir == 0 ? i : height - 1 - i;
+                        const CostType* Cy = C + (size_t)y*width1*D;
+                        CostType* Sy = S + (size_t)y*width1*D;
+                        for( int c = 0; c < ncols; c++ )
+                        {
+                            const int x = range.start + c;
+                            minLr[c] = aggregatePathStep(Cy + x*D, Lprev + c*D2, minLr[c], Lcur + c*D2, Sy + x*D, D, P1, P2);
+                        }
+                        std::swap(Lprev, Lcur);
+                    }
+                }
+            }
+
+        private:
+            const CostType* C;
+            CostType* S;
+            int width1, height, D, P1, P2;
+        };
+
+        //selects the disparity with the minimal summary cost, then applies the uniqueness and the left-right checks
+        class BinarySGBMDisparityInvoker : public ParallelLoopBody
+        {
+        public:
+            BinarySGBMDisparityInvoker( const CostType* _S, Mat& _disp1, const StereoBinarySGBMParams& _params,
+                int _minX1, int _width1, int _D, int _uniquenessRatio, int _disp12MaxDiff ) :
+                S(_S), disp1(&_disp1), params(&_params), minX1(_minX1), width1(_width1), D(_D),
+                uniquenessRatio(_uniquenessRatio), disp12MaxDiff(_disp12MaxDiff) {}
+
+            void operator()( const Range& range ) const CV_OVERRIDE
+            {
+                const int DISP_SHIFT = StereoMatcher::DISP_SHIFT;
+                const int DISP_SCALE = (1 << DISP_SHIFT);
+                const CostType MAX_COST = SHRT_MAX;
+                const int minD = params->minDisparity;
+                const int width = disp1->cols;
+                const int INVALID_DISP_SCALED = (minD - 1)*DISP_SCALE;
+                AutoBuffer<CostType> disp2costBuf(width);
+                AutoBuffer<DispType> disp2Buf(width);
+                CostType* disp2cost = disp2costBuf.data();
+                DispType* disp2ptr = disp2Buf.data();
+
+                for( int y = range.start; y < range.end; y++ )
+                {
+                    DispType* disp1ptr = disp1->ptr<DispType>(y);
+                    int x, d;
+                    for( x = 0; x < width; x++ )
+                    {
+                        disp1ptr[x] = disp2ptr[x] = (DispType)INVALID_DISP_SCALED;
+                        disp2cost[x] = MAX_COST;
+                    }
+
+                    for( x = width1 - 1; x >= 0; x-- )
+                    {
+                        const CostType* Sp = S + ((size_t)y*width1 + x)*D;
+                        int minS = MAX_COST;
+                        int bestDisp = -1;
+                        for( d = 0; d < D; d++ )
+                        {
+                            if( Sp[d] < minS )
+                            {
+                                minS = Sp[d];
+                                bestDisp = d;
+                            }
+                        }
+                        for( d = 0; d < D; d++ )
+                        {
+                            if( Sp[d]*(100 - uniquenessRatio) < minS*100 && std::abs(bestDisp - d) > 1 )
+                                break;
+                        }
+                        if( d < D || bestDisp < 0 )
+                            continue;
+                        d = bestDisp;
+                        const int _x2 = x + minX1 - d - minD;
+                        if( 0 <= _x2 && _x2 < width && disp2cost[_x2] > minS )
+                        {
+                            disp2cost[_x2] = (CostType)minS;
+                            disp2ptr[_x2] = (DispType)(d + minD);
+                        }
+                        if( 0 < d && d < D-1 )
+                        {
+                            if( params->subpixelInterpolationMethod == CV_SIMETRICV_INTERPOLATION )
+                            {
+                                const double m2 = Sp[d - 1];
+                                const double m3 = Sp[d + 1];
+                                const double m1 = Sp[d];
+                                const double m2m1 = m2 - m1;
+                                const double m3m1 = m3 - m1;
+                                if( !(m2m1 == 0 || m3m1 == 0) )
+                                {
+                                    double p = 0;
+                                    if( m2 > m3 )
+                                        p = (0.5 - 0.25 * ((m3m1 * m3m1) / (m2m1 * m2m1) + (m3m1 / m2m1)));
+                                    else
+                                        p = -1 * (0.5 - 0.25 * ((m2m1 * m2m1) / (m3m1 * m3m1) + (m2m1 / m3m1)));
+                                    if( p >= -0.5 && p <= 0.5 )
+                                        d = (int)(d * DISP_SCALE + p * DISP_SCALE);
+                                    else
+                                        d *= DISP_SCALE;
+                                }
+                                else
+                                {
+                                    d *= DISP_SCALE;
+                                }
+                            }
+                            else
+                            {
+                                const int denom2 = std::max(Sp[d-1] + Sp[d+1] - 2*Sp[d], 1);
+                                d = d*DISP_SCALE + ((Sp[d-1] - Sp[d+1])*DISP_SCALE + denom2)/(denom2*2);
+                            }
+                        }
+                        else
+                            d *= DISP_SCALE;
+                        disp1ptr[x + minX1] = (DispType)(d + minD*DISP_SCALE);
+                    }
+                    for( x = minX1; x < minX1 + width1; x++ )
+                    {
+                        const int d1 = disp1ptr[x];
+                        if( d1 == INVALID_DISP_SCALED )
+                            continue;
+                        const int _d = d1 >> DISP_SHIFT;
+                        const int d_ = (d1 + DISP_SCALE-1) >> DISP_SHIFT;
+                        const int _x = x - _d;
+                        const int x_ = x - d_;
+                        if( 0 <= _x && _x < width && disp2ptr[_x] >= minD && std::abs(disp2ptr[_x] - _d) > disp12MaxDiff &&
+                            0 <= x_ && x_ < width && disp2ptr[x_] >= minD && std::abs(disp2ptr[x_] - d_) > disp12MaxDiff )
+                            disp1ptr[x] = (DispType)INVALID_DISP_SCALED;
+                    }
+                }
+            }
+
+        private:
+            const CostType* S;
+            Mat* disp1;
+            const StereoBinarySGBMParams* params;
+            int minX1, width1, D, uniquenessRatio, disp12MaxDiff;
+        };
+
+        /*
+        path-parallel variant of computeDisparityBinarySGBM (MODE_HH4).
+        The costs are aggregated along 4 paths (left-right, right-left, top-bottom, bottom-top).
+        All the paths of one direction are independent, so they are processed in parallel.
+        Like MODE_HH it keeps the whole cost volume in memory.
+        */
+        static void computeDisparityBinarySGBMParallel( Mat& disp1, const StereoBinarySGBMParams& params,
+            Mat& buffer, const Mat& hamDist )
+        {
+            const int minD = params.minDisparity;
+            const int maxD = minD + params.numDisparities;
+            const int kernelSize = params.kernelSize > 0 ? params.kernelSize : 5;
+            const int uniquenessRatio = params.uniquenessRatio >= 0 ? params.uniquenessRatio : 10;
+            const int disp12MaxDiff = params.disp12MaxDiff > 0 ? params.disp12MaxDiff : 1;
+            const int P1 = params.P1 > 0 ? params.P1 : 2;
+            const int P2 = std::max(params.P2 > 0 ? params.P2 : 5, P1+1);
+            const int width = disp1.cols, height = disp1.rows;
+            const int minX1 = std::max(-maxD, 0);
+            const int maxX1 = width + std::min(minD, 0);
+            const int D = maxD - minD;
+            const int width1 = maxX1 - minX1;
+
+            if( minX1 >= maxX1 )
+            {
+                disp1 = Scalar::all((minD - 1)*StereoMatcher::DISP_SCALE);
+                return;
+            }
+            CV_Assert( D % 16 == 0 );
+
+            const size_t costVolumeSize = (size_t)width1*height*D;
+            const size_t totalBufSize = costVolumeSize*2*sizeof(CostType) + 64;
+            if( buffer.empty() || !buffer.isContinuous() ||
+                buffer.cols*buffer.rows*buffer.elemSize() < totalBufSize )
+                buffer.create(1, (int)totalBufSize, CV_8U);
+            CostType* C = (CostType*)alignPtr(buffer.ptr(), 16);
+            CostType* S = C + costVolumeSize;
+            memset(S, 0, costVolumeSize*sizeof(CostType));
+
+            parallel_for_(Range(0, height), BinarySGBMBlockCostInvoker(hamDist, C, width1, height, D, kernelSize/2, kernelSize/2));
+            parallel_for_(Range(0, height), BinarySGBMHorizontalPathsInvoker(C, S, width1, D, P1, P2));
+            parallel_for_(Range(0, width1), BinarySGBMVerticalPathsInvoker(C, S, width1, height, D, P1, P2), std::max(1, width1/16));
+            parallel_for_(Range(0, height), BinarySGBMDisparityInvoker(S, disp1, params, minX1, width1, D, uniquenessRatio, disp12MaxDiff));
+        }
+
         class StereoBinarySGBMImpl CV_FINAL : public StereoBinarySGBM, public Matching
         {
         public:
@@ -689,7 +1042,10 @@ namespace cv
 
                 hammingDistanceBlockMatching(censusImageLeft, censusImageRight, hamDist, params.kernelSize);
 
-                computeDisparityBinarySGBM( left, disp, params, buffer,hamDist);
+                if( params.mode == MODE_HH4 )
+                    computeDisparityBinarySGBMParallel( disp, params, buffer, hamDist );
+                else
+                    computeDisparityBinarySGBM( left, disp, params, buffer,hamDist);
 
                 if(params.regionRemoval == CV_SPECKLE_REMOVAL_AVG_ALGORITHM)
                 {
@@ -232,5 +232,35 @@ void CV_SGBlockMatchingTest::run(int )
 TEST(block_matching_simple_test, accuracy) { CV_BlockMatchingTest test; test.safe_run(); }
 TEST(SG_block_matching_simple_test, accuracy) { CV_SGBlockMatchingTest test; test.safe_run(); }
 
+TEST(SG_block_matching_simple_test, accuracy_HH4)
+{
+    const std::string path = cvtest::TS::ptr()->get_data_path() + "stereomatching/datasets/tsukuba/";
+    Mat image1 = imread(path + "im2.png", IMREAD_GRAYSCALE);
+    Mat image2 = imread(path + "im6.png", IMREAD_GRAYSCALE);
+    Mat gt = imread(path + "disp2.png", IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image1.empty() || image2.empty() || gt.empty());
+
+    Mat disparity(image1.rows, image1.cols, CV_16S);
+    Ptr<StereoBinarySGBM> sgbm = StereoBinarySGBM::create(0, 16, 9);
+    sgbm->setP1(10);
+    sgbm->setP2(100);
+    sgbm->setUniquenessRatio(1);
+    sgbm->setSpeckleWindowSize(400);
+    sgbm->setSpeckleRange(200);
+    sgbm->setDisp12MaxDiff(1);
+    sgbm->setBinaryKernelType(CV_MODIFIED_CENSUS_TRANSFORM);
+    sgbm->setSpekleRemovalTechnique(CV_SPECKLE_REMOVAL_AVG_ALGORITHM);
+    sgbm->setSubPixelInterpolationMethod(CV_SIMETRICV_INTERPOLATION);
+    sgbm->setMode(StereoBinarySGBM::MODE_HH4);
+    sgbm->compute(image1, image2, disparity);
+
+    double minVal, maxVal;
+    minMaxLoc(disparity, &minVal, &maxVal);
+    ASSERT_GT(maxVal, minVal);
+    Mat test;
+    disparity.convertTo(test, CV_8UC1, 255 / (maxVal - minVal));
+    EXPECT_LE(errorLevel(gt, test), 10);
+}
+
 
 }} // namespace
\ No newline at end of file
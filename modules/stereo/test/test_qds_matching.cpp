@@ -29,6 +29,18 @@ static float disparity_MAE(const Mat &reference, const Mat &estimation)
     return error/elems;
 }
 
+static int countSharedRightPixels(const std::vector<stereo::MatchQuasiDense> &matches, const Size &size)
+{
+    Mat used = Mat::zeros(size, CV_8U);
+    int shared = 0;
+    for (size_t i = 0; i < matches.size(); i++)
+    {
+        uchar &u = used.at<uchar>(matches[i].p1);
+        shared += u;
+        u = 1;
+    }
+    return shared;
+}
 
 // void CV_QdsMatchingTest::run(int)
 TEST(qds_getDisparity, accuracy)
@@ -60,6 +72,34 @@ TEST(qds_getDisparity, accuracy)
     ASSERT_LT(disparity_MAE(gt, outDisp),2) << "EPE should be 1.1053 for this sample/hyperparamters (Tested on version 4.5.1)";
 }
 
+TEST(qds_getDisparity, tiled_propagation)
+{
+    Mat image1, image2, gt;
+    image1 = imread(cvtest::TS::ptr()->get_data_path() + "stereomatching/datasets/cones/im2.png", IMREAD_GRAYSCALE);
+    image2 = imread(cvtest::TS::ptr()->get_data_path() + "stereomatching/datasets/cones/im6.png", IMREAD_GRAYSCALE);
+    gt = imread(cvtest::TS::ptr()->get_data_path() + "stereomatching/datasets/cones/disp2.png", IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image1.empty() || image2.empty() || gt.empty()) << "Issue with input data";
+    gt.convertTo(gt, CV_32F);
+    gt = gt/4;
+
+    Ptr<stereo::QuasiDenseStereo> reference = stereo::QuasiDenseStereo::create(image1.size());
+    reference->process(image1, image2);
+    std::vector<stereo::MatchQuasiDense> referenceMatches;
+    reference->getDenseMatches(referenceMatches);
+
+    Ptr<stereo::QuasiDenseStereo> tiled = stereo::QuasiDenseStereo::create(image1.size());
+    tiled->Param.tileSize = 64;
+    tiled->process(image1, image2);
+    std::vector<stereo::MatchQuasiDense> tiledMatches;
+    tiled->getDenseMatches(tiledMatches);
+
+    // propagation never reuses a right image pixel, only the sparse seeds may share one.
+    EXPECT_LE(countSharedRightPixels(tiledMatches, image2.size()),
+              countSharedRightPixels(referenceMatches, image2.size()));
+    EXPECT_GT(tiledMatches.size(), referenceMatches.size() * 8 / 10);
+    EXPECT_LT(disparity_MAE(gt, tiled->getDisparity()), 2);
+}
+
 
 
 }} // namespace
\ No newline at end of file
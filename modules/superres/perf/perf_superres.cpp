@@ -170,6 +170,41 @@ PERF_TEST_P(Size_MatType, SuperResolution_BTVL1,
     }
 }
 
+// 720p output from a full temporal window, the CPU engine workload
+PERF_TEST_P(Size_MatType, SuperResolution_BTVL1_TemporalWindow,
+            Combine(Values(Size(320, 180)),
+                    Values(MatType(CV_8UC1), MatType(CV_8UC3))))
+{
+    declare.time(5 * 60);
+
+    const Size size = get<0>(GetParam());
+    const int type = get<1>(GetParam());
+
+    Mat frame(size, type);
+    declare.in(frame, WARMUP_RNG);
+
+    const int scale = 4;
+    const int iterations = 10;
+    const int temporalAreaRadius = 4;
+    Ptr<DenseOpticalFlowExt> opticalFlow(new ZeroOpticalFlow);
+
+    Ptr<SuperResolution> superRes = createSuperResolution_BTVL1();
+
+    superRes->setScale(scale);
+    superRes->setIterations(iterations);
+    superRes->setTemporalAreaRadius(temporalAreaRadius);
+    superRes->setOpticalFlow(opticalFlow);
+
+    superRes->setInput(makePtr<OneFrameSource_CPU>(frame));
+
+    Mat dst;
+    superRes->nextFrame(dst);
+
+    TEST_CYCLE_N(5) superRes->nextFrame(dst);
+
+    SANITY_CHECK_NOTHING();
+}
+
 #ifdef HAVE_OPENCL
 
 namespace ocl {
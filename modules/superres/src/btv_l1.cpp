@@ -45,6 +45,7 @@
 
 #include "precomp.hpp"
 #include "opencl_kernels_superres.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 using namespace cv;
 using namespace cv::superres;
@@ -189,7 +190,7 @@ namespace
         return k.run(2, globalsize, NULL, false);
     }
 
-#endif
+    // reference CPU operators, the OpenCL path falls back to them
 
     void buildMotionMaps(InputArray _forwardMotion, InputArray _backwardMotion,
                          OutputArray _forwardMap, OutputArray _backwardMap)
@@ -240,8 +241,6 @@ namespace
         }
     }
 
-#ifdef HAVE_OPENCL
-
     static bool ocl_upscale(InputArray _src, OutputArray _dst, int scale)
     {
         int type = _src.type(), cn = CV_MAT_CN(type);
@@ -262,8 +261,6 @@ namespace
         return k.run(2, globalsize, NULL, false);
     }
 
-#endif
-
     typedef struct _Point4f { float ar[4]; } Point4f;
 
     void upscale(InputArray _src, OutputArray _dst, int scale)
@@ -285,11 +282,31 @@ namespace
         func(_src, _dst, scale);
     }
 
+#endif
+
     inline float diffSign(float a, float b)
     {
         return a > b ? 1.0f : a < b ? -1.0f : 0.0f;
     }
 
+    void calcBtvWeights(int btvKernelSize, double alpha, std::vector<float>& btvWeights)
+    {
+        const size_t size = btvKernelSize * btvKernelSize;
+
+        btvWeights.resize(size);
+
+        const int ksize = (btvKernelSize - 1) / 2;
+        const float alpha_f = static_cast<float>(alpha);
+
+        for (int m = 0, ind = 0; m <= ksize; ++m)
+        {
+            for (int l = ksize; l + m >= 0; --l, ++ind)
+                btvWeights[ind] = static_cast<float>(pow(alpha_f, std::abs(m) + std::abs(l)));
+        }
+    }
+
+#ifdef HAVE_OPENCL
+
     Point3f diffSign(Point3f a, Point3f b)
     {
         return Point3f(
@@ -299,8 +316,6 @@ namespace
         );
     }
 
-#ifdef HAVE_OPENCL
-
     static bool ocl_diffSign(InputArray _src1, OutputArray _src2, OutputArray _dst)
     {
         ocl::Kernel k("diffSign", ocl::superres::superres_btvl1_oclsrc);
@@ -320,8 +335,6 @@ namespace
         return k.run(2, globalsize, NULL, false);
     }
 
-#endif
-
     void diffSign(InputArray _src1, OutputArray _src2, OutputArray _dst)
     {
         CV_OCL_RUN(_dst.isUMat(),
@@ -344,22 +357,6 @@ namespace
         }
     }
 
-    void calcBtvWeights(int btvKernelSize, double alpha, std::vector<float>& btvWeights)
-    {
-        const size_t size = btvKernelSize * btvKernelSize;
-
-        btvWeights.resize(size);
-
-        const int ksize = (btvKernelSize - 1) / 2;
-        const float alpha_f = static_cast<float>(alpha);
-
-        for (int m = 0, ind = 0; m <= ksize; ++m)
-        {
-            for (int l = ksize; l + m >= 0; --l, ++ind)
-                btvWeights[ind] = static_cast<float>(pow(alpha_f, std::abs(m) + std::abs(l)));
-        }
-    }
-
     template <typename T>
     struct BtvRegularizationBody : ParallelLoopBody
     {
@@ -416,8 +413,6 @@ namespace
         parallel_for_(Range(ksize, src.rows - ksize), body);
     }
 
-#ifdef HAVE_OPENCL
-
     static bool ocl_calcBtvRegularization(InputArray _src, OutputArray _dst, int btvKernelSize, const UMat & ubtvWeights)
     {
         int cn = _src.channels();
@@ -440,8 +435,6 @@ namespace
         return k.run(2, globalsize, NULL, false);
     }
 
-#endif
-
     void calcBtvRegularization(InputArray _src, OutputArray _dst, int btvKernelSize,
                                const std::vector<float>& btvWeights, const UMat & ubtvWeights)
     {
@@ -462,6 +455,207 @@ namespace
         }
     }
 
+#endif
+
+    ////////////////////////////////////////////////////////////////////
+    // Fused CPU kernels of the BTV-L1 iteration. They produce the same operators as the
+    // remap / GaussianBlur / resize / upscale chain (nearest warps, REFLECT_101 blur borders)
+    // without the full resolution intermediate images.
+
+    // Rounds a dense warp map (base + motion) to the linear index of the nearest source pixel,
+    // -1 where it falls outside the image (remap with INTER_NEAREST and zero border).
+    void buildWarpIndices(const Mat& motion, Mat& indices)
+    {
+        const Size size = motion.size();
+        indices.create(size, CV_32SC1);
+
+        parallel_for_(Range(0, size.height), [&](const Range& range)
+        {
+            for (int y = range.start; y < range.end; ++y)
+            {
+                const Point2f* motionRow = motion.ptr<Point2f>(y);
+                int* indicesRow = indices.ptr<int>(y);
+
+                for (int x = 0; x < size.width; ++x)
+                {
+                    const int sx = cvRound(x + motionRow[x].x);
+                    const int sy = cvRound(y + motionRow[x].y);
+                    indicesRow[x] = (unsigned)sx < (unsigned)size.width && (unsigned)sy < (unsigned)size.height
+                                    ? sy * size.width + sx : -1;
+                }
+            }
+        });
+    }
+
+    // Blur of the zero-interleaved upscaled image (Ht * Dt) along one axis: for every high res
+    // coordinate the low res samples falling under the kernel and their weights.
+    struct UpscaleBlurTaps
+    {
+        std::vector<int> ofs;
+        std::vector<int> idx;
+        std::vector<float> weights;
+
+        void create(int highResLen, int scale, const std::vector<float>& kernel)
+        {
+            const int ksize = static_cast<int>(kernel.size()), anchor = ksize / 2;
+
+            ofs.resize(highResLen + 1);
+            idx.clear();
+            weights.clear();
+
+            for (int X = 0; X < highResLen; ++X)
+            {
+                ofs[X] = static_cast<int>(idx.size());
+                for (int i = 0; i < ksize; ++i)
+                {
+                    const int Xi = borderInterpolate(X + i - anchor, highResLen, BORDER_REFLECT_101);
+                    if (Xi % scale == 0)
+                    {
+                        idx.push_back(Xi / scale);
+                        weights.push_back(kernel[i]);
+                    }
+                }
+            }
+            ofs[highResLen] = static_cast<int>(idx.size());
+        }
+    };
+
+    // Blur taps sampled by the downscale (D * H) along one axis: ksize high res coordinates per low res one.
+    void calcDownscaleBlurTaps(int lowResLen, int scale, int ksize, std::vector<int>& taps)
+    {
+        const int anchor = ksize / 2;
+        taps.resize(static_cast<size_t>(lowResLen) * ksize);
+        for (int x = 0; x < lowResLen; ++x)
+            for (int i = 0; i < ksize; ++i)
+                taps[x * ksize + i] = borderInterpolate(x * scale + i - anchor, lowResLen * scale, BORDER_REFLECT_101);
+    }
+
+    struct BtvL1Taps
+    {
+        std::vector<float> kernel;
+        std::vector<int> downRows, downCols;
+        UpscaleBlurTaps upRows, upCols;
+    };
+
+    // dst = sign(src - D * H * M * highRes) for the low res rows of one frame
+    void calcDiffSignRows(const Mat& highRes, const Mat& warpIndices, const Mat& src, Mat& dst,
+                          const BtvL1Taps& taps, int y0, int y1)
+    {
+        const int cn = src.channels();
+        const int ksize = static_cast<int>(taps.kernel.size());
+        const float* kernel = &taps.kernel[0];
+        const float* highResData = highRes.ptr<float>();
+
+        float acc[4];
+
+        for (int y = y0; y < y1; ++y)
+        {
+            const int* rows = &taps.downRows[y * ksize];
+            const float* srcRow = src.ptr<float>(y);
+            float* dstRow = dst.ptr<float>(y);
+
+            for (int x = 0; x < src.cols; ++x)
+            {
+                const int* cols = &taps.downCols[x * ksize];
+                for (int c = 0; c < cn; ++c)
+                    acc[c] = 0.f;
+
+                for (int i = 0; i < ksize; ++i)
+                {
+                    const int* indicesRow = warpIndices.ptr<int>(rows[i]);
+                    for (int j = 0; j < ksize; ++j)
+                    {
+                        const int idx = indicesRow[cols[j]];
+                        if (idx < 0)
+                            continue;
+                        const float w = kernel[i] * kernel[j];
+                        const float* p = highResData + static_cast<size_t>(idx) * cn;
+                        for (int c = 0; c < cn; ++c)
+                            acc[c] += w * p[c];
+                    }
+                }
+
+                for (int c = 0; c < cn; ++c)
+                    dstRow[x * cn + c] = diffSign(srcRow[x * cn + c], acc[c]);
+            }
+        }
+    }
+
+    // diffRow += Mt * Ht * Dt * signs for one high res row of one frame
+    void accumulateBackProjectionRow(const Mat& signs, const Mat& adjointIndices, const BtvL1Taps& taps,
+                                     int Y, float* diffRow)
+    {
+        const int cn = signs.channels();
+        const int width = adjointIndices.cols;
+        const int* indicesRow = adjointIndices.ptr<int>(Y);
+
+        for (int X = 0; X < width; ++X)
+        {
+            const int idx = indicesRow[X];
+            if (idx < 0)
+                continue;
+            const int QY = idx / width, QX = idx - QY * width;
+
+            for (int a = taps.upRows.ofs[QY]; a < taps.upRows.ofs[QY + 1]; ++a)
+            {
+                const float* signsRow = signs.ptr<float>(taps.upRows.idx[a]);
+                const float wy = taps.upRows.weights[a];
+
+                for (int b = taps.upCols.ofs[QX]; b < taps.upCols.ofs[QX + 1]; ++b)
+                {
+                    const float w = wy * taps.upCols.weights[b];
+                    const float* p = signsRow + taps.upCols.idx[b] * cn;
+                    for (int c = 0; c < cn; ++c)
+                        diffRow[X * cn + c] += w * p[c];
+                }
+            }
+        }
+    }
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    inline v_float32 v_diffSign(const v_float32& a, const v_float32& b)
+    {
+        const v_float32 one = vx_setall_f32(1.f);
+        return v_sub(v_and(v_gt(a, b), one), v_and(v_lt(a, b), one));
+    }
+#endif
+
+    // regRow = BTV regularization term of one high res row, channels are interleaved so the
+    // neighbours of an element are l * cn elements away
+    void calcBtvRegularizationRow(const Mat& src, int Y, int ksize, const std::vector<float>& btvWeights,
+                                  float* regRow)
+    {
+        const int cn = src.channels();
+        const int end = (src.cols - ksize) * cn;
+        const float* srcRow = src.ptr<float>(Y);
+
+        for (int m = 0, ind = 0; m <= ksize; ++m)
+        {
+            const float* srcRow2 = src.ptr<float>(Y - m);
+            const float* srcRow3 = src.ptr<float>(Y + m);
+
+            for (int l = ksize; l + m >= 0; --l, ++ind)
+            {
+                const float w = btvWeights[ind];
+                const int o = l * cn;
+                int e = ksize * cn;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                const int vl = VTraits<v_float32>::vlanes();
+                const v_float32 vw = vx_setall_f32(w);
+                for (; e <= end - vl; e += vl)
+                {
+                    const v_float32 v = vx_load(srcRow + e);
+                    const v_float32 d = v_sub(v_diffSign(v, vx_load(srcRow3 + e + o)),
+                                              v_diffSign(vx_load(srcRow2 + e - o), v));
+                    v_store(regRow + e, v_fma(vw, d, vx_load(regRow + e)));
+                }
+#endif
+                for (; e < end; ++e)
+                    regRow[e] += w * (diffSign(srcRow[e], srcRow3[e + o]) - diffSign(srcRow2[e - o], srcRow[e]));
+            }
+        }
+    }
+
     class BTVL1_Base : public cv::superres::SuperResolution
     {
     public:
@@ -527,13 +721,15 @@ namespace
         std::vector<Mat> highResForwardMotions_;
         std::vector<Mat> highResBackwardMotions_;
 
-        std::vector<Mat> forwardMaps_;
-        std::vector<Mat> backwardMaps_;
+        std::vector<Mat> warpIndices_;
+        std::vector<Mat> adjointIndices_;
+        std::vector<Mat> diffSigns_;
 
-        Mat highRes_;
+        BtvL1Taps taps_;
+        Size tapsLowResSize_;
+        int tapsScale_;
 
-        Mat diffTerm_, regTerm_;
-        Mat a_, b_, c_;
+        Mat highRes_, nextHighRes_;
 
 #ifdef HAVE_OPENCL
         // UMat
@@ -572,6 +768,7 @@ namespace
 
         curBtvKernelSize_ = -1;
         curAlpha_ = -1.0;
+        tapsScale_ = -1;
     }
 
 #ifdef HAVE_OPENCL
@@ -695,6 +892,7 @@ namespace
             curBlurKernelSize_ = blurKernelSize_;
             curBlurSigma_ = blurSigma_;
             curSrcType_ = src[0].type();
+            taps_.kernel.clear();
         }
 
         if (btvWeights_.empty() || btvKernelSize_ != curBtvKernelSize_ || alpha_ != curAlpha_)
@@ -710,55 +908,98 @@ namespace
         upscaleMotions(lowResForwardMotions_, highResForwardMotions_, scale_);
         upscaleMotions(lowResBackwardMotions_, highResBackwardMotions_, scale_);
 
-        forwardMaps_.resize(highResForwardMotions_.size());
-        backwardMaps_.resize(highResForwardMotions_.size());
-        for (size_t i = 0; i < highResForwardMotions_.size(); ++i)
-            buildMotionMaps(highResForwardMotions_[i], highResBackwardMotions_[i], forwardMaps_[i], backwardMaps_[i]);
+        // M warps by the forward motions, Mt by the backward ones
+        const int count = static_cast<int>(src.size());
+        warpIndices_.resize(count);
+        adjointIndices_.resize(count);
+        for (int k = 0; k < count; ++k)
+        {
+            buildWarpIndices(highResForwardMotions_[k], warpIndices_[k]);
+            buildWarpIndices(highResBackwardMotions_[k], adjointIndices_[k]);
+        }
 
         // initial estimation
         const Size lowResSize = src[0].size();
         const Size highResSize(lowResSize.width * scale_, lowResSize.height * scale_);
+        const int cn = src[0].channels();
+        CV_Assert( src[0].depth() == CV_32F && cn <= 4 );
 
         resize(src[baseIdx], highRes_, highResSize, 0, 0, INTER_CUBIC);
+        nextHighRes_.create(highResSize, highRes_.type());
+        CV_Assert( highRes_.isContinuous() && nextHighRes_.isContinuous() );
+
+        diffSigns_.resize(count);
+        for (int k = 0; k < count; ++k)
+            diffSigns_[k].create(lowResSize, highRes_.type());
+
+        // blur taps of the fused D * H and Ht * Dt operators
+        if (taps_.kernel.empty() || lowResSize != tapsLowResSize_ || scale_ != tapsScale_)
+        {
+            Mat kernel = getGaussianKernel(blurKernelSize_, blurSigma_, CV_32F);
+            taps_.kernel.assign(kernel.ptr<float>(), kernel.ptr<float>() + kernel.total());
+            calcDownscaleBlurTaps(lowResSize.height, scale_, blurKernelSize_, taps_.downRows);
+            calcDownscaleBlurTaps(lowResSize.width, scale_, blurKernelSize_, taps_.downCols);
+            taps_.upRows.create(highResSize.height, scale_, taps_.kernel);
+            taps_.upCols.create(highResSize.width, scale_, taps_.kernel);
+            tapsLowResSize_ = lowResSize;
+            tapsScale_ = scale_;
+        }
 
         // iterations
-        diffTerm_.create(highResSize, highRes_.type());
-        a_.create(highResSize, highRes_.type());
-        b_.create(highResSize, highRes_.type());
-        c_.create(lowResSize, highRes_.type());
+        const int btvRadius = (btvKernelSize_ - 1) / 2;
+        const float tau = static_cast<float>(tau_);
+        const float lambda = static_cast<float>(lambda_);
 
         for (int i = 0; i < iterations_; ++i)
         {
-            diffTerm_.setTo(Scalar::all(0));
-
-            for (size_t k = 0; k < src.size(); ++k)
+            // c = sign(src - DHM * Ih) for all frames of the temporal window
+            parallel_for_(Range(0, count * lowResSize.height), [&](const Range& range)
             {
-                // a = M * Ih
-                remap(highRes_, a_, backwardMaps_[k], noArray(), INTER_NEAREST);
-                // b = HM * Ih
-                GaussianBlur(a_, b_, Size(blurKernelSize_, blurKernelSize_), blurSigma_);
-                // c = DHM * Ih
-                resize(b_, c_, lowResSize, 0, 0, INTER_NEAREST);
-
-                diffSign(src[k], c_, c_);
-
-                // a = Dt * diff
-                upscale(c_, a_, scale_);
-                // b = HtDt * diff
-                GaussianBlur(a_, b_, Size(blurKernelSize_, blurKernelSize_), blurSigma_);
-                // a = MtHtDt * diff
-                remap(b_, a_, forwardMaps_[k], noArray(), INTER_NEAREST);
-
-                add(diffTerm_, a_, diffTerm_);
-            }
+                for (int r = range.start; r < range.end;)
+                {
+                    const int k = r / lowResSize.height, y0 = r % lowResSize.height;
+                    const int y1 = std::min(lowResSize.height, y0 + range.end - r);
+                    calcDiffSignRows(highRes_, warpIndices_[k], src[k], diffSigns_[k], taps_, y0, y1);
+                    r += y1 - y0;
+                }
+            });
 
-            if (lambda_ > 0)
+            // Ih += tau * (sum MtHtDt * c - lambda * BTV(Ih)), the frames are summed in order
+            parallel_for_(Range(0, highResSize.height), [&](const Range& range)
             {
-                calcBtvRegularization(highRes_, regTerm_, btvKernelSize_, btvWeights_, ubtvWeights_);
-                addWeighted(diffTerm_, 1.0, regTerm_, -lambda_, 0.0, diffTerm_);
-            }
+                const int rowLen = highResSize.width * cn;
+                AutoBuffer<float> _diffRow(rowLen), _regRow(rowLen);
+                float* diffRow = _diffRow.data();
+                float* regRow = _regRow.data();
 
-            addWeighted(highRes_, 1.0, diffTerm_, tau_, 0.0, highRes_);
+                for (int Y = range.start; Y < range.end; ++Y)
+                {
+                    std::fill(diffRow, diffRow + rowLen, 0.f);
+                    for (int k = 0; k < count; ++k)
+                        accumulateBackProjectionRow(diffSigns_[k], adjointIndices_[k], taps_, Y, diffRow);
+
+                    std::fill(regRow, regRow + rowLen, 0.f);
+                    if (lambda_ > 0 && Y >= btvRadius && Y < highResSize.height - btvRadius)
+                        calcBtvRegularizationRow(highRes_, Y, btvRadius, btvWeights_, regRow);
+
+                    const float* curRow = highRes_.ptr<float>(Y);
+                    float* nextRow = nextHighRes_.ptr<float>(Y);
+                    int e = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                    const int vl = VTraits<v_float32>::vlanes();
+                    const v_float32 vtau = vx_setall_f32(tau), vlambda = vx_setall_f32(lambda);
+                    for (; e <= rowLen - vl; e += vl)
+                    {
+                        const v_float32 d = v_sub(vx_load(diffRow + e), v_mul(vlambda, vx_load(regRow + e)));
+                        v_store(nextRow + e, v_fma(vtau, d, vx_load(curRow + e)));
+                    }
+#endif
+                    for (; e < rowLen; ++e)
+                        nextRow[e] = curRow[e] + tau * (diffRow[e] - lambda * regRow[e]);
+                }
+            });
+
+            std::swap(highRes_, nextHighRes_);
         }
 
         Rect inner(btvKernelSize_, btvKernelSize_, highRes_.cols - 2 * btvKernelSize_, highRes_.rows - 2 * btvKernelSize_);
@@ -774,16 +1015,15 @@ namespace
         highResForwardMotions_.clear();
         highResBackwardMotions_.clear();
 
-        forwardMaps_.clear();
-        backwardMaps_.clear();
+        warpIndices_.clear();
+        adjointIndices_.clear();
+        diffSigns_.clear();
 
-        highRes_.release();
+        taps_ = BtvL1Taps();
+        tapsScale_ = -1;
 
-        diffTerm_.release();
-        regTerm_.release();
-        a_.release();
-        b_.release();
-        c_.release();
+        highRes_.release();
+        nextHighRes_.release();
 
 #ifdef HAVE_OPENCL
         // UMat
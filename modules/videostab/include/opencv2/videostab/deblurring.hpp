@@ -105,7 +105,6 @@ public:
 
 private:
     float sensitivity_;
-    Mat_<float> bSum_, gSum_, rSum_, wSum_;
 };
 
 //! @}
@@ -75,13 +75,29 @@ public:
     template <typename Inpaint>
     Inpaint run(const Mat &mask, Inpaint inpaint);
 
+    /** @brief Template method that runs the Fast Marching Method by tiles, in parallel.
+
+    The tiles are marched in four passes, the tiles of one pass being at least one tile apart, and
+    each tile continues the distance map from the pixels known or inpainted before it. The result
+    doesn't depend on the number of threads, but the inpainting order differs from run() near the
+    tile borders.
+
+    @param mask Image mask, see run().
+    @param inpaint Inpainting functor that overloads void operator ()(int x, int y), it's copied
+    for each tile. The functor must only write the pixel it's called for and must not read pixels
+    farther than the tile size from it.
+    @param tileSize Tile size.
+     */
+    template <typename Inpaint>
+    void runTiled(const Mat &mask, Inpaint inpaint, Size tileSize = Size(64, 64));
+
     /**
     @return Distance map that's created during working of the method.
     */
     Mat distanceMap() const { return dist_; }
 
 private:
-    enum { INSIDE = 0, BAND = 1, KNOWN = 255 };
+    enum { INSIDE = 0, BAND = 1, OUTSIDE = 2, KNOWN = 255 };
 
     struct DXY
     {
@@ -93,6 +109,14 @@ private:
         bool operator <(const DXY &dxy) const { return dist < dxy.dist; }
     };
 
+    // marches over flag_ from the KNOWN pixels, ignoring the OUTSIDE ones, and calls the
+    // functor with the coordinates shifted by offset
+    template <typename Inpaint>
+    void march(Point offset, Inpaint &inpaint);
+
+    template <typename Inpaint>
+    bool marchTile(const Rect &tile, Inpaint inpaint);
+
     float solve(int x1, int y1, int x2, int y2) const;
     int& indexOf(const DXY &dxy) { return index_(dxy.y, dxy.x); }
 
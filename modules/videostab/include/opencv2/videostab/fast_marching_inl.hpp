@@ -57,12 +57,144 @@ Inpaint FastMarchingMethod::run(const cv::Mat &mask, Inpaint inpaint)
 
     CV_Assert(mask.type() == CV_8U);
 
-    static const int lut[4][2] = {{-1,0}, {0,-1}, {1,0}, {0,1}};
-
     mask.copyTo(flag_);
-    flag_.create(mask.size());
     dist_.create(mask.size());
+    dist_.setTo(Scalar::all(0));
     index_.create(mask.size());
+
+    march(Point(), inpaint);
+
+    return inpaint;
+}
+
+
+template <typename Inpaint>
+void FastMarchingMethod::runTiled(const cv::Mat &mask, Inpaint inpaint, Size tileSize)
+{
+    using namespace cv;
+
+    CV_Assert(mask.type() == CV_8U);
+    CV_Assert(tileSize.width > 0 && tileSize.height > 0);
+
+    // flag_ and dist_ keep the pixels marched so far, the narrow bands are local to the tiles
+    mask.copyTo(flag_);
+    dist_.create(mask.size());
+    dist_.setTo(Scalar::all(inf_));
+    dist_.setTo(Scalar::all(0), flag_ == KNOWN);
+    index_.release();
+    narrowBand_.clear();
+    size_ = 0;
+
+    // the remainder goes to the last row and column of tiles, so no tile is thinner than tileSize
+    const int ntx = std::max(mask.cols / tileSize.width, 1);
+    const int nty = std::max(mask.rows / tileSize.height, 1);
+
+    // a tile whose unknown pixels don't touch any known one is marched again in the next round
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+
+        for (int pass = 0; pass < 4; ++pass)
+        {
+            std::vector<Rect> tiles;
+            for (int ty = pass / 2; ty < nty; ty += 2)
+            {
+                for (int tx = pass % 2; tx < ntx; tx += 2)
+                {
+                    const int x0 = tx * tileSize.width;
+                    const int y0 = ty * tileSize.height;
+                    const int x1 = tx == ntx - 1 ? mask.cols : x0 + tileSize.width;
+                    const int y1 = ty == nty - 1 ? mask.rows : y0 + tileSize.height;
+                    tiles.push_back(Rect(x0, y0, x1 - x0, y1 - y0));
+                }
+            }
+
+            std::vector<uchar> marched(tiles.size(), 0);
+            parallel_for_(Range(0, static_cast<int>(tiles.size())), [&](const Range &range)
+            {
+                for (int i = range.start; i < range.end; ++i)
+                    marched[i] = marchTile(tiles[i], inpaint);
+            });
+
+            for (size_t i = 0; i < marched.size(); ++i)
+                progress = progress || marched[i] != 0;
+        }
+    }
+}
+
+
+template <typename Inpaint>
+bool FastMarchingMethod::marchTile(const Rect &tile, Inpaint inpaint)
+{
+    using namespace cv;
+
+    // the tile and its one pixel border, the border pixels not marched yet are left out
+    const Rect roi = Rect(tile.x - 1, tile.y - 1, tile.width + 2, tile.height + 2)
+            & Rect(0, 0, flag_.cols, flag_.rows);
+
+    FastMarchingMethod fmm;
+    fmm.inf_ = inf_;
+    fmm.flag_.create(roi.size());
+    fmm.dist_.create(roi.size());
+    fmm.index_.create(roi.size());
+
+    bool unknown = false;
+    for (int y = 0; y < roi.height; ++y)
+    {
+        for (int x = 0; x < roi.width; ++x)
+        {
+            const int gx = roi.x + x;
+            const int gy = roi.y + y;
+
+            if (flag_(gy,gx) == KNOWN)
+            {
+                fmm.flag_(y,x) = KNOWN;
+                fmm.dist_(y,x) = dist_(gy,gx);
+            }
+            else if (tile.contains(Point(gx,gy)))
+            {
+                fmm.flag_(y,x) = INSIDE;
+                unknown = true;
+            }
+            else
+                fmm.flag_(y,x) = OUTSIDE;
+        }
+    }
+
+    if (!unknown)
+        return false;
+
+    fmm.march(roi.tl(), inpaint);
+
+    bool marched = false;
+    for (int gy = tile.y; gy < tile.br().y; ++gy)
+    {
+        for (int gx = tile.x; gx < tile.br().x; ++gx)
+        {
+            const int x = gx - roi.x;
+            const int y = gy - roi.y;
+
+            if (flag_(gy,gx) != KNOWN && fmm.flag_(y,x) == KNOWN)
+            {
+                flag_(gy,gx) = KNOWN;
+                dist_(gy,gx) = fmm.dist_(y,x);
+                marched = true;
+            }
+        }
+    }
+
+    return marched;
+}
+
+
+template <typename Inpaint>
+void FastMarchingMethod::march(Point offset, Inpaint &inpaint)
+{
+    using namespace cv;
+
+    static const int lut[4][2] = {{-1,0}, {0,-1}, {1,0}, {0,1}};
+
     narrowBand_.clear();
     size_ = 0;
 
@@ -71,40 +203,43 @@ Inpaint FastMarchingMethod::run(const cv::Mat &mask, Inpaint inpaint)
     {
         for (int x = 0; x < flag_.cols; ++x)
         {
-            if (flag_(y,x) == KNOWN)
-                dist_(y,x) = 0.f;
-            else
-            {
-                int n = 0;
-                int nunknown = 0;
+            if (flag_(y,x) == KNOWN || flag_(y,x) == OUTSIDE)
+                continue;
 
-                for (int i = 0; i < 4; ++i)
-                {
-                    int xn = x + lut[i][0];
-                    int yn = y + lut[i][1];
+            int n = 0;
+            int nunknown = 0;
+            float dist = inf_;
 
-                    if (xn >= 0 && xn < flag_.cols && yn >= 0 && yn < flag_.rows)
-                    {
-                        n++;
-                        if (flag_(yn,xn) != KNOWN)
-                            nunknown++;
-                    }
-                }
+            for (int i = 0; i < 4; ++i)
+            {
+                int xn = x + lut[i][0];
+                int yn = y + lut[i][1];
 
-                if (n>0 && nunknown == n)
+                if (xn >= 0 && xn < flag_.cols && yn >= 0 && yn < flag_.rows && flag_(yn,xn) != OUTSIDE)
                 {
-                    dist_(y,x) = inf_;
-                    flag_(y,x) = INSIDE;
+                    n++;
+                    if (flag_(yn,xn) != KNOWN)
+                        nunknown++;
+                    else
+                        dist = std::min(dist, dist_(yn,xn));
                 }
-                else
-                {
-                    dist_(y,x) = 0.f;
-                    flag_(y,x) = BAND;
-                    inpaint(x, y);
+            }
 
-                    narrowBand_.push_back(DXY(0.f,x,y));
-                    index_(y,x) = size_++;
-                }
+            if (n>0 && nunknown == n)
+            {
+                dist_(y,x) = inf_;
+                flag_(y,x) = INSIDE;
+            }
+            else
+            {
+                // the band starts at the distance of its known neighbours, zero for a mask
+                dist = nunknown < n ? dist : 0.f;
+                dist_(y,x) = dist;
+                flag_(y,x) = BAND;
+                inpaint(x + offset.x, y + offset.y);
+
+                narrowBand_.push_back(DXY(dist,x,y));
+                index_(y,x) = size_++;
             }
         }
     }
@@ -126,7 +261,8 @@ Inpaint FastMarchingMethod::run(const cv::Mat &mask, Inpaint inpaint)
             int xn = x + lut[n][0];
             int yn = y + lut[n][1];
 
-            if (xn >= 0 && xn < flag_.cols && yn >= 0 && yn < flag_.rows && flag_(yn,xn) != KNOWN)
+            if (xn >= 0 && xn < flag_.cols && yn >= 0 && yn < flag_.rows &&
+                flag_(yn,xn) != KNOWN && flag_(yn,xn) != OUTSIDE)
             {
                 dist_(yn,xn) = std::min(std::min(solve(xn-1, yn, xn, yn-1), solve(xn+1, yn, xn, yn-1)),
                                         std::min(solve(xn-1, yn, xn, yn+1), solve(xn+1, yn, xn, yn+1)));
@@ -134,7 +270,7 @@ Inpaint FastMarchingMethod::run(const cv::Mat &mask, Inpaint inpaint)
                 if (flag_(yn,xn) == INSIDE)
                 {
                     flag_(yn,xn) = BAND;
-                    inpaint(xn, yn);
+                    inpaint(xn + offset.x, yn + offset.y);
                     heapAdd(DXY(dist_(yn,xn),xn,yn));
                 }
                 else
@@ -155,8 +291,6 @@ Inpaint FastMarchingMethod::run(const cv::Mat &mask, Inpaint inpaint)
             }
         }
     }
-
-    return inpaint;
 }
 
 } // namespace videostab
@@ -188,6 +188,17 @@ public:
 
     virtual Mat estimate(const Mat &frame0, const Mat &frame1, bool *ok = 0) = 0;
 
+    /** @brief Estimates motions between consecutive frames of a sequence.
+
+    @param frames Frame sequence.
+    @param motions Output motions, motions[i] is the motion from frames[i] to frames[i+1].
+    @param ok Optional output flags, ok[i] tells whether motions[i] was estimated successfully.
+
+    The default implementation calls estimate for each pair of frames.
+     */
+    virtual void estimateSequence(const std::vector<Mat> &frames, std::vector<Mat> &motions,
+                                  std::vector<uchar> *ok = 0);
+
 protected:
     ImageMotionEstimatorBase(MotionModel model) { setMotionModel(model); }
 
@@ -248,13 +259,25 @@ public:
     virtual Mat estimate(const Mat &frame0, const Mat &frame1, bool *ok = 0) CV_OVERRIDE;
     Mat estimate(InputArray frame0, InputArray frame1, bool *ok = 0);
 
+    /** @brief Estimates motions between consecutive frames of a sequence.
+
+    Motion of the pair i is fitted while keypoints of the pair i+1 are tracked. The points tracked
+    into a frame are reused as keypoints of the next pair, keypoints are detected again only when
+    less than a half of the last detected ones survive.
+     */
+    virtual void estimateSequence(const std::vector<Mat> &frames, std::vector<Mat> &motions,
+                                  std::vector<uchar> *ok = 0) CV_OVERRIDE;
+
 private:
+    void trackPoints(InputArray frame0, InputArray frame1, bool reusePoints);
+
     Ptr<MotionEstimatorBase> motionEstimator_;
     Ptr<FeatureDetector> detector_;
     Ptr<ISparseOptFlowEstimator> optFlowEstimator_;
     Ptr<IOutlierRejector> outlierRejector_;
     Mat mask_;
 
+    size_t ndetected_;
     std::vector<uchar> status_;
     std::vector<KeyPoint> keypointsPrev_;
     std::vector<Point2f> pointsPrev_, points_;
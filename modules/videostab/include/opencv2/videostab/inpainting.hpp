@@ -164,11 +164,21 @@ private:
     float distThresh_;
     int borderMode_;
 
-    Mat frame1_, transformedFrame1_;
-    Mat_<uchar> grayFrame_, transformedGrayFrame1_;
-    Mat_<uchar> mask1_, transformedMask1_;
+    // neighbor frame warped onto the target frame
+    struct WarpedFrame
+    {
+        WarpedFrame() : error(0.f) {}
+
+        float error;
+        Mat frame;
+        Mat_<uchar> grayFrame, mask;
+    };
+
+    Mat_<uchar> grayFrame_;
+    Mat_<uchar> mask1_;
     Mat_<float> flowX_, flowY_, flowErrors_;
     Mat_<uchar> flowMask_;
+    std::vector<WarpedFrame> warpedFrames_; // one per neighbor, reused as scratch buffers
 };
 
 class CV_EXPORTS ColorAverageInpainter : public InpainterBase
@@ -44,6 +44,7 @@
 #define OPENCV_VIDEOSTAB_STABILIZER_HPP
 
 #include <vector>
+#include <deque>
 #include <ctime>
 #include "opencv2/core.hpp"
 #include "opencv2/imgproc.hpp"
@@ -104,6 +105,7 @@ protected:
     void reset();
     Mat nextStabilizedFrame();
     bool doOneIteration();
+    virtual Mat readNextFrame();
     virtual void setUp(const Mat &firstFrame);
     virtual Mat estimateMotion() = 0;
     virtual Mat estimateStabilizationMotion() = 0;
@@ -174,12 +176,30 @@ public:
     void setEstimateTrimRatio(bool val) { mustEstTrimRatio_ = val; }
     bool mustEstimateTrimaRatio() const { return mustEstTrimRatio_; }
 
+    /** @brief Enables the streaming mode.
+
+    Instead of estimating the motions of the whole video in a first pass, the motions are estimated by
+    a producer thread running ahead of the output, and each stabilization motion is computed from a
+    sliding window of lookAhead() frames on both sides of the frame. Memory no longer depends on the
+    video length. Wobble suppression and trim ratio estimation need the whole motion sequence and
+    are not available in this mode.
+     */
+    void setStreamingMode(bool val) { streamingMode_ = val; }
+    bool streamingMode() const { return streamingMode_; }
+
+    //! number of future frames whose motions are known when a frame is stabilized in the streaming mode
+    void setLookAhead(int val) { lookAhead_ = val; }
+    int lookAhead() const { return lookAhead_; }
+
     virtual void reset() CV_OVERRIDE;
     virtual Mat nextFrame() CV_OVERRIDE;
 
 protected:
+    class MotionStream;
+
     void runPrePassIfNecessary();
 
+    virtual Mat readNextFrame() CV_OVERRIDE;
     virtual void setUp(const Mat &firstFrame) CV_OVERRIDE;
     virtual Mat estimateMotion() CV_OVERRIDE;
     virtual Mat estimateStabilizationMotion() CV_OVERRIDE;
@@ -194,6 +214,11 @@ protected:
     bool doWobbleSuppression_;
     std::vector<Mat> motions2_;
     Mat suppressedFrame_;
+
+    bool streamingMode_;
+    int lookAhead_;
+    Ptr<MotionStream> motionStream_;
+    std::deque<Mat> lookAheadFrames_;
 };
 
 //! @}
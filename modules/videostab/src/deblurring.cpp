@@ -44,6 +44,7 @@
 #include "opencv2/videostab/deblurring.hpp"
 #include "opencv2/videostab/global_motion.hpp"
 #include "opencv2/videostab/ring_buffer.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace cv
 {
@@ -54,16 +55,75 @@ float calcBlurriness(const Mat &frame)
 {
     CV_INSTRUMENT_REGION();
 
-    Mat Gx, Gy;
-    Sobel(frame, Gx, CV_32F, 1, 0);
-    Sobel(frame, Gy, CV_32F, 0, 1);
-    double normGx = norm(Gx);
-    double normGy = norm(Gy);
-    double sumSq = normGx*normGx + normGy*normGy;
+    // Sobel reads the rows around a stripe from the frame itself, so the stripes have the
+    // gradients of the whole frame; their sums are added in order
+    const int stripeHeight = 32;
+    const int nstripes = (frame.rows + stripeHeight - 1) / stripeHeight;
+    std::vector<double> sums(nstripes, 0.);
+
+    parallel_for_(Range(0, nstripes), [&](const Range &range)
+    {
+        Mat Gx, Gy;
+        for (int i = range.start; i < range.end; ++i)
+        {
+            Mat stripe = frame.rowRange(i * stripeHeight, std::min((i + 1) * stripeHeight, frame.rows));
+            Sobel(stripe, Gx, CV_32F, 1, 0);
+            Sobel(stripe, Gy, CV_32F, 0, 1);
+            sums[i] = norm(Gx, NORM_L2SQR) + norm(Gy, NORM_L2SQR);
+        }
+    });
+
+    double sumSq = 0;
+    for (int i = 0; i < nstripes; ++i)
+        sumSq += sums[i];
     return static_cast<float>(1. / (sumSq / frame.size().area() + 1e-6));
 }
 
 
+// adds the weighted colors of a warped neighbor row, valid being 0 where the neighbor is
+// undefined and 1 elsewhere
+static void accumulateNeighborRow(
+        const float *intensity0, const float *bgr1, const float *valid, int cols, float scale,
+        float sensitivity, float *bSum, float *gSum, float *rSum, float *wSum)
+{
+    int x = 0;
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int vl = VTraits<v_float32>::vlanes();
+    const v_float32 vscale = vx_setall_f32(scale), vsensitivity = vx_setall_f32(sensitivity);
+    const v_float32 kb = vx_setall_f32(0.3f), kg = vx_setall_f32(0.59f), kr = vx_setall_f32(0.11f);
+    const v_float32 vzero = vx_setzero_f32();
+
+    for (; x <= cols - vl; x += vl)
+    {
+        v_float32 b1, g1, r1;
+        v_load_deinterleave(bgr1 + 3*x, b1, g1, r1);
+        // same operation order as intensity() and the scalar code below
+        v_float32 i1 = v_add(v_add(v_mul(kb, b1), v_mul(kg, g1)), v_mul(kr, r1));
+        v_float32 w = v_div(vscale, v_add(vsensitivity, v_abs(v_sub(i1, vx_load(intensity0 + x)))));
+        w = v_select(v_ne(vx_load(valid + x), vzero), w, vzero);
+        v_store(bSum + x, v_add(vx_load(bSum + x), v_mul(w, b1)));
+        v_store(gSum + x, v_add(vx_load(gSum + x), v_mul(w, g1)));
+        v_store(rSum + x, v_add(vx_load(rSum + x), v_mul(w, r1)));
+        v_store(wSum + x, v_add(vx_load(wSum + x), w));
+    }
+#endif
+
+    for (; x < cols; ++x)
+    {
+        if (valid[x] != 0.f)
+        {
+            const float b1 = bgr1[3*x], g1 = bgr1[3*x+1], r1 = bgr1[3*x+2];
+            float w = scale / (sensitivity + std::abs(0.3f*b1 + 0.59f*g1 + 0.11f*r1 - intensity0[x]));
+            bSum[x] += w * b1;
+            gSum[x] += w * g1;
+            rSum[x] += w * r1;
+            wSum[x] += w;
+        }
+    }
+}
+
+
 WeightingDeblurer::WeightingDeblurer()
 {
     setSensitivity(0.1f);
@@ -76,67 +136,95 @@ void WeightingDeblurer::deblur(int idx, Mat &frame, const Range &range)
 
     CV_Assert(frame.type() == CV_8UC3);
 
-    bSum_.create(frame.size());
-    gSum_.create(frame.size());
-    rSum_.create(frame.size());
-    wSum_.create(frame.size());
-
-    for (int y = 0; y < frame.rows; ++y)
-    {
-        for (int x = 0; x < frame.cols; ++x)
-        {
-            Point3_<uchar> p = frame.at<Point3_<uchar> >(y,x);
-            bSum_(y,x) = p.x;
-            gSum_(y,x) = p.y;
-            rSum_(y,x) = p.z;
-            wSum_(y,x) = 1.f;
-        }
-    }
+    // only the sharper neighbors contribute, in the order of the frame indices
+    std::vector<Mat> neighbors;
+    std::vector<Mat_<float> > motions;
+    std::vector<float> scales;
 
     int iMin = std::max(idx - radius_, range.start);
     int iMax = std::min(idx + radius_, range.end);
     for (int k = iMin; k <= iMax; ++k)
     {
-        const Mat &neighbor = at(k, *frames_);
         float bRatio = at(idx, *blurrinessRates_) / at(k, *blurrinessRates_);
-        Mat_<float> M = getMotion(idx, k, *motions_);
-
         if (bRatio > 1.f)
         {
-            for (int y = 0; y < frame.rows; ++y)
+            neighbors.push_back(at(k, *frames_));
+            motions.push_back(getMotion(idx, k, *motions_));
+            scales.push_back(bRatio * sensitivity_);
+        }
+    }
+
+    if (neighbors.empty())
+        return;
+
+    // The rows are independent: each one warps the neighbors onto itself and sums their
+    // weighted colors, so the result doesn't depend on the number of threads.
+    const int cols = frame.cols;
+    parallel_for_(Range(0, frame.rows), [&](const Range &rows)
+    {
+        AutoBuffer<float> buf(9 * cols);
+        float *intensity0 = buf.data();
+        float *bgr1 = intensity0 + cols;
+        float *valid = bgr1 + 3*cols;
+        float *bSum = valid + cols;
+        float *gSum = bSum + cols;
+        float *rSum = gSum + cols;
+        float *wSum = rSum + cols;
+
+        for (int y = rows.start; y < rows.end; ++y)
+        {
+            Point3_<uchar> *row = frame.ptr<Point3_<uchar> >(y);
+
+            for (int x = 0; x < cols; ++x)
+            {
+                const Point3_<uchar> &p = row[x];
+                intensity0[x] = intensity(p);
+                bSum[x] = p.x;
+                gSum[x] = p.y;
+                rSum[x] = p.z;
+                wSum[x] = 1.f;
+            }
+
+            for (size_t k = 0; k < neighbors.size(); ++k)
             {
-                for (int x = 0; x < frame.cols; ++x)
+                const Mat &neighbor = neighbors[k];
+                const Mat_<float> &M = motions[k];
+
+                for (int x = 0; x < cols; ++x)
                 {
                     int x1 = cvRound(M(0,0)*x + M(0,1)*y + M(0,2));
                     int y1 = cvRound(M(1,0)*x + M(1,1)*y + M(1,2));
 
                     if (x1 >= 0 && x1 < neighbor.cols && y1 >= 0 && y1 < neighbor.rows)
                     {
-                        const Point3_<uchar> &p = frame.at<Point3_<uchar> >(y,x);
                         const Point3_<uchar> &p1 = neighbor.at<Point3_<uchar> >(y1,x1);
-                        float w = bRatio * sensitivity_ /
-                                (sensitivity_ + std::abs(intensity(p1) - intensity(p)));
-                        bSum_(y,x) += w * p1.x;
-                        gSum_(y,x) += w * p1.y;
-                        rSum_(y,x) += w * p1.z;
-                        wSum_(y,x) += w;
+                        bgr1[3*x] = p1.x;
+                        bgr1[3*x+1] = p1.y;
+                        bgr1[3*x+2] = p1.z;
+                        valid[x] = 1.f;
+                    }
+                    else
+                    {
+                        bgr1[3*x] = bgr1[3*x+1] = bgr1[3*x+2] = 0.f;
+                        valid[x] = 0.f;
                     }
                 }
+
+                accumulateNeighborRow(
+                        intensity0, bgr1, valid, cols, scales[k], sensitivity_,
+                        bSum, gSum, rSum, wSum);
             }
-        }
-    }
 
-    for (int y = 0; y < frame.rows; ++y)
-    {
-        for (int x = 0; x < frame.cols; ++x)
-        {
-            float wSumInv = 1.f / wSum_(y,x);
-            frame.at<Point3_<uchar> >(y,x) = Point3_<uchar>(
-                    static_cast<uchar>(bSum_(y,x)*wSumInv),
-                    static_cast<uchar>(gSum_(y,x)*wSumInv),
-                    static_cast<uchar>(rSum_(y,x)*wSumInv));
+            for (int x = 0; x < cols; ++x)
+            {
+                float wSumInv = 1.f / wSum[x];
+                row[x] = Point3_<uchar>(
+                        static_cast<uchar>(bSum[x]*wSumInv),
+                        static_cast<uchar>(gSum[x]*wSumInv),
+                        static_cast<uchar>(rSum[x]*wSumInv));
+            }
         }
-    }
+    });
 }
 
 } // namespace videostab
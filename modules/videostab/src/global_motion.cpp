@@ -46,6 +46,7 @@
 #include "opencv2/videostab/outlier_rejection.hpp"
 #include "opencv2/opencv_modules.hpp"
 #include "clp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 #include "opencv2/core/private.cuda.hpp"
 
@@ -378,6 +379,57 @@ Mat estimateGlobalMotionLeastSquares(
 }
 
 
+// counts points mapped by M within sqrt(thresh2) of their correspondences, marks them in mask if given
+static int countInliers(
+        const Point2f *points0, const Point2f *points1, int npoints, const Mat_<float> &M,
+        float thresh2, uchar *mask = 0)
+{
+    const float m00 = M(0,0), m01 = M(0,1), m02 = M(0,2);
+    const float m10 = M(1,0), m11 = M(1,1), m12 = M(1,2);
+    int count = 0, i = 0;
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int vl = VTraits<v_float32>::vlanes();
+    const v_float32 vm00 = vx_setall_f32(m00), vm01 = vx_setall_f32(m01), vm02 = vx_setall_f32(m02);
+    const v_float32 vm10 = vx_setall_f32(m10), vm11 = vx_setall_f32(m11), vm12 = vx_setall_f32(m12);
+    const v_float32 vthresh2 = vx_setall_f32(thresh2);
+    v_int32 vcount = vx_setzero_s32();
+    int buf[VTraits<v_int32>::max_nlanes];
+
+    for (; i <= npoints - vl; i += vl)
+    {
+        v_float32 x0, y0, x1, y1;
+        v_load_deinterleave(reinterpret_cast<const float*>(points0 + i), x0, y0);
+        v_load_deinterleave(reinterpret_cast<const float*>(points1 + i), x1, y1);
+        // same operation order as the scalar code below, so both agree on borderline points
+        v_float32 dx = v_sub(v_add(v_add(v_mul(vm00, x0), v_mul(vm01, y0)), vm02), x1);
+        v_float32 dy = v_sub(v_add(v_add(v_mul(vm10, x0), v_mul(vm11, y0)), vm12), y1);
+        v_int32 inlier = v_reinterpret_as_s32(v_lt(v_add(v_mul(dx, dx), v_mul(dy, dy)), vthresh2));
+        vcount = v_sub(vcount, inlier);
+        if (mask)
+        {
+            v_store(buf, inlier);
+            for (int k = 0; k < vl; ++k)
+                mask[i + k] = buf[k] != 0;
+        }
+    }
+    count = v_reduce_sum(vcount);
+#endif
+
+    for (; i < npoints; ++i)
+    {
+        const Point2f p0 = points0[i], p1 = points1[i];
+        float x = m00*p0.x + m01*p0.y + m02;
+        float y = m10*p0.x + m11*p0.y + m12;
+        bool inlier = sqr(x - p1.x) + sqr(y - p1.y) < thresh2;
+        count += inlier;
+        if (mask)
+            mask[i] = inlier;
+    }
+    return count;
+}
+
+
 Mat estimateGlobalMotionRansac(
         InputArray points0, InputArray points1, int model, const RansacParams &params,
         float *rmse, int *ninliers)
@@ -395,24 +447,15 @@ Mat estimateGlobalMotionRansac(
     const Point2f *points0_ = points0.getMat().ptr<Point2f>();
     const Point2f *points1_ = points1.getMat().ptr<Point2f>();
     const int niters = params.niters();
+    const float thresh2 = params.thresh * params.thresh;
 
-    // current hypothesis
-    std::vector<int> indices(params.size);
-    std::vector<Point2f> subset0(params.size);
-    std::vector<Point2f> subset1(params.size);
-
-    // best hypothesis
-    std::vector<int> bestIndices(params.size);
-
-    Mat bestM;
-    int ninliersMax = -1;
-
+    // hypotheses are drawn serially, so the result doesn't depend on the number of threads
+    std::vector<int> hypotheses(static_cast<size_t>(niters) * params.size);
     RNG rng(0);
-    Point2f p0, p1;
-    float x, y;
 
     for (int iter = 0; iter < niters; ++iter)
     {
+        int *indices = &hypotheses[static_cast<size_t>(iter) * params.size];
         for (int i = 0; i < params.size; ++i)
         {
             bool ok = false;
@@ -425,57 +468,69 @@ Mat estimateGlobalMotionRansac(
                         { ok = false; break; }
             }
         }
-        for (int i = 0; i < params.size; ++i)
-        {
-            subset0[i] = points0_[indices[i]];
-            subset1[i] = points1_[indices[i]];
-        }
+    }
 
-        Mat_<float> M = estimateGlobalMotionLeastSquares(subset0, subset1, model, 0);
+    // fit and score hypotheses
+    std::vector<Mat> models(niters);
+    std::vector<int> scores(niters);
 
-        int numinliers = 0;
-        for (int i = 0; i < npoints; ++i)
+    parallel_for_(Range(0, niters), [&](const Range &range)
+    {
+        std::vector<Point2f> subset0(params.size);
+        std::vector<Point2f> subset1(params.size);
+
+        for (int iter = range.start; iter < range.end; ++iter)
         {
-            p0 = points0_[i];
-            p1 = points1_[i];
-            x = M(0,0)*p0.x + M(0,1)*p0.y + M(0,2);
-            y = M(1,0)*p0.x + M(1,1)*p0.y + M(1,2);
-            if (sqr(x - p1.x) + sqr(y - p1.y) < params.thresh * params.thresh)
-                numinliers++;
+            const int *indices = &hypotheses[static_cast<size_t>(iter) * params.size];
+            for (int i = 0; i < params.size; ++i)
+            {
+                subset0[i] = points0_[indices[i]];
+                subset1[i] = points1_[indices[i]];
+            }
+            models[iter] = estimateGlobalMotionLeastSquares(subset0, subset1, model, 0);
+            scores[iter] = countInliers(points0_, points1_, npoints, models[iter], thresh2);
         }
-        if (numinliers >= ninliersMax)
+    });
+
+    // the last of equally good hypotheses wins
+    int best = 0;
+    int ninliersMax = -1;
+    for (int iter = 0; iter < niters; ++iter)
+    {
+        if (scores[iter] >= ninliersMax)
         {
-            bestM = M;
-            ninliersMax = numinliers;
-            bestIndices.swap(indices);
+            best = iter;
+            ninliersMax = scores[iter];
         }
     }
 
+    Mat bestM = models[best];
+    std::vector<Point2f> subset0, subset1;
+
     if (ninliersMax < params.size)
     {
         // compute RMSE
+        const int *bestIndices = &hypotheses[static_cast<size_t>(best) * params.size];
         for (int i = 0; i < params.size; ++i)
         {
-            subset0[i] = points0_[bestIndices[i]];
-            subset1[i] = points1_[bestIndices[i]];
+            subset0.push_back(points0_[bestIndices[i]]);
+            subset1.push_back(points1_[bestIndices[i]]);
         }
         bestM = estimateGlobalMotionLeastSquares(subset0, subset1, model, rmse);
     }
     else
     {
-        subset0.resize(ninliersMax);
-        subset1.resize(ninliersMax);
-        for (int i = 0, j = 0; i < npoints && j < ninliersMax ; ++i)
+        std::vector<uchar> mask(npoints);
+        countInliers(points0_, points1_, npoints, bestM, thresh2, &mask[0]);
+
+        subset0.reserve(ninliersMax);
+        subset1.reserve(ninliersMax);
+        for (int i = 0; i < npoints; ++i)
         {
-            p0 = points0_[i];
-            p1 = points1_[i];
-            x = bestM.at<float>(0,0)*p0.x + bestM.at<float>(0,1)*p0.y + bestM.at<float>(0,2);
-            y = bestM.at<float>(1,0)*p0.x + bestM.at<float>(1,1)*p0.y + bestM.at<float>(1,2);
-            if (sqr(x - p1.x) + sqr(y - p1.y) < params.thresh * params.thresh)
+            if (mask[i])
             {
-                subset0[j] = p0;
-                subset1[j] = p1;
-                j++;
+                subset0.push_back(points0_[i]);
+                subset1.push_back(points1_[i]);
             }
         }
         bestM = estimateGlobalMotionLeastSquares(subset0, subset1, model, rmse);
@@ -665,6 +720,22 @@ Mat MotionEstimatorL1::estimate(InputArray points0, InputArray points1, bool *ok
 }
 
 
+void ImageMotionEstimatorBase::estimateSequence(
+        const std::vector<Mat> &frames, std::vector<Mat> &motions, std::vector<uchar> *ok)
+{
+    const int npairs = std::max(static_cast<int>(frames.size()) - 1, 0);
+    motions.resize(npairs);
+    if (ok) ok->assign(npairs, 1);
+
+    for (int i = 0; i < npairs; ++i)
+    {
+        bool motionOk = true;
+        motions[i] = estimate(frames[i], frames[i + 1], &motionOk);
+        if (ok) (*ok)[i] = motionOk;
+    }
+}
+
+
 FromFileMotionReader::FromFileMotionReader(const String &path)
     : ImageMotionEstimatorBase(MM_UNKNOWN)
 {
@@ -707,7 +778,7 @@ Mat ToFileMotionWriter::estimate(const Mat &frame0, const Mat &frame1, bool *ok)
 
 
 KeypointBasedMotionEstimator::KeypointBasedMotionEstimator(Ptr<MotionEstimatorBase> estimator)
-    : ImageMotionEstimatorBase(estimator->motionModel()), motionEstimator_(estimator)
+    : ImageMotionEstimatorBase(estimator->motionModel()), motionEstimator_(estimator), ndetected_(0)
 {
     setDetector(GFTTDetector::create());
     setOpticalFlowEstimator(makePtr<SparsePyrLkOptFlowEstimator>());
@@ -725,23 +796,93 @@ Mat KeypointBasedMotionEstimator::estimate(const Mat &frame0, const Mat &frame1,
 
 Mat KeypointBasedMotionEstimator::estimate(InputArray frame0, InputArray frame1, bool *ok)
 {
-    // find keypoints
-    detector_->detect(frame0, keypointsPrev_, mask_);
-    if (keypointsPrev_.empty())
+    trackPoints(frame0, frame1, false);
+    if (pointsPrev_.empty())
         return Mat::eye(3, 3, CV_32F);
 
-    // extract points from keypoints
-    pointsPrev_.resize(keypointsPrev_.size());
-    for (size_t i = 0; i < keypointsPrev_.size(); ++i)
-        pointsPrev_[i] = keypointsPrev_[i].pt;
+    // estimate motion
+    return motionEstimator_->estimate(pointsPrevGood_, pointsGood_, ok);
+}
+
+void KeypointBasedMotionEstimator::estimateSequence(
+        const std::vector<Mat> &frames, std::vector<Mat> &motions, std::vector<uchar> *ok)
+{
+    const int npairs = std::max(static_cast<int>(frames.size()) - 1, 0);
+    motions.resize(npairs);
+    if (ok) ok->assign(npairs, 1);
+    if (npairs == 0)
+        return;
+
+    // correspondences of the pair being fitted, the pair being tracked lives in the members
+    std::vector<Point2f> fitPoints0, fitPoints1;
+
+    trackPoints(frames[0], frames[1], false);
+
+    for (int i = 0; i < npairs; ++i)
+    {
+        const bool hasPoints = !pointsPrev_.empty();
+        fitPoints0.assign(pointsPrevGood_.begin(), pointsPrevGood_.end());
+        fitPoints1.assign(pointsGood_.begin(), pointsGood_.end());
+
+        // fit the pair i and track the pair i+1 concurrently
+        parallel_for_(Range(0, i + 1 < npairs ? 2 : 1), [&](const Range &range)
+        {
+            for (int task = range.start; task < range.end; ++task)
+            {
+                if (task == 0)
+                {
+                    bool motionOk = true;
+                    motions[i] = hasPoints ? motionEstimator_->estimate(fitPoints0, fitPoints1, &motionOk)
+                                           : Mat::eye(3, 3, CV_32F);
+                    if (ok) (*ok)[i] = motionOk;
+                }
+                else
+                    trackPoints(frames[i + 1], frames[i + 2], true);
+            }
+        });
+    }
+}
+
+void KeypointBasedMotionEstimator::trackPoints(InputArray frame0, InputArray frame1, bool reusePoints)
+{
+    if (reusePoints)
+    {
+        // continue the tracks which ended in frame0
+        const Rect bounds(Point(), frame0.size());
+        pointsPrev_.clear();
+        for (size_t i = 0; i < pointsGood_.size(); ++i)
+        {
+            const Point pt(cvRound(pointsGood_[i].x), cvRound(pointsGood_[i].y));
+            if (bounds.contains(pt) && (mask_.empty() || mask_.at<uchar>(pt)))
+                pointsPrev_.push_back(pointsGood_[i]);
+        }
+        reusePoints = pointsPrev_.size() * 2 >= ndetected_ && !pointsPrev_.empty();
+    }
+
+    if (!reusePoints)
+    {
+        // find keypoints
+        detector_->detect(frame0, keypointsPrev_, mask_);
+
+        // extract points from keypoints
+        pointsPrev_.resize(keypointsPrev_.size());
+        for (size_t i = 0; i < keypointsPrev_.size(); ++i)
+            pointsPrev_[i] = keypointsPrev_[i].pt;
+        ndetected_ = pointsPrev_.size();
+    }
+
+    pointsPrevGood_.clear();
+    pointsGood_.clear();
+    if (pointsPrev_.empty())
+        return;
 
     // find correspondences
     optFlowEstimator_->run(frame0, frame1, pointsPrev_, points_, status_, noArray());
 
     // leave good correspondences only
 
-    pointsPrevGood_.clear(); pointsPrevGood_.reserve(points_.size());
-    pointsGood_.clear(); pointsGood_.reserve(points_.size());
+    pointsPrevGood_.reserve(points_.size());
+    pointsGood_.reserve(points_.size());
 
     for (size_t i = 0; i < points_.size(); ++i)
     {
@@ -777,9 +918,6 @@ Mat KeypointBasedMotionEstimator::estimate(InputArray frame0, InputArray frame1,
             }
         }
     }
-
-    // estimate motion
-    return motionEstimator_->estimate(pointsPrevGood_, pointsGood_, ok);
 }
 
 #if defined(HAVE_OPENCV_CUDAIMGPROC) && defined(HAVE_OPENCV_CUDAOPTFLOW)
@@ -133,70 +133,80 @@ void ConsistentMosaicInpainter::inpaint(int idx, Mat &frame, Mat &mask)
 
     Mat invS = at(idx, *stabilizationMotions_).inv();
     std::vector<Mat_<float> > vmotions(2*radius_ + 1);
+    std::vector<Mat_<Point3_<uchar> > > vframes(2*radius_ + 1);
     for (int i = -radius_; i <= radius_; ++i)
+    {
         vmotions[radius_ + i] = getMotion(idx, idx + i, *motions_) * invS;
+        vframes[radius_ + i] = at(idx + i, *frames_);
+    }
 
-    int n;
-    float mean, var;
-    std::vector<Pixel3> pixels(2*radius_ + 1);
+    const float varThresh = stdevThresh_ * stdevThresh_;
 
     Mat_<Point3_<uchar> > frame_(frame);
     Mat_<uchar> mask_(mask);
 
-    for (int y = 0; y < mask.rows; ++y)
+    // each pixel only depends on the neighbor frames, so the rows are filled in parallel
+    parallel_for_(Range(0, mask.rows), [&](const Range &range)
     {
-        for (int x = 0; x < mask.cols; ++x)
+        int n;
+        float mean, var;
+        std::vector<Pixel3> pixels(2*radius_ + 1);
+
+        for (int y = range.start; y < range.end; ++y)
         {
-            if (!mask_(y, x))
+            for (int x = 0; x < mask.cols; ++x)
             {
-                n = 0;
-                mean = 0;
-                var = 0;
-
-                for (int i = -radius_; i <= radius_; ++i)
+                if (!mask_(y, x))
                 {
-                    const Mat_<Point3_<uchar> > &framei = at(idx + i, *frames_);
-                    const Mat_<float> &Mi = vmotions[radius_ + i];
-                    int xi = cvRound(Mi(0,0)*x + Mi(0,1)*y + Mi(0,2));
-                    int yi = cvRound(Mi(1,0)*x + Mi(1,1)*y + Mi(1,2));
-                    if (xi >= 0 && xi < framei.cols && yi >= 0 && yi < framei.rows)
+                    n = 0;
+                    mean = 0;
+                    var = 0;
+
+                    for (int i = -radius_; i <= radius_; ++i)
                     {
-                        pixels[n].color = framei(yi, xi);
-                        mean += pixels[n].intens = intensity(pixels[n].color);
-                        n++;
+                        const Mat_<Point3_<uchar> > &framei = vframes[radius_ + i];
+                        const Mat_<float> &Mi = vmotions[radius_ + i];
+                        int xi = cvRound(Mi(0,0)*x + Mi(0,1)*y + Mi(0,2));
+                        int yi = cvRound(Mi(1,0)*x + Mi(1,1)*y + Mi(1,2));
+                        if (xi >= 0 && xi < framei.cols && yi >= 0 && yi < framei.rows)
+                        {
+                            pixels[n].color = framei(yi, xi);
+                            mean += pixels[n].intens = intensity(pixels[n].color);
+                            n++;
+                        }
                     }
-                }
 
-                if (n > 0)
-                {
-                    mean /= n;
-                    for (int i = 0; i < n; ++i)
-                        var += sqr(pixels[i].intens - mean);
-                    var /= std::max(n - 1, 1);
-
-                    if (var < stdevThresh_ * stdevThresh_)
+                    if (n > 0)
                     {
-                        std::sort(pixels.begin(), pixels.begin() + n);
-                        int nh = (n-1)/2;
-                        int c1 = pixels[nh].color.x;
-                        int c2 = pixels[nh].color.y;
-                        int c3 = pixels[nh].color.z;
-                        if (n-2*nh)
+                        mean /= n;
+                        for (int i = 0; i < n; ++i)
+                            var += sqr(pixels[i].intens - mean);
+                        var /= std::max(n - 1, 1);
+
+                        if (var < varThresh)
                         {
-                            c1 = (c1 + pixels[nh].color.x) / 2;
-                            c2 = (c2 + pixels[nh].color.y) / 2;
-                            c3 = (c3 + pixels[nh].color.z) / 2;
+                            std::sort(pixels.begin(), pixels.begin() + n);
+                            int nh = (n-1)/2;
+                            int c1 = pixels[nh].color.x;
+                            int c2 = pixels[nh].color.y;
+                            int c3 = pixels[nh].color.z;
+                            if (n-2*nh)
+                            {
+                                c1 = (c1 + pixels[nh].color.x) / 2;
+                                c2 = (c2 + pixels[nh].color.y) / 2;
+                                c3 = (c3 + pixels[nh].color.z) / 2;
+                            }
+                            frame_(y, x) = Point3_<uchar>(
+                                    static_cast<uchar>(c1),
+                                    static_cast<uchar>(c2),
+                                    static_cast<uchar>(c3));
+                            mask_(y, x) = 255;
                         }
-                        frame_(y, x) = Point3_<uchar>(
-                                static_cast<uchar>(c1),
-                                static_cast<uchar>(c2),
-                                static_cast<uchar>(c3));
-                        mask_(y, x) = 255;
                     }
                 }
             }
         }
-    }
+    });
 }
 
 
@@ -345,25 +355,63 @@ void MotionInpainter::inpaint(int idx, Mat &frame, Mat &mask)
 {
     CV_INSTRUMENT_REGION();
 
-    std::priority_queue<std::pair<float,int> > neighbors;
-    std::vector<Mat> vmotions(2*radius_ + 1);
-
-    for (int i = -radius_; i <= radius_; ++i)
+    if (mask1_.size() != mask.size())
     {
-        Mat motion0to1 = getMotion(idx, idx + i, *motions_) * at(idx, *stabilizationMotions_).inv();
-        vmotions[radius_ + i] = motion0to1;
+        mask1_.create(mask.size());
+        mask1_.setTo(255);
+    }
 
-        if (i != 0)
+    const Mat invS = at(idx, *stabilizationMotions_).inv();
+    warpedFrames_.resize(2*radius_ + 1);
+
+    // The neighbors are measured and warped in parallel. The warps go through the stabilization
+    // motion of the target, so they are recomputed for each target; only the buffers are reused.
+    parallel_for_(Range(-radius_, radius_ + 1), [&](const Range &range)
+    {
+        for (int i = range.start; i < range.end; ++i)
         {
-            float err = alignementError(motion0to1, frame, mask, at(idx + i, *frames_));
-            neighbors.push(std::make_pair(-err, idx + i));
+            if (i == 0)
+                continue;
+
+            WarpedFrame &warped = warpedFrames_[radius_ + i];
+            const Mat &frame1 = at(idx + i, *frames_);
+            Mat motion0to1 = getMotion(idx, idx + i, *motions_) * invS;
+
+            warped.error = alignementError(motion0to1, frame, mask, frame1);
+
+            Mat motion1to0 = motion0to1.inv();
+
+            // warp frame
+
+            if (motionModel_ != MM_HOMOGRAPHY)
+                warpAffine(
+                        frame1, warped.frame, motion1to0(Rect(0,0,3,2)), frame1.size(),
+                        INTER_LINEAR, borderMode_);
+            else
+                warpPerspective(
+                        frame1, warped.frame, motion1to0, frame1.size(), INTER_LINEAR,
+                        borderMode_);
+
+            cvtColor(warped.frame, warped.grayFrame, COLOR_BGR2GRAY);
+
+            // warp mask
+
+            if (motionModel_ != MM_HOMOGRAPHY)
+                warpAffine(
+                        mask1_, warped.mask, motion1to0(Rect(0,0,3,2)), mask1_.size(),
+                        INTER_NEAREST);
+            else
+                warpPerspective(mask1_, warped.mask, motion1to0, mask1_.size(), INTER_NEAREST);
+
+            erode(warped.mask, warped.mask, Mat());
         }
-    }
+    });
 
-    if (mask1_.size() != mask.size())
+    std::priority_queue<std::pair<float,int> > neighbors;
+    for (int i = -radius_; i <= radius_; ++i)
     {
-        mask1_.create(mask.size());
-        mask1_.setTo(255);
+        if (i != 0)
+            neighbors.push(std::make_pair(-warpedFrames_[radius_ + i].error, idx + i));
     }
 
     cvtColor(frame, grayFrame_, COLOR_BGR2GRAY);
@@ -377,51 +425,25 @@ void MotionInpainter::inpaint(int idx, Mat &frame, Mat &mask)
         int neighbor = neighbors.top().second;
         neighbors.pop();
 
-        Mat motion1to0 = vmotions[radius_ + neighbor - idx].inv();
-
-        // warp frame
-
-        frame1_ = at(neighbor, *frames_);
-
-        if (motionModel_ != MM_HOMOGRAPHY)
-            warpAffine(
-                    frame1_, transformedFrame1_, motion1to0(Rect(0,0,3,2)), frame1_.size(),
-                    INTER_LINEAR, borderMode_);
-        else
-            warpPerspective(
-                    frame1_, transformedFrame1_, motion1to0, frame1_.size(), INTER_LINEAR,
-                    borderMode_);
-
-        cvtColor(transformedFrame1_, transformedGrayFrame1_, COLOR_BGR2GRAY);
-
-        // warp mask
-
-        if (motionModel_ != MM_HOMOGRAPHY)
-            warpAffine(
-                    mask1_, transformedMask1_, motion1to0(Rect(0,0,3,2)), mask1_.size(),
-                    INTER_NEAREST);
-        else
-            warpPerspective(mask1_, transformedMask1_, motion1to0, mask1_.size(), INTER_NEAREST);
-
-        erode(transformedMask1_, transformedMask1_, Mat());
+        const WarpedFrame &warped = warpedFrames_[radius_ + neighbor - idx];
 
         // update flow
 
-        optFlowEstimator_->run(grayFrame_, transformedGrayFrame1_, flowX_, flowY_, flowErrors_);
+        optFlowEstimator_->run(grayFrame_, warped.grayFrame, flowX_, flowY_, flowErrors_);
 
         calcFlowMask(
-                flowX_, flowY_, flowErrors_, flowErrorThreshold_, mask, transformedMask1_,
+                flowX_, flowY_, flowErrors_, flowErrorThreshold_, mask, warped.mask,
                 flowMask_);
 
         body.flowX = flowX_;
         body.flowY = flowY_;
         body.mask0 = flowMask_;
-        body.mask1 = transformedMask1_;
-        body.frame1 = transformedFrame1_;
-        fmm_.run(flowMask_, body);
+        body.mask1 = warped.mask;
+        body.frame1 = warped.frame;
+        fmm_.runTiled(flowMask_, body);
 
         completeFrameAccordingToFlow(
-                flowMask_, flowX_, flowY_, transformedFrame1_, transformedMask1_, distThresh_,
+                flowMask_, flowX_, flowY_, warped.frame, warped.mask, distThresh_,
                 frame, mask);
     }
 }
@@ -470,7 +492,7 @@ void ColorAverageInpainter::inpaint(int /*idx*/, Mat &frame, Mat &mask)
     ColorAverageInpaintBody body;
     body.mask = mask;
     body.frame = frame;
-    fmm_.run(mask, body);
+    fmm_.runTiled(mask, body);
 }
 
 
@@ -502,20 +524,23 @@ void calcFlowMask(
     flowMask.setTo(0);
     Mat_<uchar> flowMask_(flowMask);
 
-    for (int y0 = 0; y0 < flowMask_.rows; ++y0)
+    parallel_for_(Range(0, flowMask_.rows), [&](const Range &range)
     {
-        for (int x0 = 0; x0 < flowMask_.cols; ++x0)
+        for (int y0 = range.start; y0 < range.end; ++y0)
         {
-            if (mask0_(y0,x0) && errors_(y0,x0) < maxError)
+            for (int x0 = 0; x0 < flowMask_.cols; ++x0)
             {
-                int x1 = cvRound(x0 + flowX_(y0,x0));
-                int y1 = cvRound(y0 + flowY_(y0,x0));
+                if (mask0_(y0,x0) && errors_(y0,x0) < maxError)
+                {
+                    int x1 = cvRound(x0 + flowX_(y0,x0));
+                    int y1 = cvRound(y0 + flowY_(y0,x0));
 
-                if (x1 >= 0 && x1 < mask1_.cols && y1 >= 0 && y1 < mask1_.rows && mask1_(y1,x1))
-                    flowMask_(y0,x0) = 255;
+                    if (x1 >= 0 && x1 < mask1_.cols && y1 >= 0 && y1 < mask1_.rows && mask1_(y1,x1))
+                        flowMask_(y0,x0) = 255;
+                }
             }
         }
-    }
+    });
 }
 
 
@@ -536,24 +561,28 @@ void completeFrameAccordingToFlow(
     Mat_<uchar> flowMask_(flowMask), mask1_(mask1), mask0_(mask0);
     Mat_<float> flowX_(flowX), flowY_(flowY);
 
-    for (int y0 = 0; y0 < frame0.rows; ++y0)
+    // frame1 and mask1 are only read, so the rows are independent
+    parallel_for_(Range(0, frame0.rows), [&](const Range &range)
     {
-        for (int x0 = 0; x0 < frame0.cols; ++x0)
+        for (int y0 = range.start; y0 < range.end; ++y0)
         {
-            if (!mask0_(y0,x0) && flowMask_(y0,x0))
+            for (int x0 = 0; x0 < frame0.cols; ++x0)
             {
-                int x1 = cvRound(x0 + flowX_(y0,x0));
-                int y1 = cvRound(y0 + flowY_(y0,x0));
-
-                if (x1 >= 0 && x1 < frame1.cols && y1 >= 0 && y1 < frame1.rows && mask1_(y1,x1)
-                    && sqr(flowX_(y0,x0)) + sqr(flowY_(y0,x0)) < sqr(distThresh))
+                if (!mask0_(y0,x0) && flowMask_(y0,x0))
                 {
-                    frame0.at<Point3_<uchar> >(y0,x0) = frame1.at<Point3_<uchar> >(y1,x1);
-                    mask0_(y0,x0) = 255;
+                    int x1 = cvRound(x0 + flowX_(y0,x0));
+                    int y1 = cvRound(y0 + flowY_(y0,x0));
+
+                    if (x1 >= 0 && x1 < frame1.cols && y1 >= 0 && y1 < frame1.rows && mask1_(y1,x1)
+                        && sqr(flowX_(y0,x0)) + sqr(flowY_(y0,x0)) < sqr(distThresh))
+                    {
+                        frame0.at<Point3_<uchar> >(y0,x0) = frame1.at<Point3_<uchar> >(y1,x1);
+                        mask0_(y0,x0) = 255;
+                    }
                 }
             }
         }
-    }
+    });
 }
 
 } // namespace videostab
@@ -44,6 +44,13 @@
 #include "opencv2/videostab/stabilizer.hpp"
 #include "opencv2/videostab/ring_buffer.hpp"
 
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#endif
+
 // for debug purposes
 #define SAVE_MOTIONS 0
 
@@ -117,7 +124,7 @@ Mat StabilizerBase::nextStabilizedFrame()
 
 bool StabilizerBase::doOneIteration()
 {
-    Mat frame = frameSource_->nextFrame();
+    Mat frame = readNextFrame();
     if (!frame.empty())
     {
         curPos_++;
@@ -157,6 +164,12 @@ bool StabilizerBase::doOneIteration()
 }
 
 
+Mat StabilizerBase::readNextFrame()
+{
+    return frameSource_->nextFrame();
+}
+
+
 void StabilizerBase::setUp(const Mat &firstFrame)
 {
     InpainterBase *inpaint = inpainter_.get();
@@ -309,11 +322,219 @@ Mat OnePassStabilizer::postProcessFrame(const Mat &frame)
 }
 
 
+// number of frames whose motions are estimated at once, so that the estimator can pipeline them
+static const int MOTION_CHUNK_SIZE = 8;
+
+// estimates motions between consecutive frames, pair by pair when masks are given as each pair has its own
+static void estimateMotions(
+        ImageMotionEstimatorBase &estimator, const Ptr<IFrameSource> &maskSource,
+        const std::vector<Mat> &frames, std::vector<Mat> &motions, std::vector<uchar> &ok)
+{
+    if (!maskSource)
+    {
+        estimator.estimateSequence(frames, motions, &ok);
+        return;
+    }
+
+    const int npairs = std::max(static_cast<int>(frames.size()) - 1, 0);
+    motions.resize(npairs);
+    ok.resize(npairs);
+    for (int i = 0; i < npairs; ++i)
+    {
+        bool motionOk = true;
+        estimator.setFrameMask(maskSource->nextFrame());
+        motions[i] = estimator.estimate(frames[i], frames[i + 1], &motionOk);
+        ok[i] = motionOk;
+    }
+}
+
+
+// Reads the frames and estimates the motions between them ahead of the stabilizer, on a separate
+// thread unless OpenCV is built without thread support.
+class TwoPassStabilizer::MotionStream
+{
+public:
+    MotionStream(const Ptr<IFrameSource> &frameSource, const Ptr<IFrameSource> &maskSource,
+                 const Ptr<ImageMotionEstimatorBase> &motionEstimator, int capacity);
+    ~MotionStream();
+
+    // returns false when the source is exhausted, motion is the motion from the previous frame
+    bool pop(Mat &frame, Mat &motion);
+
+private:
+    bool produce(Mat &frame, Mat &motion);
+
+    Ptr<IFrameSource> frameSource_;
+    Ptr<IFrameSource> maskSource_;
+    Ptr<ImageMotionEstimatorBase> motionEstimator_;
+    std::vector<Mat> pool_;
+    Mat prevFrame_;
+    std::deque<std::pair<Mat, Mat> > ready_;
+
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+    void run();
+
+    size_t capacity_;
+    std::deque<std::pair<Mat, Mat> > queue_;
+    bool finished_;
+    bool stop_;
+    std::exception_ptr error_;
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::thread thread_;
+#endif
+};
+
+
+TwoPassStabilizer::MotionStream::MotionStream(
+        const Ptr<IFrameSource> &frameSource, const Ptr<IFrameSource> &maskSource,
+        const Ptr<ImageMotionEstimatorBase> &motionEstimator, int capacity)
+    : frameSource_(frameSource), maskSource_(maskSource), motionEstimator_(motionEstimator)
+{
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+    capacity_ = std::max(capacity, 1);
+    finished_ = false;
+    stop_ = false;
+    thread_ = std::thread(&MotionStream::run, this);
+#else
+    CV_UNUSED(capacity);
+#endif
+}
+
+
+TwoPassStabilizer::MotionStream::~MotionStream()
+{
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    notFull_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+#endif
+}
+
+
+bool TwoPassStabilizer::MotionStream::produce(Mat &frame, Mat &motion)
+{
+    if (ready_.empty())
+    {
+        std::vector<Mat> frames;
+        if (!prevFrame_.empty())
+            frames.push_back(prevFrame_);
+        size_t first = frames.size();
+
+        Mat src;
+        while (frames.size() - first < (size_t)MOTION_CHUNK_SIZE && !(src = frameSource_->nextFrame()).empty())
+        {
+            // frames wait in the look-ahead window while the source may already reuse its buffer, so
+            // they are copied into pooled buffers which are recycled once nothing else references them
+            Mat buf;
+            for (size_t i = 0; i < pool_.size() && buf.empty(); ++i)
+            {
+                const Mat &m = pool_[i];
+                if (m.u && CV_XADD(&m.u->refcount, 0) == 1 && m.size() == src.size() && m.type() == src.type())
+                    buf = m;
+            }
+            if (buf.empty())
+            {
+                buf.create(src.size(), src.type());
+                pool_.push_back(buf);
+            }
+            src.copyTo(buf);
+            frames.push_back(buf);
+        }
+        if (frames.size() == first)
+            return false;
+
+        std::vector<Mat> motions;
+        std::vector<uchar> ok;
+        estimateMotions(*motionEstimator_, maskSource_, frames, motions, ok);
+
+        if (first == 0)
+            ready_.push_back(std::make_pair(frames[0], Mat()));
+        for (size_t i = 0; i < motions.size(); ++i)
+            ready_.push_back(std::make_pair(frames[i + 1], motions[i]));
+        prevFrame_ = frames.back();
+    }
+
+    frame = ready_.front().first;
+    motion = ready_.front().second;
+    ready_.pop_front();
+    return true;
+}
+
+
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+void TwoPassStabilizer::MotionStream::run()
+{
+    try
+    {
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                notFull_.wait(lock, [this] { return stop_ || queue_.size() < capacity_; });
+                if (stop_)
+                    return;
+            }
+
+            Mat frame, motion;
+            bool ok = produce(frame, motion);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!ok)
+            {
+                finished_ = true;
+                notEmpty_.notify_one();
+                return;
+            }
+            queue_.push_back(std::make_pair(frame, motion));
+            notEmpty_.notify_one();
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+        finished_ = true;
+        notEmpty_.notify_one();
+    }
+}
+#endif
+
+
+bool TwoPassStabilizer::MotionStream::pop(Mat &frame, Mat &motion)
+{
+#ifndef OPENCV_DISABLE_THREAD_SUPPORT
+    std::unique_lock<std::mutex> lock(mutex_);
+    notEmpty_.wait(lock, [this] { return !queue_.empty() || finished_; });
+    if (queue_.empty())
+    {
+        if (error_)
+            std::rethrow_exception(error_);
+        return false;
+    }
+    frame = queue_.front().first;
+    motion = queue_.front().second;
+    queue_.pop_front();
+    notFull_.notify_one();
+    return true;
+#else
+    return produce(frame, motion);
+#endif
+}
+
+
 TwoPassStabilizer::TwoPassStabilizer()
 {
     setMotionStabilizer(makePtr<GaussianMotionFilter>());
     setWobbleSuppressor(makePtr<NullWobbleSuppressor>());
     setEstimateTrimRatio(false);
+    setStreamingMode(false);
+    setLookAhead(30);
     reset();
 }
 
@@ -326,16 +547,60 @@ void TwoPassStabilizer::reset()
     doWobbleSuppression_ = false;
     motions2_.clear();
     suppressedFrame_ = Mat();
+    motionStream_.release();
+    lookAheadFrames_.clear();
 }
 
 
 Mat TwoPassStabilizer::nextFrame()
 {
-    runPrePassIfNecessary();
+    if (!streamingMode_)
+        runPrePassIfNecessary();
     return StabilizerBase::nextStabilizedFrame();
 }
 
 
+Mat TwoPassStabilizer::readNextFrame()
+{
+    if (!streamingMode_)
+        return StabilizerBase::readNextFrame();
+
+    int lookAhead = std::max(lookAhead_, radius_);
+    if (!motionStream_)
+    {
+        if (dynamic_cast<NullWobbleSuppressor*>(wobbleSuppressor_.get()) == 0)
+            CV_Error(Error::StsNotImplemented, "Wobble suppression is not available in the streaming mode");
+        if (mustEstTrimRatio_)
+            CV_Error(Error::StsNotImplemented, "Trim ratio estimation is not available in the streaming mode");
+
+        // ring buffer covering the motions of the sliding window and of the frames read ahead
+        motions_.resize(2*lookAhead + 4);
+        for (size_t i = 0; i < motions_.size(); ++i)
+            motions_[i] = Mat::eye(3, 3, CV_32F);
+
+        motionStream_ = makePtr<MotionStream>(frameSource_, maskSource_, motionEstimator_, 4);
+    }
+
+    // the base class keeps radius_ frames after the stabilized one, the rest of the look-ahead
+    // window is kept here, so that motions up to curStabilizedPos_ + lookAhead are known
+    int pending = lookAhead - radius_;
+    Mat frame, motion;
+    while ((int)lookAheadFrames_.size() <= pending && motionStream_->pop(frame, motion))
+    {
+        if (frameCount_ > 0)
+            at(frameCount_ - 1, motions_) = motion;
+        lookAheadFrames_.push_back(frame);
+        frameCount_++;
+    }
+
+    if (lookAheadFrames_.empty())
+        return Mat();
+    frame = lookAheadFrames_.front();
+    lookAheadFrames_.pop_front();
+    return frame;
+}
+
+
 #if SAVE_MOTIONS
 static void saveMotions(
         int frameCount, const std::vector<Mat> &motions, const std::vector<Mat> &stabilizationMotions)
@@ -383,42 +648,55 @@ void TwoPassStabilizer::runPrePassIfNecessary()
         log_->print("first pass: estimating motions");
 
         Mat prevFrame, frame;
-        bool ok = true, ok2 = true;
+        std::vector<Mat> frames, motions, motions2;
+        std::vector<uchar> ok, ok2;
 
-        while (!(frame = frameSource_->nextFrame()).empty())
+        for (bool done = false; !done;)
         {
-            if (frameCount_ > 0)
+            // read a chunk of frames, it starts with the last frame of the previous one
+            frames.clear();
+            if (!prevFrame.empty())
+                frames.push_back(prevFrame);
+
+            while ((int)frames.size() <= MOTION_CHUNK_SIZE)
             {
-                if (maskSource_)
-                    motionEstimator_->setFrameMask(maskSource_->nextFrame());
+                frame = frameSource_->nextFrame();
+                if (frame.empty())
+                {
+                    done = true;
+                    break;
+                }
+                if (frameCount_ == 0)
+                {
+                    frameSize_ = frame.size();
+                    frameMask_.create(frameSize_, CV_8U);
+                    frameMask_.setTo(255);
+                }
+                frames.push_back(frame);
+                frameCount_++;
+            }
+            if (frames.empty())
+                break;
 
-                motions_.push_back(motionEstimator_->estimate(prevFrame, frame, &ok));
+            estimateMotions(*motionEstimator_, maskSource_, frames, motions, ok);
+            if (doWobbleSuppression_)
+                wobbleSuppressor_->motionEstimator()->estimateSequence(frames, motions2, &ok2);
 
+            for (size_t i = 0; i < motions.size(); ++i)
+            {
+                motions_.push_back(motions[i]);
                 if (doWobbleSuppression_)
-                {
-                    Mat M = wobbleSuppressor_->motionEstimator()->estimate(prevFrame, frame, &ok2);
-                    if (ok2)
-                        motions2_.push_back(M);
-                    else
-                        motions2_.push_back(motions_.back());
-                }
+                    motions2_.push_back(ok2[i] ? motions2[i] : motions[i]);
 
-                if (ok)
+                if (ok[i])
                 {
-                    if (ok2) log_->print(".");
+                    if (!doWobbleSuppression_ || ok2[i]) log_->print(".");
                     else log_->print("?");
                 }
                 else log_->print("x");
             }
-            else
-            {
-                frameSize_ = frame.size();
-                frameMask_.create(frameSize_, CV_8U);
-                frameMask_.setTo(255);
-            }
 
-            prevFrame = frame;
-            frameCount_++;
+            prevFrame = frames.back();
         }
 
         clock_t elapsedTime = clock() - startTime;
@@ -475,6 +753,14 @@ void TwoPassStabilizer::setUp(const Mat &firstFrame)
     for (int i = -radius_; i <= 0; ++i)
         at(i, frames_) = firstFrame;
 
+    if (streamingMode_)
+    {
+        frameSize_ = firstFrame.size();
+        frameMask_.create(frameSize_, CV_8U);
+        frameMask_.setTo(255);
+        stabilizationMotions_.resize(cacheSize);
+    }
+
     WobbleSuppressorBase *wobble = wobbleSuppressor_.get();
     doWobbleSuppression_ = dynamic_cast<NullWobbleSuppressor*>(wobble) == 0;
     if (doWobbleSuppression_)
@@ -491,13 +777,37 @@ void TwoPassStabilizer::setUp(const Mat &firstFrame)
 
 Mat TwoPassStabilizer::estimateMotion()
 {
-    return motions_[curPos_ - 1].clone();
+    return at(curPos_ - 1, motions_).clone();
 }
 
 
 Mat TwoPassStabilizer::estimateStabilizationMotion()
 {
-    return stabilizationMotions_[curStabilizedPos_].clone();
+    if (!streamingMode_)
+        return stabilizationMotions_[curStabilizedPos_].clone();
+
+    // stabilize the sliding window around the current frame
+    int idx = curStabilizedPos_;
+    int lookAhead = std::max(lookAhead_, radius_);
+    Range range(std::max(idx - lookAhead, 0), std::min(idx + lookAhead, frameCount_ - 1));
+
+    MotionFilterBase *motionFilter = dynamic_cast<MotionFilterBase*>(motionStabilizer_.get());
+    if (motionFilter)
+        return motionFilter->stabilize(idx, motions_, range);
+
+    int size = range.end - range.start + 1;
+    if (size == 1)
+        return Mat::eye(3, 3, CV_32F);
+
+    std::vector<Mat> motions(size - 1 + radius_);
+    for (int i = 0; i < size - 1; ++i)
+        motions[i] = at(range.start + i, motions_);
+    for (int i = size - 1; i < (int)motions.size(); ++i)
+        motions[i] = Mat::eye(3, 3, CV_32F);
+
+    std::vector<Mat> stabilizationMotions(size);
+    motionStabilizer_->stabilize(size, motions, Range(0, size - 1), &stabilizationMotions[0]);
+    return stabilizationMotions[idx - range.start];
 }
 
 
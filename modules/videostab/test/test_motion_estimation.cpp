@@ -172,4 +172,64 @@ TEST(Regression, MM_AFFINE)
     EXPECT_LT(testUtil::performTest(cv::videostab::MM_AFFINE, 6), 9.f);
 }
 
+TEST(Regression, RANSAC_threads_consistency)
+{
+    cv::RNG rng(1);
+    cv::Mat points0(200, 1, CV_32FC2), points1(200, 1, CV_32FC2);
+    rng.fill(points0, cv::RNG::UNIFORM, 0.f, testUtil::pointsMaxX);
+    cv::add(points0, cv::Scalar(10.f, -5.f), points1);
+    // a third of the correspondences are outliers
+    cv::Mat outliers = points1.rowRange(0, 70);
+    rng.fill(outliers, cv::RNG::UNIFORM, 0.f, testUtil::pointsMaxX);
+
+    const cv::videostab::RansacParams params(3, 1.f, 0.5f, 0.99f);
+    const int nThreads = cv::getNumThreads();
+    cv::Mat M[2];
+    int ninliers[2] = {0, 0};
+    for (int i = 0; i < 2; ++i)
+    {
+        cv::setNumThreads(i == 0 ? 1 : nThreads);
+        M[i] = cv::videostab::estimateGlobalMotionRansac(
+                points0, points1, cv::videostab::MM_AFFINE, params, 0, &ninliers[i]);
+    }
+    cv::setNumThreads(nThreads);
+
+    EXPECT_EQ(ninliers[0], ninliers[1]);
+    EXPECT_GE(ninliers[0], 130);
+    EXPECT_EQ(0, cvtest::norm(M[0], M[1], cv::NORM_INF));
+    EXPECT_NEAR(10.f, M[0].at<float>(0,2), 1e-2);
+    EXPECT_NEAR(-5.f, M[0].at<float>(1,2), 1e-2);
+}
+
+TEST(Regression, KeypointBased_estimateSequence)
+{
+    cv::RNG rng(2);
+    cv::Mat texture(360, 480, CV_8U);
+    rng.fill(texture, cv::RNG::UNIFORM, 0, 256);
+    cv::GaussianBlur(texture, texture, cv::Size(7, 7), 2.0);
+
+    // the scene moves by (2, 1) pixels per frame
+    std::vector<cv::Mat> frames(12);
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        cv::Mat shift = (cv::Mat_<double>(2, 3) << 1, 0, 2.0 * i, 0, 1, 1.0 * i);
+        cv::warpAffine(texture, frames[i], shift, texture.size(), cv::INTER_LINEAR, cv::BORDER_REFLECT);
+    }
+
+    cv::videostab::KeypointBasedMotionEstimator estimator(
+            cv::makePtr<cv::videostab::MotionEstimatorRansacL2>(cv::videostab::MM_TRANSLATION));
+    std::vector<cv::Mat> motions;
+    std::vector<uchar> ok;
+    estimator.estimateSequence(frames, motions, &ok);
+
+    ASSERT_EQ(frames.size() - 1, motions.size());
+    ASSERT_EQ(motions.size(), ok.size());
+    for (size_t i = 0; i < motions.size(); ++i)
+    {
+        EXPECT_TRUE(ok[i]);
+        EXPECT_NEAR(2.f, motions[i].at<float>(0,2), 0.3f) << i;
+        EXPECT_NEAR(1.f, motions[i].at<float>(1,2), 0.3f) << i;
+    }
+}
+
 }} // namespace
@@ -79,4 +79,374 @@ TEST(TwoPassStabilizer, oneFrame)
     EXPECT_TRUE(stabilizer.nextFrame().empty());
 }
 
+TEST(TwoPassStabilizer, oneFrame_streaming)
+{
+    Mat frame(2, 3, CV_8UC3);
+    randu(frame, Scalar::all(0), Scalar::all(255));
+
+    TwoPassStabilizer stabilizer;
+    stabilizer.setRadius(10);
+    stabilizer.setStreamingMode(true);
+    stabilizer.setFrameSource(makePtr<OneFrameTestSource>(frame));
+
+    Mat stabilizedFrame = stabilizer.nextFrame();
+    EXPECT_MAT_NEAR(frame, stabilizedFrame, 0);
+    EXPECT_TRUE(stabilizer.nextFrame().empty());
+}
+
+// frames share a texture and carry their index in the first pixel
+class IndexedTestSource : public IFrameSource
+{
+public:
+    IndexedTestSource(const Mat &texture, int count) : texture_(texture), count_(count), idx_(0) {}
+
+    virtual void reset() CV_OVERRIDE { idx_ = 0; }
+
+    virtual Mat nextFrame() CV_OVERRIDE
+    {
+        if (idx_ >= count_)
+            return Mat();
+        Mat frame = texture_.clone();
+        frame.at<uchar>(0, 0) = (uchar)idx_++;
+        return frame;
+    }
+
+private:
+    Mat texture_;
+    int count_;
+    int idx_;
+};
+
+// deterministic jittering motion derived from the frame indices
+class IndexedMotionEstimator : public ImageMotionEstimatorBase
+{
+public:
+    IndexedMotionEstimator() : ImageMotionEstimatorBase(MM_TRANSLATION) {}
+
+    virtual Mat estimate(const Mat &frame0, const Mat &frame1, bool *ok = 0) CV_OVERRIDE
+    {
+        if (ok)
+            *ok = true;
+        Mat_<float> M = Mat::eye(3, 3, CV_32F);
+        int i = frame1.at<uchar>(0, 0);
+        CV_Assert(i == frame0.at<uchar>(0, 0) + 1);
+        M(0, 2) = 3.f * std::sin(0.7f * i);
+        M(1, 2) = 2.f * std::cos(1.3f * i);
+        return Mat(M);
+    }
+};
+
+TEST(TwoPassStabilizer, streaming_matches_two_pass)
+{
+    Mat texture(48, 64, CV_8UC1);
+    randu(texture, Scalar::all(0), Scalar::all(255));
+    const int frameCount = 40;
+
+    std::vector<Mat> results[2];
+    for (int streaming = 0; streaming < 2; ++streaming)
+    {
+        TwoPassStabilizer stabilizer;
+        stabilizer.setLog(makePtr<NullLog>());
+        stabilizer.setRadius(4);
+        stabilizer.setFrameSource(makePtr<IndexedTestSource>(texture, frameCount));
+        stabilizer.setMotionEstimator(makePtr<IndexedMotionEstimator>());
+        stabilizer.setMotionStabilizer(makePtr<GaussianMotionFilter>(6));
+        stabilizer.setStreamingMode(streaming != 0);
+        stabilizer.setLookAhead(8);
+
+        Mat frame;
+        while (!(frame = stabilizer.nextFrame()).empty())
+            results[streaming].push_back(frame.clone());
+    }
+
+    ASSERT_EQ(frameCount, (int)results[0].size());
+    ASSERT_EQ(results[0].size(), results[1].size());
+    for (size_t i = 0; i < results[0].size(); ++i)
+        EXPECT_MAT_NEAR(results[0][i], results[1][i], 0);
+}
+
+TEST(ColorAverageInpainter, tiled_threads_consistency)
+{
+    Mat frame0(150, 200, CV_8UC3);
+    randu(frame0, Scalar::all(0), Scalar::all(255));
+
+    // only a small patch is known, so most of the tiles are marched in later rounds
+    Mat mask0(frame0.size(), CV_8U, Scalar::all(0));
+    mask0(Rect(90, 60, 20, 20)).setTo(255);
+
+    const int nThreads = getNumThreads();
+    Mat frames[2], masks[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        setNumThreads(i == 0 ? 1 : nThreads);
+        frames[i] = frame0.clone();
+        masks[i] = mask0.clone();
+        ColorAverageInpainter inpainter;
+        inpainter.inpaint(0, frames[i], masks[i]);
+    }
+    setNumThreads(nThreads);
+
+    EXPECT_EQ((int)mask0.total(), countNonZero(masks[0]));
+    EXPECT_MAT_NEAR(frames[0](Rect(90, 60, 20, 20)), frame0(Rect(90, 60, 20, 20)), 0);
+    EXPECT_MAT_NEAR(frames[0], frames[1], 0);
+    EXPECT_MAT_NEAR(masks[0], masks[1], 0);
+}
+
+// Translated copies of a texture, the motion between two frames is a translation by (1,-1).
+static void makeTranslatedFrames(int count, std::vector<Mat> &frames, std::vector<Mat> &motions,
+                                 std::vector<Mat> &stabilizationMotions)
+{
+    Mat texture(60, 83, CV_8UC3);
+    randu(texture, Scalar::all(0), Scalar::all(255));
+    GaussianBlur(texture, texture, Size(3, 3), 1);
+
+    frames.resize(count);
+    motions.resize(count);
+    stabilizationMotions.resize(count);
+    for (int i = 0; i < count; ++i)
+    {
+        Mat shift = (Mat_<float>(2, 3) << 1, 0, i, 0, 1, -i);
+        warpAffine(texture, frames[i], shift, texture.size(), INTER_NEAREST, BORDER_REPLICATE);
+
+        Mat_<float> M = Mat::eye(3, 3, CV_32F);
+        M(0, 2) = 1.f;
+        M(1, 2) = -1.f;
+        motions[i] = M;
+        stabilizationMotions[i] = Mat::eye(3, 3, CV_32F);
+    }
+}
+
+TEST(ConsistentMosaicInpainter, threads_consistency)
+{
+    std::vector<Mat> frames, motions, stabilizationMotions;
+    makeTranslatedFrames(5, frames, motions, stabilizationMotions);
+
+    Mat mask0(frames[2].size(), CV_8U, Scalar::all(255));
+    mask0(Rect(30, 20, 25, 15)).setTo(0);
+
+    const int nThreads = getNumThreads();
+    Mat results[2], masks[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        setNumThreads(i == 0 ? 1 : nThreads);
+        ConsistentMosaicInpainter inpainter;
+        inpainter.setRadius(2);
+        inpainter.setFrames(frames);
+        inpainter.setMotions(motions);
+        inpainter.setStabilizationMotions(stabilizationMotions);
+        results[i] = frames[2].clone();
+        results[i].setTo(Scalar::all(0), ~mask0);
+        masks[i] = mask0.clone();
+        inpainter.inpaint(2, results[i], masks[i]);
+    }
+    setNumThreads(nThreads);
+
+    EXPECT_GT(countNonZero(masks[0]), countNonZero(mask0));
+    EXPECT_MAT_NEAR(results[0], results[1], 0);
+    EXPECT_MAT_NEAR(masks[0], masks[1], 0);
+}
+
+#ifdef HAVE_OPENCV_CUDAOPTFLOW
+TEST(MotionInpainter, threads_consistency)
+{
+    if (cuda::getCudaEnabledDeviceCount() == 0)
+        throw SkipTestException("CUDA device is not available");
+
+    std::vector<Mat> frames, motions, stabilizationMotions;
+    makeTranslatedFrames(7, frames, motions, stabilizationMotions);
+
+    Mat mask0(frames[3].size(), CV_8U, Scalar::all(255));
+    mask0(Rect(30, 20, 25, 15)).setTo(0);
+
+    // the second inpainter first inpaints the previous frame, as it does in the sliding window
+    // of a stabilizer, so its buffers hold the warps of another target
+    const int nThreads = getNumThreads();
+    Mat results[2], masks[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        setNumThreads(i == 0 ? 1 : nThreads);
+        MotionInpainter inpainter;
+        inpainter.setRadius(2);
+        inpainter.setFrames(frames);
+        inpainter.setMotions(motions);
+        inpainter.setStabilizationMotions(stabilizationMotions);
+        if (i == 1)
+        {
+            Mat frame = frames[2].clone(), mask = mask0.clone();
+            inpainter.inpaint(2, frame, mask);
+        }
+        results[i] = frames[3].clone();
+        results[i].setTo(Scalar::all(0), ~mask0);
+        masks[i] = mask0.clone();
+        inpainter.inpaint(3, results[i], masks[i]);
+    }
+    setNumThreads(nThreads);
+
+    EXPECT_GT(countNonZero(masks[0]), countNonZero(mask0));
+    EXPECT_MAT_NEAR(results[0], results[1], 0);
+    EXPECT_MAT_NEAR(masks[0], masks[1], 0);
+}
+#endif
+
+TEST(WeightingDeblurer, calcBlurriness_stripes)
+{
+    Mat frame(100, 90, CV_8UC3);
+    randu(frame, Scalar::all(0), Scalar::all(255));
+    GaussianBlur(frame, frame, Size(5, 5), 1.5);
+
+    Mat Gx, Gy;
+    Sobel(frame, Gx, CV_32F, 1, 0);
+    Sobel(frame, Gy, CV_32F, 0, 1);
+    double sumSq = norm(Gx, NORM_L2SQR) + norm(Gy, NORM_L2SQR);
+    float expected = static_cast<float>(1. / (sumSq / frame.size().area() + 1e-6));
+
+    EXPECT_NEAR(expected, calcBlurriness(frame), 1e-5 * expected);
+}
+
+// the per-pixel WeightingDeblurer::deblur before the row-parallel rewrite
+static void deblurReference(int idx, Mat &frame, const Range &range, int radius, float sensitivity,
+                            const std::vector<Mat> &frames, const std::vector<Mat> &motions,
+                            const std::vector<float> &blurrinessRates)
+{
+    Mat_<float> bSum(frame.size()), gSum(frame.size()), rSum(frame.size()), wSum(frame.size());
+
+    for (int y = 0; y < frame.rows; ++y)
+    {
+        for (int x = 0; x < frame.cols; ++x)
+        {
+            Point3_<uchar> p = frame.at<Point3_<uchar> >(y,x);
+            bSum(y,x) = p.x;
+            gSum(y,x) = p.y;
+            rSum(y,x) = p.z;
+            wSum(y,x) = 1.f;
+        }
+    }
+
+    int iMin = std::max(idx - radius, range.start);
+    int iMax = std::min(idx + radius, range.end);
+    for (int k = iMin; k <= iMax; ++k)
+    {
+        const Mat &neighbor = at(k, frames);
+        float bRatio = at(idx, blurrinessRates) / at(k, blurrinessRates);
+        Mat_<float> M = getMotion(idx, k, motions);
+
+        if (bRatio > 1.f)
+        {
+            for (int y = 0; y < frame.rows; ++y)
+            {
+                for (int x = 0; x < frame.cols; ++x)
+                {
+                    int x1 = cvRound(M(0,0)*x + M(0,1)*y + M(0,2));
+                    int y1 = cvRound(M(1,0)*x + M(1,1)*y + M(1,2));
+
+                    if (x1 >= 0 && x1 < neighbor.cols && y1 >= 0 && y1 < neighbor.rows)
+                    {
+                        const Point3_<uchar> &p = frame.at<Point3_<uchar> >(y,x);
+                        const Point3_<uchar> &p1 = neighbor.at<Point3_<uchar> >(y1,x1);
+                        float i0 = 0.3f*p.x + 0.59f*p.y + 0.11f*p.z;
+                        float i1 = 0.3f*p1.x + 0.59f*p1.y + 0.11f*p1.z;
+                        float w = bRatio * sensitivity / (sensitivity + std::abs(i1 - i0));
+                        bSum(y,x) += w * p1.x;
+                        gSum(y,x) += w * p1.y;
+                        rSum(y,x) += w * p1.z;
+                        wSum(y,x) += w;
+                    }
+                }
+            }
+        }
+    }
+
+    for (int y = 0; y < frame.rows; ++y)
+    {
+        for (int x = 0; x < frame.cols; ++x)
+        {
+            float wSumInv = 1.f / wSum(y,x);
+            frame.at<Point3_<uchar> >(y,x) = Point3_<uchar>(
+                    static_cast<uchar>(bSum(y,x)*wSumInv),
+                    static_cast<uchar>(gSum(y,x)*wSumInv),
+                    static_cast<uchar>(rSum(y,x)*wSumInv));
+        }
+    }
+}
+
+// every other frame is blurred
+static void makeBlurredFrames(int count, std::vector<Mat> &frames, std::vector<Mat> &motions,
+                              std::vector<float> &blurrinessRates)
+{
+    std::vector<Mat> stabilizationMotions;
+    makeTranslatedFrames(count, frames, motions, stabilizationMotions);
+
+    blurrinessRates.resize(count);
+    for (int i = 0; i < count; ++i)
+    {
+        if (i % 2)
+            GaussianBlur(frames[i], frames[i], Size(5, 5), 1.5);
+        blurrinessRates[i] = calcBlurriness(frames[i]);
+    }
+}
+
+TEST(WeightingDeblurer, threads_consistency)
+{
+    const int radius = 2;
+    std::vector<Mat> frames, motions;
+    std::vector<float> blurrinessRates;
+    makeBlurredFrames(2*radius + 1, frames, motions, blurrinessRates);
+
+    const int nThreads = getNumThreads();
+    Mat results[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        setNumThreads(i == 0 ? 1 : nThreads);
+        WeightingDeblurer deblurer;
+        deblurer.setRadius(radius);
+        deblurer.setFrames(frames);
+        deblurer.setMotions(motions);
+        deblurer.setBlurrinessRates(blurrinessRates);
+        results[i] = frames[1].clone();
+        deblurer.deblur(1, results[i], Range(0, (int)frames.size() - 1));
+    }
+    setNumThreads(nThreads);
+
+    EXPECT_GT(cvtest::norm(results[0], frames[1], NORM_INF), 0);
+    EXPECT_MAT_NEAR(results[0], results[1], 0);
+}
+
+TEST(WeightingDeblurer, reference_accuracy)
+{
+    const int radius = 2;
+    std::vector<Mat> frames, motions;
+    std::vector<float> blurrinessRates;
+    makeBlurredFrames(7, frames, motions, blurrinessRates);
+
+    // a small rotation and scaling on top of the translation, so that the warp rounds
+    // differently along the rows and some neighbor pixels fall outside of the frame
+    for (size_t i = 0; i < motions.size(); ++i)
+    {
+        Mat R = getRotationMatrix2D(Point2f(40.f, 30.f), 2.0 + i, 1.02);
+        Mat M = Mat::eye(3, 3, CV_32F);
+        R.convertTo(R, CV_32F);
+        R.copyTo(M.rowRange(0, 2));
+        motions[i] = motions[i] * M;
+    }
+
+    WeightingDeblurer deblurer;
+    deblurer.setRadius(radius);
+    deblurer.setSensitivity(0.2f);
+    deblurer.setFrames(frames);
+    deblurer.setMotions(motions);
+    deblurer.setBlurrinessRates(blurrinessRates);
+
+    for (int idx = 0; idx < (int)frames.size(); ++idx)
+    {
+        const Range range(0, (int)frames.size() - 1);
+        Mat result = frames[idx].clone(), expected = frames[idx].clone();
+        deblurer.deblur(idx, result, range);
+        deblurReference(idx, expected, range, radius, 0.2f, frames, motions, blurrinessRates);
+
+        EXPECT_MAT_NEAR(expected, result, 0) << "idx=" << idx;
+        if (idx % 2)
+            EXPECT_GT(cvtest::norm(result, frames[idx], NORM_INF), 0) << "idx=" << idx;
+    }
+}
+
 }} // namespace
@@ -65,6 +65,13 @@ public:
         CV_PROP_RW double LineFitErrorThreshold;
         //! Default value is 1.3
         CV_PROP_RW double MaxErrorThreshold;
+        /** @brief side length of the tiles used for anchor linking. Default value is 0 (disabled).
+
+        When set, anchors are linked independently inside square tiles of this size which are processed in parallel,
+        and segments that cross tile borders are stitched afterwards. This mainly pays off for very large images.
+        The resulting segments can differ slightly from the untiled ones. Values below 32 are treated as 32.
+        */
+        CV_PROP_RW int TileSize;
 
         CV_WRAP void read(const FileNode& fn);
         CV_WRAP void write(FileStorage& fs) const;
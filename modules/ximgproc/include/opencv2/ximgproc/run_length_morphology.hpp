@@ -78,6 +78,22 @@ CV_EXPORTS cv::Mat getStructuringElement(int shape, Size ksize);
 */
 CV_EXPORTS void paint(InputOutputArray image, InputArray rlSrc, const cv::Scalar& value);
 
+/**
+* @brief   Paint a window of a run length encoded binary image into an image.
+*
+* This allows to paint a large run length encoded image directly into a (ROI) window of it, without
+* creating an intermediate image. When the runs are sorted by row, as the other functions of this
+* module produce them, only the runs in the rows of image are painted; checking the order still reads
+* every run once.
+*
+* @param   image       image to paint into (currently only single channel images).
+* @param   rlSrc       run length encoded image
+* @param   value      all foreground pixel of the binary image are set to this value
+* @param   offset      position of the top-left pixel of image in the coordinates of the runs.
+*
+*/
+CV_EXPORTS void paint(InputOutputArray image, InputArray rlSrc, const cv::Scalar& value, Point offset);
+
 /**
 * @brief   Check whether a custom made structuring element can be used with run length morphological operations.
 *          (It must consist of a continuous array of single runs per row)
@@ -96,6 +112,27 @@ CV_EXPORTS bool isRLMorphologyPossible(InputArray rlStructuringElement);
 */
 CV_EXPORTS void createRLEImage(const std::vector<cv::Point3i>& runs, OutputArray res, Size size = Size(0, 0));
 
+/**
+* @brief   Computes the connected components of a run-length encoded binary image and their statistics.
+*
+*
+* @param   rlSrc       input image (the runs must be sorted and must not overlap, as created by the functions
+*                      of this module)
+* @param   labels      label of every run of rlSrc (CV_32SC1, one row per run). The labels are numbered from 1
+*                      in the order of the first run of each component, 0 is reserved for the background.
+* @param   stats       statistics of every label, including the background label, in the same format as
+*                      cv::connectedComponentsWithStats (CV_32SC1, columns indexed by cv::ConnectedComponentsTypes)
+* @param   centroids   centroid (x, y) of every label (CV_64FC1)
+* @param   connectivity 8 or 4 for 8-way or 4-way connectivity respectively
+*
+* @return  the number of labels, including the background label
+*
+* The statistics of the background label cover the pixels of the image size stored in rlSrc that are not part
+* of any run.
+*/
+CV_EXPORTS int connectedComponentsWithStats(InputArray rlSrc, OutputArray labels, OutputArray stats,
+    OutputArray centroids, int connectivity = 8);
+
 /**
 * @brief   Applies a morphological operation to a run-length encoded binary image.
 *
@@ -138,6 +138,21 @@ public:
      */
     CV_WRAP virtual void getLabelContourMask(OutputArray image, bool thick_line = false) = 0;
 
+    /** @brief Enables or disables the video (warm start) mode.
+
+    @param warm_start If true, every call of iterate() after the first one starts from the labels
+    of the previous call instead of the initial grid. The block level updates are skipped and only
+    the num_iterations pixel level updates are run on the new image.
+
+    This mode is intended for video sequences, where consecutive frames are similar and the
+    superpixels only have to follow the motion of the scene. It is considerably faster than a full
+    iteration, but large motions take several frames to be followed. Disabling it makes the next
+    call of iterate() start again from the initial grid.
+     */
+    CV_WRAP virtual void setWarmStart(bool warm_start) = 0;
+    /** @see setWarmStart */
+    CV_WRAP virtual bool getWarmStart() const = 0;
+
     virtual ~SuperpixelSEEDS() {}
 };
 
@@ -59,6 +59,16 @@ namespace cv {
 
                             CV_WRAP virtual void setMinSize(int min_size) = 0;
                             CV_WRAP virtual int getMinSize() = 0;
+
+                            /** @brief Limit the number of graph edges held in memory at once
+                                @param max_edges When the image has more edges than this, the edges are generated and
+                                sorted range of weights by range instead of all at once, which gives the same result with
+                                less memory at the cost of computing the edge weights several times. A range never splits
+                                edges sharing the upper 16 bits of their weight, so the bound is approximate. 0 (default)
+                                keeps all edges in memory.
+                            */
+                            CV_WRAP virtual void setMaxEdgesInMemory(int max_edges) = 0;
+                            CV_WRAP virtual int getMaxEdgesInMemory() = 0;
                     };
 
                     /** @brief Creates a graph based segmentor
@@ -235,6 +245,9 @@ namespace cv {
 
                             /** @brief Based on all images, graph segmentations and stragies, computes all possible rects and return them
                                 @param rects The list of rects. The first ones are more relevents than the lasts ones.
+                                @note The combinations of images and graph segmentations are processed in parallel. Strategies keep
+                                per-image state, so the hierarchical grouping only runs in parallel when the strategies were set up
+                                by one of the switchTo* functions, each run then using its own instances of them.
                             */
                             CV_WRAP virtual void process(CV_OUT std::vector<Rect>& rects) = 0;
                     };
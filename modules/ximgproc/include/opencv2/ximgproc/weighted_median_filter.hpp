@@ -76,7 +76,8 @@ enum WMFWeightType
 *
 * For more details about this implementation, please see @cite zhang2014100+
 *
-* @param   joint       Joint 8-bit, 1-channel or 3-channel image.
+* @param   joint       Joint 8-bit, 1-channel or 3-channel image, or floating-point 1-channel image. Floating-point
+*                           guides are adaptively quantized like floating-point sources, and sigma is then given in guide units.
 * @param   src         Source 8-bit or floating-point, 1-channel or 3-channel image.
 * @param   dst         Destination image.
 * @param   r           Radius of filtering kernel, should be a positive integer.
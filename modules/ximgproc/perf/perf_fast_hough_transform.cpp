@@ -78,4 +78,35 @@ PERF_TEST_P(srcSize_srcType_dstDepth, FastHoughTransform,
 
 #undef ALL_MAT_DEPHTS
 
+CV_ENUM(FhtAngleRange, ARO_315_135, ARO_CTR_HOR, ARO_CTR_VER)
+CV_ENUM(FhtOperation, FHT_ADD, FHT_MAX, FHT_AVE)
+
+typedef tuple<Size, FhtAngleRange, FhtOperation> srcSize_angleRange_op_t;
+typedef perf::TestBaseWithParam<srcSize_angleRange_op_t> srcSize_angleRange_op;
+
+PERF_TEST_P(srcSize_angleRange_op, FastHoughTransform_document,
+            testing::Combine(
+                testing::Values(Size(1240, 1754), Size(2480, 3508)),
+                FhtAngleRange::all(),
+                FhtOperation::all()
+                )
+            )
+{
+    Size srcSize   = get<0>(GetParam());
+    int angleRange = get<1>(GetParam());
+    int operation  = get<2>(GetParam());
+
+    Mat src(srcSize, CV_8UC1);
+    Mat fht;
+
+    declare.in(src, WARMUP_RNG);
+
+    TEST_CYCLE_N(3)
+    {
+        FastHoughTransform(src, fht, CV_32S, angleRange, operation, HDO_DESKEW);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
 }} // namespace
@@ -13,8 +13,6 @@
 
 using namespace cv;
 
-#ifdef HAVE_EIGEN
-
 #define MARK_RADIUS 5
 #define PALLET_RADIUS 100
 int max_width = 1280;
@@ -50,9 +48,6 @@ double angle(Point pt1, Point pt2);
 int inCircle(Point p, Point c, int r);
 void createPlate(Mat &im1, int radius);
 
-
-#endif
-
 const String keys =
     "{help h usage ?     |                | print this message                                                }"
     "{@image             |                | input image                                                       }"
@@ -77,8 +72,6 @@ int main(int argc, char* argv[])
         return 0;
     }
 
-#ifdef HAVE_EIGEN
-
     String img = parser.get<String>(0);
     double sigma_spatial  = parser.get<double>("sigma_spatial");
     double sigma_luma  = parser.get<double>("sigma_luma");
@@ -240,17 +233,10 @@ int main(int argc, char* argv[])
 
     cv::waitKey(0);
 
-
-
-#else
-    std::cout << "Can not find eigen, please build with eigen by set WITH_EIGEN=ON" << '\n';
-#endif
-
     return 0;
 }
 
 
-#ifdef HAVE_EIGEN
 static void mouseCallback(int event, int x, int y, int, void*)
 {
     switch (event)
@@ -412,6 +398,3 @@ void createPlate(Mat &im1, int radius)
 
 	cvtColor(hsvImag, im1, COLOR_HSV2BGR);
 }
-
-
-#endif
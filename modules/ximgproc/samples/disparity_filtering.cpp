@@ -292,7 +292,6 @@ int main(int argc, char** argv)
             ROI = Rect(ROI.x*2,ROI.y*2,ROI.width*2,ROI.height*2);
         }
 
-#ifdef HAVE_EIGEN
         //! [filtering_fbs]
         solving_time = (double)getTickCount();
         fastBilateralSolverFilter(left, left_disp_resized, conf_map/255.0f, solved_disp, fbs_spatial, fbs_luma, fbs_chroma, fbs_lambda);
@@ -302,12 +301,6 @@ int main(int argc, char** argv)
         //! [filtering_wls2fbs]
         fastBilateralSolverFilter(left, filtered_disp, conf_map/255.0f, solved_filtered_disp, fbs_spatial, fbs_luma, fbs_chroma, fbs_lambda);
         //! [filtering_wls2fbs]
-#else
-        (void)fbs_spatial;
-        (void)fbs_luma;
-        (void)fbs_chroma;
-        (void)fbs_lambda;
-#endif
     }
     else if(filter=="wls_no_conf")
     {
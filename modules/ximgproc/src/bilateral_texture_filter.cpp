@@ -39,319 +39,525 @@
 
 #include "precomp.hpp"
 #include <opencv2/ximgproc.hpp>
+#include "opencv2/core/hal/hal.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+#include <functional>
 #include <vector>
 
 namespace cv
 {
 namespace ximgproc
 {
-  void compute_mRTV(const Mat& L, Mat& mRTV, int fr);
-  void compute_G(const Mat& B, const Mat& mRTV, Mat& G, Mat& alpha, int fr);
-  void joint_bilateral_filter(const Mat& img, const Mat& G, Mat& r_img, int fr2, double sigma_avg);
-  void joint_bilateral_filter3(const Mat& img, const Mat& G, Mat& r_img, int fr2, double sigma_avg);
-
-  void bilateralTextureFilter(InputArray src_, OutputArray dst_, int fr,
-                              int numIter, double sigmaAlpha, double sigmaAvg)
+namespace
+{
+  // Float image stored as separate planes padded by BORDER_REFLECT. All intermediates of an
+  // iteration live in such buffers, which are allocated once for the whole filter.
+  class BTFPlanes
   {
-    CV_Assert(!src_.empty());
+  public:
+    void create(Size sz, int cn_, int pad_)
+    {
+      cn = cn_;
+      pad = pad_;
+      size = sz;
+      buf.create(cn * (sz.height + 2 * pad), sz.width + 2 * pad, CV_32F);
+      colTab.resize(2 * pad);
+      rowTab.resize(2 * pad);
+      for (int i = 0; i < pad; i++)
+      {
+        colTab[i] = borderInterpolate(i - pad, sz.width, BORDER_REFLECT);
+        colTab[pad + i] = borderInterpolate(sz.width + i, sz.width, BORDER_REFLECT);
+        rowTab[i] = borderInterpolate(i - pad, sz.height, BORDER_REFLECT);
+        rowTab[pad + i] = borderInterpolate(sz.height + i, sz.height, BORDER_REFLECT);
+      }
+    }
 
-    Mat src = src_.getMat();
-    CV_Assert(src.depth() == CV_8U || src.depth() == CV_32F);
+    float* ptr(int c, int y) { return buf.ptr<float>(c * (size.height + 2 * pad) + y + pad) + pad; }
+    const float* ptr(int c, int y) const { return buf.ptr<float>(c * (size.height + 2 * pad) + y + pad) + pad; }
 
-    CV_Assert(fr > 0 && numIter > 0);
+    void fillBorder()
+    {
+      size_t rowSize = buf.cols * sizeof(float);
+      for (int c = 0; c < cn; c++)
+      {
+        for (int y = 0; y < size.height; y++)
+        {
+          float* row = ptr(c, y);
+          for (int x = 0; x < pad; x++)
+          {
+            row[x - pad] = row[colTab[x]];
+            row[size.width + x] = row[colTab[pad + x]];
+          }
+        }
+        for (int y = 0; y < pad; y++)
+        {
+          memcpy(ptr(c, y - pad) - pad, ptr(c, rowTab[y]) - pad, rowSize);
+          memcpy(ptr(c, size.height + y) - pad, ptr(c, rowTab[pad + y]) - pad, rowSize);
+        }
+      }
+    }
 
-    if (sigmaAlpha < 0)
-      sigmaAlpha = 5. * fr;
-    if (sigmaAvg < 0)
-      sigmaAvg = 0.05 * sqrt(static_cast<float>(src.channels()));
+    Mat buf;
+    Size size;
+    int cn, pad;
+    std::vector<int> colTab, rowTab;
+  };
 
-    Mat I;
-    src.copyTo(I);
-    if (src.type() == CV_8UC1) {
-      I.convertTo(I, CV_32FC1, 1.0 / 255.0);
+  // column-wise max/min/sum over nrows rows of n elements, colMin may be NULL
+  void columnStats(const float* const* rows, int nrows, int n, float* colMax, float* colMin, float* colSum)
+  {
+    int x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int VECSZ = VTraits<v_float32>::vlanes();
+    for (; x <= n - VECSZ; x += VECSZ)
+    {
+      v_float32 vMax = vx_load(rows[0] + x), vMin = vMax, vSum = vMax;
+      for (int r = 1; r < nrows; r++)
+      {
+        v_float32 v = vx_load(rows[r] + x);
+        vMax = v_max(vMax, v);
+        vMin = v_min(vMin, v);
+        vSum = v_add(vSum, v);
+      }
+      v_store(colMax + x, vMax);
+      if (colMin)
+        v_store(colMin + x, vMin);
+      v_store(colSum + x, vSum);
     }
-    else if (src.type() == CV_8UC3) {
-      I.convertTo(I, CV_32FC3, 1.0 / 255.0);
+#endif
+    for (; x < n; x++)
+    {
+      float vMax = rows[0][x], vMin = vMax, vSum = vMax;
+      for (int r = 1; r < nrows; r++)
+      {
+        float v = rows[r][x];
+        vMax = std::max(vMax, v);
+        vMin = std::min(vMin, v);
+        vSum += v;
+      }
+      colMax[x] = vMax;
+      if (colMin)
+        colMin[x] = vMin;
+      colSum[x] = vSum;
     }
+  }
 
-    for (int iter = 0; iter < numIter; iter++)
+  // the same reduction along a row: window of ksize elements starting at every x < width
+  void windowStats(const float* colMax, const float* colMin, const float* colSum, int width, int ksize,
+                   float* wMax, float* wMin, float* wSum)
+  {
+    int x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int VECSZ = VTraits<v_float32>::vlanes();
+    for (; x <= width - VECSZ; x += VECSZ)
     {
-      Mat B;
-      blur(I, B, Size(2 * fr + 1, 2 * fr + 1), Point(-1, -1), BORDER_REFLECT);
-
-      Mat mRTV;
-      compute_mRTV(I, mRTV, fr);
-
-      Mat G, minmRTV;
-      compute_G(B, mRTV, G, minmRTV, fr);
-
-      // alpha blending
-      Mat Gtilde;
-      Mat diff = mRTV - minmRTV;
-      Mat alpha = -diff.mul(sigmaAlpha);
-      exp(alpha, alpha);
-      alpha = alpha + 1.;
-      pow(alpha, -1, alpha);
-      alpha = (alpha - 0.5) * 2;
-      Mat alphainv = -(alpha - 1);
-
-      std::vector<Mat> Gi, Bi;
-      Gi.resize(I.channels());
-      Bi.resize(I.channels());
-      if (I.channels() == 3) {
-        split(G, &Gi[0]);
-        split(B, &Bi[0]);
-      }
-      else {
-        G.copyTo(Gi[0]);
-        B.copyTo(Bi[0]);
+      v_float32 vMax = vx_load(colMax + x), vSum = vx_load(colSum + x);
+      v_float32 vMin = colMin ? vx_load(colMin + x) : vMax;
+      for (int d = 1; d < ksize; d++)
+      {
+        vMax = v_max(vMax, vx_load(colMax + x + d));
+        if (colMin)
+          vMin = v_min(vMin, vx_load(colMin + x + d));
+        vSum = v_add(vSum, vx_load(colSum + x + d));
       }
-
-      std::vector<Mat> Gtildei;
-      Gtildei.resize(I.channels());
-      for (int i = 0; i < B.channels(); i++)
-        Gtildei[i] = Gi[i].mul(alpha) + Bi[i].mul(alphainv);
-      merge(&Gtildei[0], B.channels(), Gtilde);
-
-      // joint bilateral filter
-      cv::Mat J;
-      if (I.channels() == 1)
-        joint_bilateral_filter(I, Gtilde, J, fr * 2, sigmaAvg);
-      else if (I.channels() == 3)
-        joint_bilateral_filter3(I, Gtilde, J, fr * 2, sigmaAvg);
-      I = J;
-    }
-    if (src.type() == CV_8UC1) {
-      I.convertTo(I, CV_8UC1, 255.0);
+      v_store(wMax + x, vMax);
+      if (colMin)
+        v_store(wMin + x, vMin);
+      v_store(wSum + x, vSum);
     }
-    else if (src.type() == CV_8UC3) {
-      I.convertTo(I, CV_8UC3, 255.0);
+#endif
+    for (; x < width; x++)
+    {
+      float vMax = colMax[x], vSum = colSum[x];
+      float vMin = colMin ? colMin[x] : vMax;
+      for (int d = 1; d < ksize; d++)
+      {
+        vMax = std::max(vMax, colMax[x + d]);
+        if (colMin)
+          vMin = std::min(vMin, colMin[x + d]);
+        vSum += colSum[x + d];
+      }
+      wMax[x] = vMax;
+      if (colMin)
+        wMin[x] = vMin;
+      wSum[x] = vSum;
     }
-
-    I.copyTo(dst_);
   }
 
-  void compute_mRTV(const Mat& L, Mat& mRTV, int fr)
+  // gradient magnitude with forward differences, as filter2D() with [-1 1] kernels would give
+  void computeGradient(const BTFPlanes& I, BTFPlanes& grad)
   {
-    mRTV = Mat::zeros(L.size(), CV_32FC1);
+    const int width = I.size.width;
+    parallel_for_(Range(0, I.size.height), [&](const Range& range)
+    {
+      for (int y = range.start; y < range.end; y++)
+      {
+        for (int c = 0; c < I.cn; c++)
+        {
+          const float* L = I.ptr(c, y);
+          const float* Ld = I.ptr(c, y + 1);
+          float* G = grad.ptr(c, y);
+          int x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+          const int VECSZ = VTraits<v_float32>::vlanes();
+          for (; x <= width - VECSZ; x += VECSZ)
+          {
+            v_float32 v = vx_load(L + x);
+            v_float32 gx = v_sub(vx_load(L + x + 1), v), gy = v_sub(vx_load(Ld + x), v);
+            v_store(G + x, v_sqrt(v_add(v_mul(gx, gx), v_mul(gy, gy))));
+          }
+#endif
+          for (; x < width; x++)
+          {
+            float gx = L[x + 1] - L[x], gy = Ld[x] - L[x];
+            G[x] = std::sqrt(gx*gx + gy*gy);
+          }
+        }
+      }
+    });
+    grad.fillBorder();
+  }
 
+  // modified relative total variation and the box-filtered image B, both over (2*fr+1)^2 windows
+  void computeRTV(const BTFPlanes& I, const BTFPlanes& grad, Mat& mRTV, Mat& B, int fr)
+  {
+    const int width = I.size.width, height = I.size.height, cn = I.cn;
+    const int ksize = 2 * fr + 1, n = width + 2 * fr;
     const float eps = 0.00001f;
+    const float invArea = 1.f / (ksize * ksize);
 
-    // Calculate image derivative(gradient)
-    Mat G;
-    Mat Gx, Gy, kernelx, kernely;
-    kernelx = Mat::zeros(1, 3, CV_32F);
-    kernelx.at<float>(0, 1) = -1.0;
-    kernelx.at<float>(0, 2) = 1.0;
-    filter2D(L, Gx, -1, kernelx, Point(-1, -1), 0, BORDER_REFLECT);
-    kernely = Mat::zeros(3, 1, CV_32F);
-    kernely.at<float>(1, 0) = -1.0;
-    kernely.at<float>(2, 0) = 1.0;
-    filter2D(L, Gy, -1, kernely, Point(-1, -1), 0, BORDER_REFLECT);
-
-    Gx = Gx.mul(Gx);
-    Gy = Gy.mul(Gy);
-    sqrt(Gx + Gy, G);
-
-    // Pad image L and G
-    Mat padL;
-    Mat padG;
-    copyMakeBorder(L, padL, fr, fr, fr, fr, BORDER_REFLECT);
-    copyMakeBorder(G, padG, fr, fr, fr, fr, BORDER_REFLECT);
-
-    // Calculate maxL, minL, maxG, sumG
-    int pu = fr;
-    int pb = pu + L.rows;
-    int pl = fr;
-    int pr = pl + L.cols;
-
-    std::vector<Mat> Li, Gi;
-    Li.resize(L.channels());
-    Gi.resize(L.channels());
-    if (L.channels() == 3) {
-      split(padL, &Li[0]);
-      split(padG, &Gi[0]);
-    }
-    else {
-      padL.copyTo(Li[0]);
-      padG.copyTo(Gi[0]);
-    }
-
-    for (int i = 0; i < L.channels(); i++)
+    parallel_for_(Range(0, height), [&](const Range& range)
     {
-      Mat maxL = Mat::zeros(L.size(), CV_32FC1);
-      Mat minL = Mat::ones(L.size(), CV_32FC1);
-      Mat maxG = Mat::zeros(L.size(), CV_32FC1);
-      Mat sumG = Mat::zeros(L.size(), CV_32FC1);
-      for (int y = -fr; y <= fr; y++)
+      AutoBuffer<float> buf(5 * n + 5 * width);
+      float *colMaxL = buf.data(), *colMinL = colMaxL + n, *colSumL = colMinL + n;
+      float *colMaxG = colSumL + n, *colSumG = colMaxG + n;
+      float *maxL = colSumG + n, *minL = maxL + width, *sumL = minL + width;
+      float *maxG = sumL + width, *sumG = maxG + width;
+      AutoBuffer<const float*> rowsL(ksize), rowsG(ksize);
+
+      for (int y = range.start; y < range.end; y++)
       {
-        for (int x = -fr; x <= fr; x++)
+        float* rtv = mRTV.ptr<float>(y);
+        for (int c = 0; c < cn; c++)
+        {
+          for (int d = 0; d < ksize; d++)
+          {
+            rowsL[d] = I.ptr(c, y + d - fr) - fr;
+            rowsG[d] = grad.ptr(c, y + d - fr) - fr;
+          }
+          columnStats(rowsL.data(), ksize, n, colMaxL, colMinL, colSumL);
+          columnStats(rowsG.data(), ksize, n, colMaxG, NULL, colSumG);
+          windowStats(colMaxL, colMinL, colSumL, width, ksize, maxL, minL, sumL);
+          windowStats(colMaxG, NULL, colSumG, width, ksize, maxG, NULL, sumG);
+
+          float* b = B.ptr<float>(c * height + y);
+          for (int x = 0; x < width; x++)
+          {
+            float delta = std::max(maxL[x], 0.f) - std::min(minL[x], 1.f);
+            float v = std::max(maxG[x], 0.f) / std::max(sumG[x], eps) * ksize * delta;
+            rtv[x] = c == 0 ? v : rtv[x] + v;
+            b[x] = sumL[x] * invArea;
+          }
+        }
+        if (cn == 3)
         {
-          Mat temp = Li[i](
-            Range(pu + y, pb + y),
-            Range(pl + x, pr + x)
-          );
-          maxL = max(maxL, temp);
-          minL = min(minL, temp);
-
-          temp = Gi[i](
-            Range(pu + y, pb + y),
-            Range(pl + x, pr + x)
-          );
-          maxG = max(maxG, temp);
-          sumG = sumG + temp;
+          for (int x = 0; x < width; x++)
+            rtv[x] /= 3;
         }
       }
-      Mat deltai = maxL - minL;
-      sumG = max(sumG, eps);
-      Mat mRTVi = maxG / sumG * (2 * fr + 1);
-      mRTV = mRTV + mRTVi.mul(deltai);
-    }
-    if (L.channels() == 3)
-      mRTV = mRTV / 3;
+    });
   }
 
-  void compute_G(const Mat& B, const Mat& mRTV, Mat& G, Mat& alpha, int fr)
+  /* Picks for every pixel the box-filtered color of the least textured patch around it
+   * (the first minimum of mRTV in row-major window order, as the sequential scan did) and
+   * blends it with its own B by the sigmoid of the mRTV difference. */
+  void computeGuidance(const Mat& mRTV, const Mat& B, BTFPlanes& Gtilde, int fr, double sigmaAlpha)
   {
-    B.copyTo(G);
-    alpha = Mat::ones(B.size(), CV_32FC1);
-    for (int y = -fr; y <= fr; y++)
+    const int width = mRTV.cols, height = mRTV.rows, cn = Gtilde.cn;
+    const float negSigmaAlpha = (float)-sigmaAlpha;
+
+    parallel_for_(Range(0, height), [&](const Range& range)
     {
-      for (int x = -fr; x <= fr; x++)
+      AutoBuffer<float> fbuf(2 * width);
+      AutoBuffer<int> ibuf(3 * width);
+      float *colVal = fbuf.data(), *alpha = colVal + width;
+      int *colDy = ibuf.data(), *selY = colDy + width, *selX = selY + width;
+
+      for (int y = range.start; y < range.end; y++)
       {
-        Point pb;
-        Point pt;
-        for (pb.y = 0; pb.y < B.rows; pb.y++)
+        // vertical pass keeps the first (smallest dy) minimum of each column
+        const float* first = mRTV.ptr<float>(std::max(y - fr, 0));
+        for (int x = 0; x < width; x++)
         {
-          for (pb.x = 0; pb.x < B.cols; pb.x++)
+          colVal[x] = first[x];
+          colDy[x] = -fr;
+        }
+        for (int dy = -fr + 1; dy <= fr; dy++)
+        {
+          const float* row = mRTV.ptr<float>(std::min(std::max(y + dy, 0), height - 1));
+          for (int x = 0; x < width; x++)
           {
-            pt.x = min(max(pb.x + x, 0), B.cols - 1);
-            pt.y = min(max(pb.y + y, 0), B.rows - 1);
-            if (alpha.at<float>(pb) > mRTV.at<float>(pt))
+            if (row[x] < colVal[x])
             {
-              alpha.at<float>(pb) = mRTV.at<float>(pt);
-              if (B.channels() == 3)
-                G.at<Vec3f>(pb) = B.at<Vec3f>(pt);
-              else if (B.channels() == 1)
-                G.at<float>(pb) = B.at<float>(pt);
+              colVal[x] = row[x];
+              colDy[x] = dy;
             }
           }
         }
+
+        const float* rtv = mRTV.ptr<float>(y);
+        for (int x = 0; x < width; x++)
+        {
+          float best = 1.f;
+          int bestY = y, bestX = x;
+          bool found = false;
+          int bestDy = 0;
+          for (int dx = -fr; dx <= fr; dx++)
+          {
+            int cx = std::min(std::max(x + dx, 0), width - 1);
+            float v = colVal[cx];
+            if (v < best || (found && v == best && colDy[cx] < bestDy))
+            {
+              best = v;
+              bestDy = colDy[cx];
+              bestX = cx;
+              found = true;
+            }
+          }
+          if (found)
+            bestY = std::min(std::max(y + bestDy, 0), height - 1);
+          selY[x] = bestY;
+          selX[x] = bestX;
+          alpha[x] = (rtv[x] - best) * negSigmaAlpha;
+        }
+
+        hal::exp32f(alpha, alpha, width);
+        for (int x = 0; x < width; x++)
+          alpha[x] = (1.f / (alpha[x] + 1.f) - 0.5f) * 2;
+
+        for (int c = 0; c < cn; c++)
+        {
+          const float* b = B.ptr<float>(c * height + y);
+          float* g = Gtilde.ptr(c, y);
+          for (int x = 0; x < width; x++)
+            g[x] = B.at<float>(c * height + selY[x], selX[x]) * alpha[x] + b[x] * (1.f - alpha[x]);
+        }
       }
-    }
+    });
+    Gtilde.fillBorder();
   }
 
-  void joint_bilateral_filter(const Mat& img, const Mat& G, Mat& r_img, int fr2, double sigma_avg)
+  /* Joint bilateral filter of I guided by Gtilde over a (2*fr2+1)^2 square window. The weights of
+   * one offset are evaluated for a whole row at once, so the exponent goes through the vectorized
+   * hal::exp32f(); the offsets are visited in the same order as the original image-wide passes.
+   * The range term is a function of a continuous color distance, a quantized LUT as in
+   * rollingGuidanceFilter would change the result. */
+  void jointBilateralTexture(const BTFPlanes& I, const BTFPlanes& Gtilde, const std::vector<float>& SW,
+                             int fr2, double sigmaAvg, const std::function<void(int, const float* const*)>& storeRow)
   {
-    Mat p_G;
-    copyMakeBorder(G, p_G, fr2, fr2, fr2, fr2, BORDER_REFLECT);
-
-    Mat p_img;
-    copyMakeBorder(img, p_img, fr2, fr2, fr2, fr2, BORDER_REFLECT);
-
-    Mat SW;
-    if (SW.empty()) {
-      SW = Mat(2*fr2+1, 2*fr2+1, CV_32FC1);
-      int r, c;
-      float y, x;
-      for (r = 0, y = (float)-fr2; r < SW.rows; r++, y += 1.0) {
-        for(c = 0, x = (float)-fr2; c < SW.cols; c++, x += 1.0) {
-          SW.at<float>(r,c) = exp(-(x*x + y*y) / (2*fr2*fr2));
-        }
-      }
-    }
+    const int width = I.size.width, cn = I.cn;
+    const int ksize = 2 * fr2 + 1;
+    const float coeff = (float)(-0.5 / (sigmaAvg * sigmaAvg));
 
-    r_img = Mat::zeros(img.size(), CV_32FC1);
+    parallel_for_(Range(0, I.size.height), [&](const Range& range)
     {
-      Mat sum_d_W = Mat::zeros(img.size(), CV_32FC1);
-      Mat d_W = Mat::zeros(G.size(), CV_32FC1);
+      AutoBuffer<float> buf(5 * width);
+      float *w = buf.data(), *sumW = w + width;
+      float* acc[3] = { sumW + width, sumW + 2 * width, sumW + 3 * width };
+
+      for (int y = range.start; y < range.end; y++)
+      {
+        for (int x = 0; x < (cn + 1) * width; x++)
+          sumW[x] = 0.f;
 
-      for (int x = -fr2; x <= fr2; x++) {
-        for (int y = -fr2; y <= fr2; y++) {
-          d_W = p_G(Rect(fr2+x, fr2+y, img.cols, img.rows)) - G;
-          multiply(d_W, d_W, d_W);
-          exp(-0.5 * d_W / (sigma_avg*sigma_avg), d_W);
+        const float* g0 = Gtilde.ptr(0, y);
+        const float* g1 = Gtilde.ptr(cn == 3 ? 1 : 0, y);
+        const float* g2 = Gtilde.ptr(cn == 3 ? 2 : 0, y);
+        for (int dx = -fr2; dx <= fr2; dx++)
+        {
+          for (int dy = -fr2; dy <= fr2; dy++)
+          {
+            const float* pg0 = Gtilde.ptr(0, y + dy) + dx;
+            const float* pg1 = Gtilde.ptr(cn == 3 ? 1 : 0, y + dy) + dx;
+            const float* pg2 = Gtilde.ptr(cn == 3 ? 2 : 0, y + dy) + dx;
+            int x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+            const int VECSZ = VTraits<v_float32>::vlanes();
+            const v_float32 vCoeff = vx_setall_f32(coeff);
+            for (; x <= width - VECSZ; x += VECSZ)
+            {
+              v_float32 d = v_sub(vx_load(pg0 + x), vx_load(g0 + x));
+              v_float32 d2 = v_mul(d, d);
+              if (cn == 3)
+              {
+                d = v_sub(vx_load(pg1 + x), vx_load(g1 + x));
+                d2 = v_add(d2, v_mul(d, d));
+                d = v_sub(vx_load(pg2 + x), vx_load(g2 + x));
+                d2 = v_add(d2, v_mul(d, d));
+              }
+              v_store(w + x, v_mul(d2, vCoeff));
+            }
+#endif
+            for (; x < width; x++)
+            {
+              float d = pg0[x] - g0[x];
+              float d2 = d * d;
+              if (cn == 3)
+              {
+                d = pg1[x] - g1[x];
+                d2 += d * d;
+                d = pg2[x] - g2[x];
+                d2 += d * d;
+              }
+              w[x] = d2 * coeff;
+            }
+            hal::exp32f(w, w, width);
 
-          d_W = d_W * SW.at<float>(fr2+y, fr2+x); //Gaussian weight
+            const float sw = SW[(dy + fr2) * ksize + dx + fr2];
+            for (int c = 0; c < cn; c++)
+            {
+              const float* p = I.ptr(c, y + dy) + dx;
+              float* a = acc[c];
+              x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+              const v_float32 vSw = vx_setall_f32(sw);
+              for (; x <= width - VECSZ; x += VECSZ)
+              {
+                v_float32 vw = v_mul(vx_load(w + x), vSw);
+                v_store(a + x, v_add(vx_load(a + x), v_mul(vw, vx_load(p + x))));
+              }
+#endif
+              for (; x < width; x++)
+                a[x] += w[x] * sw * p[x];
+            }
+            for (x = 0; x < width; x++)
+              sumW[x] += w[x] * sw;
+          }
+        }
 
-          sum_d_W = sum_d_W + d_W;
-          multiply(d_W, p_img(Rect(fr2+x, fr2+y, img.cols, img.rows)), d_W);
-          r_img = r_img + d_W;
+        for (int x = 0; x < width; x++)
+          sumW[x] = std::max(sumW[x], 1e-5f);
+        for (int c = 0; c < cn; c++)
+        {
+          float* a = acc[c];
+          for (int x = 0; x < width; x++)
+            a[x] /= sumW[x];
         }
+        storeRow(y, acc);
       }
-      max(1e-5f, sum_d_W, sum_d_W);
-      divide(r_img, sum_d_W, r_img);
-    }
+    });
   }
+} // namespace
 
-  void joint_bilateral_filter3(const Mat& img, const Mat& G, Mat& r_img, int fr2, double sigma_avg)
+  void bilateralTextureFilter(InputArray src_, OutputArray dst_, int fr,
+                              int numIter, double sigmaAlpha, double sigmaAvg)
   {
-    Mat p_G;
-    copyMakeBorder(G, p_G, fr2, fr2, fr2, fr2, BORDER_REFLECT);
-
-    Mat p_img;
-    copyMakeBorder(img, p_img, fr2, fr2, fr2, fr2, BORDER_REFLECT);
-
-    Mat SW;
-    if (SW.empty()) {
-      SW = Mat(2*fr2+1, 2*fr2+1, CV_32FC1);
-      int r, c;
-      float y, x;
-      for (r = 0, y = (float)-fr2; r < SW.rows; r++, y += 1.0) {
-        for(c = 0, x = (float)-fr2; c < SW.cols; c++, x += 1.0) {
-          SW.at<float>(r,c) = exp(-(x*x + y*y) / (2*fr2*fr2));
+    CV_Assert(!src_.empty());
+
+    Mat src = src_.getMat();
+    CV_Assert(src.depth() == CV_8U || src.depth() == CV_32F);
+    CV_Assert(src.channels() == 1 || src.channels() == 3);
+
+    CV_Assert(fr > 0 && numIter > 0);
+
+    if (sigmaAlpha < 0)
+      sigmaAlpha = 5. * fr;
+    if (sigmaAvg < 0)
+      sigmaAvg = 0.05 * sqrt(static_cast<float>(src.channels()));
+
+    const int cn = src.channels();
+    const int fr2 = 2 * fr;
+    const Size sz = src.size();
+    const bool is8u = src.depth() == CV_8U;
+
+    // every intermediate is allocated once; the filtered image ping-pongs between two buffers
+    BTFPlanes I[2], grad, Gtilde;
+    I[0].create(sz, cn, fr2);
+    grad.create(sz, cn, fr);
+    Gtilde.create(sz, cn, fr2);
+    Mat mRTV(sz, CV_32FC1), B(cn * sz.height, sz.width, CV_32FC1);
+    if (numIter > 1)
+      I[1].create(sz, cn, fr2);
+
+    parallel_for_(Range(0, sz.height), [&](const Range& range)
+    {
+      for (int y = range.start; y < range.end; y++)
+      {
+        for (int c = 0; c < cn; c++)
+        {
+          float* row = I[0].ptr(c, y);
+          if (is8u)
+          {
+            const uchar* srcRow = src.ptr<uchar>(y) + c;
+            for (int x = 0; x < sz.width; x++)
+              row[x] = srcRow[x * cn] * (1.f / 255);
+          }
+          else
+          {
+            const float* srcRow = src.ptr<float>(y) + c;
+            for (int x = 0; x < sz.width; x++)
+              row[x] = srcRow[x * cn];
+          }
         }
       }
-    }
-
-    std::vector<Mat> G_channels(3);
-    split(G, G_channels);
-    std::vector<Mat> p_G_channels(3);
-    split(p_G, p_G_channels);
-    std::vector<Mat> p_img_channels(3);
-    split(p_img, p_img_channels);
-
-    Mat sum_d_W = Mat::zeros(img.size(), CV_32FC1);
-    std::vector<Mat> d_W_channels(3);
-    for (int ch = 0; ch < 3; ch++) {
-      d_W_channels[ch] = Mat::zeros(G.size(), CV_32FC1);
-    }
-    Mat d_W = Mat::zeros(G.size(), CV_32FC1);
+    });
+    I[0].fillBorder();
 
-    std::vector<Mat> r_img_channels(3);
-    for (int ch = 0; ch < 3; ch++) {
-      r_img_channels[ch] = Mat::zeros(G.size(), CV_32FC1);
+    std::vector<float> SW((2 * fr2 + 1) * (2 * fr2 + 1));
+    for (int r = 0; r < 2 * fr2 + 1; r++)
+    {
+      for (int c = 0; c < 2 * fr2 + 1; c++)
+      {
+        float y = (float)(r - fr2), x = (float)(c - fr2);
+        SW[r * (2 * fr2 + 1) + c] = std::exp(-(x*x + y*y) / (2*fr2*fr2));
+      }
     }
 
-    for (int x = -fr2; x <= fr2; x++) {
-      for (int y = -fr2; y <= fr2; y++) {
-        d_W.setTo(0);
-        for (int ch = 0; ch < 3; ch++) {
-          subtract(p_G_channels[ch](Rect(fr2+x, fr2+y, img.cols, img.rows)), G_channels[ch], d_W_channels[ch]);
-          multiply(d_W_channels[ch], d_W_channels[ch], d_W_channels[ch]);
-        }
-        for (int ch = 0; ch < 3; ch++) {
-          add(d_W, d_W_channels[ch], d_W);
-        }
-        exp(-0.5 * d_W / (sigma_avg*sigma_avg), d_W);
+    // src is completely copied into I[0] above, so writing dst in the last iteration is safe in-place
+    dst_.create(sz, src.type());
+    Mat dst = dst_.getMat();
 
-        d_W = d_W * SW.at<float>(fr2+y, fr2+x); //Gaussian weight
+    for (int iter = 0; iter < numIter; iter++)
+    {
+      const BTFPlanes& cur = I[iter & 1];
+      BTFPlanes& next = I[(iter + 1) & 1];
+      const bool lastIter = iter == numIter - 1;
 
-        add(sum_d_W, d_W, sum_d_W);
+      computeGradient(cur, grad);
+      computeRTV(cur, grad, mRTV, B, fr);
+      computeGuidance(mRTV, B, Gtilde, fr, sigmaAlpha);
 
-        for (int ch = 0; ch < 3; ch++) {
-          Mat n_p_img = p_img_channels[ch](Rect(fr2+x, fr2+y, img.cols, img.rows));
-          accumulateProduct(d_W, n_p_img, r_img_channels[ch]);
-        }
+      if (lastIter)
+      {
+        jointBilateralTexture(cur, Gtilde, SW, fr2, sigmaAvg, [&](int y, const float* const* rows)
+        {
+          for (int c = 0; c < cn; c++)
+          {
+            if (is8u)
+            {
+              uchar* dstRow = dst.ptr<uchar>(y) + c;
+              for (int x = 0; x < sz.width; x++)
+                dstRow[x * cn] = saturate_cast<uchar>(rows[c][x] * 255.f);
+            }
+            else
+            {
+              float* dstRow = dst.ptr<float>(y) + c;
+              for (int x = 0; x < sz.width; x++)
+                dstRow[x * cn] = rows[c][x];
+            }
+          }
+        });
+      }
+      else
+      {
+        jointBilateralTexture(cur, Gtilde, SW, fr2, sigmaAvg, [&](int y, const float* const* rows)
+        {
+          for (int c = 0; c < cn; c++)
+            memcpy(next.ptr(c, y), rows[c], sz.width * sizeof(float));
+        });
+        next.fillBorder();
       }
     }
-
-    max(1e-5f, sum_d_W, sum_d_W);
-    for (int ch = 0; ch < 3; ch++) {
-      divide(r_img_channels[ch], sum_d_W, r_img_channels[ch]);
-    }
-    merge(r_img_channels, r_img);
   }
-
 }
 }
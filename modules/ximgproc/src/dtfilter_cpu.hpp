@@ -142,16 +142,18 @@ protected: /*Wrappers for parallelization*/
 
         FilterNC_horPass(Mat& src_, Mat& idist_, Mat& dst_);
         void operator() (const Range& range) const CV_OVERRIDE;
+        Range getRange() const { return Range(0, divUp(src.rows, TRANSPOSE_BLOCK_ROWS)); }
     };
 
     template <typename WorkVec>
     struct FilterIC_horPass : public ParallelLoopBody
     {
-        Mat &src, &idist, &dist, &dst, isrcBuf;
+        Mat &src, &idist, &dist, &dst;
         float radius;
 
         FilterIC_horPass(Mat& src_, Mat& idist_, Mat& dist_, Mat& dst_);
         void operator() (const Range& range) const CV_OVERRIDE;
+        Range getRange() const { return Range(0, divUp(src.rows, TRANSPOSE_BLOCK_ROWS)); }
     };
 
     template <typename WorkVec>
@@ -170,14 +172,11 @@ protected: /*Wrappers for parallelization*/
     {
         Mat &res, &alphaD;
         int iteration;
+        int blockCols;
 
         FilterRF_vertPass(Mat& res_, Mat& alphaD_, int iteration_);
         void operator() (const Range& range) const CV_OVERRIDE;
-        #ifdef CV_GET_NUM_THREAD_WORKS_PROPERLY
-        Range getRange() const { return Range(0, cv::getNumThreads()); }
-        #else
-        Range getRange() const { return Range(0, res.cols); }
-        #endif
+        Range getRange() const { return Range(0, divUp(res.cols, blockCols)); }
     };
 
     template <typename GuideVec>
@@ -231,6 +230,15 @@ protected: /*Wrappers for parallelization*/
 
 protected: /*Auxiliary implementation functions*/
 
+    /*Horizontal NC/IC passes filter this many rows at once and write them transposed tile by tile*/
+    static const int TRANSPOSE_BLOCK_ROWS = 16;
+
+    template<typename WorkVec>
+    static void storeTransposed(const WorkVec *block, int blockRows, int cols, Mat& dst, int firstRow);
+
+    template<typename WorkVec>
+    static void recursiveFilterStep(WorkVec *cur, const WorkVec *prev, const DistType *ad, int cols);
+
     static Range getWorkRangeByThread(const Range& itemsRange, const Range& rangeThread, int maxThreads = 0);
     static Range getWorkRangeByThread(int items, const Range& rangeThread, int maxThreads = 0);
 
@@ -38,6 +38,7 @@
 #define __OPENCV_DTFILTER_INL_HPP__
 #include "precomp.hpp"
 #include "edgeaware_filters_common.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <limits>
 
 namespace cv
@@ -158,8 +159,8 @@ void DTFilterCPU::filter_(const Mat& src, Mat& dst, int dDepth)
         {
             horParBody.radius = vertParBody.radius = getIterRadius(iter);
 
-            parallel_for_(Range(0, res.rows), horParBody);
-            parallel_for_(Range(0, resT.rows), vertParBody);
+            parallel_for_(horParBody.getRange(), horParBody);
+            parallel_for_(vertParBody.getRange(), vertParBody);
         }
     }
     else if (mode == DTF_IC)
@@ -174,8 +175,8 @@ void DTFilterCPU::filter_(const Mat& src, Mat& dst, int dDepth)
         {
             horParBody.radius = vertParBody.radius = getIterRadius(iter);
 
-            parallel_for_(Range(0, res.rows), horParBody);
-            parallel_for_(Range(0, resT.rows), vertParBody);
+            parallel_for_(horParBody.getRange(), horParBody);
+            parallel_for_(vertParBody.getRange(), vertParBody);
         }
     }
     else if (mode == DTF_RF)
@@ -234,6 +235,51 @@ void DTFilterCPU::integrateSparseRow(const SrcVec *src, const float *dist, SrcWo
     }
 }
 
+template<typename WorkVec>
+void DTFilterCPU::storeTransposed(const WorkVec *block, int blockRows, int cols, Mat& dst, int firstRow)
+{
+    for (int j = 0; j < cols; j++)
+    {
+        WorkVec *dstLine = dst.ptr<WorkVec>(j) + firstRow;
+        for (int b = 0; b < blockRows; b++)
+            dstLine[b] = block[b*cols + j];
+    }
+}
+
+template<typename WorkVec>
+void DTFilterCPU::recursiveFilterStep(WorkVec *cur, const WorkVec *prev, const DistType *ad, int cols)
+{
+    const int cn = WorkVec::channels;
+    float *curData = cur->val;
+    const float *prevData = prev->val;
+    int j = 0;
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    if (cn == 1)
+    {
+        const int VECSZ = VTraits<v_float32>::vlanes();
+        for (; j <= cols - VECSZ; j += VECSZ)
+        {
+            v_float32 c = vx_load(curData + j);
+            v_store(curData + j, v_add(c, v_mul(vx_load(ad + j), v_sub(vx_load(prevData + j), c))));
+        }
+    }
+#endif
+#if CV_SIMD128
+    if (cn == 4)
+    {
+        for (; j < cols; j++)
+        {
+            v_float32x4 c = v_load(curData + 4*j);
+            v_store(curData + 4*j, v_add(c, v_mul(v_setall_f32(ad[j]), v_sub(v_load(prevData + 4*j), c))));
+        }
+    }
+#endif
+
+    for (; j < cols; j++)
+        cur[j] += ad[j] * (prev[j] - cur[j]);
+}
+
 template<typename WorkVec>
 void DTFilterCPU::prepareSrcImg_IC(const Mat& src, Mat& dst, Mat& dstT)
 {
@@ -280,43 +326,53 @@ void DTFilterCPU::FilterNC_horPass<WorkVec>::operator()(const Range& range) cons
     std::vector<WorkVec> isrcBuf(src.cols + 1);
     WorkVec *isrcLine = &isrcBuf[0];
     #endif
+    std::vector<WorkVec> blockBuf(TRANSPOSE_BLOCK_ROWS * src.cols);
 
-    for (int i = range.start; i < range.end; i++)
+    int rowsEnd = std::min(range.end * TRANSPOSE_BLOCK_ROWS, src.rows);
+    for (int i0 = range.start * TRANSPOSE_BLOCK_ROWS; i0 < rowsEnd; i0 += TRANSPOSE_BLOCK_ROWS)
     {
-        const WorkVec   *srcLine    = src.ptr<WorkVec>(i);
-        IDistType       *idistLine  = idist.ptr<IDistType>(i);
-        int leftBound = 0, rightBound = 0;
-        WorkVec sum;
-
-        #ifdef NC_USE_INTEGRAL_SRC
-        integrateRow(srcLine, isrcLine, src.cols);
-        #else
-        sum = srcLine[0];
-        #endif
-
-        for (int j = 0; j < src.cols; j++)
+        int blockRows = std::min((int)TRANSPOSE_BLOCK_ROWS, rowsEnd - i0);
+
+        for (int i = i0; i < i0 + blockRows; i++)
         {
-            IDistType curVal = idistLine[j];
+            const WorkVec   *srcLine    = src.ptr<WorkVec>(i);
+            IDistType       *idistLine  = idist.ptr<IDistType>(i);
+            WorkVec         *dstLine    = &blockBuf[(i - i0) * src.cols];
+            int leftBound = 0, rightBound = 0;
+            WorkVec sum;
+
             #ifdef NC_USE_INTEGRAL_SRC
-            leftBound  = getLeftBound(idistLine, leftBound, curVal - radius);
-            rightBound = getRightBound(idistLine, rightBound, curVal + radius);
-            sum = (isrcLine[rightBound + 1] - isrcLine[leftBound]);
+            integrateRow(srcLine, isrcLine, src.cols);
             #else
-            while (idistLine[leftBound] < curVal - radius)
-            {
-                sum -= srcLine[leftBound];
-                leftBound++;
-            }
+            sum = srcLine[0];
+            #endif
 
-            while (idistLine[rightBound + 1] < curVal + radius)
+            for (int j = 0; j < src.cols; j++)
             {
-                rightBound++;
-                sum += srcLine[rightBound];
+                IDistType curVal = idistLine[j];
+                #ifdef NC_USE_INTEGRAL_SRC
+                leftBound  = getLeftBound(idistLine, leftBound, curVal - radius);
+                rightBound = getRightBound(idistLine, rightBound, curVal + radius);
+                sum = (isrcLine[rightBound + 1] - isrcLine[leftBound]);
+                #else
+                while (idistLine[leftBound] < curVal - radius)
+                {
+                    sum -= srcLine[leftBound];
+                    leftBound++;
+                }
+
+                while (idistLine[rightBound + 1] < curVal + radius)
+                {
+                    rightBound++;
+                    sum += srcLine[rightBound];
+                }
+                #endif
+
+                dstLine[j] = sum / (float)(rightBound + 1 - leftBound);
             }
-            #endif
-
-            dst.at<WorkVec>(j, i) = sum / (float)(rightBound + 1 - leftBound);
         }
+
+        storeTransposed(&blockBuf[0], blockRows, src.cols, dst, i0);
     }
 }
 
@@ -325,57 +381,58 @@ DTFilterCPU::FilterIC_horPass<WorkVec>::FilterIC_horPass(Mat& src_, Mat& idist_,
 : src(src_), idist(idist_), dist(dist_), dst(dst_), radius(1.0f)
 {
     CV_DbgAssert(src.type() == traits::Type<WorkVec>::value && dst.type() == traits::Type<WorkVec>::value && dst.rows == src.cols && dst.cols == src.rows);
-
-    #ifdef CV_GET_NUM_THREAD_WORKS_PROPERLY
-    isrcBuf.create(cv::getNumThreads(), src.cols + 1, traits::Type<WorkVec>::value);
-    #else
-    isrcBuf.create(src.rows, src.cols + 1, traits::Type<WorkVec>::value);
-    #endif
 }
 
 template <typename WorkVec>
 void DTFilterCPU::FilterIC_horPass<WorkVec>::operator()(const Range& range) const
 {
-    #ifdef CV_GET_NUM_THREAD_WORKS_PROPERLY
-    WorkVec *isrcLine = const_cast<WorkVec*>( isrcBuf.ptr<WorkVec>(cv::getThreadNum()) );
-    #else
-    WorkVec *isrcLine = const_cast<WorkVec*>( isrcBuf.ptr<WorkVec>(range.start) );
-    #endif
+    std::vector<WorkVec> isrcBuf(src.cols + 1);
+    WorkVec *isrcLine = &isrcBuf[0];
+    std::vector<WorkVec> blockBuf(TRANSPOSE_BLOCK_ROWS * src.cols);
 
-    for (int i = range.start; i < range.end; i++)
+    int rowsEnd = std::min(range.end * TRANSPOSE_BLOCK_ROWS, src.rows);
+    for (int i0 = range.start * TRANSPOSE_BLOCK_ROWS; i0 < rowsEnd; i0 += TRANSPOSE_BLOCK_ROWS)
     {
-        WorkVec   *srcLine      = src.ptr<WorkVec>(i);
-        DistType  *distLine     = dist.ptr<DistType>(i);
-        IDistType *idistLine    = idist.ptr<IDistType>(i);
+        int blockRows = std::min((int)TRANSPOSE_BLOCK_ROWS, rowsEnd - i0);
 
-        integrateSparseRow(srcLine, distLine, isrcLine, src.cols);
+        for (int i = i0; i < i0 + blockRows; i++)
+        {
+            WorkVec   *srcLine      = src.ptr<WorkVec>(i);
+            DistType  *distLine     = dist.ptr<DistType>(i);
+            IDistType *idistLine    = idist.ptr<IDistType>(i);
+            WorkVec   *dstLine      = &blockBuf[(i - i0) * src.cols];
 
-        int leftBound = 0, rightBound = 0;
-        WorkVec sumL, sumR, sumC;
+            integrateSparseRow(srcLine, distLine, isrcLine, src.cols);
 
-        srcLine[-1] = srcLine[0];
-        srcLine[src.cols] = srcLine[src.cols - 1];
+            int leftBound = 0, rightBound = 0;
+            WorkVec sumL, sumR, sumC;
 
-        for (int j = 0; j < src.cols; j++)
-        {
-            IDistType curVal = idistLine[j];
-            IDistType valueLeft = curVal - radius;
-            IDistType valueRight = curVal + radius;
+            srcLine[-1] = srcLine[0];
+            srcLine[src.cols] = srcLine[src.cols - 1];
 
-            leftBound = getLeftBound(idistLine, leftBound, valueLeft);
-            rightBound = getRightBound(idistLine, rightBound, valueRight);
+            for (int j = 0; j < src.cols; j++)
+            {
+                IDistType curVal = idistLine[j];
+                IDistType valueLeft = curVal - radius;
+                IDistType valueRight = curVal + radius;
 
-            float areaL = idistLine[leftBound] - valueLeft;
-            float areaR = valueRight - idistLine[rightBound];
-            float dl = areaL / distLine[leftBound - 1];
-            float dr = areaR / distLine[rightBound];
+                leftBound = getLeftBound(idistLine, leftBound, valueLeft);
+                rightBound = getRightBound(idistLine, rightBound, valueRight);
 
-            sumL = 0.5f*areaL*(dl*srcLine[leftBound - 1] + (2.0f - dl)*srcLine[leftBound]);
-            sumR = 0.5f*areaR*((2.0f - dr)*srcLine[rightBound] + dr*srcLine[rightBound + 1]);
-            sumC = isrcLine[rightBound] - isrcLine[leftBound];
+                float areaL = idistLine[leftBound] - valueLeft;
+                float areaR = valueRight - idistLine[rightBound];
+                float dl = areaL / distLine[leftBound - 1];
+                float dr = areaR / distLine[rightBound];
 
-            dst.at<WorkVec>(j, i) = (sumL + sumC + sumR) / (2.0f * radius);
+                sumL = 0.5f*areaL*(dl*srcLine[leftBound - 1] + (2.0f - dl)*srcLine[leftBound]);
+                sumR = 0.5f*areaR*((2.0f - dr)*srcLine[rightBound] + dr*srcLine[rightBound + 1]);
+                sumC = isrcLine[rightBound] - isrcLine[leftBound];
+
+                dstLine[j] = (sumL + sumC + sumR) / (2.0f * radius);
+            }
         }
+
+        storeTransposed(&blockBuf[0], blockRows, src.cols, dst, i0);
     }
 }
 
@@ -423,17 +480,18 @@ DTFilterCPU::FilterRF_vertPass<WorkVec>::FilterRF_vertPass(Mat& res_, Mat& alpha
 {
     CV_DbgAssert(res.type() == traits::Type<WorkVec>::value);
     CV_DbgAssert(res.type() == traits::Type<WorkVec>::value && res.size() == res.size());
+
+    /*columns are independent, so each work item sweeps a cache-friendly block of whole columns row by row*/
+    blockCols = divUp(res.cols, 4 * std::max(1, cv::getNumThreads()));
+    blockCols = std::min(std::max(alignSize(blockCols, 16), 16), 256);
 }
 
 
 template <typename WorkVec>
 void DTFilterCPU::FilterRF_vertPass<WorkVec>::operator()(const Range& range) const
 {
-    #ifdef CV_GET_NUM_THREAD_WORKS_PROPERLY
-    Range rcols = getWorkRangeByThread(res.cols, range);
-    #else
-    Range rcols = range;
-    #endif
+    Range rcols(range.start * blockCols, std::min(range.end * blockCols, res.cols));
+    int ncols = rcols.size();
 
     for (int i = 1; i < res.rows; i++)
     {
@@ -447,10 +505,7 @@ void DTFilterCPU::FilterRF_vertPass<WorkVec>::operator()(const Range& range) con
                 adRow[j] *= adRow[j];
         }
 
-        for (int j = rcols.start; j < rcols.end; j++)
-        {
-            curRow[j] += adRow[j] * (prevRow[j] - curRow[j]);
-        }
+        recursiveFilterStep(curRow + rcols.start, prevRow + rcols.start, adRow + rcols.start, ncols);
     }
 
     for (int i = res.rows - 2; i >= 0; i--)
@@ -459,10 +514,7 @@ void DTFilterCPU::FilterRF_vertPass<WorkVec>::operator()(const Range& range) con
         WorkVec     *curRow  = res.ptr<WorkVec>(i);
         DistType    *adRow   = alphaD.ptr<DistType>(i);
 
-        for (int j = rcols.start; j < rcols.end; j++)
-        {
-            curRow[j] += adRow[j] * (prevRow[j] - curRow[j]);
-        }
+        recursiveFilterStep(curRow + rcols.start, prevRow + rcols.start, adRow + rcols.start, ncols);
     }
 }
 
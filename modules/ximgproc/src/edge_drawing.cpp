@@ -5,6 +5,8 @@
 #include "precomp.hpp"
 #include "edge_drawing_common.hpp"
 
+#include <unordered_map>
+
 using namespace std;
 
 namespace cv
@@ -159,7 +161,9 @@ private:
     void ComputeGradient();
     void ComputeAnchorPoints();
     void JoinAnchorPointsUsingSortedAnchors();
-    int* sortAnchorsByGradValue1();
+    void JoinAnchorsInRegion(const Rect& roi, std::vector<std::vector<Point> >& segs, std::vector<uchar>& shortSegs);
+    void StitchTileSegments(int tileSize, std::vector<std::vector<Point> >& segs, const std::vector<uchar>& shortSegs);
+    void sortAnchorsByGradValue(const Rect& roi, std::vector<int>& anchors) const;
 
     static int LongestChain(Chain *chains, int root);
     static int RetrieveChainNos(Chain *chains, int root, int chainNos[]);
@@ -185,10 +189,11 @@ private:
     NFALUT* nfa;
 
     int ComputeMinLineLength();
-    void SplitSegment2Lines(double* x, double* y, int noPixels, int segmentNo);
+    void SplitSegment2Lines(double* x, double* y, int noPixels, int segmentNo, std::vector<EDLineSegment>& segmentLines) const;
     void JoinCollinearLines();
 
     void ValidateLineSegments();
+    bool ValidateLineSegment(int* x, int* y, EDLineSegment* ls);
     bool ValidateLineSegmentRect(int* x, int* y, EDLineSegment* ls);
     bool TryToJoinTwoLineSegments(EDLineSegment* ls1, EDLineSegment* ls2, int changeIndex);
 
@@ -200,7 +205,7 @@ private:
     static void UpdateLineParameters(EDLineSegment* ls);
     static void EnumerateRectPoints(double sx, double sy, double ex, double ey, int ptsx[], int ptsy[], int* pNoPoints);
 
-    void TestSegment(int i, int index1, int index2);
+    void TestSegment(int i, int index1, int index2, std::vector<Vec2i>& validRanges);
     void ExtractNewSegments();
     double NFA(double prob, int len);
 
@@ -228,6 +233,7 @@ private:
     void GenerateCandidateCircles();
     void DetectArcs();
     void ValidateCircles(bool validate);
+    bool ValidateCircle(Circle* circle, double* px, double* py, int points_buffer_size, bool validate);
     void JoinCircles();
     void JoinArcs1();
     void JoinArcs2();
@@ -295,6 +301,7 @@ EdgeDrawing::Params::Params()
     MaxDistanceBetweenTwoLines = 6.0;
     LineFitErrorThreshold = 1.0;
     MaxErrorThreshold = 1.3;
+    TileSize = 0;
 }
 
 void EdgeDrawing::setParams(const EdgeDrawing::Params& parameters)
@@ -317,6 +324,7 @@ void EdgeDrawing::Params::read(const cv::FileNode& fn)
     MaxDistanceBetweenTwoLines = fn["MaxDistanceBetweenTwoLines"];
     LineFitErrorThreshold = fn["LineFitErrorThreshold"];
     MaxErrorThreshold = fn["MaxErrorThreshold"];
+    TileSize = fn["TileSize"];
 }
 
 void EdgeDrawing::Params::write(cv::FileStorage& fs) const
@@ -334,6 +342,7 @@ void EdgeDrawing::Params::write(cv::FileStorage& fs) const
     fs << "MaxDistanceBetweenTwoLines" << MaxDistanceBetweenTwoLines;
     fs << "LineFitErrorThreshold" << LineFitErrorThreshold;
     fs << "MaxErrorThreshold" << MaxErrorThreshold;
+    fs << "TileSize" << TileSize;
 }
 
 String EdgeDrawingImpl::getDefaultName() const
@@ -392,7 +401,6 @@ void EdgeDrawingImpl::detectEdges(InputArray src)
     anchorPoints.clear();
     lines.clear();
     segmentPoints.clear();
-    segmentPoints.push_back(vector<Point>()); // create empty vector of points for segments
     srcImage = src.getMat();
     srcImg = srcImage.data;
     height = srcImage.rows;
@@ -463,9 +471,18 @@ void EdgeDrawingImpl::detectEdges(InputArray src)
                 np += (len * (len - 1)) / 2;
             }
 
-            // Validate segments
+            // Validate segments, each one independently
+            std::vector<std::vector<Vec2i> > validRanges(segmentNos);
+            parallel_for_(Range(0, segmentNos), [&](const Range& range)
+            {
+                for (int i = range.start; i < range.end; i++)
+                    TestSegment(i, 0, (int)segmentPoints[i].size() - 1, validRanges[i]);
+            });
+
             for (int i = 0; i < segmentNos; i++)
-                TestSegment(i, 0, (int)segmentPoints[i].size() - 1);
+                for (size_t k = 0; k < validRanges[i].size(); k++)
+                    for (int l = validRanges[i][k][0]; l <= validRanges[i][k][1]; l++)
+                        edgeImg[segmentPoints[i][l].y * width + segmentPoints[i][l].x] = 255;
 
             ExtractNewSegments();
         }
@@ -599,63 +616,138 @@ void EdgeDrawingImpl::ComputeGradient()
 
 void EdgeDrawingImpl::ComputeAnchorPoints()
 {
-    for (int i = 2; i < height - 2; i++)
-    {
-        int start = 2;
-        int inc = 1;
-        if (i % params.ScanInterval != 0)
-        {
-            start = params.ScanInterval;
-            inc = params.ScanInterval;
-        }
+    // rows are scanned in parallel stripes, and the per-stripe anchors are appended in row order
+    const int nstripes = std::max(1, std::min(getNumThreads() * 4, (height - 4) / 16));
+    std::vector<std::vector<Point> > stripeAnchors(nstripes);
 
-        for (int j = start; j < width - 2; j += inc)
+    parallel_for_(Range(0, nstripes), [&](const Range& range)
+    {
+        for (int s = range.start; s < range.end; s++)
         {
-            if (gradImg[i * width + j] < gradThresh)
-                continue;
+            std::vector<Point>& anchors = stripeAnchors[s];
+            int rowStart = 2 + (int)((int64)(height - 4) * s / nstripes);
+            int rowEnd = 2 + (int)((int64)(height - 4) * (s + 1) / nstripes);
 
-            if (dirImg[i * width + j] == EDGE_VERTICAL)
+            for (int i = rowStart; i < rowEnd; i++)
             {
-                // vertical edge
-                int diff1 = gradImg[i * width + j] - gradImg[i * width + j - 1];
-                int diff2 = gradImg[i * width + j] - gradImg[i * width + j + 1];
-                if (diff1 >= anchorThresh && diff2 >= anchorThresh)
+                int start = 2;
+                int inc = 1;
+                if (i % params.ScanInterval != 0)
                 {
-                    edgeImg[i * width + j] = ANCHOR_PIXEL;
-                    anchorPoints.push_back(Point(j, i));
+                    start = params.ScanInterval;
+                    inc = params.ScanInterval;
                 }
-            }
-            else
-            {
-                // horizontal edge
-                int diff1 = gradImg[i * width + j] - gradImg[(i - 1) * width + j];
-                int diff2 = gradImg[i * width + j] - gradImg[(i + 1) * width + j];
-                if (diff1 >= anchorThresh && diff2 >= anchorThresh)
+
+                for (int j = start; j < width - 2; j += inc)
                 {
-                    edgeImg[i * width + j] = ANCHOR_PIXEL;
-                    anchorPoints.push_back(Point(j, i));
+                    if (gradImg[i * width + j] < gradThresh)
+                        continue;
+
+                    if (dirImg[i * width + j] == EDGE_VERTICAL)
+                    {
+                        // vertical edge
+                        int diff1 = gradImg[i * width + j] - gradImg[i * width + j - 1];
+                        int diff2 = gradImg[i * width + j] - gradImg[i * width + j + 1];
+                        if (diff1 >= anchorThresh && diff2 >= anchorThresh)
+                        {
+                            edgeImg[i * width + j] = ANCHOR_PIXEL;
+                            anchors.push_back(Point(j, i));
+                        }
+                    }
+                    else
+                    {
+                        // horizontal edge
+                        int diff1 = gradImg[i * width + j] - gradImg[(i - 1) * width + j];
+                        int diff2 = gradImg[i * width + j] - gradImg[(i + 1) * width + j];
+                        if (diff1 >= anchorThresh && diff2 >= anchorThresh)
+                        {
+                            edgeImg[i * width + j] = ANCHOR_PIXEL;
+                            anchors.push_back(Point(j, i));
+                        }
+                    }
                 }
             }
         }
-    }
+    });
+
+    for (int s = 0; s < nstripes; s++)
+        anchorPoints.insert(anchorPoints.end(), stripeAnchors[s].begin(), stripeAnchors[s].end());
 
     anchorNos = (int)anchorPoints.size(); // get the total number of anchor points
 }
 
 void EdgeDrawingImpl::JoinAnchorPointsUsingSortedAnchors()
 {
-    int* chainNos = new int[(width + height) * 8];
+    int tileSize = params.TileSize;
+    if (tileSize <= 0 || (tileSize >= width && tileSize >= height))
+    {
+        std::vector<uchar> shortSegs;
+        JoinAnchorsInRegion(Rect(0, 0, width, height), segmentPoints, shortSegs);
+        segmentNos = (int)segmentPoints.size();
+        return;
+    }
+
+    // Tiles that share an edge or a corner are never linked at the same time. A walk only
+    // reads and writes pixels of its own tile plus a one pixel rim, so tiles of the same
+    // phase do not interfere and the result does not depend on the number of threads.
+    tileSize = std::max(tileSize, 32);
+    const int tilesX = (width + tileSize - 1) / tileSize;
+    const int tilesY = (height + tileSize - 1) / tileSize;
+    std::vector<std::vector<std::vector<Point> > > tileSegs(tilesX * tilesY);
+    std::vector<std::vector<uchar> > tileShortSegs(tilesX * tilesY);
+
+    for (int phase = 0; phase < 4; phase++)
+    {
+        std::vector<int> tiles;
+        for (int ty = phase / 2; ty < tilesY; ty += 2)
+            for (int tx = phase % 2; tx < tilesX; tx += 2)
+                tiles.push_back(ty * tilesX + tx);
+
+        parallel_for_(Range(0, (int)tiles.size()), [&](const Range& range)
+        {
+            for (int k = range.start; k < range.end; k++)
+            {
+                int t = tiles[k];
+                Rect roi = Rect((t % tilesX) * tileSize, (t / tilesX) * tileSize, tileSize, tileSize) & Rect(0, 0, width, height);
+                JoinAnchorsInRegion(roi, tileSegs[t], tileShortSegs[t]);
+            }
+        });
+    }
+
+    std::vector<std::vector<Point> > segs;
+    std::vector<uchar> shortSegs;
+    for (size_t t = 0; t < tileSegs.size(); t++)
+    {
+        segs.insert(segs.end(), tileSegs[t].begin(), tileSegs[t].end());
+        shortSegs.insert(shortSegs.end(), tileShortSegs[t].begin(), tileShortSegs[t].end());
+    }
+
+    StitchTileSegments(tileSize, segs, shortSegs);
+    segmentPoints.swap(segs);
+    segmentNos = (int)segmentPoints.size();
+}
+
+// Links the anchors inside roi and appends the resulting segments to segs. Walks stop at the
+// border of roi. A segment whose main chain was cut there is kept even when it is shorter
+// than MinPathLength, so that it can be stitched to its continuation in a neighbouring tile;
+// such segments are flagged in shortSegs.
+void EdgeDrawingImpl::JoinAnchorsInRegion(const Rect& roi, std::vector<std::vector<Point> >& segs, std::vector<uchar>& shortSegs)
+{
+    int* chainNos = new int[(roi.width + roi.height) * 8];
 
-    Point* pixels = new Point[width * height];
-    StackNode* stack = new StackNode[width * height];
-    Chain* chains = new Chain[width * height];
+    Point* pixels = new Point[roi.width * roi.height];
+    StackNode* stack = new StackNode[roi.width * roi.height];
+    Chain* chains = new Chain[roi.width * roi.height];
 
     // sort the anchor points by their gradient value in decreasing order
-    int* pAnchors = sortAnchorsByGradValue1();
+    std::vector<int> pAnchors;
+    sortAnchorsByGradValue(roi, pAnchors);
+
+    segs.push_back(vector<Point>()); // create empty vector of points for segments
 
     // Now join the anchors starting with the anchor having the greatest gradient value
 
-    for (int k0 = anchorNos - 1; k0 >= 0; k0--)
+    for (int k0 = (int)pAnchors.size() - 1; k0 >= 0; k0--)
     {
         int pixelOffset = pAnchors[k0];
 
@@ -674,6 +766,7 @@ void EdgeDrawingImpl::JoinAnchorPointsUsingSortedAnchors()
         int noChains = 1;
         int len = 0;
         int duplicatePixelCount = 0;
+        bool hitBorder = false;
         int top = -1;  // top of the stack
 
         if (dirImg[i * width + j] == EDGE_VERTICAL)
@@ -779,7 +872,9 @@ StartOfWhile:
                         c--;
                     }
 
-                    if (edgeImg[r * width + c] == EDGE_PIXEL || gradImg[r * width + c] < gradThresh)
+                    bool outside = !roi.contains(Point(c, r));
+                    hitBorder |= outside;
+                    if (outside || edgeImg[r * width + c] == EDGE_PIXEL || gradImg[r * width + c] < gradThresh)
                     {
                         if (chainLen > 0)
                         {
@@ -865,7 +960,9 @@ StartOfWhile:
                         c++;
                     }
 
-                    if (edgeImg[r * width + c] == EDGE_PIXEL || gradImg[r * width + c] < gradThresh)
+                    bool outside = !roi.contains(Point(c, r));
+                    hitBorder |= outside;
+                    if (outside || edgeImg[r * width + c] == EDGE_PIXEL || gradImg[r * width + c] < gradThresh)
                     {
                         if (chainLen > 0)
                         {
@@ -951,7 +1048,9 @@ StartOfWhile:
                         r--;
                     }
 
-                    if (edgeImg[r * width + c] == EDGE_PIXEL || gradImg[r * width + c] < gradThresh)
+                    bool outside = !roi.contains(Point(c, r));
+                    hitBorder |= outside;
+                    if (outside || edgeImg[r * width + c] == EDGE_PIXEL || gradImg[r * width + c] < gradThresh)
                     {
                         if (chainLen > 0)
                         {
@@ -1037,7 +1136,9 @@ StartOfWhile:
                         r++;
                     }
 
-                    if (edgeImg[r * width + c] == EDGE_PIXEL || gradImg[r * width + c] < gradThresh)
+                    bool outside = !roi.contains(Point(c, r));
+                    hitBorder |= outside;
+                    if (outside || edgeImg[r * width + c] == EDGE_PIXEL || gradImg[r * width + c] < gradThresh)
                     {
                         if (chainLen > 0)
                         {
@@ -1074,7 +1175,8 @@ StartOfWhile:
             }
         }
 
-        if (len - duplicatePixelCount < params.MinPathLength)
+        bool shortSegment = len - duplicatePixelCount < params.MinPathLength;
+        if (shortSegment && (!hitBorder || len - duplicatePixelCount < 3))
         {
             for (int k1 = 0; k1 < len; k1++)
             {
@@ -1105,13 +1207,13 @@ StartOfWhile:
                     int index = noSegmentPixels - 2;
                     while (index >= 0)
                     {
-                        int dr = abs(fr - segmentPoints[segmentNos][index].y);
-                        int dc = abs(fc - segmentPoints[segmentNos][index].x);
+                        int dr = abs(fr - segs.back()[index].y);
+                        int dc = abs(fc - segs.back()[index].x);
 
                         if (dr <= 1 && dc <= 1)
                         {
                             // neighbors. Erase last pixel
-                            segmentPoints[segmentNos].pop_back();
+                            segs.back().pop_back();
                             noSegmentPixels--;
                             index--;
                         }
@@ -1124,8 +1226,8 @@ StartOfWhile:
                         fr = chains[chainNo].pixels[chains[chainNo].len - 2].y;
                         fc = chains[chainNo].pixels[chains[chainNo].len - 2].x;
 
-                        int dr = abs(fr - segmentPoints[segmentNos][noSegmentPixels - 1].y);
-                        int dc = abs(fc - segmentPoints[segmentNos][noSegmentPixels - 1].x);
+                        int dr = abs(fr - segs.back()[noSegmentPixels - 1].y);
+                        int dc = abs(fc - segs.back()[noSegmentPixels - 1].x);
 
                         if (dr <= 1 && dc <= 1)
                             chains[chainNo].len--;
@@ -1133,7 +1235,7 @@ StartOfWhile:
 
                     for (int l = chains[chainNo].len - 1; l >= 0; l--)
                     {
-                        segmentPoints[segmentNos].push_back(chains[chainNo].pixels[l]);
+                        segs.back().push_back(chains[chainNo].pixels[l]);
                         noSegmentPixels++;
                     }
 
@@ -1164,13 +1266,13 @@ StartOfWhile:
                     int index = noSegmentPixels - 2;
                     while (index >= 0)
                     {
-                        int dr = abs(fr - segmentPoints[segmentNos][index].y);
-                        int dc = abs(fc - segmentPoints[segmentNos][index].x);
+                        int dr = abs(fr - segs.back()[index].y);
+                        int dc = abs(fc - segs.back()[index].x);
 
                         if (dr <= 1 && dc <= 1)
                         {
                             // neighbors. Erase last pixel
-                            segmentPoints[segmentNos].pop_back();
+                            segs.back().pop_back();
                             noSegmentPixels--;
                             index--;
                         }
@@ -1185,8 +1287,8 @@ StartOfWhile:
                         fr = chains[chainNo].pixels[1].y;
                         fc = chains[chainNo].pixels[1].x;
 
-                        int dr = abs(fr - segmentPoints[segmentNos][noSegmentPixels - 1].y);
-                        int dc = abs(fc - segmentPoints[segmentNos][noSegmentPixels - 1].x);
+                        int dr = abs(fr - segs.back()[noSegmentPixels - 1].y);
+                        int dc = abs(fc - segs.back()[noSegmentPixels - 1].x);
 
                         if (dr <= 1 && dc <= 1)
                         {
@@ -1197,7 +1299,7 @@ StartOfWhile:
                     /* Start a new chain & copy pixels from the new chain */
                     for (int l = startIndex; l < chains[chainNo].len; l++)
                     {
-                        segmentPoints[segmentNos].push_back(chains[chainNo].pixels[l]);
+                        segs.back().push_back(chains[chainNo].pixels[l]);
                         noSegmentPixels++;
                     }
 
@@ -1206,20 +1308,24 @@ StartOfWhile:
             }
 
             // See if the first pixel can be cleaned up
-            int fr = segmentPoints[segmentNos][1].y;
-            int fc = segmentPoints[segmentNos][1].x;
+            int fr, fc, dr, dc;
+            if (noSegmentPixels >= 2)
+            {
+                fr = segs.back()[1].y;
+                fc = segs.back()[1].x;
 
-            int dr = abs(fr - segmentPoints[segmentNos][noSegmentPixels - 1].y);
-            int dc = abs(fc - segmentPoints[segmentNos][noSegmentPixels - 1].x);
+                dr = abs(fr - segs.back()[noSegmentPixels - 1].y);
+                dc = abs(fc - segs.back()[noSegmentPixels - 1].x);
 
-            if (dr <= 1 && dc <= 1)
-            {
-                segmentPoints[segmentNos].erase(segmentPoints[segmentNos].begin());
-                noSegmentPixels--;
+                if (dr <= 1 && dc <= 1)
+                {
+                    segs.back().erase(segs.back().begin());
+                    noSegmentPixels--;
+                }
             }
 
-            segmentNos++;
-            segmentPoints.push_back(vector<Point>()); // create empty vector of points for segments
+            shortSegs.push_back(shortSegment);
+            segs.push_back(vector<Point>()); // create empty vector of points for segments
 
             // Copy the rest of the long chains here
             for (int k4 = 2; k4 < noChains; k4++)
@@ -1247,13 +1353,13 @@ StartOfWhile:
                         int index = noSegmentPixels - 2;
                         while (index >= 0)
                         {
-                            dr = abs(fr - segmentPoints[segmentNos][index].y);
-                            dc = abs(fc - segmentPoints[segmentNos][index].x);
+                            dr = abs(fr - segs.back()[index].y);
+                            dc = abs(fc - segs.back()[index].x);
 
                             if (dr <= 1 && dc <= 1)
                             {
                                 // neighbors. Erase last pixel
-                                segmentPoints[segmentNos].pop_back();
+                                segs.back().pop_back();
                                 noSegmentPixels--;
                                 index--;
                             }
@@ -1268,8 +1374,8 @@ StartOfWhile:
                             fr = chains[chainNo].pixels[1].y;
                             fc = chains[chainNo].pixels[1].x;
 
-                            dr = abs(fr - segmentPoints[segmentNos][noSegmentPixels - 1].y);
-                            dc = abs(fc - segmentPoints[segmentNos][noSegmentPixels - 1].x);
+                            dr = abs(fr - segs.back()[noSegmentPixels - 1].y);
+                            dc = abs(fc - segs.back()[noSegmentPixels - 1].x);
 
                             if (dr <= 1 && dc <= 1)
                             {
@@ -1280,14 +1386,14 @@ StartOfWhile:
                         /* Start a new chain & copy pixels from the new chain */
                         for (int l = startIndex; l < chains[chainNo].len; l++)
                         {
-                            segmentPoints[segmentNos].push_back(chains[chainNo].pixels[l]);
+                            segs.back().push_back(chains[chainNo].pixels[l]);
                             noSegmentPixels++;
                         }
 
                         chains[chainNo].len = 0;  // Mark as copied
                     }
-                    segmentPoints.push_back(vector<Point>()); // create empty vector of points for segments
-                    segmentNos++;
+                    shortSegs.push_back(false);
+                    segs.push_back(vector<Point>()); // create empty vector of points for segments
                 }
             }
         }
@@ -1295,23 +1401,130 @@ StartOfWhile:
 
     // pop back last segment from vector
     // because of one preallocation in the beginning, it will always empty
-    segmentPoints.pop_back();
+    segs.pop_back();
 
     // Clean up
-    delete[] pAnchors;
     delete[] chains;
     delete[] stack;
     delete[] chainNos;
     delete[] pixels;
 }
 
-int* EdgeDrawingImpl::sortAnchorsByGradValue1() {
+// Joins segments of neighbouring tiles whose end points touch across a tile border. Chains of
+// joined segments are emitted in the order of their first segment; chains that contain a short
+// border piece and are still shorter than MinPathLength afterwards are removed from the edge map.
+void EdgeDrawingImpl::StitchTileSegments(int tileSize, std::vector<std::vector<Point> >& segs, const std::vector<uchar>& shortSegs)
+{
+    const int nsegs = (int)segs.size();
+
+    // end points lying on a tile border, keyed by pixel offset; ref = 2 * segment + (0 front, 1 back)
+    std::unordered_map<int, int> borderEnds;
+    for (int s = 0; s < nsegs; s++)
+    {
+        if (segs[s].size() < 2)
+            continue;
+        for (int e = 0; e < 2; e++)
+        {
+            const Point& p = e == 0 ? segs[s].front() : segs[s].back();
+            int tx = p.x % tileSize, ty = p.y % tileSize;
+            if (tx == 0 || ty == 0 || tx == tileSize - 1 || ty == tileSize - 1)
+                borderEnds.insert(std::make_pair(p.y * width + p.x, 2 * s + e));
+        }
+    }
+
+    std::vector<int> link(2 * nsegs, -1);
+    for (int s = 0; s < nsegs; s++)
+    {
+        if (segs[s].size() < 2)
+            continue;
+        for (int e = 0; e < 2; e++)
+        {
+            const Point p = e == 0 ? segs[s].front() : segs[s].back();
+            if (link[2 * s + e] >= 0 || borderEnds.find(p.y * width + p.x) == borderEnds.end())
+                continue;
+
+            for (int k = 0; k < 8 && link[2 * s + e] < 0; k++)
+            {
+                static const int dx[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+                static const int dy[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+                Point q(p.x + dx[k], p.y + dy[k]);
+                if (q.x < 0 || q.y < 0 || q.x >= width || q.y >= height ||
+                    (q.x / tileSize == p.x / tileSize && q.y / tileSize == p.y / tileSize))
+                    continue;
+
+                std::unordered_map<int, int>::const_iterator it = borderEnds.find(q.y * width + q.x);
+                if (it == borderEnds.end() || it->second / 2 == s || link[it->second] >= 0)
+                    continue;
+
+                link[2 * s + e] = it->second;
+                link[it->second] = 2 * s + e;
+            }
+        }
+    }
+
+    std::vector<std::vector<Point> > stitched;
+    std::vector<uchar> visited(nsegs, 0);
+    for (int s = 0; s < nsegs; s++)
+    {
+        if (visited[s])
+            continue;
+
+        // walk back to the first segment of the chain; closed chains start at s
+        int seg = s, enter = 0;
+        for (int steps = 0; steps < nsegs && link[2 * seg + enter] >= 0; steps++)
+        {
+            int prev = link[2 * seg + enter];
+            if (prev / 2 == s)
+                break;
+            seg = prev / 2;
+            enter = 1 - prev % 2;
+        }
+        if (link[2 * seg + enter] >= 0 && link[2 * seg + enter] / 2 == s && seg != s)
+        {
+            seg = s;
+            enter = 0;
+        }
+
+        std::vector<Point> chain;
+        bool hasShortPiece = false;
+        while (!visited[seg])
+        {
+            visited[seg] = 1;
+            hasShortPiece |= shortSegs[seg] != 0;
+            if (enter == 0)
+                chain.insert(chain.end(), segs[seg].begin(), segs[seg].end());
+            else
+                chain.insert(chain.end(), segs[seg].rbegin(), segs[seg].rend());
+
+            int next = link[2 * seg + 1 - enter];
+            if (next < 0)
+                break;
+            seg = next / 2;
+            enter = next % 2;
+        }
+
+        if (hasShortPiece && (int)chain.size() < params.MinPathLength)
+        {
+            for (size_t k = 0; k < chain.size(); k++)
+                edgeImg[chain[k].y * width + chain[k].x] = 0;
+            continue;
+        }
+        stitched.push_back(chain);
+    }
+
+    segs.swap(stitched);
+}
+
+void EdgeDrawingImpl::sortAnchorsByGradValue(const Rect& roi, std::vector<int>& anchors) const {
     const int SIZE = 128 * 256;
     std::vector<int> C(SIZE, 0);
 
+    const int rowStart = std::max(roi.y, 1), rowEnd = std::min(roi.y + roi.height, height - 1);
+    const int colStart = std::max(roi.x, 1), colEnd = std::min(roi.x + roi.width, width - 1);
+
     // Count the number of grad values
-    for (int i = 1; i < height - 1; i++) {
-        for (int j = 1; j < width - 1; j++) {
+    for (int i = rowStart; i < rowEnd; i++) {
+        for (int j = colStart; j < colEnd; j++) {
             if (edgeImg[i * width + j] != ANCHOR_PIXEL)
                 continue;
 
@@ -1326,20 +1539,18 @@ int* EdgeDrawingImpl::sortAnchorsByGradValue1() {
     }
 
     int noAnchors = C[SIZE - 1];
-    int* A = new int[noAnchors];
+    anchors.resize(noAnchors);
 
-    for (int i = 1; i < height - 1; i++) {
-        for (int j = 1; j < width - 1; j++) {
+    for (int i = rowStart; i < rowEnd; i++) {
+        for (int j = colStart; j < colEnd; j++) {
             if (edgeImg[i * width + j] != ANCHOR_PIXEL)
                 continue;
 
             int grad = gradImg[i * width + j];
             int index = --C[grad];
-            A[index] = i * width + j;    // anchor's offset
+            anchors[index] = i * width + j;    // anchor's offset
         }
     }
-
-    return A;
 }
 
 int EdgeDrawingImpl::LongestChain(Chain* chains, int root) {
@@ -1393,24 +1604,35 @@ void EdgeDrawingImpl::detectLines(OutputArray _lines)
     if (min_line_len < 9) // avoids small line segments in the result. Might be deleted!
         min_line_len = 9;
 
-    // Temporary buffers used during line fitting
-    double* x = new double[(width + height) * 8];
-    double* y = new double[(width + height) * 8];
-
-    lines.clear();
-    linesNo = 0;
-
-    // Use the whole segment
-    for (size_t segmentNumber = 0; segmentNumber < segmentPoints.size(); segmentNumber++)
+    // Use the whole segment. Segments are split independently, and their lines are
+    // gathered in segment order afterwards.
+    const int noSegments = (int)segmentPoints.size();
+    std::vector<std::vector<EDLineSegment> > segmentLines(noSegments);
+    parallel_for_(Range(0, noSegments), [&](const Range& range)
     {
-        std::vector<Point> segment = segmentPoints[segmentNumber];
-        for (int k = 0; k < (int)segment.size(); k++)
+        // Temporary buffers used during line fitting
+        std::vector<double> x, y;
+        for (int segmentNumber = range.start; segmentNumber < range.end; segmentNumber++)
         {
-            x[k] = segment[k].x;
-            y[k] = segment[k].y;
+            const std::vector<Point>& segment = segmentPoints[segmentNumber];
+            if ((int)segment.size() < min_line_len)
+                continue;
+
+            x.resize(segment.size());
+            y.resize(segment.size());
+            for (int k = 0; k < (int)segment.size(); k++)
+            {
+                x[k] = segment[k].x;
+                y[k] = segment[k].y;
+            }
+            SplitSegment2Lines(&x[0], &y[0], (int)segment.size(), segmentNumber, segmentLines[segmentNumber]);
         }
-        SplitSegment2Lines(x, y, (int)segment.size(), (int)segmentNumber);
-    }
+    }, std::max(1., noSegments / 64.));
+
+    lines.clear();
+    for (int i = 0; i < noSegments; i++)
+        lines.insert(lines.end(), segmentLines[i].begin(), segmentLines[i].end());
+    linesNo = (int)lines.size();
 
     JoinCollinearLines();
 
@@ -1431,9 +1653,6 @@ void EdgeDrawingImpl::detectLines(OutputArray _lines)
         segmentIndicesOfLines.push_back(lines[i].segmentNo);
     }
     Mat(linePoints).copyTo(_lines);
-
-    delete[] x;
-    delete[] y;
 }
 
 // Computes the minimum line length using the NFA formula given width & height values
@@ -1453,7 +1672,7 @@ int EdgeDrawingImpl::ComputeMinLineLength()
 // Given a full segment of pixels, splits the chain to lines
 // This code is used when we use the whole segment of pixels
 //
-void EdgeDrawingImpl::SplitSegment2Lines(double* x, double* y, int noPixels, int segmentNo)
+void EdgeDrawingImpl::SplitSegment2Lines(double* x, double* y, int noPixels, int segmentNo, std::vector<EDLineSegment>& segmentLines) const
 {
     // First pixel of the line segment within the segment of points
     int firstPixelIndex = 0;
@@ -1540,8 +1759,7 @@ void EdgeDrawingImpl::SplitSegment2Lines(double* x, double* y, int noPixels, int
                     break;
 
                 // Add the line segment to lines
-                lines.push_back(EDLineSegment(lastA, lastB, lastInvert, sx, sy, ex, ey, segmentNo, firstPixelIndex + noSkippedPixels, index - noSkippedPixels + 1));
-                linesNo++;
+                segmentLines.push_back(EDLineSegment(lastA, lastB, lastInvert, sx, sy, ex, ey, segmentNo, firstPixelIndex + noSkippedPixels, index - noSkippedPixels + 1));
                 len = index + 1;
 
                 break;
@@ -1617,108 +1835,113 @@ void EdgeDrawingImpl::ValidateLineSegments()
         nfa = new NFALUT(lutSize, prob, logNT);
     }
 
-    int* x = new int[(width + height) * 4];
-    int* y = new int[(width + height) * 4];
+    // Lines are validated independently, the valid ones are compacted in their original order
+    std::vector<uchar> valid(linesNo, 0);
+    parallel_for_(Range(0, linesNo), [&](const Range& range)
+    {
+        std::vector<int> x((width + height) * 4), y((width + height) * 4);
+        for (int i = range.start; i < range.end; i++)
+            valid[i] = ValidateLineSegment(&x[0], &y[0], &lines[i]);
+    }, std::max(1., linesNo / 64.));
 
     int noValidLines = 0;
-
     for (int i = 0; i < linesNo; i++)
     {
-        EDLineSegment* ls = &lines[i];
-
-        // Compute Line's angle
-        double lineAngle;
-
-        if (ls->invert == 0)
-        {
-            // y = a + bx
-            lineAngle = atan(ls->b);
-        }
-        else
+        if (valid[i])
         {
-            // x = a + by
-            lineAngle = atan(1.0 / ls->b);
+            if (i != noValidLines)
+                lines[noValidLines] = lines[i];
+            noValidLines++;
         }
+    }
 
-        if (lineAngle < 0)
-            lineAngle += CV_PI;
+    linesNo = noValidLines;
+}
 
-        Point* pixels = &(segmentPoints[ls->segmentNo][0]);
-        int noPixels = ls->len;
+bool EdgeDrawingImpl::ValidateLineSegment(int* x, int* y, EDLineSegment* ls)
+{
+    // Compute Line's angle
+    double lineAngle;
 
-        bool valid = false;
+    if (ls->invert == 0)
+    {
+        // y = a + bx
+        lineAngle = atan(ls->b);
+    }
+    else
+    {
+        // x = a + by
+        lineAngle = atan(1.0 / ls->b);
+    }
 
-        // Accept very long lines without testing. They are almost never invalidated.
-        if (ls->len >= 80)
-        {
-            valid = true;
-            // Validate short line segments by a line support region rectangle having width=2
-        }
-        else if (ls->len <= 25)
-        {
-            valid = ValidateLineSegmentRect(x, y, ls);
-        }
-        else
-        {
-            // Longer line segments are first validated by a line support region rectangle having width=1 (for speed)
-            // If the line segment is still invalid, then a line support region rectangle having width=2 is tried
-            // If the line segment fails both tests, it is discarded
-            int aligned = 0;
-            int count = 0;
-            for (int j = 0; j < noPixels; j++)
-            {
-                int r = pixels[j].x;
-                int c = pixels[j].y;
+    if (lineAngle < 0)
+        lineAngle += CV_PI;
 
-                if (r <= 0 || r >= height - 1 || c <= 0 || c >= width - 1)
-                    continue;
+    Point* pixels = &(segmentPoints[ls->segmentNo][0]);
+    int noPixels = ls->len;
 
-                count++;
+    bool valid = false;
 
-                // compute gx & gy using the simple [-1 -1 -1]
-                //                                  [ 1  1  1]  filter in both directions
-                // Faster method below
-                // A B C
-                // D x E
-                // F G H
-                // gx = (C-A) + (E-D) + (H-F)
-                // gy = (F-A) + (G-B) + (H-C)
-                //
-                // To make this faster:
-                // com1 = (H-A)
-                // com2 = (C-F)
-                // Then: gx = com1 + com2 + (E-D) = (H-A) + (C-F) + (E-D) = (C-A) + (E-D) + (H-F)
-                //       gy = com2 - com1 + (G-B) = (H-A) - (C-F) + (G-B) = (F-A) + (G-B) + (H-C)
-                //
-                int com1 = srcImg[(r + 1) * width + c + 1] - srcImg[(r - 1) * width + c - 1];
-                int com2 = srcImg[(r - 1) * width + c + 1] - srcImg[(r + 1) * width + c - 1];
+    // Accept very long lines without testing. They are almost never invalidated.
+    if (ls->len >= 80)
+    {
+        valid = true;
+        // Validate short line segments by a line support region rectangle having width=2
+    }
+    else if (ls->len <= 25)
+    {
+        valid = ValidateLineSegmentRect(x, y, ls);
+    }
+    else
+    {
+        // Longer line segments are first validated by a line support region rectangle having width=1 (for speed)
+        // If the line segment is still invalid, then a line support region rectangle having width=2 is tried
+        // If the line segment fails both tests, it is discarded
+        int aligned = 0;
+        int count = 0;
+        for (int j = 0; j < noPixels; j++)
+        {
+            int r = pixels[j].x;
+            int c = pixels[j].y;
 
-                int gx = com1 + com2 + srcImg[r * width + c + 1] - srcImg[r * width + c - 1];
-                int gy = com1 - com2 + srcImg[(r + 1) * width + c] - srcImg[(r - 1) * width + c];
+            if (r <= 0 || r >= height - 1 || c <= 0 || c >= width - 1)
+                continue;
 
-                double pixelAngle = nfa->myAtan2((double)gx, (double)-gy);
-                double diff = fabs(lineAngle - pixelAngle);
+            count++;
 
-                if (diff <= precision || diff >= CV_PI - precision)
-                    aligned++;
-            }
+            // compute gx & gy using the simple [-1 -1 -1]
+            //                                  [ 1  1  1]  filter in both directions
+            // Faster method below
+            // A B C
+            // D x E
+            // F G H
+            // gx = (C-A) + (E-D) + (H-F)
+            // gy = (F-A) + (G-B) + (H-C)
+            //
+            // To make this faster:
+            // com1 = (H-A)
+            // com2 = (C-F)
+            // Then: gx = com1 + com2 + (E-D) = (H-A) + (C-F) + (E-D) = (C-A) + (E-D) + (H-F)
+            //       gy = com2 - com1 + (G-B) = (H-A) - (C-F) + (G-B) = (F-A) + (G-B) + (H-C)
+            //
+            int com1 = srcImg[(r + 1) * width + c + 1] - srcImg[(r - 1) * width + c - 1];
+            int com2 = srcImg[(r - 1) * width + c + 1] - srcImg[(r + 1) * width + c - 1];
 
-            // Check validation by NFA computation (fast due to LUT)
-            valid = nfa->checkValidationByNFA(count, aligned) || ValidateLineSegmentRect(x, y, ls);
-        }
+            int gx = com1 + com2 + srcImg[r * width + c + 1] - srcImg[r * width + c - 1];
+            int gy = com1 - com2 + srcImg[(r + 1) * width + c] - srcImg[(r - 1) * width + c];
 
-        if (valid)
-        {
-            if (i != noValidLines)
-                lines[noValidLines] = lines[i];
-            noValidLines++;
+            double pixelAngle = nfa->myAtan2((double)gx, (double)-gy);
+            double diff = fabs(lineAngle - pixelAngle);
+
+            if (diff <= precision || diff >= CV_PI - precision)
+                aligned++;
         }
-    }
 
-    linesNo = noValidLines;
+        // Check validation by NFA computation (fast due to LUT)
+        valid = nfa->checkValidationByNFA(count, aligned) || ValidateLineSegmentRect(x, y, ls);
+    }
 
-    delete[] x;
-    delete[] y;
+    return valid;
 }
 
 bool EdgeDrawingImpl::ValidateLineSegmentRect(int* x, int* y, EDLineSegment* ls)
@@ -2413,7 +2636,7 @@ void EdgeDrawingImpl::EnumerateRectPoints(double sx, double sy, double ex, doubl
 // Resursive validation using half of the pixels as suggested by DMM algorithm
 // We take pixels at Nyquist distance, i.e., 2 (as suggested by DMM)
 //
-void EdgeDrawingImpl::TestSegment(int i, int index1, int index2)
+void EdgeDrawingImpl::TestSegment(int i, int index1, int index2, std::vector<Vec2i>& validRanges)
 {
     int chainLen = index2 - index1 + 1;
     if (chainLen < params.MinPathLength)
@@ -2435,12 +2658,7 @@ void EdgeDrawingImpl::TestSegment(int i, int index1, int index2)
     double nfa0 = NFA(dH[minGrad], (int)(chainLen / divForTestSegment));
 
     if (nfa0 <= 1.0) {
-        for (int k = index1; k <= index2; k++) {
-            int r = segmentPoints[i][k].y;
-            int c = segmentPoints[i][k].x;
-
-            edgeImg[r * width + c] = 255;
-        }
+        validRanges.push_back(Vec2i(index1, index2));
         return;
     }
 
@@ -2463,8 +2681,8 @@ void EdgeDrawingImpl::TestSegment(int i, int index1, int index2)
         else break;
     }
 
-    TestSegment(i, index1, end);
-    TestSegment(i, start, index2);
+    TestSegment(i, index1, end, validRanges);
+    TestSegment(i, start, index2, validRanges);
 }
 
 // After validating the edge segments, this function extracts the valid ones.
@@ -2634,7 +2852,7 @@ void EdgeDrawingImpl::detectEllipses(OutputArray ellipses)
             }
         }
         // Otherwise, split to lines
-        SplitSegment2Lines(x, y, noPixels, i);
+        SplitSegment2Lines(x, y, noPixels, i, lines);
     }
 
     min_line_len = params.MinLineLength;
@@ -3211,8 +3429,6 @@ void EdgeDrawingImpl::ValidateCircles(bool validate)
     precision = CV_PI / 16;  // Alignment precision
 
     int points_buffer_size = 8 * (width + height);
-    double *px = new double[points_buffer_size];
-    double *py = new double[points_buffer_size];
 
     if (nfa->LUTSize == 1 && params.NFAValidation)
     {
@@ -3222,32 +3438,44 @@ void EdgeDrawingImpl::ValidateCircles(bool validate)
         nfa = new NFALUT(lutSize, prob, logNT); // create look up table
     }
 
-    // Validate circles & ellipses
-    bool validateAgain;
+    // Validate circles & ellipses. Candidates are independent, the valid ones are
+    // compacted in their original order.
+    std::vector<uchar> valid(noCircles1, 0);
+    parallel_for_(Range(0, noCircles1), [&](const Range& range)
+    {
+        std::vector<double> px(points_buffer_size), py(points_buffer_size);
+        for (int i = range.start; i < range.end; i++)
+            valid[i] = ValidateCircle(&circles1[i], &px[0], &py[0], points_buffer_size, validate);
+    });
+
     int count = 0;
-    for (int i = 0; i < noCircles1; )
+    for (int i = 0; i < noCircles1; i++)
+    {
+        if (valid[i])
+            circles2[count++] = circles1[i];
+    }
+
+    noCircles2 = count;
+}
+
+// Validates a single candidate. A circle that fails but covers enough of its perimeter is refitted
+// as an ellipse in place and validated again.
+bool EdgeDrawingImpl::ValidateCircle(Circle* circle, double* px, double* py, int points_buffer_size, bool validate)
+{
+    for (;;)
     {
-        Circle* circle = &circles1[i];
         double xc = circle->xc;
         double yc = circle->yc;
         double radius = circle->r;
 
         // Skip potential invalid circles (sometimes these kinds of candidates get generated!)
         if (radius > MAX(width, height))
-        {
-            i++;
-            continue;
-        }
-
-        validateAgain = false;
+            return false;
 
         int noPoints = (int)(computeEllipsePerimeter(&circle->eq));
 
         if (noPoints > points_buffer_size)
-        {
-            i++;
-            continue;
-        }
+            return false;
 
         if (circle->isEllipse)
         {
@@ -3440,38 +3668,27 @@ void EdgeDrawingImpl::ValidateCircles(bool validate)
         bool isValid = !validate || nfa->checkValidationByNFA(noPeripheryPixels, aligned);
 
         if (isValid)
-        {
-            circles2[count++] = circles1[i];
-        }
-        else if (circle->isEllipse == false && circle->coverRatio >= CANDIDATE_ELLIPSE_RATIO)
-        {
-            // Fit an ellipse to this circle, and try to revalidate
-            double ellipseFitError = 1e10;
-            EllipseEquation eq;
+            return true;
 
-            if (EllipseFit(circle->x, circle->y, circle->noPixels, &eq))
-            {
-                ellipseFitError = ComputeEllipseError(&eq, circle->x, circle->y, circle->noPixels);
-            }
+        if (circle->isEllipse || circle->coverRatio < CANDIDATE_ELLIPSE_RATIO)
+            return false;
 
-            if (ellipseFitError <= ELLIPSE_ERROR)
-            {
-                circle->isEllipse = true;
-                circle->ellipseFitError = ellipseFitError;
-                circle->eq = eq;
+        // Fit an ellipse to this circle, and try to revalidate
+        double ellipseFitError = 1e10;
+        EllipseEquation eq;
 
-                validateAgain = true;
-            }
+        if (EllipseFit(circle->x, circle->y, circle->noPixels, &eq))
+        {
+            ellipseFitError = ComputeEllipseError(&eq, circle->x, circle->y, circle->noPixels);
         }
 
-        if (validateAgain == false)
-            i++;
-    }
-
-    noCircles2 = count;
+        if (ellipseFitError > ELLIPSE_ERROR)
+            return false;
 
-    delete[] px;
-    delete[] py;
+        circle->isEllipse = true;
+        circle->ellipseFitError = ellipseFitError;
+        circle->eq = eq;
+    }
 }
 
 void EdgeDrawingImpl::JoinCircles()
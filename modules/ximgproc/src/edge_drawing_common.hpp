@@ -125,7 +125,6 @@ double NFALUT::myAtan2(double yy, double xx)
 
 double NFALUT::nfa(int n, int k)
 {
-    static double inv[TABSIZE];   /* table to keep computed inverse values */
     double tolerance = 0.1;       /* an error of 10% in the result is accepted */
     double log1term, term, bin_term, mult_term, bin_tail, err, p_term;
     int i;
@@ -173,13 +172,9 @@ double NFALUT::nfa(int n, int k)
         term_i / term_i-1 = (n-i+1)/i * p/(1-p)
         and
         term_i = term_i-1 * (n-i+1)/i * p/(1-p).
-        1/i is stored in a table as they are computed,
-        because divisions are expensive.
         p/(1-p) is computed only once and stored in 'p_term'.
         */
-        bin_term = (double)(n - i + 1) * (i < TABSIZE ?
-            (inv[i] != 0.0 ? inv[i] : (inv[i] = 1.0 / (double)i)) :
-            1.0 / (double)i);
+        bin_term = (double)(n - i + 1) * (1.0 / (double)i);
 
         mult_term = bin_term * p_term;
         term *= mult_term;
@@ -48,6 +48,7 @@ OpenCV port by: Leonardo Lontra <lhe dot lontra at gmail dot com>
 */
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 using namespace cv;
 using namespace std;
 
@@ -160,18 +161,29 @@ private:
     vector<float> _scaleNorm;
     float _sxStep, _ayStep, _xyStepRatio;
 
-    // data structures for efficiency (see scoreBox)
-    Mat _sWts;
-    Mat _sDone, _sMap, _sIds;
-    int _sId;
+    // data structures for efficiency (see scoreBox), one per thread
+    struct ScoreBuffers
+    {
+        vector<float> wts;
+        vector<int> done, map, ids;
+        int id;
+        explicit ScoreBuffers(int n) : wts(n, 0.f), done(n, -1), map(n, 0), ids(n, 0), id(0) {}
+    };
+
+    // boxes of one size sharing their x position (see scoreAllBoxes)
+    struct BoxColumn
+    {
+        int x, w, h, yStep;
+    };
 
     // helper routines
     static bool boxesCompare(const Box &a, const Box &b) { return a.score < b.score; }
     void clusterEdges(Mat &edgeMap, Mat &orientationMap);
     void prepDataStructs(Mat &edgeMap);
     void scoreAllBoxes(Boxes &boxes);
-    void scoreBox(Box &box);
-    void refineBox(Box &box);
+    void scoreColumn(const BoxColumn &column, ScoreBuffers &buf, Boxes &boxes) const;
+    void scoreBox(Box &box, ScoreBuffers &buf) const;
+    void refineBox(Box &box, ScoreBuffers &buf) const;
     float boxesOverlap(Box &a, Box &b);
     void boxesNms(Boxes &boxes, float thr, float eta, int maxBoxes);
 };
@@ -523,63 +535,62 @@ void EdgeBoxesImpl::prepDataStructs(Mat &edgeMap)
     }
 
     // create remaining data structures
-    int s = 0;
-    int s1;
-
     _hIdxs.resize(h);
     _hIdxImg = Mat::zeros(w, h, DataType<int>::type);
-    for (y = 0; y < h; y++)
+    parallel_for_(Range(0, h), [&](const Range &range)
     {
-        s = 0;
-        _hIdxs[y].push_back(s);
-        for (x = 0; x < w; x++)
+        for (int yy = range.start; yy < range.end; yy++)
         {
-            s1 = _segIds.at<int>(x, y);
-            if (s1 != s)
+            vector<int> &idxs = _hIdxs[yy];
+            int s = 0;
+            idxs.assign(1, s);
+            for (int xx = 0; xx < w; xx++)
             {
-                s = s1;
-                _hIdxs[y].push_back(s);
+                int s1 = _segIds.at<int>(xx, yy);
+                if (s1 != s)
+                {
+                    s = s1;
+                    idxs.push_back(s);
+                }
+                _hIdxImg.at<int>(xx, yy) = (int)idxs.size() - 1;
             }
-            _hIdxImg.at<int>(x, y) = (int)_hIdxs[y].size() - 1;
         }
-    }
+    });
 
     _vIdxs.resize(w);
     _vIdxImg = Mat::zeros(w, h, DataType<int>::type);
-    for (x = 0; x < w; x++)
+    parallel_for_(Range(0, w), [&](const Range &range)
     {
-        s = 0;
-        _vIdxs[x].push_back(s);
-        for (y = 0; y < h; y++)
+        for (int xx = range.start; xx < range.end; xx++)
         {
-            s1 = _segIds.at<int>(x, y);
-            if (s1 != s)
+            vector<int> &idxs = _vIdxs[xx];
+            const int *s_ptr = _segIds.ptr<int>(xx);
+            int *v_ptr = _vIdxImg.ptr<int>(xx);
+            int s = 0;
+            idxs.assign(1, s);
+            for (int yy = 0; yy < h; yy++)
             {
-                s = s1;
-                _vIdxs[x].push_back(s);
+                int s1 = s_ptr[yy];
+                if (s1 != s)
+                {
+                    s = s1;
+                    idxs.push_back(s);
+                }
+                v_ptr[yy] = (int)idxs.size() - 1;
             }
-            _vIdxImg.at<int>(x, y) = (int)_vIdxs[x].size() - 1;
         }
-    }
-
-    // initialize scoreBox() data structures
-    int n = _segCnt + 1;
-    _sWts = Mat::zeros(n, 1, DataType<float>::type);
-    _sDone = Mat(n, 1, DataType<int>::type,Scalar(-1));
-    _sMap = Mat::zeros(n, 1, DataType<int>::type);
-    _sIds = Mat::zeros(n, 1, DataType<int>::type);
-    _sId = 0;
+    });
 }
 
 
-void EdgeBoxesImpl::scoreBox(Box &box)
+void EdgeBoxesImpl::scoreBox(Box &box, ScoreBuffers &buf) const
 {
     int i, j, k, q, bh, bw, y0, x0, y1, x1, y0m, y1m, x0m, x1m;
-    float *sWts = (float *)_sWts.data;
-    int *sDone = (int *)_sDone.data;
-    int *sMap = (int *)_sMap.data;
-    int *sIds = (int *)_sIds.data;
-    int sId = _sId++;
+    float *sWts = buf.wts.data();
+    int *sDone = buf.done.data();
+    int *sMap = buf.map.data();
+    int *sIds = buf.ids.data();
+    int sId = buf.id++;
 
     // add edge count inside box
     y1 = clamp(box.y + box.h, 0, h - 1);
@@ -708,7 +719,7 @@ void EdgeBoxesImpl::scoreBox(Box &box)
 }
 
 
-void EdgeBoxesImpl::refineBox(Box &box)
+void EdgeBoxesImpl::refineBox(Box &box, ScoreBuffers &buf) const
 {
     int yStep = (int)(box.h * _xyStepRatio);
     int xStep = (int)(box.w * _xyStepRatio);
@@ -725,62 +736,131 @@ void EdgeBoxesImpl::refineBox(Box &box)
         B = box;
         B.y = box.y - yStep;
         B.h = B.h + yStep;
-        scoreBox(B);
+        scoreBox(B, buf);
 
         if (B.score <= box.score)
         {
             B = box;
             B.y = box.y + yStep;
             B.h = B.h - yStep;
-            scoreBox(B);
+            scoreBox(B, buf);
         }
         if (B.score > box.score) box = B;
         // search over y end
         B = box;
         B.h = B.h + yStep;
-        scoreBox(B);
+        scoreBox(B, buf);
 
         if (B.score <= box.score)
         {
             B = box;
             B.h = B.h - yStep;
-            scoreBox(B);
+            scoreBox(B, buf);
         }
         if (B.score > box.score) box = B;
         // search over x start
         B = box;
         B.x = box.x - xStep;
         B.w = B.w + xStep;
-        scoreBox(B);
+        scoreBox(B, buf);
 
         if (B.score <= box.score)
         {
             B = box;
             B.x = box.x + xStep;
             B.w = B.w - xStep;
-            scoreBox(B);
+            scoreBox(B, buf);
         }
 
         if (B.score > box.score) box = B;
         // search over x end
         B = box;
         B.w = B.w + xStep;
-        scoreBox(B);
+        scoreBox(B, buf);
 
         if (B.score <= box.score)
         {
             B = box;
             B.w = B.w - xStep;
-            scoreBox(B);
+            scoreBox(B, buf);
         }
         if (B.score > box.score) box = B;
     }
 }
 
+void EdgeBoxesImpl::scoreColumn(const BoxColumn &column, ScoreBuffers &buf, Boxes &boxes) const
+{
+    int cnt = 0;
+    for (int y = 0; y < h - column.h + column.yStep; y += column.yStep) cnt++;
+    if (cnt == 0) return;
+
+    // the integral image terms of scoreBox() for all boxes of the column; they only
+    // differ in their y range, which indexes the rows of the transposed integral images
+    int x0 = clamp(column.x, 0, w - 1);
+    int x1 = clamp(column.x + column.w, 0, w - 1);
+    int bw = (x1 - x0) / 2;
+    int x0m = x0 + bw / 2;
+    int x1m = x0m + bw;
+    const float *si0 = _segIImg.ptr<float>(x0), *si1 = _segIImg.ptr<float>(x1 + 1);
+    const float *mi0 = _magIImg.ptr<float>(x0m), *mi1 = _magIImg.ptr<float>(x1m + 1);
+
+    AutoBuffer<int> idxBuf(cnt * 5);
+    AutoBuffer<float> scores(cnt);
+    int *iy0 = idxBuf.data(), *iy1 = iy0 + cnt, *iy0m = iy1 + cnt, *iy1m = iy0m + cnt;
+    int *inorm = iy1m + cnt;
+    for (int n = 0; n < cnt; n++)
+    {
+        int y = n * column.yStep;
+        int y0 = clamp(y, 0, h - 1);
+        int y1 = clamp(y + column.h, 0, h - 1);
+        int bh = (y1 - y0) / 2;
+        iy0[n] = y0;
+        iy1[n] = y1 + 1;
+        iy0m[n] = y0 + bh / 2;
+        iy1m[n] = iy0m[n] + bh + 1;
+        inorm[n] = bw + bh;
+    }
+
+    int n = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int vlanes = VTraits<v_float32>::vlanes();
+    for (; n <= cnt - vlanes; n += vlanes)
+    {
+        v_float32 v = v_sub(v_sub(v_add(v_lut(si0, iy0 + n), v_lut(si1, iy1 + n)),
+                                  v_lut(si1, iy0 + n)), v_lut(si0, iy1 + n));
+        v_float32 m = v_sub(v_sub(v_add(v_lut(mi0, iy0m + n), v_lut(mi1, iy1m + n)),
+                                  v_lut(mi1, iy0m + n)), v_lut(mi0, iy1m + n));
+        v_store(scores.data() + n, v_mul(v_sub(v, m), v_lut(_scaleNorm.data(), inorm + n)));
+    }
+#endif
+    for (; n < cnt; n++)
+    {
+        float v = si0[iy0[n]] + si1[iy1[n]] - si1[iy0[n]] - si0[iy1[n]];
+        v -= mi0[iy0m[n]] + mi1[iy1m[n]] - mi1[iy0m[n]] - mi0[iy1m[n]];
+        scores[n] = v * _scaleNorm[inorm[n]];
+    }
+
+    // score boxes passing the short circuit of scoreBox(), refine top candidates
+    for (n = 0; n < cnt; n++)
+    {
+        if (scores[n] < _minScore) continue;
+        Box b;
+        b.y = n * column.yStep;
+        b.x = column.x;
+        b.h = column.h;
+        b.w = column.w;
+        scoreBox(b, buf);
+        if (!b.score) continue;
+        refineBox(b, buf);
+        boxes.push_back(b);
+    }
+}
+
 void EdgeBoxesImpl::scoreAllBoxes(Boxes &boxes)
 {
-    // get list of all boxes roughly distributed in grid
-    boxes.resize(0);
+    // get list of all boxes roughly distributed in grid, one column of boxes per
+    // scale, aspect ratio and x position
+    vector<BoxColumn> columns;
     int ayRad, sxNum;
     float minSize = sqrt(_minBoxArea);
     ayRad = (int)(log(_maxAspectRatio) / log(_ayStep * _ayStep));
@@ -788,7 +868,7 @@ void EdgeBoxesImpl::scoreAllBoxes(Boxes &boxes)
 
     for (int s = 0; s < sxNum; s++)
     {
-        int a, y, x, bh, bw, ky, kx = -1;
+        int a, x, bh, bw, ky, kx = -1;
         float ay, sx;
         for (a = 0; a < 2 * ayRad + 1; a++)
         {
@@ -800,30 +880,31 @@ void EdgeBoxesImpl::scoreAllBoxes(Boxes &boxes)
             kx = max(2, (int)(bw * _xyStepRatio));
             for (x = 0; x < w - bw + kx; x += kx)
             {
-                for (y = 0; y < h - bh + ky; y += ky)
-                {
-                    Box b;
-                    b.y = y;
-                    b.x = x;
-                    b.h = bh;
-                    b.w = bw;
-                    boxes.push_back(b);
-                }
+                BoxColumn c;
+                c.x = x;
+                c.w = bw;
+                c.h = bh;
+                c.yStep = ky;
+                columns.push_back(c);
             }
         }
     }
 
-    // score all boxes, refine top candidates
-    int i, k = 0, m = (int)boxes.size();
-    for (i = 0; i < m; i++)
+    // score all boxes, refine top candidates; the candidates of each column are kept
+    // apart and merged in grid order, so the result does not depend on the threads
+    int nColumns = (int)columns.size();
+    vector<Boxes> candidates(nColumns);
+    parallel_for_(Range(0, nColumns), [&](const Range &range)
     {
-        scoreBox(boxes[i]);
-        if (!boxes[i].score) continue;
-        k++;
-        refineBox(boxes[i]);
-    }
+        ScoreBuffers buf(_segCnt + 1);
+        for (int i = range.start; i < range.end; i++)
+            scoreColumn(columns[i], buf, candidates[i]);
+    }, std::min(nColumns, max(1, getNumThreads()) * 4));
+
+    boxes.resize(0);
+    for (int i = 0; i < nColumns; i++)
+        boxes.insert(boxes.end(), candidates[i].begin(), candidates[i].end());
     sort(boxes.rbegin(), boxes.rend(), boxesCompare);
-    boxes.resize(k);
 }
 
 
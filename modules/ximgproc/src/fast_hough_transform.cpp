@@ -42,6 +42,8 @@
 //M*/
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+#include <type_traits>
 
 namespace cv { namespace ximgproc {
 
@@ -49,67 +51,178 @@ namespace cv { namespace ximgproc {
     typedef __int32 int32_t;
 #endif
 
+struct HoughVecAdd {
+    template <typename V> V operator()(const V &a, const V &b) const { return v_add(a, b); }
+};
+struct HoughVecMin {
+    template <typename V> V operator()(const V &a, const V &b) const { return v_min(a, b); }
+};
+struct HoughVecMax {
+    template <typename V> V operator()(const V &a, const V &b) const { return v_max(a, b); }
+};
+
+// vectorized part of a row operation, returns the number of processed elements
+template <typename T, typename VOp>
+static inline int houghVecOperate(T *pDst, const T *pSrc0, const T *pSrc1, int len,
+                                  const VOp &op)
+{
+    int i = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int vlanes = VTraits<decltype(vx_load(pSrc0))>::vlanes();
+    for (; i <= len - vlanes; i += vlanes)
+        v_store(pDst + i, op(vx_load(pSrc0 + i), vx_load(pSrc1 + i)));
+#else
+    CV_UNUSED(pDst); CV_UNUSED(pSrc0); CV_UNUSED(pSrc1); CV_UNUSED(len); CV_UNUSED(op);
+#endif
+    return i;
+}
+
+#if !(CV_SIMD_64F || CV_SIMD_SCALABLE_64F)
+template <typename VOp>
+static inline int houghVecOperate(double *, const double *, const double *, int,
+                                  const VOp &)
+{
+    return 0;
+}
+#endif
+
+// vectorized average of floating-point rows, the integer depths use the scalar loop
+template <typename T>
+static inline int houghVecAverage(T *, const T *, const T *, int)
+{
+    return 0;
+}
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+static inline int houghVecAverage(float *pDst, const float *pSrc0, const float *pSrc1, int len)
+{
+    const int vlanes = VTraits<v_float32>::vlanes();
+    const v_float32 half = vx_setall_f32(0.5f);
+    int i = 0;
+    for (; i <= len - vlanes; i += vlanes)
+        v_store(pDst + i, v_add(v_mul(vx_load(pSrc0 + i), half), v_mul(vx_load(pSrc1 + i), half)));
+    return i;
+}
+#endif
+
+#if (CV_SIMD_64F || CV_SIMD_SCALABLE_64F)
+static inline int houghVecAverage(double *pDst, const double *pSrc0, const double *pSrc1, int len)
+{
+    const int vlanes = VTraits<v_float64>::vlanes();
+    const v_float64 half = vx_setall_f64(0.5);
+    int i = 0;
+    for (; i <= len - vlanes; i += vlanes)
+        v_store(pDst + i, v_add(v_mul(vx_load(pSrc0 + i), half), v_mul(vx_load(pSrc1 + i), half)));
+    return i;
+}
+#endif
+
 template<typename T, int D, HoughOp Op>
 struct HoughOperator { };
-#define SPECIALIZE_HOUGHOP(TOp, body)                                         \
-    template<typename T, int D>                                               \
-    struct HoughOperator<T, D, TOp> {                                         \
-        static void operate(T *pDst, T *pSrc0, T* pSrc1, int len) {           \
-            Mat dst (Size(1, len), D, pDst);                                  \
-            Mat src0(Size(1, len), D, pSrc0);                                 \
-            Mat src1(Size(1, len), D, pSrc1);                                 \
-            body;                                                             \
-        }                                                                     \
-    };
-SPECIALIZE_HOUGHOP(FHT_ADD, add(src0, src1, dst));
-SPECIALIZE_HOUGHOP(FHT_MIN, min(src0, src1, dst));
-SPECIALIZE_HOUGHOP(FHT_MAX, max(src0, src1, dst));
-SPECIALIZE_HOUGHOP(FHT_AVE, addWeighted(src0, 0.5, src1, 0.5, 0.0, dst));
-#undef SPECIALIZE_HOUGHOP
+template<typename T, int D>
+struct HoughOperator<T, D, FHT_ADD> {
+    static void operate(T *pDst, T *pSrc0, T* pSrc1, int len) {
+        int i = houghVecOperate(pDst, pSrc0, pSrc1, len, HoughVecAdd());
+        for (; i < len; i++)
+            pDst[i] = saturate_cast<T>(pSrc0[i] + pSrc1[i]);
+    }
+};
+template<typename T, int D>
+struct HoughOperator<T, D, FHT_MIN> {
+    static void operate(T *pDst, T *pSrc0, T* pSrc1, int len) {
+        int i = houghVecOperate(pDst, pSrc0, pSrc1, len, HoughVecMin());
+        for (; i < len; i++)
+            pDst[i] = std::min(pSrc0[i], pSrc1[i]);
+    }
+};
+template<typename T, int D>
+struct HoughOperator<T, D, FHT_MAX> {
+    static void operate(T *pDst, T *pSrc0, T* pSrc1, int len) {
+        int i = houghVecOperate(pDst, pSrc0, pSrc1, len, HoughVecMax());
+        for (; i < len; i++)
+            pDst[i] = std::max(pSrc0[i], pSrc1[i]);
+    }
+};
+template<typename T, int D>
+struct HoughOperator<T, D, FHT_AVE> {
+    // Rounds like addWeighted(src0, 0.5, src1, 0.5, 0.0, dst): the halves are exact, so only the sum
+    // is rounded, in float except for the 32S and 64F depths which addWeighted computes in double.
+    typedef typename std::conditional<D == CV_32S || D == CV_64F, double, float>::type WT;
+
+    static void operate(T *pDst, T *pSrc0, T* pSrc1, int len) {
+        int i = houghVecAverage(pDst, pSrc0, pSrc1, len);
+        for (; i < len; i++)
+            pDst[i] = saturate_cast<T>((WT)pSrc0[i] * (WT)0.5 + (WT)pSrc1[i] * (WT)0.5);
+    }
+};
 
 //----------------------fht----------------------------------------------------
 
-template <typename T, int D, HoughOp OP>
-void fhtCore(Mat     &img0,
-             Mat     &img1,
-             int32_t  y0,
-             int32_t  h,
-             bool     isPositiveShift,
-             int      level,
-             double   aspl)
+// block of rows [y0, y0 + h) merged from its two halves (see fhtCore)
+struct FhtBlock {
+    int32_t y0, h;
+};
+
+// collects the blocks of the recursive FHT split, one list per recursion depth
+static void fhtPlan(std::vector<std::vector<FhtBlock> > &depths,
+                    int32_t y0,
+                    int32_t h,
+                    int     depth,
+                    int     level)
 {
     if (level <= 0)
         return;
 
     CV_Assert(h > 0);
+    if ((int)depths.size() <= depth)
+        depths.resize(depth + 1);
+    FhtBlock block = { y0, h };
+    depths[depth].push_back(block);
     if (h == 1)
-    {
-        if ((aspl != 0.0) && (level == 1))
-        {
-            int w = img0.cols;
-            uchar* pLine0 = img0.data + img0.step * y0;
-            uchar* pLine1 = img1.data + img1.step * y0;
-            int dLine = cvRound(y0 * aspl);
-            dLine = dLine % w;
-            dLine = dLine * (int)(img1.elemSize());
-            int wLine = img0.cols * (int)(img0.elemSize());
-            memcpy(pLine0, pLine1 + wLine - dLine, dLine);
-            memcpy(pLine0 + dLine, pLine1, wLine - dLine);
-        }
-        else
-        {
-            memcpy(img0.data + img0.step * y0,
-                   img1.data + img1.step * y0,
-                   img0.cols * (int)(img0.elemSize()));
-        }
         return;
-    }
+
     const int32_t k = h >> 1;
-    fhtCore<T, D, OP>(img1, img0, y0, k,
-                      isPositiveShift, level - 1, aspl);
-    fhtCore<T, D, OP>(img1, img0, y0 + k, h - k,
-                      isPositiveShift, level - 1, aspl);
+    fhtPlan(depths, y0, k, depth + 1, level - 1);
+    fhtPlan(depths, y0 + k, h - k, depth + 1, level - 1);
+}
+
+static void fhtCopyLine(Mat     &img0,
+                        Mat     &img1,
+                        int32_t  y0,
+                        int      level,
+                        double   aspl)
+{
+    if ((aspl != 0.0) && (level == 1))
+    {
+        int w = img0.cols;
+        uchar* pLine0 = img0.data + img0.step * y0;
+        uchar* pLine1 = img1.data + img1.step * y0;
+        int dLine = cvRound(y0 * aspl);
+        dLine = dLine % w;
+        dLine = dLine * (int)(img1.elemSize());
+        int wLine = img0.cols * (int)(img0.elemSize());
+        memcpy(pLine0, pLine1 + wLine - dLine, dLine);
+        memcpy(pLine0 + dLine, pLine1, wLine - dLine);
+    }
+    else
+    {
+        memcpy(img0.data + img0.step * y0,
+               img1.data + img1.step * y0,
+               img0.cols * (int)(img0.elemSize()));
+    }
+}
 
+template <typename T, int D, HoughOp OP>
+static void fhtMergeLine(Mat     &img0,
+                         Mat     &img1,
+                         int32_t  y0,
+                         int32_t  h,
+                         int32_t  s,
+                         bool     isPositiveShift,
+                         int      level,
+                         double   aspl)
+{
+    const int32_t k = h >> 1;
     int au = 2 * k - 2;
     int ad = 2 * h - 2 * k - 2;
     int b = h - 1;
@@ -117,90 +230,132 @@ void fhtCore(Mat     &img0,
     int w = img0.cols;
     int wm = (h / w + 1) * w;
 
-    for (int32_t s = 0; s < h; s++)
+    int su = (s * au + b) / d;
+    int sd = (s * ad + b) / d;
+    int rd = isPositiveShift ? sd - s : s - sd;
+    rd = (rd + wm) % w;
+    uchar *pLine0 = img0.data + img0.step * (y0 + s);
+    uchar *pLineU = img1.data + img1.step * (y0 + su);
+    uchar *pLineD = img1.data + img1.step * (y0 + k + sd);
+    int w0 = img0.channels() * rd;
+    int w1 = img0.channels() * (w - rd);
+
+    if ((aspl != 0.0) && (level == 1))
     {
-        int su = (s * au + b) / d;
-        int sd = (s * ad + b) / d;
-        int rd = isPositiveShift ? sd - s : s - sd;
-        rd = (rd + wm) % w;
-        uchar *pLine0 = img0.data + img0.step * (y0 + s);
-        uchar *pLineU = img1.data + img1.step * (y0 + su);
-        uchar *pLineD = img1.data + img1.step * (y0 + k + sd);
-        int w0 = img0.channels() * rd;
-        int w1 = img0.channels() * (w - rd);
-
-        if ((aspl != 0.0) && (level == 1))
+        int dU = cvRound((y0 + su) * aspl);
+        dU = dU % w;
+        dU *= img0.channels();
+        int dD = cvRound((y0 + k + sd) * aspl);
+        dD = dD % w;
+        dD *= img0.channels();
+        int wB = w * img0.channels();
+
+        int dX = dD - dU;
+        if (w0 >= dX)
         {
-            int dU = cvRound((y0 + su) * aspl);
-            dU = dU % w;
-            dU *= img0.channels();
-            int dD = cvRound((y0 + k + sd) * aspl);
-            dD = dD % w;
-            dD *= img0.channels();
-            int wB = w * img0.channels();
-
-            int dX = dD - dU;
-            if (w0 >= dX)
+            if (w0 >= dD)
             {
-                if (w0 >= dD)
-                {
-                    HoughOperator<T, D, OP>::operate((T *)pLine0 + dU,
-                                               (T *)pLineU,
-                                               (T *)pLineD + (w0 - dX),
-                                               w1 + dX);
-                    HoughOperator<T, D, OP>::operate((T *)pLine0 + (w1 + dD),
-                                               (T *)pLineU + (w1 + dX),
-                                               (T *)pLineD,
-                                               w0 - dD);
-                    HoughOperator<T, D, OP>::operate((T *)pLine0,
-                                               (T *)pLineU + (wB - dU),
-                                               (T *)pLineD + (w0 - dD),
-                                               dU);
-                }
-                else
-                {
-                    HoughOperator<T, D, OP>::operate((T *)pLine0 + dU,
-                                               (T *)pLineU,
-                                               (T *)pLineD + (w0 - dX),
-                                               wB - dU);
-                    HoughOperator<T, D, OP>::operate((T *)pLine0,
-                                               (T *)pLineU + (wB - dU),
-                                               (T *)pLineD + (w0 + wB - dD),
-                                               dD - w0);
-                    HoughOperator<T, D, OP>::operate((T *)pLine0 + (dD - w0),
-                                               (T *)pLineU + (w1 + dX),
-                                               (T *)pLineD,
-                                               w0 - dX);
-                }
+                HoughOperator<T, D, OP>::operate((T *)pLine0 + dU,
+                                           (T *)pLineU,
+                                           (T *)pLineD + (w0 - dX),
+                                           w1 + dX);
+                HoughOperator<T, D, OP>::operate((T *)pLine0 + (w1 + dD),
+                                           (T *)pLineU + (w1 + dX),
+                                           (T *)pLineD,
+                                           w0 - dD);
+                HoughOperator<T, D, OP>::operate((T *)pLine0,
+                                           (T *)pLineU + (wB - dU),
+                                           (T *)pLineD + (w0 - dD),
+                                           dU);
             }
             else
             {
                 HoughOperator<T, D, OP>::operate((T *)pLine0 + dU,
                                            (T *)pLineU,
-                                           (T *)pLineD + (wB - (dX - w0)),
-                                           dX - w0);
-                HoughOperator<T, D, OP>::operate((T *)pLine0 + (dD - w0),
-                                           (T *)pLineU + (dX - w0),
-                                           (T *)pLineD,
-                                           wB - (dX - w0) - dU);
+                                           (T *)pLineD + (w0 - dX),
+                                           wB - dU);
                 HoughOperator<T, D, OP>::operate((T *)pLine0,
                                            (T *)pLineU + (wB - dU),
-                                           (T *)pLineD + (wB - (dX - w0) - dU),
-                                           dU);
+                                           (T *)pLineD + (w0 + wB - dD),
+                                           dD - w0);
+                HoughOperator<T, D, OP>::operate((T *)pLine0 + (dD - w0),
+                                           (T *)pLineU + (w1 + dX),
+                                           (T *)pLineD,
+                                           w0 - dX);
             }
         }
         else
         {
+            HoughOperator<T, D, OP>::operate((T *)pLine0 + dU,
+                                       (T *)pLineU,
+                                       (T *)pLineD + (wB - (dX - w0)),
+                                       dX - w0);
+            HoughOperator<T, D, OP>::operate((T *)pLine0 + (dD - w0),
+                                       (T *)pLineU + (dX - w0),
+                                       (T *)pLineD,
+                                       wB - (dX - w0) - dU);
             HoughOperator<T, D, OP>::operate((T *)pLine0,
-                                        (T *)pLineU,
-                                        (T *)pLineD + w0,
-                                        w1);
-            HoughOperator<T, D, OP>::operate((T *)pLine0 + w1,
-                                        (T *)pLineU + w1,
-                                        (T *)pLineD,
-                                        w0);
+                                       (T *)pLineU + (wB - dU),
+                                       (T *)pLineD + (wB - (dX - w0) - dU),
+                                       dU);
         }
     }
+    else
+    {
+        HoughOperator<T, D, OP>::operate((T *)pLine0,
+                                    (T *)pLineU,
+                                    (T *)pLineD + w0,
+                                    w1);
+        HoughOperator<T, D, OP>::operate((T *)pLine0 + w1,
+                                    (T *)pLineU + w1,
+                                    (T *)pLineD,
+                                    w0);
+    }
+}
+
+// Runs the recursive split of fhtCore bottom-up, one recursion depth at a time. Blocks of
+// the same depth cover disjoint rows and read only rows written at the next depth, so each
+// depth is processed with a single parallel loop over its rows.
+template <typename T, int D, HoughOp OP>
+void fhtCore(Mat     &img0,
+             Mat     &img1,
+             int32_t  y0,
+             int32_t  h,
+             bool     isPositiveShift,
+             int      level,
+             double   aspl)
+{
+    std::vector<std::vector<FhtBlock> > depths;
+    fhtPlan(depths, y0, h, 0, level);
+
+    for (int depth = (int)depths.size() - 1; depth >= 0; depth--)
+    {
+        // blocks of odd depth write to img1 and read from img0
+        Mat &dst = (depth & 1) ? img1 : img0;
+        Mat &src = (depth & 1) ? img0 : img1;
+        const std::vector<FhtBlock> &blocks = depths[depth];
+        const int blockLevel = level - depth;
+
+        std::vector<int> ofs(blocks.size() + 1, 0);
+        for (size_t i = 0; i < blocks.size(); i++)
+            ofs[i + 1] = ofs[i] + blocks[i].h;
+
+        parallel_for_(Range(0, ofs.back()), [&](const Range &range)
+        {
+            int i = (int)(std::upper_bound(ofs.begin(), ofs.end(), range.start) - ofs.begin()) - 1;
+            for (int r = range.start; r < range.end; r++)
+            {
+                while (r >= ofs[i + 1])
+                    i++;
+                const FhtBlock &block = blocks[i];
+                if (block.h == 1)
+                    fhtCopyLine(dst, src, block.y0, blockLevel, aspl);
+                else
+                    fhtMergeLine<T, D, OP>(dst, src, block.y0, block.h, r - ofs[i],
+                                           isPositiveShift, blockLevel, aspl);
+            }
+        });
+    }
 }
 
 template <typename T, int D, HoughOp Op>
@@ -500,11 +655,8 @@ static void rotateLineRightCyclic(uchar *pLine,
 
 static void skewQuadrant(Mat         &quad,
                          const Mat   &src,
-                         uchar       *pBuf,
                          int          quadrant)
 {
-    CV_Assert(pBuf);
-
     const int wd = src.cols;
     const int ht = src.rows;
 
@@ -533,12 +685,17 @@ static void skewQuadrant(Mat         &quad,
 
     const int pixlen = static_cast<int>(quad.elemSize());
     const int len = quad.cols * pixlen;
-    for (int y = 0; y < quad.rows; y++)
+    CV_Assert(len > 0);
+    parallel_for_(Range(0, quad.rows), [&](const Range &range)
     {
-        uchar *pLine = quad.ptr(y);
-        int shift = static_cast<int>(start + step * y) * pixlen;
-        rotateLineRightCyclic(pLine, pBuf, len, shift);
-    }
+        AutoBuffer<uchar> buf(len);
+        for (int y = range.start; y < range.end; y++)
+        {
+            uchar *pLine = quad.ptr(y);
+            int shift = static_cast<int>(start + step * y) * pixlen;
+            rotateLineRightCyclic(pLine, buf.data(), len, shift);
+        }
+    });
 }
 
 void FastHoughTransform(InputArray  src,
@@ -557,10 +714,6 @@ void FastHoughTransform(InputArray  src,
     Mat dstMat = dst.getMat();
 
     Mat imgRegDst;
-    const int len = dstMat.cols * static_cast<int>(dstMat.elemSize());
-    CV_Assert(len > 0);
-    std::vector<uchar> buf_(len);
-    uchar *buf(&buf_[0]);
 
     if (angleRange == ARO_315_135)
     {
@@ -572,12 +725,12 @@ void FastHoughTransform(InputArray  src,
             calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_315_0);
             flip(imgRegDst, imgRegDst, 0);
             if (HDO_DESKEW == makeSkew)
-                skewQuadrant(imgRegDst, imgSrc, buf, ARO_315_0);
+                skewQuadrant(imgRegDst, imgSrc, ARO_315_0);
 
             setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_0_45, angleRange);
             calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_0_45);
             if (HDO_DESKEW == makeSkew)
-                skewQuadrant(imgRegDst, imgSrc, buf, ARO_0_45);
+                skewQuadrant(imgRegDst, imgSrc, ARO_0_45);
         }
         {
             Mat imgSrc;
@@ -587,12 +740,12 @@ void FastHoughTransform(InputArray  src,
             calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_45_90);
             flip(imgRegDst, imgRegDst, 0);
             if (HDO_DESKEW == makeSkew)
-                skewQuadrant(imgRegDst, imgSrc, buf, ARO_45_90);
+                skewQuadrant(imgRegDst, imgSrc, ARO_45_90);
 
             setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_90_135, angleRange);
             calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_90_135);
             if (HDO_DESKEW == makeSkew)
-                skewQuadrant(imgRegDst, imgSrc, buf, ARO_90_135);
+                skewQuadrant(imgRegDst, imgSrc, ARO_90_135);
         }
         return;
     }
@@ -606,58 +759,58 @@ void FastHoughTransform(InputArray  src,
         calculateFHTQuadrant(dstMat, imgSrc, operation, angleRange);
         flip(dstMat, dstMat, 0);
         if (HDO_DESKEW == makeSkew)
-            skewQuadrant(dstMat, imgSrc, buf, angleRange);
+            skewQuadrant(dstMat, imgSrc, angleRange);
         return;
     case ARO_0_45:
         calculateFHTQuadrant(dstMat, imgSrc, operation, angleRange);
         if (HDO_DESKEW == makeSkew)
-            skewQuadrant(dstMat, imgSrc, buf, angleRange);
+            skewQuadrant(dstMat, imgSrc, angleRange);
         return;
     case ARO_45_90:
         calculateFHTQuadrant(dstMat, imgSrc, operation, angleRange);
         flip(dstMat, dstMat, 0);
         if (HDO_DESKEW == makeSkew)
-            skewQuadrant(dstMat, imgSrc, buf, angleRange);
+            skewQuadrant(dstMat, imgSrc, angleRange);
         return;
     case ARO_90_135:
         calculateFHTQuadrant(dstMat, imgSrc, operation, angleRange);
         if (HDO_DESKEW == makeSkew)
-            skewQuadrant(dstMat, imgSrc, buf, angleRange);
+            skewQuadrant(dstMat, imgSrc, angleRange);
         return;
     case ARO_315_45:
         setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_315_0, angleRange);
         calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_315_0);
         flip(imgRegDst, imgRegDst, 0);
         if (HDO_DESKEW == makeSkew)
-            skewQuadrant(imgRegDst, imgSrc, buf, ARO_315_0);
+            skewQuadrant(imgRegDst, imgSrc, ARO_315_0);
 
         setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_0_45, angleRange);
         calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_0_45);
         if (HDO_DESKEW == makeSkew)
-            skewQuadrant(imgRegDst, imgSrc, buf, ARO_0_45);
+            skewQuadrant(imgRegDst, imgSrc, ARO_0_45);
         return;
     case ARO_45_135:
         setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_45_90, angleRange);
         calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_45_90);
         flip(imgRegDst, imgRegDst, 0);
         if (HDO_DESKEW == makeSkew)
-            skewQuadrant(imgRegDst, imgSrc, buf, ARO_45_90);
+            skewQuadrant(imgRegDst, imgSrc, ARO_45_90);
 
         setFHTDstRegion(imgRegDst, dstMat, srcMat, ARO_90_135, angleRange);
         calculateFHTQuadrant(imgRegDst, imgSrc, operation, ARO_90_135);
         if (HDO_DESKEW == makeSkew)
-            skewQuadrant(imgRegDst, imgSrc, buf, ARO_90_135);
+            skewQuadrant(imgRegDst, imgSrc, ARO_90_135);
         return;
     case ARO_CTR_VER:
         calculateFHTQuadrant(dstMat, imgSrc, operation, angleRange);
         flip(dstMat, dstMat, 0);
         if (HDO_DESKEW == makeSkew)
-            skewQuadrant(dstMat, imgSrc, buf, angleRange);
+            skewQuadrant(dstMat, imgSrc, angleRange);
         return;
     case ARO_CTR_HOR:
         calculateFHTQuadrant(dstMat, imgSrc, operation, angleRange);
         if (HDO_DESKEW == makeSkew)
-            skewQuadrant(dstMat, imgSrc, buf, angleRange);
+            skewQuadrant(dstMat, imgSrc, angleRange);
         return;
     default:
         CV_Error_(Error::StsNotImplemented, ("Unknown angleRange %d", angleRange));
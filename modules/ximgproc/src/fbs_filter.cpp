@@ -35,41 +35,180 @@
  */
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 #include <cmath>
+#include <cfloat>
 #include <vector>
-#include <memory>
-#include <stdlib.h>
-#include <iostream>
-#include <iterator>
 #include <algorithm>
 
+namespace cv
+{
+namespace ximgproc
+{
 
-#ifdef HAVE_EIGEN
-#  if defined __GNUC__ && defined __APPLE__
-#    pragma GCC diagnostic ignored "-Wshadow"
-#  endif
-#  include <Eigen/Dense>
-#  include <Eigen/SparseCore>
-#  include <Eigen/SparseCholesky>
-#  include <Eigen/IterativeLinearSolvers>
-#  include <Eigen/Sparse>
+namespace
+{
 
+// Open addressing table from lattice keys to vertex ids. Lookups are read-only,
+// so once the lattice is built the table can be queried from several threads.
+class LatticeHashTable
+{
+public:
+    LatticeHashTable() : used(0) { rehash(1 << 12); }
 
+    int findOrInsert(int64 key, int id)
+    {
+        if ((used + 1) * 2 > ids.size())
+            rehash(ids.size() * 2);
+        size_t mask = ids.size() - 1;
+        for (size_t i = bucket(key, mask);; i = (i + 1) & mask)
+        {
+            if (ids[i] < 0)
+            {
+                keys[i] = key;
+                ids[i] = id;
+                used++;
+                return id;
+            }
+            if (keys[i] == key)
+                return ids[i];
+        }
+    }
 
+    int find(int64 key) const
+    {
+        size_t mask = ids.size() - 1;
+        for (size_t i = bucket(key, mask);; i = (i + 1) & mask)
+        {
+            if (ids[i] < 0)
+                return -1;
+            if (keys[i] == key)
+                return ids[i];
+        }
+    }
 
-#if __cplusplus <= 199711L
-    #include <map>
-    typedef std::map<long long /* hash */, int /* vert id */>  mapId;
-#else
-    #include <unordered_map>
-    typedef std::unordered_map<long long /* hash */, int /* vert id */>  mapId;
-#endif
+private:
+    static size_t bucket(int64 key, size_t mask)
+    {
+        uint64 h = (uint64)key * CV_BIG_UINT(0x9E3779B97F4A7C15);
+        return (size_t)(h ^ (h >> 32)) & mask;
+    }
 
-namespace cv
+    void rehash(size_t capacity)
+    {
+        std::vector<int64> oldKeys;
+        std::vector<int> oldIds;
+        oldKeys.swap(keys);
+        oldIds.swap(ids);
+        keys.assign(capacity, 0);
+        ids.assign(capacity, -1);
+        size_t mask = capacity - 1;
+        for (size_t j = 0; j < oldIds.size(); j++)
+        {
+            if (oldIds[j] < 0)
+                continue;
+            size_t i = bucket(oldKeys[j], mask);
+            while (ids[i] >= 0)
+                i = (i + 1) & mask;
+            keys[i] = oldKeys[j];
+            ids[i] = oldIds[j];
+        }
+    }
+
+    std::vector<int64> keys;
+    std::vector<int> ids;
+    size_t used;
+};
+
+// Vertex loops are cut into a fixed number of stripes that only depends on the
+// vector length, and reductions are summed in stripe order, so the solver gives
+// the same result for any number of threads.
+template<typename Body>
+static void stripedReduce(int len, int nacc, const Body& body, double* result)
 {
-namespace ximgproc
+    const int nstripes = std::max(1, std::min(64, len / 4096));
+    std::vector<double> partial((size_t)nstripes * std::max(nacc, 1), 0.0);
+    parallel_for_(Range(0, nstripes), [&](const Range& range)
+    {
+        for (int s = range.start; s < range.end; s++)
+        {
+            Range r((int)((int64)len * s / nstripes), (int)((int64)len * (s + 1) / nstripes));
+            body(r, &partial[(size_t)s * std::max(nacc, 1)]);
+        }
+    });
+    for (int k = 0; k < nacc; k++)
+    {
+        double sum = 0;
+        for (int s = 0; s < nstripes; s++)
+            sum += partial[(size_t)s * nacc + k];
+        result[k] = sum;
+    }
+}
+
+template<typename Body>
+static void stripedFor(int len, const Body& body)
 {
+    stripedReduce(len, 0, [&](const Range& r, double*) { body(r); }, NULL);
+}
+
+// dst = 10 * src + sum of the lattice neighbours of src; missing neighbours point
+// to the zero element src[nv].
+static void blurVertices(const float* src, const int* nb, int nv, int nnb, float* dst, const Range& r)
+{
+    int v = r.start;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int vlanes = VTraits<v_float32>::vlanes();
+    const v_float32 v10 = vx_setall_f32(10.f);
+    for (; v <= r.end - vlanes; v += vlanes)
+    {
+        v_float32 s = v_mul(vx_load(src + v), v10);
+        for (int k = 0; k < nnb; k++)
+            s = v_add(s, v_lut(src, nb + (size_t)k * nv + v));
+        v_store(dst + v, s);
+    }
+#endif
+    for (; v < r.end; v++)
+    {
+        float s = src[v] * 10.f;
+        for (int k = 0; k < nnb; k++)
+            s += src[nb[(size_t)k * nv + v]];
+        dst[v] = s;
+    }
+}
+
+// dst = A * p over the range, returns p.dot(dst) over the range.
+static double applySystem(const float* p, const float* diag, const float* offw, const int* nb,
+                          int nv, int nnb, float* dst, const Range& r)
+{
+    int v = r.start;
+    double dot = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int vlanes = VTraits<v_float32>::vlanes();
+    v_float32 vdot = vx_setzero_f32();
+    for (; v <= r.end - vlanes; v += vlanes)
+    {
+        v_float32 pv = vx_load(p + v);
+        v_float32 s = v_mul(vx_load(diag + v), pv);
+        for (int k = 0; k < nnb; k++)
+            s = v_fma(vx_load(offw + (size_t)k * nv + v), v_lut(p, nb + (size_t)k * nv + v), s);
+        v_store(dst + v, s);
+        vdot = v_fma(pv, s, vdot);
+    }
+    dot = v_reduce_sum(vdot);
+#endif
+    for (; v < r.end; v++)
+    {
+        float s = diag[v] * p[v];
+        for (int k = 0; k < nnb; k++)
+            s += offw[(size_t)k * nv + v] * p[nb[(size_t)k * nv + v]];
+        dst[v] = s;
+        dot += (double)p[v] * s;
+    }
+    return dot;
+}
+
+} // namespace
 
     class FastBilateralSolverFilterImpl : public FastBilateralSolverFilter
     {
@@ -78,6 +217,7 @@ namespace ximgproc
         static Ptr<FastBilateralSolverFilterImpl> create(InputArray guide, double sigma_spatial, double sigma_luma, double sigma_chroma, double lambda, int num_iter, double max_tol)
         {
             CV_Assert(guide.type() == CV_8UC1 || guide.type() == CV_8UC3);
+            CV_Assert(sigma_spatial > 0 && sigma_luma > 0 && sigma_chroma > 0);
             FastBilateralSolverFilterImpl *fbs = new FastBilateralSolverFilterImpl();
             Mat gui = guide.getMat();
             fbs->init(gui,sigma_spatial,sigma_luma,sigma_chroma,lambda,num_iter,max_tol);
@@ -111,10 +251,9 @@ namespace ximgproc
 
             for(int i=0;i<src.channels();i++)
             {
-                Mat cur_res = src_channels[i].clone();
+                Mat cur_res;
 
-                solve(cur_res,conf,cur_res);
-                cur_res.convertTo(cur_res, src.type());
+                solve(src_channels[i],conf,cur_res);
                 dst_channels.push_back(cur_res);
             }
 
@@ -130,23 +269,10 @@ namespace ximgproc
         }
 
     // protected:
-        void solve(cv::Mat& src, cv::Mat& confidence, cv::Mat& dst);
+        void solve(const cv::Mat& src, const cv::Mat& confidence, cv::Mat& dst);
         void init(cv::Mat& reference, double sigma_spatial, double sigma_luma, double sigma_chroma, double lambda, int num_iter, double max_tol);
 
-        void Splat(Eigen::VectorXf& input, Eigen::VectorXf& dst);
-        void Blur(Eigen::VectorXf& input, Eigen::VectorXf& dst);
-        void Slice(Eigen::VectorXf& input, Eigen::VectorXf& dst);
-
-        void diagonal(Eigen::VectorXf& v,Eigen::SparseMatrix<float>& mat)
-        {
-            mat = Eigen::SparseMatrix<float>(v.size(),v.size());
-            for (int i = 0; i < int(v.size()); i++)
-            {
-                mat.insert(i,i) = v(i);
-            }
-        }
-
-
+        void Blur(const std::vector<float>& input, std::vector<float>& dst);
 
     private:
 
@@ -155,14 +281,13 @@ namespace ximgproc
         int dim;
         int cols;
         int rows;
-        std::vector<int> splat_idx;
-        std::vector<std::pair<int, int> > blur_idx;
-        Eigen::VectorXf m;
-        Eigen::VectorXf n;
-        Eigen::SparseMatrix<float, Eigen::ColMajor> blurs;
-        Eigen::SparseMatrix<float, Eigen::ColMajor> S;
-        Eigen::SparseMatrix<float, Eigen::ColMajor> Dn;
-        Eigen::SparseMatrix<float, Eigen::ColMajor> Dm;
+        std::vector<int> splat_idx;     // vertex of every pixel
+        std::vector<int> vert_ofs;      // pixels of vertex v are vert_pix[vert_ofs[v]] .. vert_pix[vert_ofs[v+1]-1]
+        std::vector<int> vert_pix;
+        std::vector<int> neighbours;    // 2*dim planes of nvertices ids, nvertices marks a missing neighbour
+        std::vector<float> counts;      // number of pixels splatted onto each vertex
+        std::vector<float> smooth_diag; // diagonal of lam*(Dm - Dn*B*Dn)
+        std::vector<float> smooth_offw; // off-diagonal weights of lam*(Dm - Dn*B*Dn), same layout as neighbours
 
         struct grid_params
         {
@@ -202,404 +327,295 @@ namespace ximgproc
     void FastBilateralSolverFilterImpl::init(cv::Mat& reference, double sigma_spatial, double sigma_luma, double sigma_chroma, double lambda, int num_iter, double max_tol)
     {
 
-        bs_param.lam = lambda;
+        bs_param.lam = (float)lambda;
         bs_param.cg_maxiter = num_iter;
-        bs_param.cg_tol = max_tol;
+        bs_param.cg_tol = (float)max_tol;
 
+        cv::Mat ref;
         if(reference.channels()==1)
         {
             dim = 3;
-            cols = reference.cols;
-            rows = reference.rows;
-            npixels = cols*rows;
-            long long hash_vec[3];
-            for (int i = 0; i < 3; ++i)
-            hash_vec[i] = static_cast<long long>(std::pow(255, i));
-
-            mapId hashed_coords;
-#if __cplusplus <= 199711L
-#else
-            hashed_coords.reserve(cols*rows);
-#endif
-
-            const unsigned char* pref = (const unsigned char*)reference.data;
-            int vert_idx = 0;
-            int pix_idx = 0;
-
-            // construct Splat(Slice) matrices
-            splat_idx.resize(npixels);
-            for (int y = 0; y < rows; ++y)
-            {
-                for (int x = 0; x < cols; ++x)
-                {
-                    long long coord[3];
-                    coord[0] = int(x / sigma_spatial);
-                    coord[1] = int(y / sigma_spatial);
-                    coord[2] = int(pref[0] / sigma_luma);
-
-                    // convert the coordinate to a hash value
-                    long long hash_coord = 0;
-                    for (int i = 0; i < 3; ++i)
-                        hash_coord += coord[i] * hash_vec[i];
-
-                    // pixels whom are alike will have the same hash value.
-                    // We only want to keep a unique list of hash values, therefore make sure we only insert
-                    // unique hash values.
-                    mapId::iterator it = hashed_coords.find(hash_coord);
-                    if (it == hashed_coords.end())
-                    {
-                        hashed_coords.insert(std::pair<long long, int>(hash_coord, vert_idx));
-                        splat_idx[pix_idx] = vert_idx;
-                        ++vert_idx;
-                    }
-                    else
-                    {
-                        splat_idx[pix_idx] = it->second;
-                    }
-
-                    pref += 1; // skip 1 bytes (y)
-                    ++pix_idx;
-                }
-            }
-            nvertices = static_cast<int>(hashed_coords.size());
-
-            // construct Blur matrices
-            Eigen::VectorXf ones_nvertices = Eigen::VectorXf::Ones(nvertices);
-            diagonal(ones_nvertices,blurs);
-            blurs *= 10;
-            for(int offset = -1; offset <= 1;++offset)
-            {
-                if(offset == 0) continue;
-                for (int i = 0; i < dim; ++i)
-                {
-                    Eigen::SparseMatrix<float, Eigen::ColMajor> blur_temp(hashed_coords.size(), hashed_coords.size());
-                    blur_temp.reserve(Eigen::VectorXi::Constant(nvertices,6));
-                    long long offset_hash_coord = offset * hash_vec[i];
-                    for (mapId::iterator it = hashed_coords.begin(); it != hashed_coords.end(); ++it)
-                    {
-                        long long neighb_coord = it->first + offset_hash_coord;
-                        mapId::iterator it_neighb = hashed_coords.find(neighb_coord);
-                        if (it_neighb != hashed_coords.end())
-                        {
-                            blur_temp.insert(it->second,it_neighb->second) = 1.0f;
-                            blur_idx.push_back(std::pair<int,int>(it->second, it_neighb->second));
-                        }
-                    }
-                    blurs += blur_temp;
-                }
-            }
-            blurs.finalize();
-
-            //bistochastize
-            int maxiter = 10;
-            n = ones_nvertices;
-            m = Eigen::VectorXf::Zero(nvertices);
-            for (int i = 0; i < int(splat_idx.size()); i++)
-            {
-                m(splat_idx[i]) += 1.0f;
-            }
-
-            Eigen::VectorXf bluredn(nvertices);
-
-            for (int i = 0; i < maxiter; i++)
-            {
-                Blur(n,bluredn);
-                n = ((n.array()*m.array()).array()/bluredn.array()).array().sqrt();
-            }
-            Blur(n,bluredn);
-
-            m = n.array() * (bluredn).array();
-            diagonal(m,Dm);
-            diagonal(n,Dn);
-
+            ref = reference;
         }
         else
         {
             dim = 5;
-            cv::Mat reference_yuv;
-            cv::cvtColor(reference, reference_yuv, COLOR_BGR2YCrCb);
-
-            cols = reference_yuv.cols;
-            rows = reference_yuv.rows;
-            npixels = cols*rows;
-            long long hash_vec[5];
-            for (int i = 0; i < 5; ++i)
-            hash_vec[i] = static_cast<long long>(std::pow(255, i));
-
-            mapId hashed_coords;
-#if __cplusplus <= 199711L
-#else
-            hashed_coords.reserve(cols*rows);
-#endif
-
-            const unsigned char* pref = (const unsigned char*)reference_yuv.data;
-            int vert_idx = 0;
-            int pix_idx = 0;
+            cv::cvtColor(reference, ref, COLOR_BGR2YCrCb);
+        }
+        cols = ref.cols;
+        rows = ref.rows;
+        npixels = cols*rows;
+        const int cn = ref.channels();
+
+        // Every lattice coordinate is bounded, so a mixed radix key with one spare slot
+        // per axis is collision free and the +-1 neighbours of a vertex never alias
+        // another vertex.
+        const double sigmas[5] = { sigma_spatial, sigma_spatial, sigma_luma, sigma_chroma, sigma_chroma };
+        const int maxval[5] = { cols - 1, rows - 1, 255, 255, 255 };
+        int64 radix[5];
+        int64 r = 1;
+        for (int i = 0; i < dim; ++i)
+        {
+            radix[i] = r;
+            r *= int64(maxval[i] / sigmas[i]) + 2;
+        }
 
-            // construct Splat(Slice) matrices
-            splat_idx.resize(npixels);
-            for (int y = 0; y < rows; ++y)
+        // construct Splat(Slice) indices
+        LatticeHashTable hashed_coords;
+        std::vector<int64> vert_key;
+        splat_idx.resize(npixels);
+        int64 last_key = -1;
+        int last_id = -1;
+        for (int y = 0; y < rows; ++y)
+        {
+            const uchar* pref = ref.ptr<uchar>(y);
+            int64 row_key = int64(y / sigma_spatial) * radix[1];
+            for (int x = 0; x < cols; ++x, pref += cn)
             {
-                for (int x = 0; x < cols; ++x)
-                {
-                    long long coord[5];
-                    coord[0] = int(x / sigma_spatial);
-                    coord[1] = int(y / sigma_spatial);
-                    coord[2] = int(pref[0] / sigma_luma);
-                    coord[3] = int(pref[1] / sigma_chroma);
-                    coord[4] = int(pref[2] / sigma_chroma);
-
-                    // convert the coordinate to a hash value
-                    long long hash_coord = 0;
-                    for (int i = 0; i < 5; ++i)
-                        hash_coord += coord[i] * hash_vec[i];
-
-                    // pixels whom are alike will have the same hash value.
-                    // We only want to keep a unique list of hash values, therefore make sure we only insert
-                    // unique hash values.
-                    mapId::iterator it = hashed_coords.find(hash_coord);
-                    if (it == hashed_coords.end())
-                    {
-                        hashed_coords.insert(std::pair<long long, int>(hash_coord, vert_idx));
-                        splat_idx[pix_idx] = vert_idx;
-                        ++vert_idx;
-                    }
-                    else
-                    {
-                        splat_idx[pix_idx] = it->second;
-                    }
+                int64 key = row_key + int64(x / sigma_spatial) * radix[0] + int64(pref[0] / sigma_luma) * radix[2];
+                if (dim == 5)
+                    key += int64(pref[1] / sigma_chroma) * radix[3] + int64(pref[2] / sigma_chroma) * radix[4];
 
-                    pref += 3; // skip 3 bytes (y u v)
-                    ++pix_idx;
+                // neighbouring pixels mostly fall into the same vertex
+                if (key != last_key)
+                {
+                    last_id = hashed_coords.findOrInsert(key, (int)vert_key.size());
+                    if (last_id == (int)vert_key.size())
+                        vert_key.push_back(key);
+                    last_key = key;
                 }
+                splat_idx[y*cols + x] = last_id;
             }
-            nvertices = static_cast<int>(hashed_coords.size());
+        }
+        nvertices = (int)vert_key.size();
+        const int nv = nvertices;
+        const int nnb = 2*dim;
+
+        // vertex -> pixels lists, kept in pixel order so that splatting sums in the same
+        // order as a sequential scatter
+        vert_ofs.assign(nv + 1, 0);
+        for (int i = 0; i < npixels; i++)
+            vert_ofs[splat_idx[i] + 1]++;
+        counts.resize(nv);
+        for (int v = 0; v < nv; v++)
+        {
+            counts[v] = (float)vert_ofs[v + 1];
+            vert_ofs[v + 1] += vert_ofs[v];
+        }
+        vert_pix.resize(npixels);
+        {
+            std::vector<int> fill(vert_ofs.begin(), vert_ofs.end() - 1);
+            for (int i = 0; i < npixels; i++)
+                vert_pix[fill[splat_idx[i]]++] = i;
+        }
 
-            // construct Blur matrices
-            Eigen::VectorXf ones_nvertices = Eigen::VectorXf::Ones(nvertices);
-            diagonal(ones_nvertices,blurs);
-            blurs *= 10;
-            for(int offset = -1; offset <= 1;++offset)
+        // construct Blur neighbours
+        neighbours.resize((size_t)nnb * nv);
+        stripedFor(nv, [&](const Range& range)
+        {
+            for (int v = range.start; v < range.end; v++)
             {
-                if(offset == 0) continue;
                 for (int i = 0; i < dim; ++i)
                 {
-                    Eigen::SparseMatrix<float, Eigen::ColMajor> blur_temp(hashed_coords.size(), hashed_coords.size());
-                    blur_temp.reserve(Eigen::VectorXi::Constant(nvertices,6));
-                    long long offset_hash_coord = offset * hash_vec[i];
-                    for (mapId::iterator it = hashed_coords.begin(); it != hashed_coords.end(); ++it)
-                    {
-                        long long neighb_coord = it->first + offset_hash_coord;
-                        mapId::iterator it_neighb = hashed_coords.find(neighb_coord);
-                        if (it_neighb != hashed_coords.end())
-                        {
-                            blur_temp.insert(it->second,it_neighb->second) = 1.0f;
-                            blur_idx.push_back(std::pair<int,int>(it->second, it_neighb->second));
-                        }
-                    }
-                    blurs += blur_temp;
+                    int lo = hashed_coords.find(vert_key[v] - radix[i]);
+                    int hi = hashed_coords.find(vert_key[v] + radix[i]);
+                    neighbours[(size_t)(2*i) * nv + v] = lo < 0 ? nv : lo;
+                    neighbours[(size_t)(2*i + 1) * nv + v] = hi < 0 ? nv : hi;
                 }
             }
-            blurs.finalize();
-
-
-            //bistochastize
-            int maxiter = 10;
-            n = ones_nvertices;
-            m = Eigen::VectorXf::Zero(nvertices);
-            for (int i = 0; i < int(splat_idx.size()); i++)
-            {
-                m(splat_idx[i]) += 1.0f;
-            }
-
-            Eigen::VectorXf bluredn(nvertices);
-
-            for (int i = 0; i < maxiter; i++)
-            {
-                Blur(n,bluredn);
-                n = ((n.array()*m.array()).array()/bluredn.array()).array().sqrt();
-            }
-            Blur(n,bluredn);
+        });
 
-            m = n.array() * (bluredn).array();
-            diagonal(m,Dm);
-            diagonal(n,Dn);
-        }
-    }
-
-    void FastBilateralSolverFilterImpl::Splat(Eigen::VectorXf& input, Eigen::VectorXf& output)
-    {
-        output.setZero();
-        for (int i = 0; i < int(splat_idx.size()); i++)
+        //bistochastize
+        int maxiter = 10;
+        std::vector<float> n(nv + 1, 1.0f), m(counts), bluredn(nv);
+        n[nv] = 0.0f;
+        for (int i = 0; i < maxiter; i++)
         {
-            output(splat_idx[i]) += input(i);
+            Blur(n, bluredn);
+            stripedFor(nv, [&](const Range& range)
+            {
+                for (int v = range.start; v < range.end; v++)
+                    n[v] = std::sqrt(n[v] * m[v] / bluredn[v]);
+            });
         }
+        Blur(n, bluredn);
 
-    }
-
-    void FastBilateralSolverFilterImpl::Blur(Eigen::VectorXf& input, Eigen::VectorXf& output)
-    {
-        output.setZero();
-        output = input * 10;
-        for (int i = 0; i < int(blur_idx.size()); i++)
+        // lam*(Dm - Dn*B*Dn) only depends on the guide, the data term is added per solve
+        const float lam = bs_param.lam;
+        smooth_diag.resize(nv);
+        smooth_offw.resize((size_t)nnb * nv);
+        stripedFor(nv, [&](const Range& range)
         {
-            output(blur_idx[i].first) += input(blur_idx[i].second);
-        }
+            for (int v = range.start; v < range.end; v++)
+            {
+                m[v] = n[v] * bluredn[v];
+                smooth_diag[v] = lam * (m[v] - n[v] * (10.0f * n[v]));
+                for (int k = 0; k < nnb; k++)
+                    smooth_offw[(size_t)k * nv + v] = -lam * (n[v] * n[neighbours[(size_t)k * nv + v]]);
+            }
+        });
     }
 
-
-    void FastBilateralSolverFilterImpl::Slice(Eigen::VectorXf& input, Eigen::VectorXf& output)
+    void FastBilateralSolverFilterImpl::Blur(const std::vector<float>& input, std::vector<float>& output)
     {
-        output.setZero();
-        for (int i = 0; i < int(splat_idx.size()); i++)
+        CV_DbgAssert((int)input.size() == nvertices + 1 && input[nvertices] == 0.0f);
+        output.resize(nvertices);
+        stripedFor(nvertices, [&](const Range& range)
         {
-            output(i) = input(splat_idx[i]);
-        }
+            blurVertices(&input[0], &neighbours[0], nvertices, 2*dim, &output[0], range);
+        });
     }
 
 
-    void FastBilateralSolverFilterImpl::solve(cv::Mat& target,
-               cv::Mat& confidence,
+    void FastBilateralSolverFilterImpl::solve(const cv::Mat& target,
+               const cv::Mat& confidence,
                cv::Mat& output)
     {
-
-        Eigen::SparseMatrix<float, Eigen::ColMajor> M(nvertices,nvertices);
-        Eigen::SparseMatrix<float, Eigen::ColMajor> A_data(nvertices,nvertices);
-        Eigen::SparseMatrix<float, Eigen::ColMajor> A(nvertices,nvertices);
-        Eigen::VectorXf b(nvertices);
-        Eigen::VectorXf y(nvertices);
-        Eigen::VectorXf y0(nvertices);
-        Eigen::VectorXf y1(nvertices);
-        Eigen::VectorXf w_splat(nvertices);
-
-        Eigen::VectorXf x(npixels);
-        Eigen::VectorXf w(npixels);
-
-        if(target.depth() == CV_16S)
-        {
-            const int16_t *pft = reinterpret_cast<const int16_t*>(target.data);
-            for (int i = 0; i < npixels; i++)
-            {
-                x(i) = (cv::saturate_cast<float>(pft[i])+32768.0f)/65535.0f;
-            }
-        }
-        else if(target.depth() == CV_16U)
-        {
-            const uint16_t *pft = reinterpret_cast<const uint16_t*>(target.data);
-            for (int i = 0; i < npixels; i++)
-            {
-                x(i) = cv::saturate_cast<float>(pft[i])/65535.0f;
-            }
-        }
-        else if(target.depth() == CV_8U)
-        {
-            const uchar *pft = reinterpret_cast<const uchar*>(target.data);
-            for (int i = 0; i < npixels; i++)
-            {
-                x(i) = cv::saturate_cast<float>(pft[i])/255.0f;
-            }
-        }
-        else if(target.depth() == CV_32F)
+        const int nv = nvertices;
+        const int nnb = 2*dim;
+        const int depth = target.depth();
+
+        // bring target and confidence to [0, 1]
+        Mat x, w;
+        if(depth == CV_16S)
+            target.convertTo(x, CV_32F, 1.0/65535.0, 32768.0/65535.0);
+        else if(depth == CV_16U)
+            target.convertTo(x, CV_32F, 1.0/65535.0);
+        else if(depth == CV_8U)
+            target.convertTo(x, CV_32F, 1.0/255.0);
+        else
+            target.convertTo(x, CV_32F);
+        confidence.convertTo(w, CV_32F, confidence.depth() == CV_8U ? 1.0/255.0 : 1.0);
+        CV_Assert(x.isContinuous() && w.isContinuous());
+        const float* px = x.ptr<float>();
+        const float* pw = w.ptr<float>();
+
+        // splat: A = lam*(Dm - Dn*B*Dn) + diag(splat(w)), b = splat(x*w), y0 = splat(x)/splat(1)
+        std::vector<float> diag(nv), invdiag(nv), b(nv);
+        std::vector<float> y(nv + 1, 0.0f);
+        stripedFor(nv, [&](const Range& range)
         {
-            const float *pft = reinterpret_cast<const float*>(target.data);
-            for (int i = 0; i < npixels; i++)
+            for (int v = range.start; v < range.end; v++)
             {
-                x(i) = pft[i];
+                float sw = 0.0f, sxw = 0.0f, sx = 0.0f;
+                for (int j = vert_ofs[v]; j < vert_ofs[v + 1]; j++)
+                {
+                    int i = vert_pix[j];
+                    sw += pw[i];
+                    sxw += px[i] * pw[i];
+                    sx += px[i];
+                }
+                diag[v] = smooth_diag[v] + sw;
+                invdiag[v] = diag[v] != 0.0f ? 1.0f / diag[v] : 1.0f;
+                b[v] = sxw;
+                y[v] = sx / counts[v];
             }
-        }
+        });
 
-        if(confidence.depth() == CV_8U)
-        {
-            const uchar *pfc = reinterpret_cast<const uchar*>(confidence.data);
-            for (int i = 0; i < npixels; i++)
-            {
-                w(i) = cv::saturate_cast<float>(pfc[i])/255.0f;
-            }
-        }
-        else if(confidence.depth() == CV_32F)
+        // solve Ay = b with Jacobi preconditioned conjugate gradients
+        std::vector<float> residual(nv), z(nv), tmp(nv);
+        std::vector<float> p(nv + 1, 0.0f);
+        const float* pdiag = &diag[0];
+        const float* poffw = &smooth_offw[0];
+        const int* pnb = &neighbours[0];
+
+        double sums[2];
+        stripedReduce(nv, 2, [&](const Range& range, double* acc)
         {
-            const float *pfc = reinterpret_cast<const float*>(confidence.data);
-            for (int i = 0; i < npixels; i++)
+            applySystem(&y[0], pdiag, poffw, pnb, nv, nnb, &tmp[0], range);
+            double bb = 0, rr = 0;
+            for (int v = range.start; v < range.end; v++)
             {
-                w(i) = pfc[i];
+                residual[v] = b[v] - tmp[v];
+                bb += (double)b[v] * b[v];
+                rr += (double)residual[v] * residual[v];
             }
-        }
-
-        //construct A
-        Splat(w,w_splat);
+            acc[0] = bb;
+            acc[1] = rr;
+        }, sums);
+        const double rhsNorm2 = sums[0];
+        double residualNorm2 = sums[1];
 
-        diagonal(w_splat,A_data);
-        A = bs_param.lam * (Dm - Dn * (blurs*Dn)) + A_data ;
-
-        //construct b
-        b.setZero();
-        for (int i = 0; i < int(splat_idx.size()); i++)
-        {
-            b(splat_idx[i]) += x(i) * w(i);
-        }
-
-        //construct guess for y
-        y0.setZero();
-        for (int i = 0; i < int(splat_idx.size()); i++)
-        {
-            y0(splat_idx[i]) += x(i);
-        }
-        y1.setZero();
-        for (int i = 0; i < int(splat_idx.size()); i++)
-        {
-            y1(splat_idx[i]) += 1.0f;
-        }
-        for (int i = 0; i < nvertices; i++)
+        if (rhsNorm2 == 0)
         {
-            y0(i) = y0(i)/y1(i);
+            std::fill(y.begin(), y.end(), 0.0f);
         }
-
-
-        // solve Ay = b
-        Eigen::ConjugateGradient<Eigen::SparseMatrix<float>, Eigen::Lower|Eigen::Upper> cg;
-        cg.compute(A);
-        cg.setMaxIterations(bs_param.cg_maxiter);
-        cg.setTolerance(bs_param.cg_tol);
-        // y = cg.solve(b);
-        y = cg.solveWithGuess(b,y0);
-        std::cout << "#iterations:     " << cg.iterations() << std::endl;
-        std::cout << "estimated error: " << cg.error()      << std::endl;
-
-        //slice
-        if(target.depth() == CV_16S)
+        else
         {
-            int16_t *pftar = (int16_t*) output.data;
-            for (int i = 0; i < int(splat_idx.size()); i++)
+            const double tol = bs_param.cg_tol;
+            const double threshold = std::max(tol*tol*rhsNorm2, (double)FLT_MIN);
+            double absNew = 0;
+            if (residualNorm2 >= threshold)
             {
-                pftar[i] = cv::saturate_cast<short>(y(splat_idx[i]) * 65535.0f - 32768.0f);
+                stripedReduce(nv, 1, [&](const Range& range, double* acc)
+                {
+                    double rz = 0;
+                    for (int v = range.start; v < range.end; v++)
+                    {
+                        p[v] = invdiag[v] * residual[v];
+                        rz += (double)residual[v] * p[v];
+                    }
+                    acc[0] = rz;
+                }, &absNew);
             }
-        }
-        else if(target.depth() == CV_16U)
-        {
-            uint16_t *pftar = (uint16_t*) output.data;
-            for (int i = 0; i < int(splat_idx.size()); i++)
+            for (int iter = 0; iter < bs_param.cg_maxiter && residualNorm2 >= threshold; iter++)
             {
-                pftar[i] = cv::saturate_cast<ushort>(y(splat_idx[i]) * 65535.0f);
+                double pAp = 0;
+                stripedReduce(nv, 1, [&](const Range& range, double* acc)
+                {
+                    acc[0] = applySystem(&p[0], pdiag, poffw, pnb, nv, nnb, &tmp[0], range);
+                }, &pAp);
+                const float alpha = (float)(absNew / pAp);
+
+                stripedReduce(nv, 2, [&](const Range& range, double* acc)
+                {
+                    double rr = 0, rz = 0;
+                    for (int v = range.start; v < range.end; v++)
+                    {
+                        y[v] += alpha * p[v];
+                        residual[v] -= alpha * tmp[v];
+                        z[v] = invdiag[v] * residual[v];
+                        rr += (double)residual[v] * residual[v];
+                        rz += (double)residual[v] * z[v];
+                    }
+                    acc[0] = rr;
+                    acc[1] = rz;
+                }, sums);
+                residualNorm2 = sums[0];
+                if (residualNorm2 < threshold)
+                    break;
+
+                const float beta = (float)(sums[1] / absNew);
+                absNew = sums[1];
+                stripedFor(nv, [&](const Range& range)
+                {
+                    for (int v = range.start; v < range.end; v++)
+                        p[v] = z[v] + beta * p[v];
+                });
             }
         }
-        else if (target.depth() == CV_8U)
+
+        //slice
+        Mat sliced(rows, cols, CV_32F);
+        parallel_for_(Range(0, rows), [&](const Range& range)
         {
-            uchar *pftar = (uchar*) output.data;
-            for (int i = 0; i < int(splat_idx.size()); i++)
+            for (int row = range.start; row < range.end; row++)
             {
-                pftar[i] = cv::saturate_cast<uchar>(y(splat_idx[i]) * 255.0f);
+                float* pdst = sliced.ptr<float>(row);
+                const int* pidx = &splat_idx[(size_t)row * cols];
+                for (int col = 0; col < cols; col++)
+                    pdst[col] = y[pidx[col]];
             }
-        }
+        });
+
+        if(depth == CV_16S)
+            sliced.convertTo(output, CV_16S, 65535.0, -32768.0);
+        else if(depth == CV_16U)
+            sliced.convertTo(output, CV_16U, 65535.0);
+        else if(depth == CV_8U)
+            sliced.convertTo(output, CV_8U, 255.0);
         else
-        {
-            float *pftar = (float*)(output.data);
-            for (int i = 0; i < int(splat_idx.size()); i++)
-            {
-                pftar[i] = y(splat_idx[i]);
-            }
-        }
-
-
+            output = sliced;
     }
 
 
@@ -619,27 +635,3 @@ void fastBilateralSolverFilter(InputArray guide, InputArray src, InputArray conf
 }
 
 }
-
-#else
-
-namespace cv
-{
-namespace ximgproc
-{
-
-Ptr<FastBilateralSolverFilter> createFastBilateralSolverFilter(InputArray, double, double, double, double, int, double)
-{
-    CV_Error(Error::StsNotImplemented, "createFastBilateralSolverFilter : needs to be compiled with EIGEN");
-}
-
-void fastBilateralSolverFilter(InputArray, InputArray, InputArray, OutputArray, double, double, double, double, int, double)
-{
-    CV_Error(Error::StsNotImplemented, "fastBilateralSolverFilter : needs to be compiled with EIGEN");
-}
-
-
-}
-
-}
-
-#endif // HAVE_EIGEN
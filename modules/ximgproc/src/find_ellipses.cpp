@@ -4,7 +4,6 @@
 
 #include "precomp.hpp"
 #include <opencv2/core.hpp>
-#include <unordered_map>
 #include <numeric>
 
 namespace cv {
@@ -181,6 +180,81 @@ struct EllipseData {
     std::vector<float> Sa, Sb;
 };
 
+// position constraint between an arc i and a candidate arc j or k of a triplet
+struct ArcConstraint {
+    bool last;    // use the last point of the candidate arc, otherwise the first one
+    bool y;       // compare y coordinates, otherwise x coordinates
+    bool below;   // candidate coordinate must not exceed the reference, otherwise not fall below it
+    bool refLast; // reference is the last point of arc i, otherwise the first one
+};
+
+// constraints on arcs j and k for the triplets 124, 231, 342 and 413
+static const ArcConstraint tripletConstraints[4][2] = {
+        {{true, false, true, false}, {true, true, false, true}},
+        {{false, true, false, false}, {false, false, false, true}},
+        {{false, false, false, true}, {false, true, true, false}},
+        {{true, true, true, true}, {true, false, true, false}}
+};
+
+static inline int arcCoordinate(const VP &arc, bool last, bool y) {
+    const Point &p = last ? arc.back() : arc.front();
+    return y ? p.y : p.x;
+}
+
+static inline float constraintBound(const ArcConstraint &c, const VP &ref, float threshold) {
+    return float(arcCoordinate(ref, c.refLast, c.y)) + (c.below ? threshold : -threshold);
+}
+
+static inline bool satisfiesConstraint(const ArcConstraint &c, const VP &ref, const VP &arc,
+                                       float threshold) {
+    float bound = constraintBound(c, ref, threshold);
+    auto v = float(arcCoordinate(arc, c.last, c.y));
+    return c.below ? !(v > bound) : !(v < bound);
+}
+
+// arcs sorted by the endpoint coordinate a constraint looks at, so that the arcs satisfying
+// it are found by binary search instead of testing every arc
+class ArcEndpointIndex {
+public:
+    void build(const VVP &arcs, const ArcConstraint &constraint) {
+        c = constraint;
+        std::vector<std::pair<int, int> > order(arcs.size());
+        for (size_t n = 0; n < arcs.size(); n++)
+            order[n] = std::make_pair(arcCoordinate(arcs[n], c.last, c.y), int(n));
+        std::sort(order.begin(), order.end());
+        keys.resize(order.size());
+        ids.resize(order.size());
+        for (size_t n = 0; n < order.size(); n++) {
+            keys[n] = order[n].first;
+            ids[n] = order[n].second;
+        }
+    }
+
+    // indices of the arcs satisfying the constraint with respect to ref, in increasing order
+    void select(const VP &ref, float threshold, std::vector<int> &out) const {
+        float bound = constraintBound(c, ref, threshold);
+        std::vector<int>::const_iterator first = keys.begin(), last = keys.end();
+        if (c.below)
+            last = std::upper_bound(keys.begin(), keys.end(), bound,
+                                    [](float b, int k) { return b < float(k); });
+        else
+            first = std::lower_bound(keys.begin(), keys.end(), bound,
+                                     [](int k, float b) { return float(k) < b; });
+        out.assign(ids.begin() + (first - keys.begin()), ids.begin() + (last - keys.begin()));
+        std::sort(out.begin(), out.end());
+    }
+
+private:
+    ArcConstraint c;
+    std::vector<int> keys, ids;
+};
+
+// arc pairs surviving the position and CNC constraints of one triplet search
+struct TripletCandidates {
+    std::vector<std::vector<int> > arcs_j; // arcs j of each arc i, in increasing order
+    std::vector<uchar> has_k; // whether any arc k satisfies the position constraint of arc i
+};
+
 // implement of ellipse detector
 class EllipseDetectorImpl {
 
@@ -213,12 +287,8 @@ class EllipseDetectorImpl {
     Size _imgSize; // input image size
 
     int ACC_N_SIZE, ACC_R_SIZE, ACC_A_SIZE; // size of accumulator
-    int *accN, *accR, *accA; // pointer to accumulator
 
 public:
-    float countsOfFindEllipse;
-    float countsOfGetFastCenter;
-
     EllipseDetectorImpl();
 
     ~EllipseDetectorImpl() = default;
@@ -230,14 +300,6 @@ public:
     void setParameters(float maxCenterDistance, float minScore, float minReliability);
 
 private:
-    // keys for hash table
-    static const ushort PAIR_12 = 0x00;
-    static const ushort PAIR_23 = 0x01;
-    static const ushort PAIR_34 = 0x02;
-    static const ushort PAIR_14 = 0x03;
-
-    static uint inline generateKey(uchar pair, ushort u, ushort v);
-
     void preProcessing(Mat1b &image, Mat1b &dp, Mat1b &dn);
 
     void clusterEllipses(std::vector<Ellipse> &ellipses);
@@ -247,31 +309,35 @@ private:
 
     void getFastCenter(std::vector<Point> &e1, std::vector<Point> &e2, EllipseData &data);
 
-    void detectEdges13(Mat1b &DP, VVP &points_1, VVP &points_3);
+    void detectEdges13(VVP &contours, VVP &points_1, VVP &points_3);
 
-    void detectEdges24(Mat1b &DN, VVP &points_2, VVP &points_4);
+    void detectEdges24(VVP &contours, VVP &points_2, VVP &points_4);
 
     void
     findEllipses(Point2f &center, VP &edge_i, VP &edge_j, VP &edge_k, EllipseData &data_ij,
-                 EllipseData &data_ik, std::vector<Ellipse> &ellipses);
+                 EllipseData &data_ik, int *acc, std::vector<Ellipse> &ellipses);
 
     static Point2f getCenterCoordinates(EllipseData &data_ij, EllipseData &data_ik);
 
     void
-    getTriplets124(VVP &pi, VVP &pj, VVP &pk, std::unordered_map<uint, EllipseData> &data,
-                   std::vector<Ellipse> &ellipses);
+    getTriplets124(VVP &pi, VVP &pj, VVP &pk, int i, const std::vector<int> &cand_j,
+                   const std::vector<int> &cand_k, const TripletCandidates *passes,
+                   int *acc, std::vector<Ellipse> &ellipses);
 
     void
-    getTriplets231(VVP &pi, VVP &pj, VVP &pk, std::unordered_map<uint, EllipseData> &data,
-                   std::vector<Ellipse> &ellipses);
+    getTriplets231(VVP &pi, VVP &pj, VVP &pk, int i, const std::vector<int> &cand_j,
+                   const std::vector<int> &cand_k, const TripletCandidates *passes,
+                   int *acc, std::vector<Ellipse> &ellipses);
 
     void
-    getTriplets342(VVP &pi, VVP &pj, VVP &pk, std::unordered_map<uint, EllipseData> &data,
-                   std::vector<Ellipse> &ellipses);
+    getTriplets342(VVP &pi, VVP &pj, VVP &pk, int i, const std::vector<int> &cand_j,
+                   const std::vector<int> &cand_k, const TripletCandidates *passes,
+                   int *acc, std::vector<Ellipse> &ellipses);
 
     void
-    getTriplets413(VVP &pi, VVP &pj, VVP &pk, std::unordered_map<uint, EllipseData> &data,
-                   std::vector<Ellipse> &ellipses);
+    getTriplets413(VVP &pi, VVP &pj, VVP &pk, int i, const std::vector<int> &cand_j,
+                   const std::vector<int> &cand_k, const TripletCandidates *passes,
+                   int *acc, std::vector<Ellipse> &ellipses);
 
     static void labeling(Mat1b &image, VVP &segments, int minLength);
 };
@@ -300,10 +366,6 @@ void EllipseDetectorImpl::setParameters(float maxCenterDistance, float minScore,
     _maxCenterDistance2 = _maxCenterDistance * _maxCenterDistance;
 }
 
-uint inline EllipseDetectorImpl::generateKey(uchar pair, ushort u, ushort v) {
-    return (pair << 30) + (u << 15) + v;
-}
-
 float EllipseDetectorImpl::getMedianSlope(std::vector<Point2f> &med, Point2f &centers,
                                           std::vector<float> &slopes) {
     // med		: vector of points
@@ -349,7 +411,6 @@ float EllipseDetectorImpl::getMedianSlope(std::vector<Point2f> &med, Point2f &ce
 
 void EllipseDetectorImpl::getFastCenter(std::vector<Point> &e1, std::vector<Point> &e2,
                                         EllipseData &data) {
-    countsOfGetFastCenter++;
     data.isValid = true;
 
     auto size_1 = unsigned(e1.size());
@@ -720,99 +781,111 @@ void EllipseDetectorImpl::labeling(Mat1b &image, VVP &segments, int minLength) {
     }
 }
 
-void EllipseDetectorImpl::detectEdges13(Mat1b &DP, VVP &points_1, VVP &points_3) {
-    // vector of connected edge points
-    VVP contours;
-    // labeling 8-connected edge points, discarding edge too small
-    labeling(DP, contours, _minEdgeLength); // label point on the same arc
+void EllipseDetectorImpl::detectEdges13(VVP &contours, VVP &points_1, VVP &points_3) {
     int contourSize = int(contours.size());
+    std::vector<uchar> convexity(contourSize, 0);
 
     // for each edge
-    for (int i = 0; i < contourSize; i++) {
-        VP &edgeSegment = contours[i];
+    parallel_for_(Range(0, contourSize), [&](const Range &range) {
+        for (int i = range.start; i < range.end; i++) {
+            VP &edgeSegment = contours[i];
 
-        // selection strategy - constraint on axes aspect ratio
-        RotatedRect oriented = minAreaRect(edgeSegment);
-        float orMin = min(oriented.size.width, oriented.size.height);
+            // selection strategy - constraint on axes aspect ratio
+            RotatedRect oriented = minAreaRect(edgeSegment);
+            float orMin = min(oriented.size.width, oriented.size.height);
 
-        if (orMin < _minOrientedRectSide) {
-            continue;
-        }
+            if (orMin < _minOrientedRectSide) {
+                continue;
+            }
 
-        // order edge points of the same arc
-        std::sort(edgeSegment.begin(), edgeSegment.end(), sortPoint);
-        int edgeSegmentSize = unsigned(edgeSegment.size());
+            // order edge points of the same arc
+            std::sort(edgeSegment.begin(), edgeSegment.end(), sortPoint);
+            int edgeSegmentSize = unsigned(edgeSegment.size());
 
-        // get extrema of the arc
-        Point &left = edgeSegment[0];
-        Point &right = edgeSegment[edgeSegmentSize - 1];
+            // get extrema of the arc
+            Point &left = edgeSegment[0];
+            Point &right = edgeSegment[edgeSegmentSize - 1];
 
-        // find convexity
-        int countTop = 0;
-        int lx = left.x;
-        for (int k = 1; k < edgeSegmentSize; ++k) {
-            if (edgeSegment[k].x == lx)
-                continue;
-            countTop += (edgeSegment[k].y - left.y);
-            lx = edgeSegment[k].x;
-        }
+            // find convexity
+            int countTop = 0;
+            int lx = left.x;
+            for (int k = 1; k < edgeSegmentSize; ++k) {
+                if (edgeSegment[k].x == lx)
+                    continue;
+                countTop += (edgeSegment[k].y - left.y);
+                lx = edgeSegment[k].x;
+            }
 
-        int width = abs(right.x - left.x) + 1;
-        int height = abs(right.y - left.y) + 1;
-        int countBottom = (width * height) - edgeSegmentSize - countTop;
+            int width = abs(right.x - left.x) + 1;
+            int height = abs(right.y - left.y) + 1;
+            int countBottom = (width * height) - edgeSegmentSize - countTop;
 
-        if (countBottom > countTop)
-            points_1.push_back(edgeSegment);
-        else if (countBottom < countTop)
-            points_3.push_back(edgeSegment);
+            if (countBottom > countTop)
+                convexity[i] = 1;
+            else if (countBottom < countTop)
+                convexity[i] = 3;
+        }
+    });
+
+    for (int i = 0; i < contourSize; i++) {
+        if (convexity[i] == 1)
+            points_1.push_back(std::move(contours[i]));
+        else if (convexity[i] == 3)
+            points_3.push_back(std::move(contours[i]));
     }
 }
 
-void EllipseDetectorImpl::detectEdges24(Mat1b &DN, VVP &points_2, VVP &points_4) {
-    // vector of connected edge points
-    VVP contours;
-    // labeling 8-connected edge points, discarding edge too small
-    labeling(DN, contours, _minEdgeLength); // label point on the same arc
+void EllipseDetectorImpl::detectEdges24(VVP &contours, VVP &points_2, VVP &points_4) {
     int contourSize = int(contours.size());
+    std::vector<uchar> convexity(contourSize, 0);
 
     // for each edge
-    for (int i = 0; i < contourSize; i++) {
-        VP &edgeSegment = contours[i];
+    parallel_for_(Range(0, contourSize), [&](const Range &range) {
+        for (int i = range.start; i < range.end; i++) {
+            VP &edgeSegment = contours[i];
 
-        // selection strategy - constraint on axes aspect ratio
-        RotatedRect oriented = minAreaRect(edgeSegment);
-        float orMin = min(oriented.size.width, oriented.size.height);
+            // selection strategy - constraint on axes aspect ratio
+            RotatedRect oriented = minAreaRect(edgeSegment);
+            float orMin = min(oriented.size.width, oriented.size.height);
 
-        if (orMin < _minOrientedRectSide) {
-            continue;
-        }
+            if (orMin < _minOrientedRectSide) {
+                continue;
+            }
 
-        // order edge points of the same arc
-        std::sort(edgeSegment.begin(), edgeSegment.end(), sortPoint);
-        int edgeSegmentSize = unsigned(edgeSegment.size());
+            // order edge points of the same arc
+            std::sort(edgeSegment.begin(), edgeSegment.end(), sortPoint);
+            int edgeSegmentSize = unsigned(edgeSegment.size());
 
-        // get extrema of the arc
-        Point &left = edgeSegment[0];
-        Point &right = edgeSegment[edgeSegmentSize - 1];
+            // get extrema of the arc
+            Point &left = edgeSegment[0];
+            Point &right = edgeSegment[edgeSegmentSize - 1];
 
-        // find convexity
-        int countBottom = 0;
-        int lx = left.x;
-        for (int k = 0; k < edgeSegmentSize; ++k) {
-            if (edgeSegment[k].x == lx)
-                continue;
-            countBottom += (left.y - edgeSegment[k].y);
-            lx = edgeSegment[k].x;
-        }
+            // find convexity
+            int countBottom = 0;
+            int lx = left.x;
+            for (int k = 0; k < edgeSegmentSize; ++k) {
+                if (edgeSegment[k].x == lx)
+                    continue;
+                countBottom += (left.y - edgeSegment[k].y);
+                lx = edgeSegment[k].x;
+            }
 
-        int width = abs(right.x - left.x) + 1;
-        int height = abs(right.y - left.y) + 1;
-        int countTop = (width * height) - edgeSegmentSize - countBottom;
+            int width = abs(right.x - left.x) + 1;
+            int height = abs(right.y - left.y) + 1;
+            int countTop = (width * height) - edgeSegmentSize - countBottom;
 
-        if (countBottom > countTop)
-            points_2.push_back(edgeSegment);
-        else if (countBottom < countTop)
-            points_4.push_back(edgeSegment);
+            if (countBottom > countTop)
+                convexity[i] = 2;
+            else if (countBottom < countTop)
+                convexity[i] = 4;
+        }
+    });
+
+    for (int i = 0; i < contourSize; i++) {
+        if (convexity[i] == 2)
+            points_2.push_back(std::move(contours[i]));
+        else if (convexity[i] == 4)
+            points_4.push_back(std::move(contours[i]));
     }
 }
 
@@ -821,399 +894,270 @@ void EllipseDetectorImpl::detectEdges24(Mat1b &DN, VVP &points_2, VVP &points_4)
 #define T342 pif,pim,pil,pjf,pjm,pjl
 #define T413 pif,pim,pil,pjl,pjm,pjf
 
-void EllipseDetectorImpl::getTriplets124(VVP &pi, VVP &pj, VVP &pk,
-                                         std::unordered_map<uint, EllipseData> &data,
-                                         std::vector<Ellipse> &ellipses) {
-    // get arcs length
-    auto sz_i = ushort(pi.size());
-    auto sz_j = ushort(pj.size());
-    auto sz_k = ushort(pk.size());
-
-    // for each edge i
-    for (ushort i = 0; i < sz_i; i++) {
-        VP &edge_i = pi[i];
-        auto sz_ei = ushort(edge_i.size());
-
-        Point &pif = edge_i[0];
-        Point &pim = edge_i[sz_ei / 2];
-        Point &pil = edge_i[sz_ei - 1];
-
-        // 1 -> reverse 1
-        VP rev_i(edge_i.size());
-        std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
-
-        // for each edge j
-        for (ushort j = 0; j < sz_j; ++j) {
-            VP &edge_j = pj[j];
-            auto sz_ej = ushort(edge_j.size());
-
-            Point &pjf = edge_j[0];
-            Point &pjm = edge_j[sz_ej / 2];
-            Point &pjl = edge_j[sz_ej - 1];
-
-            // constraints on position
-            if (pjl.x > pif.x + _positionThreshold)
-                continue;
-
-            // constraints on CNC
-            const float CNC_THRESHOLD = 0.3f;
-            if (fabs(valueOfPoints(T124) - 1) > CNC_THRESHOLD)
-                continue;
-
-            uint key_ij = generateKey(PAIR_12, i, j);
-
-            // for each edge k
-            for (ushort k = 0; k < sz_k; ++k) {
-                VP &edge_k = pk[k];
-                auto sz_ek = ushort(edge_k.size());
+// constraint on CNC between arcs i and j of the triplets 124, 231, 342 and 413
+static bool satisfiesCNC(int triplet, const VP &edge_i, const VP &edge_j) {
+    const float CNC_THRESHOLD = 0.3f;
+
+    const Point &pif = edge_i[0];
+    const Point &pim = edge_i[edge_i.size() / 2];
+    const Point &pil = edge_i[edge_i.size() - 1];
+    const Point &pjf = edge_j[0];
+    const Point &pjm = edge_j[edge_j.size() / 2];
+    const Point &pjl = edge_j[edge_j.size() - 1];
+
+    float cnc;
+    switch (triplet) {
+        case 0: cnc = valueOfPoints(T124); break;
+        case 1: cnc = valueOfPoints(T231); break;
+        case 2: cnc = valueOfPoints(T342); break;
+        default: cnc = valueOfPoints(T413); break;
+    }
+    return !(fabs(cnc - 1) > CNC_THRESHOLD);
+}
 
-                Point &pkl = edge_k[sz_ek - 1];
+// Pair data is computed per arc i, so the triplet searches run independently. A pair also
+// reached by an earlier search (12 in 124, 23 in 231, 34 in 342) reuses the arc order of that
+// search, as the data shared through a single hash table did when the searches ran in sequence.
 
-                // constraints on position
-                if (pkl.y < pil.y - _positionThreshold)
-                    continue;
+void EllipseDetectorImpl::getTriplets124(VVP &pi, VVP &pj, VVP &pk, int i,
+                                         const std::vector<int> &cand_j,
+                                         const std::vector<int> &cand_k,
+                                         const TripletCandidates * /*passes*/,
+                                         int *acc, std::vector<Ellipse> &ellipses) {
+    VP &edge_i = pi[i];
 
-                uint key_ik = generateKey(PAIR_14, i, k);
+    // 1 -> reverse 1
+    VP rev_i(edge_i.size());
+    std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
 
-                // find centers
-                EllipseData data_ij, data_ik;
+    // data of the pairs i-k, computed on first use
+    std::vector<EllipseData> data_k(cand_k.size());
+    std::vector<uchar> done_k(cand_k.size(), 0);
 
-                // if the data for the pair i-j have not been computed yet
-                if (data.count(key_ij) == 0) {
-                    getFastCenter(edge_j, rev_i, data_ij);
-                    // insert computed data in the hash table
-                    data.insert(std::pair<uint, EllipseData>(key_ij, data_ij));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ij = data.at(key_ij);
-                }
+    // for each edge j
+    for (int j : cand_j) {
+        VP &edge_j = pj[j];
 
-                // if the data for the pair i-k have not been computed yet
-                if (data.count(key_ik) == 0) {
-                    getFastCenter(edge_i, edge_k, data_ik);
-                    // insert computed data in the hash table
-                    data.insert(std::pair<uint, EllipseData>(key_ik, data_ik));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ik = data.at(key_ik);
-                }
-
-                // invalid centers
-                if (!data_ij.isValid || !data_ik.isValid)
-                    continue;
+        EllipseData data_ij;
+        getFastCenter(edge_j, rev_i, data_ij);
+        if (!data_ij.isValid)
+            continue;
 
-                // selection strategy - Step 3.
-                // the computed centers are not close enough
-                if (pointDistance2(data_ij.Cab, data_ik.Cab) > _maxCenterDistance2)
-                    continue;
+        // for each edge k
+        for (size_t n = 0; n < cand_k.size(); ++n) {
+            VP &edge_k = pk[cand_k[n]];
 
-                // find ellipse parameters
-                // get the coordinates of the center (xc, yc)
-                Point2f center = getCenterCoordinates(data_ij, data_ik);
-                // find remaining parameters (A, B, rho)
-                findEllipses(center, edge_i, edge_j, edge_k, data_ij, data_ik, ellipses);
+            EllipseData &data_ik = data_k[n];
+            if (!done_k[n]) {
+                getFastCenter(edge_i, edge_k, data_ik);
+                done_k[n] = 1;
             }
-        }
-    }
-}
 
-void EllipseDetectorImpl::getTriplets231(VVP &pi, VVP &pj, VVP &pk,
-                                         std::unordered_map<uint, EllipseData> &data,
-                                         std::vector<Ellipse> &ellipses) {
-    // get arc length
-    auto sz_i = ushort(pi.size());
-    auto sz_j = ushort(pj.size());
-    auto sz_k = ushort(pk.size());
-
-    // for each edge i
-    for (ushort i = 0; i < sz_i; i++) {
-        VP &edge_i = pi[i];
-        auto sz_ei = ushort(edge_i.size());
-
-        Point &pif = edge_i[0];
-        Point &pim = edge_i[sz_ei / 2];
-        Point &pil = edge_i[sz_ei - 1];
-
-        // 2 -> reverse 2
-        VP rev_i(edge_i.size());
-        std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
-
-        // for each edge j
-        for (ushort j = 0; j < sz_j; ++j) {
-            VP &edge_j = pj[j];
-            auto sz_ej = ushort(edge_j.size());
-
-            Point &pjf = edge_j[0];
-            Point &pjm = edge_j[sz_ej / 2];
-            Point &pjl = edge_j[sz_ej - 1];
-
-            // constraints on position
-            if (pjf.y < pif.y - _positionThreshold)
+            // invalid centers
+            if (!data_ik.isValid)
                 continue;
 
-            // constraints on CNC
-            const float CNC_THRESHOLD = 0.3f;
-            if (fabs(valueOfPoints(T231) - 1) > CNC_THRESHOLD)
+            // selection strategy - Step 3.
+            // the computed centers are not close enough
+            if (pointDistance2(data_ij.Cab, data_ik.Cab) > _maxCenterDistance2)
                 continue;
 
-            // 3 -> reverse 3
-            VP rev_j(edge_j.size());
-            std::reverse_copy(edge_j.begin(), edge_j.end(), rev_j.begin());
-
-            uint key_ij = generateKey(PAIR_23, i, j);
-
-            // for each edge k
-            for (ushort k = 0; k < sz_k; ++k) {
-                VP &edge_k = pk[k];
-
-                Point &pkf = edge_k[0];
-
-                // constraints on position
-                if (pkf.x < pil.x - _positionThreshold)
-                    continue;
-
-                uint key_ik = generateKey(PAIR_12, k, i);
-
-                // find centers
-                EllipseData data_ij, data_ik;
-
-                // if the data for the pair i-j have not been computed yet
-                if (data.count(key_ij) == 0) {
-                    getFastCenter(rev_i, rev_j, data_ij);
-                    // insert computed date in the hash table
-                    data.insert(std::pair<uint, EllipseData>(key_ij, data_ij));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ij = data.at(key_ij);
-                }
-
-                // if the data for the pair i-k have not been computed yet
-                if (data.count(key_ik) == 0) {
-                    // 1 -> reverse 1
-                    VP rev_k(edge_k.size());
-                    std::reverse_copy(edge_k.begin(), edge_k.end(), rev_k.begin());
-
-                    getFastCenter(edge_i, rev_k, data_ik);
-                    data.insert(std::pair<uint, EllipseData>(key_ik, data_ik));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ik = data.at(key_ik);
-                }
-
-                // invalid centers
-                if (!data_ij.isValid || !data_ik.isValid)
-                    continue;
-
-                // selection strategy - Step 3.
-                // the computed centers are not close enough
-                if (pointDistance2(data_ij.Cab, data_ik.Cab) > _maxCenterDistance2)
-                    continue;
-
-                // find ellipse parameters
-                // get the coordinates of the center (xc, yc)
-                Point2f center = getCenterCoordinates(data_ij, data_ik);
-                // find remaining parameters (A, B, rho)
-                findEllipses(center, edge_i, edge_j, edge_k, data_ij, data_ik, ellipses);
-            }
+            // find ellipse parameters
+            // get the coordinates of the center (xc, yc)
+            Point2f center = getCenterCoordinates(data_ij, data_ik);
+            // find remaining parameters (A, B, rho)
+            findEllipses(center, edge_i, edge_j, edge_k, data_ij, data_ik, acc, ellipses);
         }
     }
 }
 
-void EllipseDetectorImpl::getTriplets342(VVP &pi, VVP &pj, VVP &pk,
-                                         std::unordered_map<uint, EllipseData> &data,
-                                         std::vector<Ellipse> &ellipses) {
-    // get arcs length
-    auto sz_i = ushort(pi.size());
-    auto sz_j = ushort(pj.size());
-    auto sz_k = ushort(pk.size());
+void EllipseDetectorImpl::getTriplets231(VVP &pi, VVP &pj, VVP &pk, int i,
+                                         const std::vector<int> &cand_j,
+                                         const std::vector<int> &cand_k,
+                                         const TripletCandidates * /*passes*/,
+                                         int *acc, std::vector<Ellipse> &ellipses) {
+    VP &edge_i = pi[i];
 
-    // for each edge i
-    for (ushort i = 0; i < sz_i; i++) {
-        VP &edge_i = pi[i];
-        auto sz_ei = ushort(edge_i.size());
+    // 2 -> reverse 2
+    VP rev_i(edge_i.size());
+    std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
 
-        Point &pif = edge_i[0];
-        Point &pim = edge_i[sz_ei / 2];
-        Point &pil = edge_i[sz_ei - 1];
-
-        // 3 -> reverse 3
-        VP rev_i(edge_i.size());
-        std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
+    // data of the pairs i-k, computed on first use
+    std::vector<EllipseData> data_k(cand_k.size());
+    std::vector<uchar> done_k(cand_k.size(), 0);
 
-        // for each edge j
-        for (ushort j = 0; j < sz_j; ++j) {
-            VP &edge_j = pj[j];
-            auto sz_ej = ushort(edge_j.size());
+    // for each edge j
+    for (int j : cand_j) {
+        VP &edge_j = pj[j];
 
-            Point &pjf = edge_j[0];
-            Point &pjm = edge_j[sz_ej / 2];
-            Point &pjl = edge_j[sz_ej - 1];
-
-            // constraints on position
-            if (pjf.x < pil.x - _positionThreshold)
-                continue;
-
-            // constraints on CNC
-            const float CNC_THRESHOLD = 0.3f;
-            if (fabs(valueOfPoints(T342) - 1) > CNC_THRESHOLD)
-                continue;
-
-            // 4 -> reverse 4
-            VP rev_j(edge_j.size());
-            std::reverse_copy(edge_j.begin(), edge_j.end(), rev_j.begin());
-
-            uint key_ij = generateKey(PAIR_34, i, j);
-
-            // for each edge k
-            for (ushort k = 0; k < sz_k; ++k) {
-                VP &edge_k = pk[k];
-
-                Point &pkf = edge_k[0];
-
-                // constraints on position
-                if (pkf.y > pif.y + _positionThreshold)
-                    continue;
-
-                uint key_ik = generateKey(PAIR_23, k, i);
+        // 3 -> reverse 3
+        VP rev_j(edge_j.size());
+        std::reverse_copy(edge_j.begin(), edge_j.end(), rev_j.begin());
 
-                // find centers
-                EllipseData data_ij, data_ik;
+        EllipseData data_ij;
+        getFastCenter(rev_i, rev_j, data_ij);
+        if (!data_ij.isValid)
+            continue;
 
-                // if the data for the pair i-j have not been computed yet
-                if (data.count(key_ij) == 0) {
-                    getFastCenter(edge_i, rev_j, data_ij);
-                    // insert computed data in the hash table
-                    data.insert(std::pair<uint, EllipseData>(key_ij, data_ij));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ij = data.at(key_ij);
-                }
+        // for each edge k
+        for (size_t n = 0; n < cand_k.size(); ++n) {
+            VP &edge_k = pk[cand_k[n]];
 
-                // if the data for the pair i-k have not been computed yet
-                if (data.count(key_ik) == 0) {
-                    // 2 -> reverse 2
-                    VP rev_k(edge_k.size());
-                    std::reverse_copy(edge_k.begin(), edge_k.end(), rev_k.begin());
+            EllipseData &data_ik = data_k[n];
+            if (!done_k[n]) {
+                // 1 -> reverse 1
+                VP rev_k(edge_k.size());
+                std::reverse_copy(edge_k.begin(), edge_k.end(), rev_k.begin());
 
-                    getFastCenter(rev_i, rev_k, data_ik);
-                    data.insert(std::pair<uint, EllipseData>(key_ik, data_ik));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ik = data.at(key_ik);
-                }
+                getFastCenter(edge_i, rev_k, data_ik);
+                done_k[n] = 1;
+            }
 
-                // invalid centers
-                if (!data_ij.isValid || !data_ik.isValid)
-                    continue;
+            // invalid centers
+            if (!data_ik.isValid)
+                continue;
 
-                // selection strategy - Step 3.
-                // the computed centers are not close enough
-                if (pointDistance2(data_ij.Cab, data_ik.Cab) > _maxCenterDistance2)
-                    continue;
+            // selection strategy - Step 3.
+            // the computed centers are not close enough
+            if (pointDistance2(data_ij.Cab, data_ik.Cab) > _maxCenterDistance2)
+                continue;
 
-                // find ellipse parameters
-                // get the coordinates of the center (xc, yc)
-                Point2f center = getCenterCoordinates(data_ij, data_ik);
-                // find remaining parameters (A, B, rho)
-                findEllipses(center, edge_i, edge_j, edge_k, data_ij, data_ik, ellipses);
-            }
+            // find ellipse parameters
+            // get the coordinates of the center (xc, yc)
+            Point2f center = getCenterCoordinates(data_ij, data_ik);
+            // find remaining parameters (A, B, rho)
+            findEllipses(center, edge_i, edge_j, edge_k, data_ij, data_ik, acc, ellipses);
         }
-
     }
 }
 
-void EllipseDetectorImpl::getTriplets413(VVP &pi, VVP &pj, VVP &pk,
-                                         std::unordered_map<uint, EllipseData> &data,
-                                         std::vector<Ellipse> &ellipses) {
-    // get arch length
-    auto sz_i = ushort(pi.size());
-    auto sz_j = ushort(pj.size());
-    auto sz_k = ushort(pk.size());
+void EllipseDetectorImpl::getTriplets342(VVP &pi, VVP &pj, VVP &pk, int i,
+                                         const std::vector<int> &cand_j,
+                                         const std::vector<int> &cand_k,
+                                         const TripletCandidates *passes,
+                                         int *acc, std::vector<Ellipse> &ellipses) {
+    VP &edge_i = pi[i];
 
-    // for each edge i
-    for (ushort i = 0; i < sz_i; i++) {
-        VP &edge_i = pi[i];
-        auto sz_ei = ushort(edge_i.size());
+    // 3 -> reverse 3
+    VP rev_i(edge_i.size());
+    std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
 
-        Point &pif = edge_i[0];
-        Point &pim = edge_i[sz_ei / 2];
-        Point &pil = edge_i[sz_ei - 1];
+    // data of the pairs i-k, computed on first use
+    std::vector<EllipseData> data_k(cand_k.size());
+    std::vector<uchar> done_k(cand_k.size(), 0);
+
+    // for each edge j
+    for (int j : cand_j) {
+        VP &edge_j = pj[j];
 
         // 4 -> reverse 4
-        VP rev_i(edge_i.size());
-        std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
+        VP rev_j(edge_j.size());
+        std::reverse_copy(edge_j.begin(), edge_j.end(), rev_j.begin());
 
-        // for each edge j
-        for (ushort j = 0; j < sz_j; ++j) {
-            VP &edge_j = pj[j];
-            auto sz_ej = ushort(edge_j.size());
+        EllipseData data_ij;
+        getFastCenter(edge_i, rev_j, data_ij);
+        if (!data_ij.isValid)
+            continue;
 
-            Point &pjf = edge_j[0];
-            Point &pjm = edge_j[sz_ej / 2];
-            Point &pjl = edge_j[sz_ej - 1];
+        // for each edge k
+        for (size_t n = 0; n < cand_k.size(); ++n) {
+            int k = cand_k[n];
+            VP &edge_k = pk[k];
+
+            EllipseData &data_ik = data_k[n];
+            if (!done_k[n]) {
+                // 2 -> reverse 2
+                VP rev_k(edge_k.size());
+                std::reverse_copy(edge_k.begin(), edge_k.end(), rev_k.begin());
+
+                // pair 2-3 already reached by the triplet 231
+                const TripletCandidates &t231 = passes[1];
+                if (t231.has_k[k] &&
+                    std::binary_search(t231.arcs_j[k].begin(), t231.arcs_j[k].end(), i))
+                    getFastCenter(rev_k, rev_i, data_ik);
+                else
+                    getFastCenter(rev_i, rev_k, data_ik);
+                done_k[n] = 1;
+            }
 
-            // constraints on position
-            if (pjl.y > pil.y + _positionThreshold)
+            // invalid centers
+            if (!data_ik.isValid)
                 continue;
 
-            // constraints on CNC
-            const float CNC_THRESHOLD = 0.3f;
-            if (fabs(valueOfPoints(T413) - 1) > CNC_THRESHOLD)
+            // selection strategy - Step 3.
+            // the computed centers are not close enough
+            if (pointDistance2(data_ij.Cab, data_ik.Cab) > _maxCenterDistance2)
                 continue;
 
-            uint key_ij = generateKey(PAIR_14, j, i);
-
-            // for each edge k
-            for (ushort k = 0; k < sz_k; ++k) {
-                VP &edge_k = pk[k];
-                auto sz_ek = ushort(edge_k.size());
-
-                Point &pkl = edge_k[sz_ek - 1];
-
-                // constraints on position
-                if (pkl.x > pif.x + _positionThreshold)
-                    continue;
-
-                uint key_ik = generateKey(PAIR_34, k, i);
-
-                // find centers
-                EllipseData data_ij, data_ik;
+            // find ellipse parameters
+            // get the coordinates of the center (xc, yc)
+            Point2f center = getCenterCoordinates(data_ij, data_ik);
+            // find remaining parameters (A, B, rho)
+            findEllipses(center, edge_i, edge_j, edge_k, data_ij, data_ik, acc, ellipses);
+        }
+    }
+}
 
-                // if the data for the pair i-j have not been computed yet
-                if (data.count(key_ij) == 0) {
-                    getFastCenter(edge_i, edge_j, data_ij);
-                    // insert computed date in the hash table
-                    data.insert(std::pair<uint, EllipseData>(key_ij, data_ij));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ij = data.at(key_ij);
-                }
+void EllipseDetectorImpl::getTriplets413(VVP &pi, VVP &pj, VVP &pk, int i,
+                                         const std::vector<int> &cand_j,
+                                         const std::vector<int> &cand_k,
+                                         const TripletCandidates *passes,
+                                         int *acc, std::vector<Ellipse> &ellipses) {
+    VP &edge_i = pi[i];
+
+    // 4 -> reverse 4
+    VP rev_i(edge_i.size());
+    std::reverse_copy(edge_i.begin(), edge_i.end(), rev_i.begin());
+
+    // data of the pairs i-k, computed on first use
+    std::vector<EllipseData> data_k(cand_k.size());
+    std::vector<uchar> done_k(cand_k.size(), 0);
+
+    // for each edge j
+    for (int j : cand_j) {
+        VP &edge_j = pj[j];
+
+        // pair 1-4 already reached by the triplet 124
+        EllipseData data_ij;
+        if (!passes[0].arcs_j[j].empty() &&
+            satisfiesConstraint(tripletConstraints[0][1], edge_j, edge_i, _positionThreshold))
+            getFastCenter(edge_j, edge_i, data_ij);
+        else
+            getFastCenter(edge_i, edge_j, data_ij);
+        if (!data_ij.isValid)
+            continue;
 
-                // if the data for the pair i-k have not been computed yet
-                if (data.count(key_ik) == 0) {
+        // for each edge k
+        for (size_t n = 0; n < cand_k.size(); ++n) {
+            int k = cand_k[n];
+            VP &edge_k = pk[k];
+
+            EllipseData &data_ik = data_k[n];
+            if (!done_k[n]) {
+                // pair 3-4 already reached by the triplet 342
+                const TripletCandidates &t342 = passes[2];
+                if (t342.has_k[k] &&
+                    std::binary_search(t342.arcs_j[k].begin(), t342.arcs_j[k].end(), i))
+                    getFastCenter(edge_k, rev_i, data_ik);
+                else
                     getFastCenter(rev_i, edge_k, data_ik);
-                    data.insert(std::pair<uint, EllipseData>(key_ik, data_ik));
-                } else {
-                    // otherwise, just lookup the data in the hash table
-                    data_ik = data.at(key_ik);
-                }
-
-                // invalid centers
-                if (!data_ij.isValid || !data_ik.isValid)
-                    continue;
+                done_k[n] = 1;
+            }
 
-                // selection strategy - Step 3.
-                // the computed centers are not close enough
-                if (pointDistance2(data_ij.Cab, data_ik.Cab) > _maxCenterDistance2)
-                    continue;
+            // invalid centers
+            if (!data_ik.isValid)
+                continue;
 
-                // find ellipse parameters
-                // get the coordinates of the center (xc, yc)
-                Point2f center = getCenterCoordinates(data_ij, data_ik);
-                // find remaining parameters (A, B, rho)
-                findEllipses(center, edge_i, edge_j, edge_k, data_ij, data_ik, ellipses);
+            // selection strategy - Step 3.
+            // the computed centers are not close enough
+            if (pointDistance2(data_ij.Cab, data_ik.Cab) > _maxCenterDistance2)
+                continue;
 
-            }
+            // find ellipse parameters
+            // get the coordinates of the center (xc, yc)
+            Point2f center = getCenterCoordinates(data_ij, data_ik);
+            // find remaining parameters (A, B, rho)
+            findEllipses(center, edge_i, edge_j, edge_k, data_ij, data_ik, acc, ellipses);
         }
     }
 }
@@ -1475,8 +1419,6 @@ void EllipseDetectorImpl::preProcessing(Mat1b &src, Mat1b &dp, Mat1b &dn) {
 }
 
 void EllipseDetectorImpl::detect(Mat1b &image, std::vector<Ellipse> &ellipses) {
-    countsOfFindEllipse = 0, countsOfGetFastCenter = 0;
-
     // set the image size
     _imgSize = image.size();
 
@@ -1487,46 +1429,110 @@ void EllipseDetectorImpl::detect(Mat1b &image, std::vector<Ellipse> &ellipses) {
     // initialize accumulator dimensions
     ACC_N_SIZE = 101, ACC_R_SIZE = 180, ACC_A_SIZE = max(_imgSize.height, _imgSize.width);
 
-    // allocate accumulators
-    accN = new int[ACC_N_SIZE], accR = new int[ACC_R_SIZE], accA = new int[ACC_A_SIZE];
-
     // other temporary
     VVP points_1, points_2, points_3, points_4; // vector of points, one for each convexity class
-    std::unordered_map<uint, EllipseData> centers; // hash map for reusing already computed EllipseData
 
     // preprocessing
     // find edge point with coarse convexity along positive (dp) or negative (dn) diagonal
     preProcessing(image, dp, dn);
 
+    // labeling 8-connected edge points, discarding edge too small
+    VVP contours[2];
+    parallel_for_(Range(0, 2), [&](const Range &range) {
+        for (int d = range.start; d < range.end; d++)
+            labeling(d == 0 ? dp : dn, contours[d], _minEdgeLength);
+    });
+
     // detect edge and find convexity
-    detectEdges13(dp, points_1, points_3);
-    detectEdges24(dn, points_2, points_4);
+    detectEdges13(contours[0], points_1, points_3);
+    detectEdges24(contours[1], points_2, points_4);
+
+    // arcs i, j and k of the triplets 124, 231, 342 and 413
+    VVP *arcs[4][3] = {
+            {&points_1, &points_2, &points_4},
+            {&points_2, &points_3, &points_1},
+            {&points_3, &points_4, &points_2},
+            {&points_4, &points_1, &points_3}
+    };
+
+    // the four searches are flattened into one range of arcs i
+    int ofs[5] = {0};
+    ArcEndpointIndex index[4][2];
+    TripletCandidates candidates[4];
+    for (int t = 0; t < 4; t++) {
+        index[t][0].build(*arcs[t][1], tripletConstraints[t][0]);
+        index[t][1].build(*arcs[t][2], tripletConstraints[t][1]);
+        candidates[t].arcs_j.resize(arcs[t][0]->size());
+        candidates[t].has_k.resize(arcs[t][0]->size(), 0);
+        ofs[t + 1] = ofs[t] + int(arcs[t][0]->size());
+    }
+
+    // selection strategy - Step 2 - position and CNC constraints
+    parallel_for_(Range(0, ofs[4]), [&](const Range &range) {
+        std::vector<int> cand;
+        for (int n = range.start; n < range.end; n++) {
+            int t = int(std::upper_bound(ofs, ofs + 5, n) - ofs) - 1, i = n - ofs[t];
+            VP &edge_i = (*arcs[t][0])[i];
+
+            index[t][1].select(edge_i, _positionThreshold, cand);
+            if (cand.empty())
+                continue;
+            candidates[t].has_k[i] = 1;
 
-    // find triplets
-    getTriplets124(points_1, points_2, points_4, centers, ellipses);
-    getTriplets231(points_2, points_3, points_1, centers, ellipses);
-    getTriplets342(points_3, points_4, points_2, centers, ellipses);
-    getTriplets413(points_4, points_1, points_3, centers, ellipses);
+            index[t][0].select(edge_i, _positionThreshold, cand);
+            for (int j : cand)
+                if (satisfiesCNC(t, edge_i, (*arcs[t][1])[j]))
+                    candidates[t].arcs_j[i].push_back(j);
+        }
+    });
+
+    // find triplets, keeping the detections of each arc i apart so that they are merged
+    // in the same order as a sequential search
+    std::vector<std::vector<Ellipse> > found(ofs[4]);
+    parallel_for_(Range(0, ofs[4]), [&](const Range &range) {
+        AutoBuffer<int> acc(ACC_N_SIZE + ACC_R_SIZE + ACC_A_SIZE);
+        std::vector<int> cand_k;
+        for (int n = range.start; n < range.end; n++) {
+            int t = int(std::upper_bound(ofs, ofs + 5, n) - ofs) - 1, i = n - ofs[t];
+            if (!candidates[t].has_k[i] || candidates[t].arcs_j[i].empty())
+                continue;
+
+            VVP &pi = *arcs[t][0], &pj = *arcs[t][1], &pk = *arcs[t][2];
+            const std::vector<int> &cand_j = candidates[t].arcs_j[i];
+            index[t][1].select(pi[i], _positionThreshold, cand_k);
+            switch (t) {
+                case 0:
+                    getTriplets124(pi, pj, pk, i, cand_j, cand_k, candidates, acc.data(), found[n]);
+                    break;
+                case 1:
+                    getTriplets231(pi, pj, pk, i, cand_j, cand_k, candidates, acc.data(), found[n]);
+                    break;
+                case 2:
+                    getTriplets342(pi, pj, pk, i, cand_j, cand_k, candidates, acc.data(), found[n]);
+                    break;
+                default:
+                    getTriplets413(pi, pj, pk, i, cand_j, cand_k, candidates, acc.data(), found[n]);
+                    break;
+            }
+        }
+    });
+    for (const std::vector<Ellipse> &f : found)
+        ellipses.insert(ellipses.end(), f.begin(), f.end());
 
     // std::sort by score
     std::sort(ellipses.begin(), ellipses.end());
 
-    // free accumulator memory
-    delete[]accN;
-    delete[]accR;
-    delete[]accA;
-
     // cluster detections
     clusterEllipses(ellipses);
 }
 
 void EllipseDetectorImpl::findEllipses(Point2f &center, VP &edge_i, VP &edge_j, VP &edge_k,
                                        EllipseData &data_ij, EllipseData &data_ik,
-                                       std::vector<Ellipse> &ellipses) {
-    countsOfFindEllipse++;
+                                       int *acc, std::vector<Ellipse> &ellipses) {
     // find ellipse parameters
 
     // 0-initialize accumulators
+    int *accN = acc, *accR = accN + ACC_N_SIZE, *accA = accR + ACC_R_SIZE;
     memset(accN, 0, sizeof(int) * ACC_N_SIZE);
     memset(accR, 0, sizeof(int) * ACC_R_SIZE);
     memset(accA, 0, sizeof(int) * ACC_A_SIZE);
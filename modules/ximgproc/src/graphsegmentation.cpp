@@ -40,6 +40,7 @@ the use of this software, even if advised of the possibility of such damage.
 
 #include "precomp.hpp"
 #include "opencv2/ximgproc/segmentation.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 #include <iostream>
 
@@ -103,6 +104,7 @@ namespace cv {
                         sigma = 0.5;
                         k = 300;
                         min_size = 100;
+                        max_edges = 0;
                         name_ = "GraphSegmentation";
                     }
 
@@ -120,11 +122,15 @@ namespace cv {
                     virtual void setMinSize(int min_size_) CV_OVERRIDE { min_size = min_size_; }
                     virtual int getMinSize() CV_OVERRIDE { return min_size; }
 
+                    virtual void setMaxEdgesInMemory(int max_edges_) CV_OVERRIDE { max_edges = std::max(max_edges_, 0); }
+                    virtual int getMaxEdgesInMemory() CV_OVERRIDE { return max_edges; }
+
                     virtual void write(FileStorage& fs) const CV_OVERRIDE {
                         fs << "name" << name_
                         << "sigma" << sigma
                         << "k" << k
-                        << "min_size" << (int)min_size;
+                        << "min_size" << (int)min_size
+                        << "max_edges" << (int)max_edges;
                     }
 
                     virtual void read(const FileNode& fn) CV_OVERRIDE {
@@ -133,12 +139,14 @@ namespace cv {
                         sigma = (double)fn["sigma"];
                         k = (float)fn["k"];
                         min_size = (int)(int)fn["min_size"];
+                        max_edges = (int)fn["max_edges"];
                     }
 
                 private:
                     double sigma;
                     float k;
                     int min_size;
+                    int max_edges;
                     String name_;
 
                     // Pre-filter the image
@@ -150,6 +158,12 @@ namespace cv {
                     // Segment the graph
                     void segmentGraph(Edge * edges, const int &nb_edges, const Mat & img_filtered, PointSet **es);
 
+                    // Merge a sorted run of edges into the segmentation
+                    void mergeSortedEdges(Edge *edges, int nb_edges, PointSet *es, float *thresholds);
+
+                    // Segment the graph and remove small areas without holding all edges in memory
+                    void segmentGraphBounded(const Mat &img_filtered, PointSet **es);
+
                     // Remove areas too small
                     void filterSmallAreas(Edge *edges, const int &nb_edges, PointSet *es);
 
@@ -168,46 +182,218 @@ namespace cv {
                 GaussianBlur(img_converted, img_filtered, Size(0, 0), sigma, sigma);
             }
 
+            // Computes the weights of the right (cols - 1) and bottom (cols, if p_down is set) edges of a row
+            static void computeRowWeights(const float *p, const float *p_down, int cols, int nb_channels,
+                                          float *w_right, float *w_down) {
+
+                int j = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                const int VECSZ = VTraits<v_float32>::vlanes();
+                if (nb_channels == 1) {
+                    for (; j <= cols - 1 - VECSZ; j += VECSZ) {
+                        v_float32 d = v_sub(vx_load(p + j), vx_load(p + j + 1));
+                        v_store(w_right + j, v_sqrt(v_mul(d, d)));
+                    }
+                } else if (nb_channels == 3) {
+                    for (; j <= cols - 1 - VECSZ; j += VECSZ) {
+                        v_float32 a0, a1, a2, b0, b1, b2;
+                        v_load_deinterleave(p + j * 3, a0, a1, a2);
+                        v_load_deinterleave(p + (j + 1) * 3, b0, b1, b2);
+                        v_float32 d0 = v_sub(a0, b0), d1 = v_sub(a1, b1), d2 = v_sub(a2, b2);
+                        v_store(w_right + j, v_sqrt(v_add(v_add(v_mul(d0, d0), v_mul(d1, d1)), v_mul(d2, d2))));
+                    }
+                }
+#endif
+                for (; j < cols - 1; j++) {
+                    float tmp_total = 0;
+                    for (int channel = 0; channel < nb_channels; channel++) {
+                        float tmp_diff = p[j * nb_channels + channel] - p[(j + 1) * nb_channels + channel];
+                        tmp_total += tmp_diff * tmp_diff;
+                    }
+                    w_right[j] = sqrt(tmp_total);
+                }
+
+                if (!p_down)
+                    return;
+
+                j = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+                if (nb_channels == 1) {
+                    for (; j <= cols - VECSZ; j += VECSZ) {
+                        v_float32 d = v_sub(vx_load(p + j), vx_load(p_down + j));
+                        v_store(w_down + j, v_sqrt(v_mul(d, d)));
+                    }
+                } else if (nb_channels == 3) {
+                    for (; j <= cols - VECSZ; j += VECSZ) {
+                        v_float32 a0, a1, a2, b0, b1, b2;
+                        v_load_deinterleave(p + j * 3, a0, a1, a2);
+                        v_load_deinterleave(p_down + j * 3, b0, b1, b2);
+                        v_float32 d0 = v_sub(a0, b0), d1 = v_sub(a1, b1), d2 = v_sub(a2, b2);
+                        v_store(w_down + j, v_sqrt(v_add(v_add(v_mul(d0, d0), v_mul(d1, d1)), v_mul(d2, d2))));
+                    }
+                }
+#endif
+                for (; j < cols; j++) {
+                    float tmp_total = 0;
+                    for (int channel = 0; channel < nb_channels; channel++) {
+                        float tmp_diff = p[j * nb_channels + channel] - p_down[j * nb_channels + channel];
+                        tmp_total += tmp_diff * tmp_diff;
+                    }
+                    w_down[j] = sqrt(tmp_total);
+                }
+            }
+
+            // Calls fn(weight, from, to) for the right and bottom edges of row i, in graph building order
+            template<typename Fn>
+            static void visitRowEdges(const Mat &img_filtered, int i, float *w_right, float *w_down, Fn &fn) {
+
+                const int rows = img_filtered.rows, cols = img_filtered.cols;
+                const float* p = img_filtered.ptr<float>(i);
+                const float* p_down = i + 1 < rows ? img_filtered.ptr<float>(i + 1) : NULL;
+
+                computeRowWeights(p, p_down, cols, img_filtered.channels(), w_right, w_down);
+
+                for (int j = 0; j < cols; j++) {
+
+                    // Take the right and down pixel, the left and top ones are handled by their neighbours
+                    if (j + 1 < cols)
+                        fn(w_right[j], i * cols + j, i * cols + j + 1);
+
+                    if (p_down)
+                        fn(w_down[j], i * cols + j, (i + 1) * cols + j);
+                }
+            }
+
+            // Computes the right and bottom edges of a range of rows. The edges of row i start at
+            // i * (2 * cols - 1), every row but the last one having cols - 1 right and cols bottom edges.
+            class GraphBuilderInvoker : public ParallelLoopBody {
+                public:
+                    GraphBuilderInvoker(const Mat &img_filtered_, Edge *edges_) : img_filtered(img_filtered_), edges(edges_) { }
+
+                    void operator()(const Range &range) const CV_OVERRIDE {
+
+                        const int cols = img_filtered.cols;
+                        AutoBuffer<float> buf(2 * cols);
+
+                        for (int i = range.start; i < range.end; i++) {
+                            Edge *e = edges + (size_t)i * (2 * cols - 1);
+                            auto store = [&e](float weight, int from, int to) {
+                                e->weight = weight;
+                                e->from = from;
+                                e->to = to;
+                                e++;
+                            };
+                            visitRowEdges(img_filtered, i, buf.data(), buf.data() + cols, store);
+                        }
+                    }
+
+                private:
+                    const Mat &img_filtered;
+                    Edge *edges;
+            };
+
             void GraphSegmentationImpl::buildGraph(Edge **edges, int &nb_edges, const Mat &img_filtered) {
 
-                *edges = new Edge[img_filtered.rows * img_filtered.cols * 4];
+                const int rows = img_filtered.rows, cols = img_filtered.cols;
 
-                nb_edges = 0;
+                // Each pixel is linked to its right and bottom neighbours, so every edge is present once
+                nb_edges = (rows - 1) * (2 * cols - 1) + (cols - 1);
+                nb_edges = std::max(nb_edges, 0);
 
-                int nb_channels = img_filtered.channels();
+                *edges = new Edge[std::max(nb_edges, 1)];
 
-                for (int i = 0; i < (int)img_filtered.rows; i++) {
-                    const float* p = img_filtered.ptr<float>(i);
+                parallel_for_(Range(0, rows), GraphBuilderInvoker(img_filtered, *edges));
+            }
 
-                    for (int j = 0; j < (int)img_filtered.cols; j++) {
+            // Weights are non negative, so their IEEE 754 bit patterns sort like the values
+            static inline unsigned edgeKey(float weight) {
+                Cv32suf u;
+                u.f = weight;
+                return u.u;
+            }
 
-                        //Take the right, left, top and down pixel
-                        for (int delta = -1; delta <= 1; delta += 2) {
-                            for (int delta_j = 0, delta_i = 1; delta_j <= 1; delta_j++ || delta_i--) {
+            // Stable LSD radix sort on the weight keys, 11 + 11 + 10 bits. Every pass histograms fixed chunks
+            // in parallel and scatters each chunk to its own offsets, so equal weights keep the graph building
+            // order and the result does not depend on the number of threads.
+            static void sortEdges(Edge *edges, int nb_edges) {
 
-                                int i2 = i + delta * delta_i;
-                                int j2 = j + delta * delta_j;
+                if (nb_edges < 2)
+                    return;
 
-                                if (i2 >= 0 && i2 < img_filtered.rows && j2 >= 0 && j2 < img_filtered.cols) {
-                                    const float* p2 = img_filtered.ptr<float>(i2);
+                const int radix_bits = 11, radix = 1 << radix_bits;
+                const int min_chunk = 1 << 15;
+                const int nb_chunks = std::max(1, std::min(getNumThreads() * 2, nb_edges / min_chunk));
 
-                                    float tmp_total = 0;
+                std::vector<int> bounds(nb_chunks + 1);
+                for (int k = 0; k <= nb_chunks; k++)
+                    bounds[k] = (int)((int64)nb_edges * k / nb_chunks);
 
-                                    for ( int channel = 0; channel < nb_channels; channel++) {
-                                        float tmp_diff = p[j * nb_channels + channel] - p2[j2 * nb_channels + channel];
-                                        tmp_total += tmp_diff * tmp_diff;
-                                    }
+                std::vector<int> hist((size_t)nb_chunks * radix);
+                std::vector<Edge> buffer;
+                Edge *src = edges, *dst = NULL;
 
-                                    float diff = 0;
-                                    diff = sqrt(tmp_total);
+                for (int shift = 0; shift < 32; shift += radix_bits) {
 
-                                    (*edges)[nb_edges].weight = diff;
-                                    (*edges)[nb_edges].from = i * img_filtered.cols +  j;
-                                    (*edges)[nb_edges].to = i2 * img_filtered.cols + j2;
+                    parallel_for_(Range(0, nb_chunks), [&](const Range &range) {
+                        for (int k = range.start; k < range.end; k++) {
+                            int *h = &hist[(size_t)k * radix];
+                            std::fill(h, h + radix, 0);
+                            for (int i = bounds[k]; i < bounds[k + 1]; i++)
+                                h[(edgeKey(src[i].weight) >> shift) & (radix - 1)]++;
+                        }
+                    });
+
+                    // Exclusive prefix sums, bucket-major so the chunks of a bucket stay in order
+                    int offset = 0;
+                    bool single_bucket = false;
+                    for (int b = 0; b < radix; b++) {
+                        int bucket_start = offset;
+                        for (int k = 0; k < nb_chunks; k++) {
+                            int count = hist[(size_t)k * radix + b];
+                            hist[(size_t)k * radix + b] = offset;
+                            offset += count;
+                        }
+                        if (offset - bucket_start == nb_edges)
+                            single_bucket = true;
+                    }
 
-                                    nb_edges++;
-                                }
-                            }
+                    // Every key has the same digit, the pass would not move anything
+                    if (single_bucket)
+                        continue;
+
+                    if (!dst) {
+                        buffer.resize(nb_edges);
+                        dst = &buffer[0];
+                    }
+
+                    parallel_for_(Range(0, nb_chunks), [&](const Range &range) {
+                        for (int k = range.start; k < range.end; k++) {
+                            int *h = &hist[(size_t)k * radix];
+                            for (int i = bounds[k]; i < bounds[k + 1]; i++)
+                                dst[h[(edgeKey(src[i].weight) >> shift) & (radix - 1)]++] = src[i];
+                        }
+                    });
+                    std::swap(src, dst);
+                }
+
+                if (src != edges)
+                    std::copy(src, src + nb_edges, edges);
+            }
+
+            void GraphSegmentationImpl::mergeSortedEdges(Edge *edges, int nb_edges, PointSet *es, float *thresholds) {
+
+                for ( int i = 0; i < nb_edges; i++) {
+
+                    int p_a = es->getBasePoint(edges[i].from);
+                    int p_b = es->getBasePoint(edges[i].to);
+
+                    if (p_a != p_b) {
+                        if (edges[i].weight <= thresholds[p_a] && edges[i].weight <= thresholds[p_b]) {
+                            es->joinPoints(p_a, p_b);
+                            p_a = es->getBasePoint(p_a);
+                            thresholds[p_a] = edges[i].weight + k / es->size(p_a);
+
+                            edges[i].weight = 0;
                         }
                     }
                 }
@@ -218,34 +404,103 @@ namespace cv {
                 int total_points = ( int)(img_filtered.rows * img_filtered.cols);
 
                 // Sort edges
-                std::sort(edges, edges + nb_edges);
+                sortEdges(edges, nb_edges);
 
                 // Create a set with all point (by default mapped to themselves)
                 *es = new PointSet(img_filtered.cols * img_filtered.rows);
 
                 // Thresholds
-                float* thresholds = new float[total_points];
+                std::vector<float> thresholds(total_points, k);
 
-                for (int i = 0; i < total_points; i++)
-                    thresholds[i] = k;
-
-                for ( int i = 0; i < nb_edges; i++) {
+                mergeSortedEdges(edges, nb_edges, *es, &thresholds[0]);
+            }
 
-                    int p_a = (*es)->getBasePoint(edges[i].from);
-                    int p_b = (*es)->getBasePoint(edges[i].to);
+            // Collects, in graph building order, the edges whose key prefix (upper 16 bits) is in [prefix_lo, prefix_hi)
+            static void collectEdges(const Mat &img_filtered, unsigned prefix_lo, unsigned prefix_hi, std::vector<Edge> &edges) {
+
+                const int rows = img_filtered.rows, cols = img_filtered.cols;
+                const int nb_bands = std::max(1, std::min(rows, getNumThreads() * 4));
+                std::vector<std::vector<Edge> > band_edges(nb_bands);
+
+                parallel_for_(Range(0, nb_bands), [&](const Range &range) {
+                    AutoBuffer<float> buf(2 * cols);
+                    for (int b = range.start; b < range.end; b++) {
+                        std::vector<Edge> &out = band_edges[b];
+                        auto select = [&out, prefix_lo, prefix_hi](float weight, int from, int to) {
+                            unsigned prefix = edgeKey(weight) >> 16;
+                            if (prefix >= prefix_lo && prefix < prefix_hi) {
+                                Edge e;
+                                e.from = from;
+                                e.to = to;
+                                e.weight = weight;
+                                out.push_back(e);
+                            }
+                        };
+                        for (int i = rows * b / nb_bands; i < rows * (b + 1) / nb_bands; i++)
+                            visitRowEdges(img_filtered, i, buf.data(), buf.data() + cols, select);
+                    }
+                });
 
-                    if (p_a != p_b) {
-                        if (edges[i].weight <= thresholds[p_a] && edges[i].weight <= thresholds[p_b]) {
-                            (*es)->joinPoints(p_a, p_b);
-                            p_a = (*es)->getBasePoint(p_a);
-                            thresholds[p_a] = edges[i].weight + k / (*es)->size(p_a);
+                edges.clear();
+                for (int b = 0; b < nb_bands; b++) {
+                    edges.insert(edges.end(), band_edges[b].begin(), band_edges[b].end());
+                    std::vector<Edge>().swap(band_edges[b]);
+                }
+            }
 
-                            edges[i].weight = 0;
-                        }
+            // Produces exactly the edge order of the full sort, one range of weights at a time: a histogram of
+            // the key prefixes splits the weights into ranges of at most max_edges edges (a single prefix is
+            // never split), and every range is regenerated from the image, sorted and merged on its own.
+            // Edges joined during segmentation always link points of the same set afterwards, so the small
+            // area pass does not need to know which ones were merged and simply regenerates the ranges again.
+            void GraphSegmentationImpl::segmentGraphBounded(const Mat &img_filtered, PointSet **es) {
+
+                const int rows = img_filtered.rows, cols = img_filtered.cols;
+                const int nb_prefixes = 1 << 16;
+                const int nb_bands = std::max(1, std::min(rows, getNumThreads()));
+
+                std::vector<std::vector<int> > band_hist(nb_bands);
+                parallel_for_(Range(0, nb_bands), [&](const Range &range) {
+                    AutoBuffer<float> buf(2 * cols);
+                    for (int b = range.start; b < range.end; b++) {
+                        std::vector<int> &h = band_hist[b];
+                        h.assign(nb_prefixes, 0);
+                        auto count = [&h](float weight, int, int) { h[edgeKey(weight) >> 16]++; };
+                        for (int i = rows * b / nb_bands; i < rows * (b + 1) / nb_bands; i++)
+                            visitRowEdges(img_filtered, i, buf.data(), buf.data() + cols, count);
+                    }
+                });
+
+                std::vector<unsigned> range_bounds(1, 0);
+                int64 in_range = 0;
+                for (int prefix = 0; prefix < nb_prefixes; prefix++) {
+                    int64 count = 0;
+                    for (int b = 0; b < nb_bands; b++)
+                        count += band_hist[b][prefix];
+                    if (in_range > 0 && in_range + count > max_edges) {
+                        range_bounds.push_back(prefix);
+                        in_range = 0;
                     }
+                    in_range += count;
                 }
+                range_bounds.push_back(nb_prefixes);
+                band_hist.clear();
 
-                delete [] thresholds;
+                *es = new PointSet(cols * rows);
+                std::vector<float> thresholds(cols * rows, k);
+                std::vector<Edge> edges;
+
+                for (size_t r = 0; r + 1 < range_bounds.size(); r++) {
+                    collectEdges(img_filtered, range_bounds[r], range_bounds[r + 1], edges);
+                    sortEdges(edges.data(), (int)edges.size());
+                    mergeSortedEdges(edges.data(), (int)edges.size(), *es, &thresholds[0]);
+                }
+
+                for (size_t r = 0; r + 1 < range_bounds.size(); r++) {
+                    collectEdges(img_filtered, range_bounds[r], range_bounds[r + 1], edges);
+                    sortEdges(edges.data(), (int)edges.size());
+                    filterSmallAreas(edges.data(), (int)edges.size(), *es);
+                }
             }
 
             void GraphSegmentationImpl::filterSmallAreas(Edge *edges, const int &nb_edges, PointSet *es) {
@@ -316,24 +571,30 @@ namespace cv {
                 Mat img_filtered;
                 filter(img, img_filtered);
 
-                // Build graph
-                Edge *edges;
-                int nb_edges;
+                PointSet *es;
+                int64 total_edges = (int64)(img.rows - 1) * (2 * img.cols - 1) + (img.cols - 1);
 
-                buildGraph(&edges, nb_edges, img_filtered);
+                if (max_edges > 0 && total_edges > max_edges) {
+                    segmentGraphBounded(img_filtered, &es);
+                } else {
+                    // Build graph
+                    Edge *edges;
+                    int nb_edges;
 
-                // Segment graph
-                PointSet *es;
+                    buildGraph(&edges, nb_edges, img_filtered);
+
+                    // Segment graph
+                    segmentGraph(edges, nb_edges, img_filtered, &es);
 
-                segmentGraph(edges, nb_edges, img_filtered, &es);
+                    // Remove small areas
+                    filterSmallAreas(edges, nb_edges, es);
 
-                // Remove small areas
-                filterSmallAreas(edges, nb_edges, es);
+                    delete [] edges;
+                }
 
                 // Map to final output
                 finalMapping(es, output);
 
-                delete [] edges;
                 delete es;
 
             }
@@ -371,8 +632,12 @@ namespace cv {
                     base_p = mapping[base_p].p;
                 }
 
-                // Save mapping for faster acces later
-                mapping[p].p = base_p;
+                // Save mapping for faster acces later, for every point of the path
+                while (p != base_p) {
+                    int next_p = mapping[p].p;
+                    mapping[p].p = base_p;
+                    p = next_p;
+                }
 
                 return base_p;
             }
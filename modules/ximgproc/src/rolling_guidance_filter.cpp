@@ -36,47 +36,432 @@
 
 #include "precomp.hpp"
 #include <opencv2/ximgproc.hpp>
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace cv
 {
 namespace ximgproc
 {
+namespace
+{
+
+/* Images are kept as float planes padded by the filter radius. The source is bordered once,
+ * the guidance ping-pongs between two such buffers, so an iteration only refreshes the border
+ * of the plane it has just written instead of re-allocating and re-bordering both images. */
+class RGFPlanes
+{
+public:
+    void create(Size sz, int cn_, int radius_)
+    {
+        cn = cn_;
+        radius = radius_;
+        size = sz;
+        buf.create(cn * (sz.height + 2 * radius), sz.width + 2 * radius, CV_32F);
+    }
+
+    int step() const { return buf.cols; }
+
+    float* ptr(int c, int y) { return buf.ptr<float>(c * (size.height + 2 * radius) + y + radius) + radius; }
+    const float* ptr(int c, int y) const { return buf.ptr<float>(c * (size.height + 2 * radius) + y + radius) + radius; }
+
+    //! fills the left and right border of row y; colTab holds 2*radius borderInterpolate() indices
+    void fillRowBorder(int y, const int* colTab)
+    {
+        for (int c = 0; c < cn; c++)
+        {
+            float* row = ptr(c, y);
+            for (int x = 0; x < radius; x++)
+            {
+                row[x - radius] = colTab[x] < 0 ? 0.f : row[colTab[x]];
+                row[size.width + x] = colTab[radius + x] < 0 ? 0.f : row[colTab[radius + x]];
+            }
+        }
+    }
+
+    //! fills the top and bottom border from the already bordered rows
+    void fillTopBottom(const int* rowTab)
+    {
+        size_t rowSize = buf.cols * sizeof(float);
+        for (int c = 0; c < cn; c++)
+        {
+            for (int y = 0; y < radius; y++)
+            {
+                int dy[2] = { y - radius, size.height + y };
+                for (int t = 0; t < 2; t++)
+                {
+                    float* dstRow = ptr(c, dy[t]) - radius;
+                    int srcY = rowTab[t * radius + y];
+                    if (srcY < 0)
+                        memset(dstRow, 0, rowSize);
+                    else
+                        memcpy(dstRow, ptr(c, srcY) - radius, rowSize);
+                }
+            }
+        }
+    }
+
+    Mat buf;
+    Size size;
+    int cn, radius;
+};
+
+typedef void (*RGFRowFunc)(const float* const* guide, const float* const* src, float* const* dst, int width,
+                           const int* spaceOfs, const float* spaceWeights, int maxk,
+                           const float* expLUT, float scaleIndex);
+
+/* One output row of the joint bilateral filter guided by the previous iteration. The arithmetic
+ * follows jointBilateralFilter(): 8U images use an exact integer-indexed LUT and round the result,
+ * 32F images interpolate linearly between LUT bins. */
+template<int cn, bool is8u>
+void rollingGuidanceRow(const float* const* guide, const float* const* src, float* const* dst, int width,
+                        const int* spaceOfs, const float* spaceWeights, int maxk,
+                        const float* expLUT, float scaleIndex)
+{
+    int j = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int VECSZ = VTraits<v_float32>::vlanes();
+    const v_float32 vScale = vx_setall_f32(scaleIndex), vOne = vx_setall_f32(1.f);
+    for (; j <= width - VECSZ; j += VECSZ)
+    {
+        v_float32 g0 = vx_load(guide[0] + j), g1 = g0, g2 = g0;
+        if (cn == 3)
+        {
+            g1 = vx_load(guide[1] + j);
+            g2 = vx_load(guide[2] + j);
+        }
+        v_float32 sum0 = vx_setzero_f32(), sum1 = sum0, sum2 = sum0, wSum = sum0;
+
+        for (int k = 0; k < maxk; k++)
+        {
+            const int ofs = spaceOfs[k] + j;
+            v_float32 alpha = v_abs(v_sub(vx_load(guide[0] + ofs), g0));
+            if (cn == 3)
+            {
+                alpha = v_add(alpha, v_abs(v_sub(vx_load(guide[1] + ofs), g1)));
+                alpha = v_add(alpha, v_abs(v_sub(vx_load(guide[2] + ofs), g2)));
+            }
+
+            v_float32 w;
+            if (is8u)
+            {
+                w = v_lut(expLUT, v_trunc(alpha));
+            }
+            else
+            {
+                alpha = v_mul(alpha, vScale);
+                v_int32 idx = v_trunc(alpha);
+                alpha = v_sub(alpha, v_cvt_f32(idx));
+                v_float32 l0 = v_lut(expLUT, idx), l1 = v_lut(expLUT + 1, idx);
+                w = v_add(l0, v_mul(alpha, v_sub(l1, l0)));
+            }
+            w = v_mul(vx_setall_f32(spaceWeights[k]), w);
+
+            sum0 = v_add(sum0, v_mul(w, vx_load(src[0] + ofs)));
+            if (cn == 3)
+            {
+                sum1 = v_add(sum1, v_mul(w, vx_load(src[1] + ofs)));
+                sum2 = v_add(sum2, v_mul(w, vx_load(src[2] + ofs)));
+            }
+            wSum = v_add(wSum, w);
+        }
+
+        v_float32 inv = v_div(vOne, wSum);
+        sum0 = v_mul(sum0, inv);
+        sum1 = v_mul(sum1, inv);
+        sum2 = v_mul(sum2, inv);
+        if (is8u)
+        {
+            const v_int32 vZero = vx_setzero_s32(), vMax = vx_setall_s32(255);
+            sum0 = v_cvt_f32(v_min(v_max(v_round(sum0), vZero), vMax));
+            sum1 = v_cvt_f32(v_min(v_max(v_round(sum1), vZero), vMax));
+            sum2 = v_cvt_f32(v_min(v_max(v_round(sum2), vZero), vMax));
+        }
+        v_store(dst[0] + j, sum0);
+        if (cn == 3)
+        {
+            v_store(dst[1] + j, sum1);
+            v_store(dst[2] + j, sum2);
+        }
+    }
+#endif
+    for (; j < width; j++)
+    {
+        float sum[cn], wSum = 0.f;
+        for (int c = 0; c < cn; c++)
+            sum[c] = 0.f;
+
+        for (int k = 0; k < maxk; k++)
+        {
+            const int ofs = spaceOfs[k] + j;
+            float alpha = 0.f;
+            for (int c = 0; c < cn; c++)
+                alpha += std::abs(guide[c][ofs] - guide[c][j]);
+
+            float w;
+            if (is8u)
+            {
+                w = expLUT[(int)alpha];
+            }
+            else
+            {
+                alpha *= scaleIndex;
+                int idx = (int)alpha;
+                alpha -= idx;
+                w = expLUT[idx] + alpha * (expLUT[idx + 1] - expLUT[idx]);
+            }
+            w = spaceWeights[k] * w;
+
+            for (int c = 0; c < cn; c++)
+                sum[c] += w * src[c][ofs];
+            wSum += w;
+        }
+
+        float inv = 1.f / wSum;
+        for (int c = 0; c < cn; c++)
+            dst[c][j] = is8u ? (float)saturate_cast<uchar>(sum[c] * inv) : sum[c] * inv;
+    }
+}
+
+void rowMinMax(const float* row, int width, float& minVal, float& maxVal)
+{
+    int j = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int VECSZ = VTraits<v_float32>::vlanes();
+    if (width >= VECSZ)
+    {
+        v_float32 vMin = vx_load(row), vMax = vMin;
+        for (j = VECSZ; j <= width - VECSZ; j += VECSZ)
+        {
+            v_float32 v = vx_load(row + j);
+            vMin = v_min(vMin, v);
+            vMax = v_max(vMax, v);
+        }
+        minVal = std::min(minVal, v_reduce_min(vMin));
+        maxVal = std::max(maxVal, v_reduce_max(vMax));
+    }
+#endif
+    for (; j < width; j++)
+    {
+        minVal = std::min(minVal, row[j]);
+        maxVal = std::max(maxVal, row[j]);
+    }
+}
+
+template<typename T>
+void loadPlanes(const Mat& src, RGFPlanes& planes, const int* colTab, const int* rowTab)
+{
+    const int cn = src.channels();
+    parallel_for_(Range(0, src.rows), [&](const Range& range)
+    {
+        for (int y = range.start; y < range.end; y++)
+        {
+            const T* srcRow = src.ptr<T>(y);
+            for (int c = 0; c < cn; c++)
+            {
+                float* row = planes.ptr(c, y);
+                for (int x = 0; x < src.cols; x++)
+                    row[x] = (float)srcRow[x * cn + c];
+            }
+            planes.fillRowBorder(y, colTab);
+        }
+    });
+    planes.fillTopBottom(rowTab);
+}
+
+} // namespace
+
     void rollingGuidanceFilter(InputArray src_, OutputArray dst_, int d,
                                double sigmaColor, double sigmaSpace,  int numOfIter, int borderType)
     {
         CV_Assert(!src_.empty());
 
-        Mat guidance = src_.getMat();
         Mat src = src_.getMat();
+        CV_Assert(src.depth() == CV_8U || src.depth() == CV_32F);
 
-        CV_Assert(src.size() == guidance.size());
-        CV_Assert(src.depth() == guidance.depth() && (src.depth() == CV_8U || src.depth() == CV_32F) );
+        int srcCnNum = src.channels();
+        if (srcCnNum != 1 && srcCnNum != 3)
+            CV_Error(Error::BadNumChannels, "Unsupported number of channels");
 
         if (sigmaColor <= 0)
             sigmaColor = 1;
         if (sigmaSpace <= 0)
             sigmaSpace = 1;
 
+        if (numOfIter <= 0)
+        {
+            src.copyTo(dst_);
+            return;
+        }
+
+        int radius;
+        if (d <= 0)
+            radius = cvRound(sigmaSpace*1.5);
+        else
+            radius = d / 2;
+        radius = std::max(radius, 1);
+
+        // src is completely copied into srcPlanes before dst is written, so in-place calls are fine
         dst_.create(src.size(), src.type());
         Mat dst = dst_.getMat();
 
-        if (src.data == guidance.data)
-            guidance = guidance.clone();
-        if (dst.data == src.data)
-            src = src.clone();
+        const bool is8u = src.depth() == CV_8U;
+        borderType &= ~BORDER_ISOLATED;
 
-        int srcCnNum = src.channels();
+        std::vector<int> colTab(2 * radius), rowTab(2 * radius);
+        for (int i = 0; i < radius; i++)
+        {
+            colTab[i] = borderInterpolate(i - radius, src.cols, borderType);
+            colTab[radius + i] = borderInterpolate(src.cols + i, src.cols, borderType);
+            rowTab[i] = borderInterpolate(i - radius, src.rows, borderType);
+            rowTab[radius + i] = borderInterpolate(src.rows + i, src.rows, borderType);
+        }
 
-        if (srcCnNum == 1 || srcCnNum == 3)
+        RGFPlanes srcPlanes, guidePlanes[2];
+        srcPlanes.create(src.size(), srcCnNum, radius);
+        if (is8u)
+            loadPlanes<uchar>(src, srcPlanes, &colTab[0], &rowTab[0]);
+        else
+            loadPlanes<float>(src, srcPlanes, &colTab[0], &rowTab[0]);
+
+        double gaussColorCoeff = -0.5 / (sigmaColor*sigmaColor);
+        double gaussSpaceCoeff = -0.5 / (sigmaSpace*sigmaSpace);
+
+        std::vector<float> spaceWeights;
+        std::vector<int> spaceOfs;
+        const int pstep = srcPlanes.step();
+        for (int i = -radius; i <= radius; i++)
         {
-            while(numOfIter--){
-                jointBilateralFilter(guidance, src, guidance, d, sigmaColor, sigmaSpace, borderType);
+            for (int j = -radius; j <= radius; j++)
+            {
+                double r2 = i*i + j*j;
+                if (r2 > radius*radius)
+                    continue;
+
+                spaceWeights.push_back((float)std::exp(r2 * gaussSpaceCoeff));
+                spaceOfs.push_back(i*pstep + j);
             }
-            guidance.copyTo(dst_);
         }
+        const int maxk = (int)spaceOfs.size();
+
+        // the 8U table is indexed by the exact L1 color distance and does not change between
+        // iterations, the 32F one is rescaled to the value range of the current guidance
+        const int kExpNumBinsPerChannel = 1 << 12;
+        std::vector<float> expLUT(is8u ? srcCnNum*256 : kExpNumBinsPerChannel*srcCnNum + 2);
+        float scaleIndex = 1.f;
+        if (is8u)
+        {
+            for (int i = 0; i < (int)expLUT.size(); i++)
+                expLUT[i] = (float)std::exp(i * i * gaussColorCoeff);
+        }
+
+        RGFRowFunc rowFunc;
+        if (srcCnNum == 1)
+            rowFunc = is8u ? &rollingGuidanceRow<1, true> : &rollingGuidanceRow<1, false>;
         else
+            rowFunc = is8u ? &rollingGuidanceRow<3, true> : &rollingGuidanceRow<3, false>;
+
+        double minValGuide = 0, maxValGuide = 0;
+        if (!is8u)
+            minMaxLoc(src.reshape(1), &minValGuide, &maxValGuide);
+        std::vector<float> rowMin(src.rows), rowMax(src.rows);
+
+        // the first iteration is guided by the source itself
+        const RGFPlanes* guide = &srcPlanes;
+        for (int iter = 0; iter < numOfIter; iter++)
         {
-            CV_Error(Error::BadNumChannels, "Unsupported number of channels");
+            const bool lastIter = iter == numOfIter - 1;
+            RGFPlanes& next = guidePlanes[iter & 1];
+            if (!lastIter)
+                next.create(src.size(), srcCnNum, radius);
+
+            if (!is8u)
+            {
+                if (std::abs(maxValGuide - minValGuide) < FLT_EPSILON)
+                {
+                    // constant guidance, the range kernel vanishes
+                    int ksize = 2*radius + 1;
+                    if (lastIter)
+                    {
+                        GaussianBlur(src, dst, Size(ksize, ksize), sigmaSpace, 0, borderType);
+                        break;
+                    }
+                    Mat blurred;
+                    GaussianBlur(src, blurred, Size(ksize, ksize), sigmaSpace, 0, borderType);
+                    loadPlanes<float>(blurred, next, &colTab[0], &rowTab[0]);
+                    minMaxLoc(blurred.reshape(1), &minValGuide, &maxValGuide);
+                    guide = &next;
+                    continue;
+                }
+
+                float colorRange = (float)(maxValGuide - minValGuide) * srcCnNum;
+                colorRange = std::max(0.01f, colorRange);
+                scaleIndex = kExpNumBinsPerChannel*srcCnNum / colorRange;
+                for (int i = 0; i < (int)expLUT.size(); i++)
+                {
+                    double val = i / scaleIndex;
+                    expLUT[i] = (float)std::exp(val * val * gaussColorCoeff);
+                }
+            }
+
+            parallel_for_(Range(0, src.rows), [&](const Range& range)
+            {
+                AutoBuffer<float> rowBuf(lastIter ? srcCnNum*src.cols : 1);
+                const float* guideRows[3];
+                const float* srcRows[3];
+                float* dstRows[3];
+                for (int y = range.start; y < range.end; y++)
+                {
+                    for (int c = 0; c < srcCnNum; c++)
+                    {
+                        guideRows[c] = guide->ptr(c, y);
+                        srcRows[c] = srcPlanes.ptr(c, y);
+                        dstRows[c] = lastIter ? rowBuf.data() + c*src.cols : next.ptr(c, y);
+                    }
+                    rowFunc(guideRows, srcRows, dstRows, src.cols, &spaceOfs[0], &spaceWeights[0], maxk,
+                            &expLUT[0], scaleIndex);
+
+                    if (lastIter)
+                    {
+                        for (int c = 0; c < srcCnNum; c++)
+                        {
+                            const float* row = dstRows[c];
+                            if (is8u)
+                            {
+                                uchar* dstRow = dst.ptr<uchar>(y) + c;
+                                for (int x = 0; x < src.cols; x++)
+                                    dstRow[x*srcCnNum] = (uchar)row[x];
+                            }
+                            else
+                            {
+                                float* dstRow = dst.ptr<float>(y) + c;
+                                for (int x = 0; x < src.cols; x++)
+                                    dstRow[x*srcCnNum] = row[x];
+                            }
+                        }
+                    }
+                    else
+                    {
+                        next.fillRowBorder(y, &colTab[0]);
+                        if (!is8u)
+                        {
+                            rowMin[y] = rowMax[y] = dstRows[0][0];
+                            for (int c = 0; c < srcCnNum; c++)
+                                rowMinMax(dstRows[c], src.cols, rowMin[y], rowMax[y]);
+                        }
+                    }
+                }
+            });
+
+            if (!lastIter)
+            {
+                next.fillTopBottom(&rowTab[0]);
+                if (!is8u)
+                {
+                    minValGuide = *std::min_element(rowMin.begin(), rowMin.end());
+                    maxValGuide = *std::max_element(rowMax.begin(), rowMax.end());
+                }
+                guide = &next;
+            }
         }
     }
 }
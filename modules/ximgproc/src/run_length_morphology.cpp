@@ -36,6 +36,7 @@
 #include "precomp.hpp"
 #include <math.h>
 #include <vector>
+#include <iterator>
 #include <iostream>
 
 
@@ -54,8 +55,72 @@ struct rlType
 
 typedef std::vector<rlType> rlVec;
 
+// runs are stored in the same layout as the Point3i of the encoded images
+CV_StaticAssert(sizeof(rlType) == sizeof(Point3i), "rlType must match Point3i");
+
+// Operations that are local to a row (or to a fixed window of rows) are run on bands of whole
+// rows in parallel and the results of the bands are concatenated. Every row gives the same runs
+// whatever band it is in, so the result does not depend on the number of bands.
+
+static int getNumBands(size_t nWork)
+{
+    // small inputs are not worth the overhead of the parallel loop
+    const size_t nMinWorkPerBand = 2048;
+    const int nThreads = getNumThreads();
+    if (nThreads <= 1 || nWork < 2 * nMinWorkPerBand)
+        return 1;
+    return (int)std::min((size_t)nThreads * 4, nWork / nMinWorkPerBand);
+}
+
+// bandRows[b] is the first row of band b, the bands split the (sorted) runs of reg evenly
+static void getBandRows(const rlVec& reg, std::vector<int>& bandRows)
+{
+    int nBands = reg.empty() ? 1 : getNumBands(reg.size());
+    bandRows.resize(nBands + 1);
+    bandRows[0] = std::numeric_limits<int>::min();
+    bandRows[nBands] = std::numeric_limits<int>::max();
+    for (int b = 1; b < nBands; ++b)
+        bandRows[b] = reg[reg.size() * b / nBands].r;
+}
+
+static bool isRowLess(const rlType& run, int row)
+{
+    return run.r < row;
+}
+
+static rlVec::const_iterator firstRunOfRow(const rlVec& reg, int row)
+{
+    return std::lower_bound(reg.begin(), reg.end(), row, isRowLess);
+}
+
+template <typename BandBody>
+static void processBands(const std::vector<int>& bandRows, rlVec& res, const BandBody& body)
+{
+    const int nBands = (int)bandRows.size() - 1;
+    res.clear();
+    if (nBands == 1)
+    {
+        body(bandRows[0], bandRows[1], res);
+        return;
+    }
+
+    std::vector<rlVec> bandRes(nBands);
+    parallel_for_(Range(0, nBands), [&](const Range& range)
+    {
+        for (int b = range.start; b < range.end; ++b)
+            body(bandRows[b], bandRows[b + 1], bandRes[b]);
+    });
+
+    size_t nRuns = 0;
+    for (int b = 0; b < nBands; ++b)
+        nRuns += bandRes[b].size();
+    res.reserve(nRuns);
+    for (int b = 0; b < nBands; ++b)
+        res.insert(res.end(), bandRes[b].begin(), bandRes[b].end());
+}
+
 template <class T>
-void _thresholdLine(T* pData, int nWidth, int nRow, T threshold, int type, rlVec& res)
+void _thresholdLine(const T* pData, int nWidth, int nRow, T threshold, int type, rlVec& res)
 {
   bool bOn = false;
   int nStartSegment = 0;
@@ -83,59 +148,72 @@ void _thresholdLine(T* pData, int nWidth, int nRow, T threshold, int type, rlVec
   }
 }
 
+template <class T>
+static void _thresholdRows(const cv::Mat& img, int nRowBegin, int nRowEnd, double threshold, int type,
+    rlVec& res)
+{
+    for (int i = nRowBegin; i < nRowEnd; ++i)
+        _thresholdLine<T>(img.ptr<T>(i), img.cols, i, (T) threshold, type, res);
+}
+
+typedef void (*ThresholdRowsFunc)(const cv::Mat&, int, int, double, int, rlVec&);
+
 static void _threshold(cv::Mat& img, rlVec& res, double threshold, int type)
 {
-  res.clear();
+  ThresholdRowsFunc func = 0;
   switch (img.depth())
   {
   case CV_8U:
-    for (int i = 0; i < img.rows; ++i)
-      _thresholdLine<uchar>(img.ptr(i), img.cols, i, (uchar) threshold, type, res);
+    func = _thresholdRows<uchar>;
     break;
   case CV_8S:
-    for (int i = 0; i < img.rows; ++i)
-      _thresholdLine<schar>((schar*) img.ptr(i), img.cols, i, (schar) threshold, type, res);
+    func = _thresholdRows<schar>;
     break;
   case CV_16U:
-      for (int i = 0; i < img.rows; ++i)
-      {
-          _thresholdLine<unsigned short>((unsigned short*)img.ptr(i), img.cols, i,
-              (unsigned short)threshold, type, res);
-      }
+    func = _thresholdRows<unsigned short>;
     break;
   case CV_16S:
-    for (int i = 0; i < img.rows; ++i)
-      _thresholdLine<short>((short*) img.ptr(i), img.cols, i, (short) threshold, type, res);
+    func = _thresholdRows<short>;
     break;
   case CV_32S:
-    for (int i = 0; i < img.rows; ++i)
-      _thresholdLine<int>((int*) img.ptr(i), img.cols, i, (int) threshold, type, res);
+    func = _thresholdRows<int>;
     break;
   case CV_32F:
-    for (int i = 0; i < img.rows; ++i)
-      _thresholdLine<float>((float*) img.ptr(i), img.cols, i, (float) threshold, type, res);
+    func = _thresholdRows<float>;
     break;
   case CV_64F:
-    for (int i = 0; i < img.rows; ++i)
-      _thresholdLine<double>((double*) img.ptr(i), img.cols, i, threshold, type, res);
+    func = _thresholdRows<double>;
     break;
   default:
     CV_Error( Error::StsUnsupportedFormat, "unsupported image type" );
   }
+
+  int nBands = std::min(getNumBands(img.total() / 16), std::max(img.rows, 1));
+  std::vector<int> bandRows(nBands + 1);
+  for (int b = 0; b <= nBands; ++b)
+    bandRows[b] = img.rows * b / nBands;
+  processBands(bandRows, res, [&](int nRowBegin, int nRowEnd, rlVec& bandRes)
+  {
+    func(img, nRowBegin, nRowEnd, threshold, type, bandRes);
+  });
 }
 
 
-static void convertToOutputArray(rlVec& runs, Size size, OutputArray& res)
+static void convertToOutputArray(const rlVec& runs, Size size, OutputArray& res)
 {
-    size_t nRuns = runs.size();
-    std::vector<cv::Point3i> segments(nRuns + 1);
-    segments[0] = cv::Point3i(size.width, size.height, 0);
-    for (size_t i = 0; i < nRuns; ++i)
+    // the runs are copied as they are, rlType has the layout of Point3i
+    res.create((int)runs.size() + 1, 1, CV_32SC3);
+    Mat dst = res.getMat();
+    dst.at<Point3i>(0) = Point3i(size.width, size.height, 0);
+    if (runs.empty())
+        return;
+    if (dst.isContinuous())
+        memcpy(dst.ptr<Point3i>() + 1, &runs[0], runs.size() * sizeof(rlType));
+    else
     {
-        rlType& curRun = runs[i];
-        segments[i + 1] = Point3i(curRun.cb, curRun.ce, curRun.r);
+        for (size_t i = 0; i < runs.size(); ++i)
+            dst.at<Point3i>((int)i + 1) = Point3i(runs[i].cb, runs[i].ce, runs[i].r);
     }
-    Mat(segments).copyTo(res);
 }
 
 
@@ -155,23 +233,38 @@ CV_EXPORTS void threshold(InputArray src, OutputArray rlDest, double thresh, int
 
 
 template <class T>
-void paint_impl(cv::Mat& img, rlType* pRuns, int nSize, T value)
+static void paint_impl(cv::Mat& img, const rlType* pBegin, const rlType* pEnd, double dValue, Point offset)
 {
-    int i;
-    rlType* pCurRun;
-    for (pCurRun = pRuns, i = 0; i< nSize; ++pCurRun, ++i)
+    T value = (T)dValue;
+    for (const rlType* pCurRun = pBegin; pCurRun != pEnd; ++pCurRun)
     {
-        rlType& curRun = *pCurRun;
-        if (curRun.r < 0 || curRun.r >= img.rows || curRun.cb >= img.cols || curRun.ce < 0)
+        int r = pCurRun->r - offset.y;
+        int cb = pCurRun->cb - offset.x;
+        int ce = pCurRun->ce - offset.x;
+        if (r < 0 || r >= img.rows || cb >= img.cols || ce < 0)
             continue;
 
-        T* rowPtr = (T*)img.ptr(curRun.r);
-        std::fill(rowPtr + std::max(curRun.cb, 0), rowPtr + std::min(curRun.ce + 1, img.cols), value);
+        T* rowPtr = img.ptr<T>(r);
+        std::fill(rowPtr + std::max(cb, 0), rowPtr + std::min(ce + 1, img.cols), value);
     }
 }
 
+typedef void (*PaintFunc)(cv::Mat&, const rlType*, const rlType*, double, Point);
+
+static bool isRunRowLess(const rlType& run1, const rlType& run2)
+{
+    return run1.r < run2.r;
+}
+
   CV_EXPORTS void paint(InputOutputArray image, InputArray rlSrc, const Scalar& value)
   {
+    paint(image, rlSrc, value, Point(0, 0));
+  }
+
+  CV_EXPORTS void paint(InputOutputArray image, InputArray rlSrc, const Scalar& value, Point offset)
+  {
+    CV_INSTRUMENT_REGION();
+
     Mat _runs;
     _runs = rlSrc.getMat();
     int N = _runs.checkVector(3);
@@ -182,34 +275,65 @@ void paint_impl(cv::Mat& img, rlType* pRuns, int nSize, T value)
 
     cv::Mat _image = image.getMat();
 
-    rlType* pRuns = (rlType*) &(_runs.at<Point3i>(1));
+    PaintFunc func = 0;
     switch (_image.type())
     {
     case CV_8UC1:
-        paint_impl<uchar>(_image, pRuns, N - 1, (uchar)dValue);
+        func = paint_impl<uchar>;
         break;
     case CV_8SC1:
-        paint_impl<schar>(_image, pRuns, N - 1, (schar)dValue);
+        func = paint_impl<schar>;
         break;
     case CV_16UC1:
-        paint_impl<unsigned short>(_image, pRuns, N - 1, (unsigned short)dValue);
+        func = paint_impl<unsigned short>;
         break;
     case CV_16SC1:
-        paint_impl<short>(_image, pRuns, N - 1, (short)dValue);
+        func = paint_impl<short>;
         break;
     case CV_32SC1:
-        paint_impl<int>(_image, pRuns, N - 1, (int)dValue);
+        func = paint_impl<int>;
         break;
     case CV_32FC1:
-        paint_impl<float>(_image, pRuns, N - 1, (float)dValue);
+        func = paint_impl<float>;
         break;
     case CV_64FC1:
-        paint_impl<double>(_image, pRuns, N - 1, dValue);
+        func = paint_impl<double>;
         break;
     default:
         CV_Error(Error::StsUnsupportedFormat, "unsupported image type");
         break;
     }
+
+    // the runs are painted straight from the encoded image, no translated copy is made
+    const rlType* pBegin = _runs.ptr<rlType>() + 1;
+    const rlType* pEnd = pBegin + (N - 1);
+    if (!std::is_sorted(pBegin, pEnd, isRunRowLess))
+    {
+        func(_image, pBegin, pEnd, dValue, offset);
+        return;
+    }
+
+    // only the runs in the rows of the image are painted; they are painted in bands of whole
+    // rows, so that no two bands write to the same row
+    rlType rowFirst(0, 0, offset.y), rowLast(0, 0, offset.y + _image.rows - 1);
+    pBegin = std::lower_bound(pBegin, pEnd, rowFirst, isRunRowLess);
+    pEnd = std::upper_bound(pBegin, pEnd, rowLast, isRunRowLess);
+    const int nBands = getNumBands((size_t)(pEnd - pBegin));
+    if (nBands == 1)
+    {
+        func(_image, pBegin, pEnd, dValue, offset);
+        return;
+    }
+    std::vector<const rlType*> bandBegin(nBands + 1);
+    bandBegin[0] = pBegin;
+    bandBegin[nBands] = pEnd;
+    for (int b = 1; b < nBands; ++b)
+        bandBegin[b] = std::lower_bound(pBegin, pEnd, pBegin[(pEnd - pBegin) * b / nBands], isRunRowLess);
+    parallel_for_(Range(0, nBands), [&](const Range& range)
+    {
+        for (int b = range.start; b < range.end; ++b)
+            func(_image, bandBegin[b], bandBegin[b + 1], dValue, offset);
+    });
   }
 
 static void translateRegion(rlVec& reg, Point ptTrans)
@@ -237,7 +361,7 @@ CV_EXPORTS Mat getStructuringElement(int shape, Size ksize)
   return rlDest;
 }
 
-static void erode_rle (rlVec& regIn, rlVec& regOut, rlVec& se)
+static void erode_rle (const rlVec& regIn, rlVec& regOut, const rlVec& se)
 {
   using namespace std;
 
@@ -258,22 +382,22 @@ static void erode_rle (rlVec& regIn, rlVec& regOut, rlVec& se)
     vector<int> pIdxChord1(nRows);
     vector<int> pIdxNextRow(nRows);
 
-    int i,j;
+    int k;
 
-    for (i=1;i<nRows;i++)
+    for (k=1;k<nRows;k++)
     {
-        pIdxChord1[i] = EMPTY;
-        pIdxNextRow[i] = EMPTY;
+        pIdxChord1[k] = EMPTY;
+        pIdxNextRow[k] = EMPTY;
     }
 
     pIdxChord1[0] = 0;
     pIdxNextRow[nRows-1] = (int) regIn.size();
 
-    for (i=1; i < (int) regIn.size();i++)
-        if (regIn[i].r != regIn[i-1].r)
+    for (k=1; k < (int) regIn.size();k++)
+        if (regIn[k].r != regIn[k-1].r)
         {
-            pIdxChord1[regIn[i].r - nMinRow] = i;
-            pIdxNextRow[regIn[i-1].r - nMinRow] = i;
+            pIdxChord1[regIn[k].r - nMinRow] = k;
+            pIdxNextRow[regIn[k-1].r - nMinRow] = k;
         }
 
     int nMinRowSE = se[0].r;
@@ -283,85 +407,93 @@ static void erode_rle (rlVec& regIn, rlVec& regOut, rlVec& se)
 
     assert(nRowsSE == (int) se.size());
 
-    vector<int> pCurIdxRow(nRowsSE);
-
-    // loop through all possible rows
-    for (i=nMinRow - nMinRowSE; i<= nMaxRow - nMaxRowSE; i++)
+    // every result row i is computed by the band holding the input row i + nMinRowSE
+    std::vector<int> bandRows;
+    getBandRows(regIn, bandRows);
+    processBands(bandRows, regOut, [&](int nBandBegin, int nBandEnd, rlVec& bandOut)
     {
-        // check whether all relevant rows are available
-        bool bNextRow = false;
+        int i,j;
+        vector<int> pCurIdxRow(nRowsSE);
+        const int nFirstRow = max(nMinRow, nBandBegin) - nMinRowSE;
+        const int nLastRow = min(nMaxRow - nMaxRowSE, min(nMaxRow, nBandEnd - 1) - nMinRowSE);
 
-        for (j=0; j < nRowsSE; j++)
+        // loop through all possible rows
+        for (i=nFirstRow; i<= nLastRow; i++)
         {
-            // get idx of first chord in regIn for this row of the se
-            pCurIdxRow[j] = pIdxChord1[ j + nMinRowSE + i - nMinRow];
-            if (pCurIdxRow[j] == -1)
+            // check whether all relevant rows are available
+            bool bNextRow = false;
+
+            for (j=0; j < nRowsSE; j++)
             {
-                bNextRow = true;
-                break;
+                // get idx of first chord in regIn for this row of the se
+                pCurIdxRow[j] = pIdxChord1[ j + nMinRowSE + i - nMinRow];
+                if (pCurIdxRow[j] == -1)
+                {
+                    bNextRow = true;
+                    break;
+                }
             }
-        }
 
-        if (bNextRow)
-            continue;
+            if (bNextRow)
+                continue;
 
-        while (!bNextRow)
-        {
-          int nPossibleStart = std::numeric_limits<int>::min();
-
-          // search for row with max( cb - se.cb) (the leftmost possible position of a result chord
-          for (j=0;j<nRowsSE;j++)
-              nPossibleStart = max(nPossibleStart, regIn[pCurIdxRow[j]].cb - se[j].cb);
-
-          // for all rows skip chords whose end is left from the point
-          // where it can contribute to a result
-          bool bHaveResult = true;
-          int nLimitingRow = 0;
-          int nChordEnd = std::numeric_limits<int>::max(); //INT_MAX;
-
-          for (j=0;j<nRowsSE;j++)
-          {
-              while (regIn[pCurIdxRow[j]].ce < nPossibleStart + se[j].ce &&
-                  pCurIdxRow[j] != pIdxNextRow[j + nMinRowSE + i - nMinRow])
-              {
-                  pCurIdxRow[j]++;
-              }
+            while (!bNextRow)
+            {
+              int nPossibleStart = std::numeric_limits<int>::min();
 
-              // if all chords in this row skipped -> next row
-              if (pCurIdxRow[j] == pIdxNextRow[ j + nMinRowSE + i - nMinRow])
-              {
-                  bNextRow = true;
-                  bHaveResult = false;
-                  break;
-              }
-              else if ( bHaveResult )
-              {
-              // can the found chord contribute to a result ?
-              if (regIn[ pCurIdxRow[j] ].cb - se[j].cb <= nPossibleStart)
+              // search for row with max( cb - se.cb) (the leftmost possible position of a result chord
+              for (j=0;j<nRowsSE;j++)
+                  nPossibleStart = max(nPossibleStart, regIn[pCurIdxRow[j]].cb - se[j].cb);
+
+              // for all rows skip chords whose end is left from the point
+              // where it can contribute to a result
+              bool bHaveResult = true;
+              int nLimitingRow = 0;
+              int nChordEnd = std::numeric_limits<int>::max(); //INT_MAX;
+
+              for (j=0;j<nRowsSE;j++)
               {
-                  int nCurPossibleEnd = regIn[ pCurIdxRow[j] ].ce - se[j].ce;
-                  if (nCurPossibleEnd < nChordEnd)
+                  while (regIn[pCurIdxRow[j]].ce < nPossibleStart + se[j].ce &&
+                      pCurIdxRow[j] != pIdxNextRow[j + nMinRowSE + i - nMinRow])
                   {
-                      nChordEnd = nCurPossibleEnd;
-                      nLimitingRow = j;
+                      pCurIdxRow[j]++;
                   }
-              }
-              else
-                  bHaveResult = false;
-              }
-          }
 
-        if (bHaveResult)
-        {
-            regOut.push_back(rlType(nPossibleStart, nChordEnd, i));
-            pCurIdxRow[nLimitingRow]++;
+                  // if all chords in this row skipped -> next row
+                  if (pCurIdxRow[j] == pIdxNextRow[ j + nMinRowSE + i - nMinRow])
+                  {
+                      bNextRow = true;
+                      bHaveResult = false;
+                      break;
+                  }
+                  else if ( bHaveResult )
+                  {
+                  // can the found chord contribute to a result ?
+                  if (regIn[ pCurIdxRow[j] ].cb - se[j].cb <= nPossibleStart)
+                  {
+                      int nCurPossibleEnd = regIn[ pCurIdxRow[j] ].ce - se[j].ce;
+                      if (nCurPossibleEnd < nChordEnd)
+                      {
+                          nChordEnd = nCurPossibleEnd;
+                          nLimitingRow = j;
+                      }
+                  }
+                  else
+                      bHaveResult = false;
+                  }
+              }
 
-            if (pCurIdxRow[nLimitingRow] == pIdxNextRow[ nLimitingRow + nMinRowSE + i - nMinRow])
-                  bNextRow = true;
-        }
-        } // end while (!bNextRow
-    } // end for
+            if (bHaveResult)
+            {
+                bandOut.push_back(rlType(nPossibleStart, nChordEnd, i));
+                pCurIdxRow[nLimitingRow]++;
 
+                if (pCurIdxRow[nLimitingRow] == pIdxNextRow[ nLimitingRow + nMinRowSE + i - nMinRow])
+                      bNextRow = true;
+            }
+            } // end while (!bNextRow
+        } // end for
+    });
 }
 
 static void convertInputArrayToRuns(InputArray& theArray, rlVec& runs, Size& theSize)
@@ -369,6 +501,7 @@ static void convertInputArrayToRuns(InputArray& theArray, rlVec& runs, Size& the
   Mat _runs;
   _runs = theArray.getMat();
   int N = _runs.checkVector(3);
+  CV_Assert(N >= 0);
   if (N == 0)
   {
       runs.clear();
@@ -379,11 +512,9 @@ static void convertInputArrayToRuns(InputArray& theArray, rlVec& runs, Size& the
   theSize.width = pt.x;
   theSize.height = pt.y;
 
-  for (int i = 1; i < N; ++i)
-  {
-    pt = _runs.at<Point3i>(i);
-    runs[i-1] = rlType(pt.x, pt.y, pt.z);
-  }
+  // checkVector() guarantees continuous data, which has the layout of rlType
+  if (N > 1)
+      memcpy(&runs[0], _runs.ptr<Point3i>() + 1, (N - 1) * sizeof(rlType));
 }
 
 static void sortChords(rlVec& lChords)
@@ -391,7 +522,7 @@ static void sortChords(rlVec& lChords)
     std::sort(lChords.begin(), lChords.end());
 }
 
-static void mergeNeighbouringChords(rlVec& rlIn, rlVec& rlOut)
+static void mergeNeighbouringChords(const rlVec& rlIn, rlVec& rlOut)
 {
     rlOut.clear();
     if (rlIn.size() == 0)
@@ -401,7 +532,7 @@ static void mergeNeighbouringChords(rlVec& rlIn, rlVec& rlOut)
 
     for (int i = 1; i< (int)rlIn.size(); i++)
     {
-        rlType& curIn = rlIn[i];
+        const rlType& curIn = rlIn[i];
         rlType& lastAddedOut = rlOut.back();
         if (curIn.r == lastAddedOut.r && curIn.cb <= lastAddedOut.ce + 1)
             lastAddedOut.ce = max(curIn.ce, lastAddedOut.ce);
@@ -410,25 +541,34 @@ static void mergeNeighbouringChords(rlVec& rlIn, rlVec& rlOut)
     }
 }
 
-static void union_regions(rlVec& reg1, rlVec& reg2, rlVec& regUnion)
+static void union_regions(const rlVec& reg1, const rlVec& reg2, rlVec& regUnion)
 {
-    rlVec lAllChords(reg1);
+    if (!std::is_sorted(reg1.begin(), reg1.end()) || !std::is_sorted(reg2.begin(), reg2.end()))
+    {
+        // runs that were not created by the functions of this module
+        rlVec lAllChords(reg1);
+
+        lAllChords.insert(lAllChords.end(), reg2.begin(), reg2.end());
 
-    lAllChords.insert(lAllChords.end(), reg2.begin(), reg2.end());
+        sortChords(lAllChords);
+        mergeNeighbouringChords(lAllChords, regUnion);
+        return;
+    }
 
-    sortChords(lAllChords);
-    mergeNeighbouringChords(lAllChords, regUnion);
+    std::vector<int> bandRows;
+    getBandRows(reg1.size() >= reg2.size() ? reg1 : reg2, bandRows);
+    processBands(bandRows, regUnion, [&](int nBandBegin, int nBandEnd, rlVec& bandUnion)
+    {
+        rlVec lAllChords;
+        std::merge(firstRunOfRow(reg1, nBandBegin), firstRunOfRow(reg1, nBandEnd),
+            firstRunOfRow(reg2, nBandBegin), firstRunOfRow(reg2, nBandEnd), std::back_inserter(lAllChords));
+        mergeNeighbouringChords(lAllChords, bandUnion);
+    });
 }
 
-static void intersect(rlVec& reg1, rlVec& reg2, rlVec& regRes)
+static void intersect_range(rlVec::const_iterator cur1, rlVec::const_iterator end1,
+    rlVec::const_iterator cur2, rlVec::const_iterator end2, rlVec& regRes)
 {
-    rlVec::iterator end1 = reg1.end();
-    rlVec::iterator end2 = reg2.end();
-
-    rlVec::iterator cur1 = reg1.begin();
-    rlVec::iterator cur2 = reg2.begin();
-    regRes.clear();
-
     while (cur1 != end1 && cur2 != end2)
     {
         if (cur1->r < cur2->r || (cur1->r == cur2->r && cur1->ce < cur2->cb))
@@ -454,6 +594,17 @@ static void intersect(rlVec& reg1, rlVec& reg2, rlVec& regRes)
     }
 }
 
+static void intersect(const rlVec& reg1, const rlVec& reg2, rlVec& regRes)
+{
+    std::vector<int> bandRows;
+    getBandRows(reg1.size() >= reg2.size() ? reg1 : reg2, bandRows);
+    processBands(bandRows, regRes, [&](int nBandBegin, int nBandEnd, rlVec& bandRes)
+    {
+        intersect_range(firstRunOfRow(reg1, nBandBegin), firstRunOfRow(reg1, nBandEnd),
+            firstRunOfRow(reg2, nBandBegin), firstRunOfRow(reg2, nBandEnd), bandRes);
+    });
+}
+
 static void addBoundary(rlVec& runsIn, int nWidth, int nHeight, int nBoundaryLeft, int nBoundaryTop,
     int nBoundaryRight, int nBoundaryBottom, rlVec& res)
 {
@@ -552,17 +703,10 @@ CV_EXPORTS void erode(InputArray rlSrc, OutputArray rlDest, InputArray rlKernel,
 }
 
 
-static void subtract_rle( rlVec& regFrom,
-                        rlVec& regSubtract,
+static void subtract_range(rlVec::const_iterator cur1, rlVec::const_iterator end1,
+                        rlVec::const_iterator cur2, rlVec::const_iterator end2,
                         rlVec& regRes)
 {
-    rlVec::iterator end1 = regFrom.end();
-    rlVec::iterator end2 = regSubtract.end();
-
-    rlVec::iterator cur1 = regFrom.begin();
-    rlVec::iterator cur2 = regSubtract.begin();
-    regRes.clear();
-
     while( cur1 != end1)
     {
         if (cur2 == end2)
@@ -581,7 +725,7 @@ static void subtract_rle( rlVec& regFrom,
         {
             int curR = cur1->r;
             assert(curR == cur2->r);
-            rlVec::iterator lastIncluded;
+            rlVec::const_iterator lastIncluded;
 
             bool bIncremented = false;
             for (lastIncluded = cur2;
@@ -620,17 +764,29 @@ static void subtract_rle( rlVec& regFrom,
     }
 }
 
+static void subtract_rle( const rlVec& regFrom,
+                        const rlVec& regSubtract,
+                        rlVec& regRes)
+{
+    std::vector<int> bandRows;
+    getBandRows(regFrom.size() >= regSubtract.size() ? regFrom : regSubtract, bandRows);
+    processBands(bandRows, regRes, [&](int nBandBegin, int nBandEnd, rlVec& bandRes)
+    {
+        subtract_range(firstRunOfRow(regFrom, nBandBegin), firstRunOfRow(regFrom, nBandEnd),
+            firstRunOfRow(regSubtract, nBandBegin), firstRunOfRow(regSubtract, nBandEnd), bandRes);
+    });
+}
 
 
 
-static void invertRegion(rlVec& runsIn, rlVec& runsOut)
+
+static void invertRegion_range(rlVec::const_iterator itBegin, rlVec::const_iterator itEnd, rlVec& runsOut)
 {
     // if there is only one chord in row -> do not insert anything for this row
     // otherwise insert chords for the spaces between chords
-    runsOut.clear();
     int nCurRow = std::numeric_limits<int>::min();
     int nLastRight = nCurRow;
-    for (rlVec::iterator it = runsIn.begin(); it != runsIn.end(); ++it)
+    for (rlVec::const_iterator it = itBegin; it != itEnd; ++it)
     {
         rlType run = *it;
         if (run.r != nCurRow)
@@ -647,6 +803,16 @@ static void invertRegion(rlVec& runsIn, rlVec& runsOut)
     }
 }
 
+static void invertRegion(const rlVec& runsIn, rlVec& runsOut)
+{
+    std::vector<int> bandRows;
+    getBandRows(runsIn, bandRows);
+    processBands(bandRows, runsOut, [&](int nBandBegin, int nBandEnd, rlVec& bandOut)
+    {
+        invertRegion_range(firstRunOfRow(runsIn, nBandBegin), firstRunOfRow(runsIn, nBandEnd), bandOut);
+    });
+}
+
 
 static void dilate_rle(rlVec& runsSource,
     rlVec& runsDestination,
@@ -721,6 +887,196 @@ CV_EXPORTS void createRLEImage(const std::vector<cv::Point3i>& runs, OutputArray
 }
 
 
+static int findRoot(std::vector<int>& parent, int i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// the root of a component is always its first run
+static void unionRuns(std::vector<int>& parent, int i, int j)
+{
+    int ri = findRoot(parent, i);
+    int rj = findRoot(parent, j);
+    if (ri < rj)
+        parent[rj] = ri;
+    else if (rj < ri)
+        parent[ri] = rj;
+}
+
+// connects the runs [nFirst1, nEnd1) of a row with the runs [nFirst2, nEnd2) of the next row
+static void unionAdjacentRows(const rlVec& runs, int nFirst1, int nEnd1, int nFirst2, int nEnd2,
+    int nGap, std::vector<int>& parent)
+{
+    int i = nFirst1, j = nFirst2;
+    while (i < nEnd1 && j < nEnd2)
+    {
+        if (runs[i].cb <= runs[j].ce + nGap && runs[j].cb <= runs[i].ce + nGap)
+            unionRuns(parent, i, j);
+        if (runs[i].ce < runs[j].ce)
+            ++i;
+        else
+            ++j;
+    }
+}
+
+// connects the touching runs of the rows [nRowBegin, nRowEnd), rowStart holds the index of the
+// first run of every row that has runs (plus the end)
+static void unionRowRange(const rlVec& runs, const std::vector<int>& rowStart, int nRowBegin, int nRowEnd,
+    int nGap, std::vector<int>& parent)
+{
+    for (int k = nRowBegin; k < nRowEnd; ++k)
+    {
+        // runs of the same row that touch each other
+        for (int i = rowStart[k] + 1; i < rowStart[k + 1]; ++i)
+            if (runs[i].cb <= runs[i - 1].ce + 1)
+                unionRuns(parent, i - 1, i);
+
+        if (k > nRowBegin && runs[rowStart[k]].r == runs[rowStart[k - 1]].r + 1)
+            unionAdjacentRows(runs, rowStart[k - 1], rowStart[k], rowStart[k], rowStart[k + 1], nGap, parent);
+    }
+}
+
+CV_EXPORTS int connectedComponentsWithStats(InputArray rlSrc, OutputArray labels, OutputArray stats,
+    OutputArray centroids, int connectivity)
+{
+    CV_INSTRUMENT_REGION();
+
+    CV_Assert(connectivity == 8 || connectivity == 4);
+    rlVec runs;
+    Size size;
+    convertInputArrayToRuns(rlSrc, runs, size);
+    CV_Assert(std::is_sorted(runs.begin(), runs.end()));
+    const int nRuns = (int)runs.size();
+    const int nGap = (connectivity == 8) ? 1 : 0;
+
+    // index of the first run of every row that has runs
+    std::vector<int> rowStart;
+    for (int i = 0; i < nRuns; ++i)
+        if (i == 0 || runs[i].r != runs[i - 1].r)
+            rowStart.push_back(i);
+    const int nRowsWithRuns = (int)rowStart.size();
+    rowStart.push_back(nRuns);
+
+    // every band of rows links its own runs, then the bands are linked to each other
+    std::vector<int> parent(nRuns);
+    for (int i = 0; i < nRuns; ++i)
+        parent[i] = i;
+    const int nBands = std::min(getNumBands(runs.size()), std::max(nRowsWithRuns, 1));
+    std::vector<int> bandStart(nBands + 1);
+    for (int b = 0; b <= nBands; ++b)
+        bandStart[b] = nRowsWithRuns * b / nBands;
+    parallel_for_(Range(0, nBands), [&](const Range& range)
+    {
+        for (int b = range.start; b < range.end; ++b)
+            unionRowRange(runs, rowStart, bandStart[b], bandStart[b + 1], nGap, parent);
+    });
+    for (int b = 1; b < nBands; ++b)
+    {
+        int k = bandStart[b];
+        if (k > 0 && k < nRowsWithRuns && runs[rowStart[k]].r == runs[rowStart[k - 1]].r + 1)
+            unionAdjacentRows(runs, rowStart[k - 1], rowStart[k], rowStart[k], rowStart[k + 1], nGap, parent);
+    }
+
+    // the labels are numbered in the order of the first run of the components, 0 is the background
+    labels.create(nRuns, 1, CV_32SC1);
+    Mat runLabels = labels.getMat();
+    int* pLabels = runLabels.ptr<int>();
+    int nLabels = 1;
+    for (int i = 0; i < nRuns; ++i)
+    {
+        int root = findRoot(parent, i);
+        pLabels[i] = (root == i) ? nLabels++ : pLabels[root];
+    }
+
+    if (!stats.needed() && !centroids.needed())
+        return nLabels;
+
+    std::vector<int> left(nLabels, std::numeric_limits<int>::max()), top(left);
+    std::vector<int> right(nLabels, std::numeric_limits<int>::min()), bottom(right);
+    std::vector<int64> area(nLabels, 0);
+    std::vector<double> sumX(nLabels, 0.0), sumY(nLabels, 0.0);
+    for (int i = 0; i < nRuns; ++i)
+    {
+        const rlType& run = runs[i];
+        const int l = pLabels[i];
+        const int64 len = run.ce - run.cb + 1;
+        left[l] = min(left[l], run.cb);
+        right[l] = max(right[l], run.ce);
+        top[l] = min(top[l], run.r);
+        bottom[l] = max(bottom[l], run.r);
+        area[l] += len;
+        sumX[l] += 0.5 * (double)(run.cb + run.ce) * len;
+        sumY[l] += (double)run.r * len;
+    }
+
+    // background: the pixels of the image that are not covered by any run
+    auto addBackground = [&](int cb, int ce, int r)
+    {
+        const int64 len = ce - cb + 1;
+        left[0] = min(left[0], cb);
+        right[0] = max(right[0], ce);
+        top[0] = min(top[0], r);
+        bottom[0] = max(bottom[0], r);
+        area[0] += len;
+        sumX[0] += 0.5 * (double)(cb + ce) * len;
+        sumY[0] += (double)r * len;
+    };
+    size_t nRun = 0;
+    for (int r = 0; r < size.height; ++r)
+    {
+        while (nRun < runs.size() && runs[nRun].r < r)
+            ++nRun;
+        int x = 0; // first column that is not known to be covered
+        for (; nRun < runs.size() && runs[nRun].r == r; ++nRun)
+        {
+            int cb = max(runs[nRun].cb, 0);
+            int ce = min(runs[nRun].ce, size.width - 1);
+            if (cb > ce || ce < x)
+                continue;
+            if (cb > x)
+                addBackground(x, cb - 1, r);
+            x = ce + 1;
+        }
+        if (x < size.width)
+            addBackground(x, size.width - 1, r);
+    }
+
+    if (stats.needed())
+    {
+        stats.create(nLabels, CC_STAT_MAX, CV_32SC1);
+        Mat statsMat = stats.getMat();
+        for (int l = 0; l < nLabels; ++l)
+        {
+            int* pStat = statsMat.ptr<int>(l);
+            bool bEmpty = (area[l] == 0);
+            pStat[CC_STAT_LEFT] = bEmpty ? 0 : left[l];
+            pStat[CC_STAT_TOP] = bEmpty ? 0 : top[l];
+            pStat[CC_STAT_WIDTH] = bEmpty ? 0 : right[l] - left[l] + 1;
+            pStat[CC_STAT_HEIGHT] = bEmpty ? 0 : bottom[l] - top[l] + 1;
+            pStat[CC_STAT_AREA] = saturate_cast<int>(area[l]);
+        }
+    }
+    if (centroids.needed())
+    {
+        centroids.create(nLabels, 2, CV_64FC1);
+        Mat centroidsMat = centroids.getMat();
+        for (int l = 0; l < nLabels; ++l)
+        {
+            double* pCentroid = centroidsMat.ptr<double>(l);
+            double dArea = (double)area[l];
+            pCentroid[0] = (area[l] == 0) ? 0.0 : sumX[l] / dArea;
+            pCentroid[1] = (area[l] == 0) ? 0.0 : sumY[l] / dArea;
+        }
+    }
+
+    return nLabels;
+}
+
 CV_EXPORTS void morphologyEx(InputArray rlSrc, OutputArray rlDest, int op, InputArray rlKernel,
     bool bBoundaryOnForErosion, Point anchor)
 {
@@ -40,6 +40,7 @@
 //M*/
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 /******************************************************************************\
 *                            SEEDS Superpixels                                *
@@ -69,6 +70,17 @@ typedef float HISTN;
 namespace cv {
 namespace ximgproc {
 
+// a pixel (idx = image index) or block (idx = sublabel) that changed its top level label
+struct SeedsMove
+{
+    int idx;
+    int label_old;
+    int label_new;
+
+    SeedsMove(int idx_, int label_old_, int label_new_)
+        : idx(idx_), label_old(label_old_), label_new(label_new_) {}
+};
+
 class SuperpixelSEEDSImpl : public SuperpixelSEEDS
 {
 public:
@@ -87,12 +99,18 @@ public:
     virtual void getLabels(OutputArray labels_out) CV_OVERRIDE;
     virtual void getLabelContourMask(OutputArray image, bool thick_line = false) CV_OVERRIDE;
 
+    virtual void setWarmStart(bool warm_start) CV_OVERRIDE { seeds_warm_start = warm_start; }
+    virtual bool getWarmStart() const CV_OVERRIDE { return seeds_warm_start; }
+
 private:
     /* initialization */
     void initialize(int num_superpixels, int num_levels);
     void initImage(InputArray img);
+    void computeImageBins(InputArray img);
     void assignLabels();
     void computeHistograms(int until_level = -1);
+    // rebuild the top level histograms from the current labels (warm start)
+    void computeToplevelHistograms();
     template<typename _Tp>
     inline void initImageBins(const Mat& img, int max_value);
 
@@ -109,6 +127,11 @@ private:
     inline void updateLabels();
     // main loop for pixel updating
     void updatePixels();
+    // update every y_step-th row in [y_begin, y_end) in parallel
+    void updatePixelRows(int y_begin, int y_end, int y_step, bool vertical);
+    void updatePixelsHorizontal(int y, vector<SeedsMove>& moves);
+    void updatePixelsVertical(int y, vector<SeedsMove>& moves);
+    inline void movePixel(int label_new, int image_idx, int label_old, vector<SeedsMove>& moves);
 
 
     /* block operations */
@@ -122,6 +145,11 @@ private:
 
     //main loop for block updates
     void updateBlocks(int level, float req_confidence = 0.0f);
+    // update the blocks (x0 + i*x_step, y0 + j*y_step) in parallel
+    void updateBlockPhase(int level, float req_confidence, bool vertical,
+            int x0, int x_step, int y0, int y_step);
+    void proposeBlockMoveH(int level, int x, int y, float req_confidence, vector<SeedsMove>& moves);
+    void proposeBlockMoveV(int level, int x, int y, float req_confidence, vector<SeedsMove>& moves);
 
     /* go to next block level */
     int goDownOneLevel();
@@ -153,6 +181,8 @@ private:
     int seeds_current_level; //start with level seeds_top_level-1, then go down
     bool seeds_double_step;
     int seeds_prior;
+    bool seeds_warm_start;
+    bool seeds_has_labels; // labels hold the result of a previous iterate()
 
     // keep one labeling for each level
     vector<int> nr_wh; // [2*level]/[2*level+1] number of labels in x-direction/y-direction
@@ -182,6 +212,10 @@ private:
     vector<Mat> T_mat;
     vector<Mat> parent_mat;
     vector<Mat> parent_pre_init_mat;
+
+    /* scratch buffers, reused between calls */
+    vector<vector<SeedsMove> > phase_moves; //[row of the phase] proposed moves
+    Mat partial_histograms_mat; //[stripe] top level histograms followed by T (warm start)
 };
 
 CV_EXPORTS Ptr<SuperpixelSEEDS> createSuperpixelSEEDS(int image_width, int image_height,
@@ -201,6 +235,8 @@ SuperpixelSEEDSImpl::SuperpixelSEEDSImpl(int image_width, int image_height, int
     nr_channels = image_channels;
     seeds_double_step = double_step;
     seeds_prior = std::min(prior, 5);
+    seeds_warm_start = false;
+    seeds_has_labels = false;
 
     histogram_size = nr_bins;
     for (int i = 1; i < nr_channels; ++i)
@@ -218,21 +254,31 @@ SuperpixelSEEDSImpl::~SuperpixelSEEDSImpl()
 
 void SuperpixelSEEDSImpl::iterate(InputArray img, int num_iterations)
 {
-    initImage(img);
-
-    // block updates
-    while (seeds_current_level >= 0)
+    if( seeds_warm_start && seeds_has_labels )
     {
-        if( seeds_double_step )
-            updateBlocks(seeds_current_level, REQ_CONF);
+        // video mode: continue from the previous labels at pixel level
+        computeImageBins(img);
+        computeToplevelHistograms();
+    }
+    else
+    {
+        initImage(img);
+
+        // block updates
+        while (seeds_current_level >= 0)
+        {
+            if( seeds_double_step )
+                updateBlocks(seeds_current_level, REQ_CONF);
 
-        updateBlocks(seeds_current_level);
-        seeds_current_level = goDownOneLevel();
+            updateBlocks(seeds_current_level);
+            seeds_current_level = goDownOneLevel();
+        }
+        updateLabels();
     }
-    updateLabels();
 
     for (int i = 0; i < num_iterations; ++i)
         updatePixels();
+    seeds_has_labels = true;
 }
 void SuperpixelSEEDSImpl::getLabels(OutputArray labels_out)
 {
@@ -339,17 +385,21 @@ void SuperpixelSEEDSImpl::initImageBins(const Mat& img, int max_value)
     int img_height = img.size().height;
     int channels = img.channels();
 
-    for (int y = 0; y < img_height; ++y)
+    parallel_for_(Range(0, img_height), [&](const Range& range)
     {
-        for (int x = 0; x < img_width; ++x)
+        for (int y = range.start; y < range.end; ++y)
         {
-            const _Tp* ptr = img.ptr<_Tp>(y, x);
-            int bin = 0;
-            for (int i = 0; i < channels; ++i)
-                bin = bin * nr_bins + (int) ptr[i] * nr_bins / max_value;
-            image_bins[y * img_width + x] = bin;
+            const _Tp* ptr = img.ptr<_Tp>(y);
+            unsigned int* bins = image_bins + y * img_width;
+            for (int x = 0; x < img_width; ++x, ptr += channels)
+            {
+                int bin = 0;
+                for (int i = 0; i < channels; ++i)
+                    bin = bin * nr_bins + (int) ptr[i] * nr_bins / max_value;
+                bins[x] = bin;
+            }
         }
-    }
+    });
 }
 
 /* specialization for float: max_value is assumed to be 1.0f */
@@ -360,20 +410,34 @@ void SuperpixelSEEDSImpl::initImageBins<float>(const Mat& img, int)
     int img_height = img.size().height;
     int channels = img.channels();
 
-    for (int y = 0; y < img_height; ++y)
+    parallel_for_(Range(0, img_height), [&](const Range& range)
     {
-        for (int x = 0; x < img_width; ++x)
+        for (int y = range.start; y < range.end; ++y)
         {
-            const float* ptr = img.ptr<float>(y, x);
-            int bin = 0;
-            for(int i=0; i<channels; ++i)
-                bin = bin * nr_bins + std::min((int)(ptr[i] * (float)nr_bins), nr_bins-1);
-            image_bins[y*img_width + x] = bin;
+            const float* ptr = img.ptr<float>(y);
+            unsigned int* bins = image_bins + y * img_width;
+            for (int x = 0; x < img_width; ++x, ptr += channels)
+            {
+                int bin = 0;
+                for(int i=0; i<channels; ++i)
+                    bin = bin * nr_bins + std::min((int)(ptr[i] * (float)nr_bins), nr_bins-1);
+                bins[x] = bin;
+            }
         }
-    }
+    });
 }
 
 void SuperpixelSEEDSImpl::initImage(InputArray img)
+{
+    seeds_current_level = seeds_nr_levels - 2;
+    forwardbackward = true;
+
+    assignLabels();
+    computeImageBins(img);
+    computeHistograms();
+}
+
+void SuperpixelSEEDSImpl::computeImageBins(InputArray img)
 {
     Mat src;
 
@@ -401,10 +465,6 @@ void SuperpixelSEEDSImpl::initImage(InputArray img)
       CV_Error( Error::StsInternal, "Invalid InputArray." );
 
     int depth = src.depth();
-    seeds_current_level = seeds_nr_levels - 2;
-    forwardbackward = true;
-
-    assignLabels();
 
     CV_Assert(src.size().width == width && src.size().height == height);
     CV_Assert(depth == CV_8U || depth == CV_16U || depth == CV_32F);
@@ -423,8 +483,6 @@ void SuperpixelSEEDSImpl::initImage(InputArray img)
         initImageBins<float>(src, 1);
         break;
     }
-
-    computeHistograms();
 }
 
 // adds labeling to all the blocks at all levels and sets the correct parents
@@ -457,9 +515,18 @@ void SuperpixelSEEDSImpl::computeHistograms(int until_level)
         memset(T[level], 0, sizeof(HISTN) * nr_labels);
     }
 
-    // build histograms on the first level by adding the pixels to the blocks
-    for (int i = 0; i < width * height; ++i)
-        addPixel(0, labels_bottom[i], i);
+    // build histograms on the first level by adding the pixels to the blocks. the blocks of
+    // level 0 form a grid, so every row of blocks is only touched by its own image rows
+    int nr_block_rows = nr_wh[1];
+    vector<int> block_row_begin(nr_block_rows + 1, height);
+    for (int y = height - 1; y >= 0; --y)
+        block_row_begin[std::min(y * nr_block_rows / height, nr_block_rows - 1)] = y;
+    parallel_for_(Range(0, nr_block_rows), [&](const Range& range)
+    {
+        for (int i = block_row_begin[range.start] * width;
+                i < block_row_begin[range.end] * width; ++i)
+            addPixel(0, labels_bottom[i], i);
+    });
 
     // build histograms on the upper levels by adding the histogram from the level below
     for (int level = 1; level < until_level; level++)
@@ -471,136 +538,220 @@ void SuperpixelSEEDSImpl::computeHistograms(int until_level)
     }
 }
 
+void SuperpixelSEEDSImpl::computeToplevelHistograms()
+{
+    const int nr_labels = nrLabels(seeds_top_level);
+    const int hist_len = nr_labels * histogram_size_aligned;
+    const int nr_stripes = std::max(1, std::min(getNumThreads(), height / 16));
+
+    // every stripe of image rows counts into its own copy, the counts are integers so the
+    // result does not depend on the number of stripes
+    partial_histograms_mat.create(nr_stripes, hist_len + nr_labels, CV_32FC1);
+    parallel_for_(Range(0, nr_stripes), [&](const Range& range)
+    {
+        for (int s = range.start; s < range.end; ++s)
+        {
+            HISTN* hist = partial_histograms_mat.ptr<HISTN>(s);
+            HISTN* count = hist + hist_len;
+            memset(hist, 0, sizeof(HISTN) * (hist_len + nr_labels));
+            const int end = height * (s + 1) / nr_stripes * width;
+            for (int i = height * s / nr_stripes * width; i < end; ++i)
+            {
+                int label = labels[i];
+                hist[label * histogram_size_aligned + image_bins[i]]++;
+                count[label]++;
+            }
+        }
+    }, nr_stripes);
+
+    HISTN* h_top = histogram[seeds_top_level];
+    HISTN* t_top = T[seeds_top_level];
+    parallel_for_(Range(0, nr_labels), [&](const Range& range)
+    {
+        const int h_begin = range.start * histogram_size_aligned;
+        const int h_end = range.end * histogram_size_aligned;
+        memset(h_top + h_begin, 0, sizeof(HISTN) * (h_end - h_begin));
+        memset(t_top + range.start, 0, sizeof(HISTN) * (range.end - range.start));
+        for (int s = 0; s < nr_stripes; ++s)
+        {
+            const HISTN* hist = partial_histograms_mat.ptr<HISTN>(s);
+            for (int n = h_begin; n < h_end; ++n)
+                h_top[n] += hist[n];
+            for (int label = range.start; label < range.end; ++label)
+                t_top[label] += hist[hist_len + label];
+        }
+    });
+}
+
 void SuperpixelSEEDSImpl::updateBlocks(int level, float req_confidence)
 {
-    int labelA;
-    int labelB;
-    int sublabel;
-    bool done;
-    int step = nr_wh[2 * level];
+    /* the blocks are updated in phases of blocks that are far enough from each other to not see
+     * each other's moves: a horizontal move of block (x, y) or (x + 1, y) reads the blocks in
+     * rows y-1..y+1 and columns x-1..x+2, a vertical move of (x, y) or (x, y + 1) reads rows
+     * y-1..y+2 and columns x-1..x+1. within a phase all the proposals are made in parallel on the
+     * same histograms, then they are applied in order.
+     */
 
     // horizontal bidirectional block updating
-    for (int y = 1; y < nr_wh[2 * level + 1] - 1; y++)
+    for (int y0 = 1; y0 < 4; y0++)
+        for (int x0 = 1; x0 < 5; x0++)
+            updateBlockPhase(level, req_confidence, false, x0, 4, y0, 3);
+
+    // vertical bidirectional
+    for (int y0 = 1; y0 < 5; y0++)
+        for (int x0 = 1; x0 < 4; x0++)
+            updateBlockPhase(level, req_confidence, true, x0, 3, y0, 4);
+}
+
+void SuperpixelSEEDSImpl::updateBlockPhase(int level, float req_confidence, bool vertical,
+        int x0, int x_step, int y0, int y_step)
+{
+    // pairs (x, x + 1) for horizontal moves, (y, y + 1) for vertical moves
+    const int x_end = nr_wh[2 * level] - (vertical ? 1 : 2);
+    const int y_end = nr_wh[2 * level + 1] - (vertical ? 2 : 1);
+    if( x0 >= x_end || y0 >= y_end )
+        return;
+    const int nr_rows = (y_end - y0 + y_step - 1) / y_step;
+    if( (int)phase_moves.size() < nr_rows )
+        phase_moves.resize(nr_rows);
+
+    parallel_for_(Range(0, nr_rows), [&](const Range& range)
     {
-        for (int x = 1; x < nr_wh[2 * level] - 2; x++)
+        for (int i = range.start; i < range.end; ++i)
         {
-            // choose a label at the current level
-            sublabel = y * step + x;
-            // get the label at the top level (= superpixel label)
-            labelA = parent[level][y * step + x];
-            // get the neighboring label at the top level (= superpixel label)
-            labelB = parent[level][y * step + x + 1];
-
-            if( labelA == labelB )
-                continue;
-
-            // get the surrounding labels at the top level, to check for splitting
-            int a11 = parent[level][(y - 1) * step + (x - 1)];
-            int a12 = parent[level][(y - 1) * step + (x)];
-            int a21 = parent[level][(y) * step + (x - 1)];
-            int a22 = parent[level][(y) * step + (x)];
-            int a31 = parent[level][(y + 1) * step + (x - 1)];
-            int a32 = parent[level][(y + 1) * step + (x)];
-            done = false;
-
-            if( nr_partitions[labelA] == 2 || (nr_partitions[labelA] > 2 // 3 or more partitions
-                    && checkSplit_hf(a11, a12, a21, a22, a31, a32)) )
+            vector<SeedsMove>& moves = phase_moves[i];
+            moves.clear();
+            const int y = y0 + i * y_step;
+            for (int x = x0; x < x_end; x += x_step)
             {
-                // run algorithm as usual
-                float conf = intersectConf(seeds_top_level, labelB, labelA, level, sublabel);
-                if( conf > req_confidence )
-                {
-                    deleteBlockToplevel(labelA, level, sublabel);
-                    addBlockToplevel(labelB, level, sublabel);
-                    done = true;
-                }
+                if( vertical )
+                    proposeBlockMoveV(level, x, y, req_confidence, moves);
+                else
+                    proposeBlockMoveH(level, x, y, req_confidence, moves);
             }
+        }
+    });
 
-            if( !done && (nr_partitions[labelB] > MINIMUM_NR_SUBLABELS) )
-            {
-                // try opposite direction
-                sublabel = y * step + x + 1;
-                int a13 = parent[level][(y - 1) * step + (x + 1)];
-                int a14 = parent[level][(y - 1) * step + (x + 2)];
-                int a23 = parent[level][(y) * step + (x + 1)];
-                int a24 = parent[level][(y) * step + (x + 2)];
-                int a33 = parent[level][(y + 1) * step + (x + 1)];
-                int a34 = parent[level][(y + 1) * step + (x + 2)];
-                if( nr_partitions[labelB] <= 2 // == 2
-                        || (nr_partitions[labelB] > 2 && checkSplit_hb(a13, a14, a23, a24, a33, a34)) )
-                {
-                    // run algorithm as usual
-                    float conf = intersectConf(seeds_top_level, labelA, labelB, level, sublabel);
-                    if( conf > req_confidence )
-                    {
-                        deleteBlockToplevel(labelB, level, sublabel);
-                        addBlockToplevel(labelA, level, sublabel);
-                        x++;
-                    }
-                }
-            }
+    for (int i = 0; i < nr_rows; ++i)
+    {
+        const vector<SeedsMove>& moves = phase_moves[i];
+        for (size_t k = 0; k < moves.size(); ++k)
+        {
+            const SeedsMove& m = moves[k];
+            // another move of this phase may already have taken the last spare block
+            if( nr_partitions[m.label_old] <= MINIMUM_NR_SUBLABELS )
+                continue;
+            deleteBlockToplevel(m.label_old, level, m.idx);
+            addBlockToplevel(m.label_new, level, m.idx);
         }
     }
+}
 
-    // vertical bidirectional
-    for (int x = 1; x < nr_wh[2 * level] - 1; x++)
+void SuperpixelSEEDSImpl::proposeBlockMoveH(int level, int x, int y, float req_confidence,
+        vector<SeedsMove>& moves)
+{
+    int step = nr_wh[2 * level];
+    // choose a label at the current level
+    int sublabel = y * step + x;
+    // get the label at the top level (= superpixel label)
+    int labelA = parent[level][y * step + x];
+    // get the neighboring label at the top level (= superpixel label)
+    int labelB = parent[level][y * step + x + 1];
+
+    if( labelA == labelB )
+        return;
+
+    // get the surrounding labels at the top level, to check for splitting
+    int a11 = parent[level][(y - 1) * step + (x - 1)];
+    int a12 = parent[level][(y - 1) * step + (x)];
+    int a21 = parent[level][(y) * step + (x - 1)];
+    int a22 = parent[level][(y) * step + (x)];
+    int a31 = parent[level][(y + 1) * step + (x - 1)];
+    int a32 = parent[level][(y + 1) * step + (x)];
+
+    if( nr_partitions[labelA] == 2 || (nr_partitions[labelA] > 2 // 3 or more partitions
+            && checkSplit_hf(a11, a12, a21, a22, a31, a32)) )
     {
-        for (int y = 1; y < nr_wh[2 * level + 1] - 2; y++)
+        // run algorithm as usual
+        float conf = intersectConf(seeds_top_level, labelB, labelA, level, sublabel);
+        if( conf > req_confidence )
         {
-            // choose a label at the current level
-            sublabel = y * step + x;
-            // get the label at the top level (= superpixel label)
-            labelA = parent[level][y * step + x];
-            // get the neighboring label at the top level (= superpixel label)
-            labelB = parent[level][(y + 1) * step + x];
-
-            if( labelA == labelB )
-                continue;
+            moves.push_back(SeedsMove(sublabel, labelA, labelB));
+            return;
+        }
+    }
 
-            int a11 = parent[level][(y - 1) * step + (x - 1)];
-            int a12 = parent[level][(y - 1) * step + (x)];
-            int a13 = parent[level][(y - 1) * step + (x + 1)];
-            int a21 = parent[level][(y) * step + (x - 1)];
-            int a22 = parent[level][(y) * step + (x)];
-            int a23 = parent[level][(y) * step + (x + 1)];
+    if( nr_partitions[labelB] > MINIMUM_NR_SUBLABELS )
+    {
+        // try opposite direction
+        sublabel = y * step + x + 1;
+        int a13 = parent[level][(y - 1) * step + (x + 1)];
+        int a14 = parent[level][(y - 1) * step + (x + 2)];
+        int a23 = parent[level][(y) * step + (x + 1)];
+        int a24 = parent[level][(y) * step + (x + 2)];
+        int a33 = parent[level][(y + 1) * step + (x + 1)];
+        int a34 = parent[level][(y + 1) * step + (x + 2)];
+        if( nr_partitions[labelB] <= 2 // == 2
+                || (nr_partitions[labelB] > 2 && checkSplit_hb(a13, a14, a23, a24, a33, a34)) )
+        {
+            // run algorithm as usual
+            float conf = intersectConf(seeds_top_level, labelA, labelB, level, sublabel);
+            if( conf > req_confidence )
+                moves.push_back(SeedsMove(sublabel, labelB, labelA));
+        }
+    }
+}
 
-            done = false;
-            if( nr_partitions[labelA] == 2 || (nr_partitions[labelA] > 2 // 3 or more partitions
-                    && checkSplit_vf(a11, a12, a13, a21, a22, a23)) )
-            {
-                // run algorithm as usual
-                float conf = intersectConf(seeds_top_level, labelB, labelA, level, sublabel);
-                if( conf > req_confidence )
-                {
-                    deleteBlockToplevel(labelA, level, sublabel);
-                    addBlockToplevel(labelB, level, sublabel);
-                    done = true;
-                }
-            }
+void SuperpixelSEEDSImpl::proposeBlockMoveV(int level, int x, int y, float req_confidence,
+        vector<SeedsMove>& moves)
+{
+    int step = nr_wh[2 * level];
+    // choose a label at the current level
+    int sublabel = y * step + x;
+    // get the label at the top level (= superpixel label)
+    int labelA = parent[level][y * step + x];
+    // get the neighboring label at the top level (= superpixel label)
+    int labelB = parent[level][(y + 1) * step + x];
+
+    if( labelA == labelB )
+        return;
+
+    int a11 = parent[level][(y - 1) * step + (x - 1)];
+    int a12 = parent[level][(y - 1) * step + (x)];
+    int a13 = parent[level][(y - 1) * step + (x + 1)];
+    int a21 = parent[level][(y) * step + (x - 1)];
+    int a22 = parent[level][(y) * step + (x)];
+    int a23 = parent[level][(y) * step + (x + 1)];
+
+    if( nr_partitions[labelA] == 2 || (nr_partitions[labelA] > 2 // 3 or more partitions
+            && checkSplit_vf(a11, a12, a13, a21, a22, a23)) )
+    {
+        // run algorithm as usual
+        float conf = intersectConf(seeds_top_level, labelB, labelA, level, sublabel);
+        if( conf > req_confidence )
+        {
+            moves.push_back(SeedsMove(sublabel, labelA, labelB));
+            return;
+        }
+    }
 
-            if( !done && (nr_partitions[labelB] > MINIMUM_NR_SUBLABELS) )
-            {
-                // try opposite direction
-                sublabel = (y + 1) * step + x;
-                int a31 = parent[level][(y + 1) * step + (x - 1)];
-                int a32 = parent[level][(y + 1) * step + (x)];
-                int a33 = parent[level][(y + 1) * step + (x + 1)];
-                int a41 = parent[level][(y + 2) * step + (x - 1)];
-                int a42 = parent[level][(y + 2) * step + (x)];
-                int a43 = parent[level][(y + 2) * step + (x + 1)];
-                if( nr_partitions[labelB] <= 2 // == 2
-                        || (nr_partitions[labelB] > 2 && checkSplit_vb(a31, a32, a33, a41, a42, a43)) )
-                {
-                    // run algorithm as usual
-                    float conf = intersectConf(seeds_top_level, labelA, labelB, level, sublabel);
-                    if( conf > req_confidence )
-                    {
-                        deleteBlockToplevel(labelB, level, sublabel);
-                        addBlockToplevel(labelA, level, sublabel);
-                        y++;
-                    }
-                }
-            }
+    if( nr_partitions[labelB] > MINIMUM_NR_SUBLABELS )
+    {
+        // try opposite direction
+        sublabel = (y + 1) * step + x;
+        int a31 = parent[level][(y + 1) * step + (x - 1)];
+        int a32 = parent[level][(y + 1) * step + (x)];
+        int a33 = parent[level][(y + 1) * step + (x + 1)];
+        int a41 = parent[level][(y + 2) * step + (x - 1)];
+        int a42 = parent[level][(y + 2) * step + (x)];
+        int a43 = parent[level][(y + 2) * step + (x + 1)];
+        if( nr_partitions[labelB] <= 2 // == 2
+                || (nr_partitions[labelB] > 2 && checkSplit_vb(a31, a32, a33, a41, a42, a43)) )
+        {
+            // run algorithm as usual
+            float conf = intersectConf(seeds_top_level, labelA, labelB, level, sublabel);
+            if( conf > req_confidence )
+                moves.push_back(SeedsMove(sublabel, labelB, labelA));
         }
     }
 }
@@ -636,222 +787,278 @@ int SuperpixelSEEDSImpl::goDownOneLevel()
 }
 
 void SuperpixelSEEDSImpl::updatePixels()
+{
+    int labelA;
+    int labelB;
+
+    /* the rows are updated in phases of rows that are far enough from each other to not see
+     * each other's moves: a horizontal move in row y reads rows y-1..y+1, a vertical move of
+     * (x, y) or (x, y + 1) reads rows y-1..y+2. the rows of a phase are updated in parallel on the
+     * same histograms, which are updated at the end of the phase.
+     */
+    for (int y0 = 1; y0 < 4; y0++)
+        updatePixelRows(y0, height - 1, 3, false);
+    for (int y0 = 1; y0 < 5; y0++)
+        updatePixelRows(y0, height - 2, 4, true);
+    forwardbackward = !forwardbackward;
+
+    // update border pixels
+    for (int x = 0; x < width; x++)
+    {
+        labelA = labels[x];
+        labelB = labels[width + x];
+        if( labelA != labelB )
+            update(labelB, x, labelA);
+        labelA = labels[(height - 1) * width + x];
+        labelB = labels[(height - 2) * width + x];
+        if( labelA != labelB )
+            update(labelB, (height - 1) * width + x, labelA);
+    }
+    for (int y = 0; y < height; y++)
+    {
+        labelA = labels[y * width];
+        labelB = labels[y * width + 1];
+        if( labelA != labelB )
+            update(labelB, y * width, labelA);
+        labelA = labels[y * width + width - 1];
+        labelB = labels[y * width + width - 2];
+        if( labelA != labelB )
+            update(labelB, y * width + width - 1, labelA);
+    }
+}
+
+void SuperpixelSEEDSImpl::updatePixelRows(int y_begin, int y_end, int y_step, bool vertical)
+{
+    if( y_begin >= y_end )
+        return;
+    const int nr_rows = (y_end - y_begin + y_step - 1) / y_step;
+    if( (int)phase_moves.size() < nr_rows )
+        phase_moves.resize(nr_rows);
+
+    parallel_for_(Range(0, nr_rows), [&](const Range& range)
+    {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            vector<SeedsMove>& moves = phase_moves[i];
+            moves.clear();
+            if( vertical )
+                updatePixelsVertical(y_begin + i * y_step, moves);
+            else
+                updatePixelsHorizontal(y_begin + i * y_step, moves);
+        }
+    });
+
+    for (int i = 0; i < nr_rows; ++i)
+    {
+        const vector<SeedsMove>& moves = phase_moves[i];
+        for (size_t k = 0; k < moves.size(); ++k)
+        {
+            deletePixel(seeds_top_level, moves[k].label_old, moves[k].idx);
+            addPixel(seeds_top_level, moves[k].label_new, moves[k].idx);
+        }
+    }
+}
+
+void SuperpixelSEEDSImpl::updatePixelsHorizontal(int y, vector<SeedsMove>& moves)
 {
     int labelA;
     int labelB;
     int priorA = 0;
     int priorB = 0;
 
-    for (int y = 1; y < height - 1; y++)
+    for (int x = 1; x < width - 2; x++)
     {
-        for (int x = 1; x < width - 2; x++)
-        {
 
-            labelA = labels[(y) * width + (x)];
-            labelB = labels[(y) * width + (x + 1)];
+        labelA = labels[(y) * width + (x)];
+        labelB = labels[(y) * width + (x + 1)];
 
-            if( labelA != labelB )
+        if( labelA != labelB )
+        {
+            int a22 = labelA;
+            int a23 = labelB;
+            if( forwardbackward )
             {
-                int a22 = labelA;
-                int a23 = labelB;
-                if( forwardbackward )
+                // horizontal bidirectional
+                int a11 = labels[(y - 1) * width + (x - 1)];
+                int a12 = labels[(y - 1) * width + (x)];
+                int a21 = labels[(y) * width + (x - 1)];
+                int a31 = labels[(y + 1) * width + (x - 1)];
+                int a32 = labels[(y + 1) * width + (x)];
+                if( checkSplit_hf(a11, a12, a21, a22, a31, a32) )
                 {
-                    // horizontal bidirectional
-                    int a11 = labels[(y - 1) * width + (x - 1)];
-                    int a12 = labels[(y - 1) * width + (x)];
-                    int a21 = labels[(y) * width + (x - 1)];
-                    int a31 = labels[(y + 1) * width + (x - 1)];
-                    int a32 = labels[(y + 1) * width + (x)];
-                    if( checkSplit_hf(a11, a12, a21, a22, a31, a32) )
+                    if( seeds_prior )
                     {
-                        if( seeds_prior )
-                        {
-                            priorA = threebyfour(x, y, labelA);
-                            priorB = threebyfour(x, y, labelB);
-                        }
+                        priorA = threebyfour(x, y, labelA);
+                        priorB = threebyfour(x, y, labelB);
+                    }
 
-                        if( probability(y * width + x, labelA, labelB, priorA, priorB) )
-                        {
-                            update(labelB, y * width + x, labelA);
-                        }
-                        else
+                    if( probability(y * width + x, labelA, labelB, priorA, priorB) )
+                    {
+                        movePixel(labelB, y * width + x, labelA, moves);
+                    }
+                    else
+                    {
+                        int a13 = labels[(y - 1) * width + (x + 1)];
+                        int a14 = labels[(y - 1) * width + (x + 2)];
+                        int a24 = labels[(y) * width + (x + 2)];
+                        int a33 = labels[(y + 1) * width + (x + 1)];
+                        int a34 = labels[(y + 1) * width + (x + 2)];
+                        if( checkSplit_hb(a13, a14, a23, a24, a33, a34) )
                         {
-                            int a13 = labels[(y - 1) * width + (x + 1)];
-                            int a14 = labels[(y - 1) * width + (x + 2)];
-                            int a24 = labels[(y) * width + (x + 2)];
-                            int a33 = labels[(y + 1) * width + (x + 1)];
-                            int a34 = labels[(y + 1) * width + (x + 2)];
-                            if( checkSplit_hb(a13, a14, a23, a24, a33, a34) )
+                            if( probability(y * width + x + 1, labelB, labelA, priorB, priorA) )
                             {
-                                if( probability(y * width + x + 1, labelB, labelA, priorB, priorA) )
-                                {
-                                    update(labelA, y * width + x + 1, labelB);
-                                    x++;
-                                }
+                                movePixel(labelA, y * width + x + 1, labelB, moves);
+                                x++;
                             }
                         }
                     }
                 }
-                else
-                { // forward backward
-                    // horizontal bidirectional
-                    int a13 = labels[(y - 1) * width + (x + 1)];
-                    int a14 = labels[(y - 1) * width + (x + 2)];
-                    int a24 = labels[(y) * width + (x + 2)];
-                    int a33 = labels[(y + 1) * width + (x + 1)];
-                    int a34 = labels[(y + 1) * width + (x + 2)];
-                    if( checkSplit_hb(a13, a14, a23, a24, a33, a34) )
+            }
+            else
+            { // forward backward
+                // horizontal bidirectional
+                int a13 = labels[(y - 1) * width + (x + 1)];
+                int a14 = labels[(y - 1) * width + (x + 2)];
+                int a24 = labels[(y) * width + (x + 2)];
+                int a33 = labels[(y + 1) * width + (x + 1)];
+                int a34 = labels[(y + 1) * width + (x + 2)];
+                if( checkSplit_hb(a13, a14, a23, a24, a33, a34) )
+                {
+                    if( seeds_prior )
                     {
-                        if( seeds_prior )
-                        {
-                            priorA = threebyfour(x, y, labelA);
-                            priorB = threebyfour(x, y, labelB);
-                        }
+                        priorA = threebyfour(x, y, labelA);
+                        priorB = threebyfour(x, y, labelB);
+                    }
 
-                        if( probability(y * width + x + 1, labelB, labelA, priorB, priorA) )
-                        {
-                            update(labelA, y * width + x + 1, labelB);
-                            x++;
-                        }
-                        else
+                    if( probability(y * width + x + 1, labelB, labelA, priorB, priorA) )
+                    {
+                        movePixel(labelA, y * width + x + 1, labelB, moves);
+                        x++;
+                    }
+                    else
+                    {
+                        int a11 = labels[(y - 1) * width + (x - 1)];
+                        int a12 = labels[(y - 1) * width + (x)];
+                        int a21 = labels[(y) * width + (x - 1)];
+                        int a31 = labels[(y + 1) * width + (x - 1)];
+                        int a32 = labels[(y + 1) * width + (x)];
+                        if( checkSplit_hf(a11, a12, a21, a22, a31, a32) )
                         {
-                            int a11 = labels[(y - 1) * width + (x - 1)];
-                            int a12 = labels[(y - 1) * width + (x)];
-                            int a21 = labels[(y) * width + (x - 1)];
-                            int a31 = labels[(y + 1) * width + (x - 1)];
-                            int a32 = labels[(y + 1) * width + (x)];
-                            if( checkSplit_hf(a11, a12, a21, a22, a31, a32) )
+                            if( probability(y * width + x, labelA, labelB, priorA, priorB) )
                             {
-                                if( probability(y * width + x, labelA, labelB, priorA, priorB) )
-                                {
-                                    update(labelB, y * width + x, labelA);
-                                }
+                                movePixel(labelB, y * width + x, labelA, moves);
                             }
                         }
                     }
                 }
-            } // labelA != labelB
-        } // for x
-    } // for y
+            }
+        } // labelA != labelB
+    }
+}
+
+void SuperpixelSEEDSImpl::updatePixelsVertical(int y, vector<SeedsMove>& moves)
+{
+    int labelA;
+    int labelB;
+    int priorA = 0;
+    int priorB = 0;
 
     for (int x = 1; x < width - 1; x++)
     {
-        for (int y = 1; y < height - 2; y++)
+
+        labelA = labels[(y) * width + (x)];
+        labelB = labels[(y + 1) * width + (x)];
+        if( labelA != labelB )
         {
+            int a22 = labelA;
+            int a32 = labelB;
 
-            labelA = labels[(y) * width + (x)];
-            labelB = labels[(y + 1) * width + (x)];
-            if( labelA != labelB )
+            if( forwardbackward )
             {
-                int a22 = labelA;
-                int a32 = labelB;
-
-                if( forwardbackward )
+                // vertical bidirectional
+                int a11 = labels[(y - 1) * width + (x - 1)];
+                int a12 = labels[(y - 1) * width + (x)];
+                int a13 = labels[(y - 1) * width + (x + 1)];
+                int a21 = labels[(y) * width + (x - 1)];
+                int a23 = labels[(y) * width + (x + 1)];
+                if( checkSplit_vf(a11, a12, a13, a21, a22, a23) )
                 {
-                    // vertical bidirectional
-                    int a11 = labels[(y - 1) * width + (x - 1)];
-                    int a12 = labels[(y - 1) * width + (x)];
-                    int a13 = labels[(y - 1) * width + (x + 1)];
-                    int a21 = labels[(y) * width + (x - 1)];
-                    int a23 = labels[(y) * width + (x + 1)];
-                    if( checkSplit_vf(a11, a12, a13, a21, a22, a23) )
+                    if( seeds_prior )
                     {
-                        if( seeds_prior )
-                        {
-                            priorA = fourbythree(x, y, labelA);
-                            priorB = fourbythree(x, y, labelB);
-                        }
+                        priorA = fourbythree(x, y, labelA);
+                        priorB = fourbythree(x, y, labelB);
+                    }
 
-                        if( probability(y * width + x, labelA, labelB, priorA, priorB) )
-                        {
-                            update(labelB, y * width + x, labelA);
-                        }
-                        else
+                    if( probability(y * width + x, labelA, labelB, priorA, priorB) )
+                    {
+                        movePixel(labelB, y * width + x, labelA, moves);
+                    }
+                    else
+                    {
+                        int a31 = labels[(y + 1) * width + (x - 1)];
+                        int a33 = labels[(y + 1) * width + (x + 1)];
+                        int a41 = labels[(y + 2) * width + (x - 1)];
+                        int a42 = labels[(y + 2) * width + (x)];
+                        int a43 = labels[(y + 2) * width + (x + 1)];
+                        if( checkSplit_vb(a31, a32, a33, a41, a42, a43) )
                         {
-                            int a31 = labels[(y + 1) * width + (x - 1)];
-                            int a33 = labels[(y + 1) * width + (x + 1)];
-                            int a41 = labels[(y + 2) * width + (x - 1)];
-                            int a42 = labels[(y + 2) * width + (x)];
-                            int a43 = labels[(y + 2) * width + (x + 1)];
-                            if( checkSplit_vb(a31, a32, a33, a41, a42, a43) )
+                            if( probability((y + 1) * width + x, labelB, labelA, priorB, priorA) )
                             {
-                                if( probability((y + 1) * width + x, labelB, labelA, priorB, priorA) )
-                                {
-                                    update(labelA, (y + 1) * width + x, labelB);
-                                    y++;
-                                }
+                                movePixel(labelA, (y + 1) * width + x, labelB, moves);
                             }
                         }
                     }
                 }
-                else
-                { // forwardbackward
-                    // vertical bidirectional
-                    int a31 = labels[(y + 1) * width + (x - 1)];
-                    int a33 = labels[(y + 1) * width + (x + 1)];
-                    int a41 = labels[(y + 2) * width + (x - 1)];
-                    int a42 = labels[(y + 2) * width + (x)];
-                    int a43 = labels[(y + 2) * width + (x + 1)];
-                    if( checkSplit_vb(a31, a32, a33, a41, a42, a43) )
+            }
+            else
+            { // forwardbackward
+                // vertical bidirectional
+                int a31 = labels[(y + 1) * width + (x - 1)];
+                int a33 = labels[(y + 1) * width + (x + 1)];
+                int a41 = labels[(y + 2) * width + (x - 1)];
+                int a42 = labels[(y + 2) * width + (x)];
+                int a43 = labels[(y + 2) * width + (x + 1)];
+                if( checkSplit_vb(a31, a32, a33, a41, a42, a43) )
+                {
+                    if( seeds_prior )
                     {
-                        if( seeds_prior )
-                        {
-                            priorA = fourbythree(x, y, labelA);
-                            priorB = fourbythree(x, y, labelB);
-                        }
+                        priorA = fourbythree(x, y, labelA);
+                        priorB = fourbythree(x, y, labelB);
+                    }
 
-                        if( probability((y + 1) * width + x, labelB, labelA, priorB, priorA) )
-                        {
-                            update(labelA, (y + 1) * width + x, labelB);
-                            y++;
-                        }
-                        else
+                    if( probability((y + 1) * width + x, labelB, labelA, priorB, priorA) )
+                    {
+                        movePixel(labelA, (y + 1) * width + x, labelB, moves);
+                    }
+                    else
+                    {
+                        int a11 = labels[(y - 1) * width + (x - 1)];
+                        int a12 = labels[(y - 1) * width + (x)];
+                        int a13 = labels[(y - 1) * width + (x + 1)];
+                        int a21 = labels[(y) * width + (x - 1)];
+                        int a23 = labels[(y) * width + (x + 1)];
+                        if( checkSplit_vf(a11, a12, a13, a21, a22, a23) )
                         {
-                            int a11 = labels[(y - 1) * width + (x - 1)];
-                            int a12 = labels[(y - 1) * width + (x)];
-                            int a13 = labels[(y - 1) * width + (x + 1)];
-                            int a21 = labels[(y) * width + (x - 1)];
-                            int a23 = labels[(y) * width + (x + 1)];
-                            if( checkSplit_vf(a11, a12, a13, a21, a22, a23) )
+                            if( probability(y * width + x, labelA, labelB, priorA, priorB) )
                             {
-                                if( probability(y * width + x, labelA, labelB, priorA, priorB) )
-                                {
-                                    update(labelB, y * width + x, labelA);
-                                }
+                                movePixel(labelB, y * width + x, labelA, moves);
                             }
                         }
                     }
                 }
-            } // labelA != labelB
-        } // for y
-    } // for x
-    forwardbackward = !forwardbackward;
-
-    // update border pixels
-    for (int x = 0; x < width; x++)
-    {
-        labelA = labels[x];
-        labelB = labels[width + x];
-        if( labelA != labelB )
-            update(labelB, x, labelA);
-        labelA = labels[(height - 1) * width + x];
-        labelB = labels[(height - 2) * width + x];
-        if( labelA != labelB )
-            update(labelB, (height - 1) * width + x, labelA);
-    }
-    for (int y = 0; y < height; y++)
-    {
-        labelA = labels[y * width];
-        labelB = labels[y * width + 1];
-        if( labelA != labelB )
-            update(labelB, y * width, labelA);
-        labelA = labels[y * width + width - 1];
-        labelB = labels[y * width + width - 2];
-        if( labelA != labelB )
-            update(labelB, y * width + width - 1, labelA);
+            }
+        } // labelA != labelB
     }
 }
 
+void SuperpixelSEEDSImpl::movePixel(int label_new, int image_idx, int label_old,
+        vector<SeedsMove>& moves)
+{
+    // the histograms are updated once the phase is done
+    labels[image_idx] = label_new;
+    moves.push_back(SeedsMove(image_idx, label_old, label_new));
+}
+
 void SuperpixelSEEDSImpl::update(int label_new, int image_idx, int label_old)
 {
     //change the label of a single pixel
@@ -882,16 +1089,10 @@ void SuperpixelSEEDSImpl::addBlock(int level, int label, int sublevel,
 
     //add the (sublevel, sublabel) block to the block (level, label)
     int n = 0;
-#if CV_SSSE3
-    const int loop_end = histogram_size - 3;
-    for (; n < loop_end; n += 4)
-    {
-        //this does exactly the same as the loop peeling below, but 4 elements at a time
-        __m128 h_labelp = _mm_load_ps(h_label + n);
-        __m128 h_sublabelp = _mm_load_ps(h_sublabel + n);
-        h_labelp = _mm_add_ps(h_labelp, h_sublabelp);
-        _mm_store_ps(h_label + n, h_labelp);
-    }
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int nlanes = VTraits<v_float32>::vlanes();
+    for (; n <= histogram_size - nlanes; n += nlanes)
+        v_store(h_label + n, v_add(vx_load(h_label + n), vx_load(h_sublabel + n)));
 #endif
 
     //loop peeling
@@ -914,16 +1115,10 @@ void SuperpixelSEEDSImpl::deleteBlockToplevel(int label, int sublevel, int subla
 
     //do the reverse operation of add_block_toplevel
     int n = 0;
-#if CV_SSSE3
-    const int loop_end = histogram_size - 3;
-    for (; n < loop_end; n += 4)
-    {
-        //this does exactly the same as the loop peeling below, but 4 elements at a time
-        __m128 h_labelp = _mm_load_ps(h_label + n);
-        __m128 h_sublabelp = _mm_load_ps(h_sublabel + n);
-        h_labelp = _mm_sub_ps(h_labelp, h_sublabelp);
-        _mm_store_ps(h_label + n, h_labelp);
-    }
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int nlanes = VTraits<v_float32>::vlanes();
+    for (; n <= histogram_size - nlanes; n += nlanes)
+        v_store(h_label + n, v_sub(vx_load(h_label + n), vx_load(h_sublabel + n)));
 #endif
 
     //loop peeling
@@ -937,8 +1132,12 @@ void SuperpixelSEEDSImpl::deleteBlockToplevel(int label, int sublevel, int subla
 
 void SuperpixelSEEDSImpl::updateLabels()
 {
-    for (int i = 0; i < width * height; ++i)
-        labels[i] = parent[0][labels_bottom[i]];
+    const int* parent0 = parent[0];
+    parallel_for_(Range(0, height), [&](const Range& range)
+    {
+        for (int i = range.start * width; i < range.end * width; ++i)
+            labels[i] = parent0[labels_bottom[i]];
+    });
 }
 
 bool SuperpixelSEEDSImpl::probability(int image_idx, int label1, int label2,
@@ -988,28 +1187,18 @@ int SuperpixelSEEDSImpl::threebyfour(int x, int y, int label)
      * x x x x
      */
 
-#if CV_SSSE3
-    __m128i addp = _mm_set1_epi32(1);
-    __m128i addp_middle = _mm_set_epi32(1, 0, 0, 1);
-    __m128i labelp = _mm_set1_epi32(label);
+#if CV_SIMD128
+    const v_int32x4 addp = v_setall_s32(1);
+    const v_int32x4 addp_middle(1, 0, 0, 1);
+    const v_int32x4 labelp = v_setall_s32(label);
     /* 1. row */
-    __m128i data1 = _mm_loadu_si128((__m128i*) (labels + (y-1)*width + x -1));
-    __m128i mask1 = _mm_cmpeq_epi32(data1, labelp);
-    __m128i countp = _mm_and_si128(mask1, addp);
+    v_int32x4 countp = v_and(v_eq(v_load(labels + (y-1)*width + x - 1), labelp), addp);
     /* 2. row */
-    __m128i data2 = _mm_loadu_si128((__m128i*) (labels + y*width + x -1));
-    __m128i mask2 = _mm_cmpeq_epi32(data2, labelp);
-    __m128i count1 = _mm_and_si128(mask2, addp_middle);
-    countp = _mm_add_epi32(countp, count1);
+    countp = v_add(countp, v_and(v_eq(v_load(labels + y*width + x - 1), labelp), addp_middle));
     /* 3. row */
-    __m128i data3 = _mm_loadu_si128((__m128i*) (labels + (y+1)*width + x -1));
-    __m128i mask3 = _mm_cmpeq_epi32(data3, labelp);
-    __m128i count3 = _mm_and_si128(mask3, addp);
-    countp = _mm_add_epi32(count3, countp);
-
-    countp = _mm_hadd_epi32(countp, countp);
-    countp = _mm_hadd_epi32(countp, countp);
-    return _mm_cvtsi128_si32(countp);
+    countp = v_add(countp, v_and(v_eq(v_load(labels + (y+1)*width + x - 1), labelp), addp));
+
+    return v_reduce_sum(countp);
 #else
     int count = 0;
     count += (labels[(y - 1) * width + x - 1] == label);
@@ -1039,33 +1228,20 @@ int SuperpixelSEEDSImpl::fourbythree(int x, int y, int label)
      * x x x o
      */
 
-#if CV_SSSE3
-    __m128i addp_border = _mm_set_epi32(0, 1, 1, 1);
-    __m128i addp_middle = _mm_set_epi32(1, 0, 0, 1);
-    __m128i labelp = _mm_set1_epi32(label);
+#if CV_SIMD128
+    const v_int32x4 addp_border(1, 1, 1, 0);
+    const v_int32x4 addp_middle(1, 0, 0, 1);
+    const v_int32x4 labelp = v_setall_s32(label);
     /* 1. row */
-    __m128i data1 = _mm_loadu_si128((__m128i*) (labels + (y-1)*width + x -1));
-    __m128i mask1 = _mm_cmpeq_epi32(data1, labelp);
-    __m128i countp = _mm_and_si128(mask1, addp_border);
+    v_int32x4 countp = v_and(v_eq(v_load(labels + (y-1)*width + x - 1), labelp), addp_border);
     /* 2. row */
-    __m128i data2 = _mm_loadu_si128((__m128i*) (labels + y*width + x -1));
-    __m128i mask2 = _mm_cmpeq_epi32(data2, labelp);
-    __m128i count1 = _mm_and_si128(mask2, addp_middle);
-    countp = _mm_add_epi32(countp, count1);
+    countp = v_add(countp, v_and(v_eq(v_load(labels + y*width + x - 1), labelp), addp_middle));
     /* 3. row */
-    __m128i data3 = _mm_loadu_si128((__m128i*) (labels + (y+1)*width + x -1));
-    __m128i mask3 = _mm_cmpeq_epi32(data3, labelp);
-    __m128i count3 = _mm_and_si128(mask3, addp_middle);
-    countp = _mm_add_epi32(count3, countp);
+    countp = v_add(countp, v_and(v_eq(v_load(labels + (y+1)*width + x - 1), labelp), addp_middle));
     /* 4. row */
-    __m128i data4 = _mm_loadu_si128((__m128i*) (labels + (y+2)*width + x -1));
-    __m128i mask4 = _mm_cmpeq_epi32(data4, labelp);
-    __m128i count4 = _mm_and_si128(mask4, addp_border);
-    countp = _mm_add_epi32(countp, count4);
-
-    countp = _mm_hadd_epi32(countp, countp);
-    countp = _mm_hadd_epi32(countp, countp);
-    return _mm_cvtsi128_si32(countp);
+    countp = v_add(countp, v_and(v_eq(v_load(labels + (y+2)*width + x - 1), labelp), addp_border));
+
+    return v_reduce_sum(countp);
 #else
     int count = 0;
     count += (labels[(y - 1) * width + x - 1] == label);
@@ -1109,54 +1285,27 @@ float SuperpixelSEEDSImpl::intersectConf(int level1, int label1A, int label1B,
      */
 
     int n = 0;
-#if CV_SSSE3
-    __m128 count1Ap = _mm_set1_ps(count1A);
-    __m128 count2p = _mm_set1_ps(count2);
-    __m128 count1Bp = _mm_set1_ps(count1B);
-    __m128 sumAp = _mm_set1_ps(0.0f);
-    __m128 sumBp = _mm_set1_ps(0.0f);
-
-    const int loop_end = histogram_size - 3;
-    for(; n < loop_end; n += 4)
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    // min(x, y) is the same as the (x < y ? x : y) selection of the loop peeling below
+    const int nlanes = VTraits<v_float32>::vlanes();
+    const v_float32 count1Ap = vx_setall_f32(count1A);
+    const v_float32 count2p = vx_setall_f32(count2);
+    const v_float32 count1Bp = vx_setall_f32(count1B);
+    v_float32 sumAp = vx_setzero_f32();
+    v_float32 sumBp = vx_setzero_f32();
+    for (; n <= histogram_size - nlanes; n += nlanes)
     {
-        //this does exactly the same as the loop peeling below, but 4 elements at a time
+        v_float32 h1Ap = vx_load(h1A + n);
+        v_float32 h1Bp = vx_load(h1B + n);
+        v_float32 h2p = vx_load(h2 + n);
 
         // normal
-        __m128 h1Ap = _mm_load_ps(h1A + n);
-        __m128 h1Bp = _mm_load_ps(h1B + n);
-        __m128 h2p = _mm_load_ps(h2 + n);
-
-        __m128 h1ApC2 = _mm_mul_ps(h1Ap, count2p);
-        __m128 h2pC1A = _mm_mul_ps(h2p, count1Ap);
-        __m128 maskA = _mm_cmple_ps(h1ApC2, h2pC1A);
-        __m128 sum1AddA = _mm_and_ps(maskA, h1ApC2);
-        __m128 sum2AddA = _mm_andnot_ps(maskA, h2pC1A);
-        sumAp = _mm_add_ps(sumAp, sum1AddA);
-        sumAp = _mm_add_ps(sumAp, sum2AddA);
-
+        sumAp = v_add(sumAp, v_min(v_mul(h1Ap, count2p), v_mul(h2p, count1Ap)));
         // del
-        __m128 diffp = _mm_sub_ps(h1Bp, h2p);
-        __m128 h1BpC2 = _mm_mul_ps(diffp, count2p);
-        __m128 h2pC1B = _mm_mul_ps(h2p, count1Bp);
-        __m128 maskB = _mm_cmple_ps(h1BpC2, h2pC1B);
-        __m128 sum1AddB = _mm_and_ps(maskB, h1BpC2);
-        __m128 sum2AddB = _mm_andnot_ps(maskB, h2pC1B);
-        sumBp = _mm_add_ps(sumBp, sum1AddB);
-        sumBp = _mm_add_ps(sumBp, sum2AddB);
+        sumBp = v_add(sumBp, v_min(v_mul(v_sub(h1Bp, h2p), count2p), v_mul(h2p, count1Bp)));
     }
-    // merge results (quite expensive)
-    float sum1Asse;
-    sumAp = _mm_hadd_ps(sumAp, sumAp);
-    sumAp = _mm_hadd_ps(sumAp, sumAp);
-    _mm_store_ss(&sum1Asse, sumAp);
-
-    float sum1Bsse;
-    sumBp = _mm_hadd_ps(sumBp, sumBp);
-    sumBp = _mm_hadd_ps(sumBp, sumBp);
-    _mm_store_ss(&sum1Bsse, sumBp);
-
-    sumA += sum1Asse;
-    sumB += sum1Bsse;
+    sumA += v_reduce_sum(sumAp);
+    sumB += v_reduce_sum(sumBp);
 #endif
 
     //loop peeling
@@ -42,6 +42,7 @@ the use of this software, even if advised of the possibility of such damage.
 #include "opencv2/ximgproc/segmentation.hpp"
 
 #include <iostream>
+#include <queue>
 
 namespace cv {
     namespace ximgproc {
@@ -692,6 +693,7 @@ namespace cv {
                 public:
                     SelectiveSearchSegmentationImpl() {
                         name_ = "SelectiveSearchSegmentation";
+                        preset = PRESET_NONE;
                     }
 
                     ~SelectiveSearchSegmentationImpl() CV_OVERRIDE {
@@ -731,7 +733,44 @@ namespace cv {
                     std::vector<Ptr<GraphSegmentation> > segmentations;
                     std::vector<Ptr<SelectiveSearchSegmentationStrategy> > strategies;
 
-                    void hierarchicalGrouping(const Mat& img, Ptr<SelectiveSearchSegmentationStrategy>& s, const Mat& img_regions, const Mat_<char>& is_neighbour, const Mat_<int>& sizes, int& nb_segs, const std::vector<Rect>& bounding_rects, std::vector<Region>& regions, int region_id);
+                    // Strategy set installed by a switchTo* function, or PRESET_NONE if strategies were added by the user
+                    enum { PRESET_NONE = -1, PRESET_SINGLE = 0, PRESET_FAST = 1, PRESET_QUALITY = 2 };
+                    int preset;
+
+                    // Append fresh instances of the strategies of a preset
+                    static void createPresetStrategies(int preset_, std::vector<Ptr<SelectiveSearchSegmentationStrategy> >& out);
+
+                    // Segment one image with one graph segmentation and group it with every strategy
+                    void processRun(int run, const std::vector<Ptr<SelectiveSearchSegmentationStrategy> >& run_strategies, std::vector<std::vector<Region> >& run_regions);
+
+                    void hierarchicalGrouping(const Mat& img, const Ptr<SelectiveSearchSegmentationStrategy>& s, const Mat& img_regions, const std::vector<std::pair<int, int> >& neighbour_pairs, const Mat_<int>& sizes, int nb_segs, const std::vector<Rect>& bounding_rects, std::vector<Region>& regions, int region_id);
+
+                    class RunInvoker : public ParallelLoopBody {
+                        public:
+                            RunInvoker(SelectiveSearchSegmentationImpl& impl_, std::vector<std::vector<Region> >& regions_, bool fresh_strategies_)
+                                : impl(impl_), regions(regions_), fresh_strategies(fresh_strategies_) {}
+
+                            void operator()(const Range& range) const CV_OVERRIDE {
+                                const size_t nb_strategies = impl.strategies.size();
+                                for (int run = range.start; run < range.end; run++) {
+                                    std::vector<std::vector<Region> > run_regions(nb_strategies);
+                                    if (fresh_strategies) {
+                                        std::vector<Ptr<SelectiveSearchSegmentationStrategy> > local;
+                                        createPresetStrategies(impl.preset, local);
+                                        impl.processRun(run, local, run_regions);
+                                    } else {
+                                        impl.processRun(run, impl.strategies, run_regions);
+                                    }
+                                    for (size_t s = 0; s < nb_strategies; s++)
+                                        regions[run * nb_strategies + s].swap(run_regions[s]);
+                                }
+                            }
+
+                        private:
+                            SelectiveSearchSegmentationImpl& impl;
+                            std::vector<std::vector<Region> >& regions;
+                            bool fresh_strategies;
+                    };
             };
 
             void SelectiveSearchSegmentationImpl::setBaseImage(InputArray img) {
@@ -756,10 +795,44 @@ namespace cv {
 
             void SelectiveSearchSegmentationImpl::addStrategy(Ptr<SelectiveSearchSegmentationStrategy> s) {
                 strategies.push_back(s);
+                preset = PRESET_NONE;
             }
 
             void SelectiveSearchSegmentationImpl::clearStrategies() {
                 strategies.clear();
+                preset = PRESET_NONE;
+            }
+
+            void SelectiveSearchSegmentationImpl::createPresetStrategies(int preset_, std::vector<Ptr<SelectiveSearchSegmentationStrategy> >& out) {
+
+                Ptr<SelectiveSearchSegmentationStrategyColor> color = createSelectiveSearchSegmentationStrategyColor();
+                Ptr<SelectiveSearchSegmentationStrategyFill> fill = createSelectiveSearchSegmentationStrategyFill();
+                Ptr<SelectiveSearchSegmentationStrategyTexture> texture = createSelectiveSearchSegmentationStrategyTexture();
+                Ptr<SelectiveSearchSegmentationStrategySize> size = createSelectiveSearchSegmentationStrategySize();
+
+                Ptr<SelectiveSearchSegmentationStrategyMultiple> m = createSelectiveSearchSegmentationStrategyMultiple(color, fill, texture, size);
+
+                out.push_back(m);
+
+                if (preset_ == PRESET_SINGLE)
+                    return;
+
+                Ptr<SelectiveSearchSegmentationStrategyFill> fill2 = createSelectiveSearchSegmentationStrategyFill();
+                Ptr<SelectiveSearchSegmentationStrategyTexture> texture2 = createSelectiveSearchSegmentationStrategyTexture();
+                Ptr<SelectiveSearchSegmentationStrategySize> size2 = createSelectiveSearchSegmentationStrategySize();
+
+                Ptr<SelectiveSearchSegmentationStrategyMultiple> m2 = createSelectiveSearchSegmentationStrategyMultiple(fill2, texture2, size2);
+
+                out.push_back(m2);
+
+                if (preset_ == PRESET_FAST)
+                    return;
+
+                Ptr<SelectiveSearchSegmentationStrategyFill> fill3 = createSelectiveSearchSegmentationStrategyFill();
+                out.push_back(fill3);
+
+                Ptr<SelectiveSearchSegmentationStrategySize> size3 = createSelectiveSearchSegmentationStrategySize();
+                out.push_back(size3);
             }
 
             void SelectiveSearchSegmentationImpl::switchToSingleStrategy(int k, float sigma) {
@@ -776,15 +849,8 @@ namespace cv {
                 gs->setSigma(sigma);
                 addGraphSegmentation(gs);
 
-                Ptr<SelectiveSearchSegmentationStrategyColor> color = createSelectiveSearchSegmentationStrategyColor();
-                Ptr<SelectiveSearchSegmentationStrategyFill> fill = createSelectiveSearchSegmentationStrategyFill();
-                Ptr<SelectiveSearchSegmentationStrategyTexture> texture = createSelectiveSearchSegmentationStrategyTexture();
-                Ptr<SelectiveSearchSegmentationStrategySize> size = createSelectiveSearchSegmentationStrategySize();
-
-                Ptr<SelectiveSearchSegmentationStrategyMultiple> m = createSelectiveSearchSegmentationStrategyMultiple(color, fill, texture, size);
-
-                addStrategy(m);
-
+                createPresetStrategies(PRESET_SINGLE, strategies);
+                preset = PRESET_SINGLE;
             }
 
             void SelectiveSearchSegmentationImpl::switchToSelectiveSearchFast(int base_k, int inc_k, float sigma) {
@@ -806,23 +872,8 @@ namespace cv {
                     addGraphSegmentation(gs);
                 }
 
-                Ptr<SelectiveSearchSegmentationStrategyColor> color = createSelectiveSearchSegmentationStrategyColor();
-                Ptr<SelectiveSearchSegmentationStrategyFill> fill = createSelectiveSearchSegmentationStrategyFill();
-                Ptr<SelectiveSearchSegmentationStrategyTexture> texture = createSelectiveSearchSegmentationStrategyTexture();
-                Ptr<SelectiveSearchSegmentationStrategySize> size = createSelectiveSearchSegmentationStrategySize();
-
-                Ptr<SelectiveSearchSegmentationStrategyMultiple> m = createSelectiveSearchSegmentationStrategyMultiple(color, fill, texture, size);
-
-                addStrategy(m);
-
-                Ptr<SelectiveSearchSegmentationStrategyFill> fill2 = createSelectiveSearchSegmentationStrategyFill();
-                Ptr<SelectiveSearchSegmentationStrategyTexture> texture2 = createSelectiveSearchSegmentationStrategyTexture();
-                Ptr<SelectiveSearchSegmentationStrategySize> size2 = createSelectiveSearchSegmentationStrategySize();
-
-                Ptr<SelectiveSearchSegmentationStrategyMultiple> m2 = createSelectiveSearchSegmentationStrategyMultiple(fill2, texture2, size2);
-
-                addStrategy(m2);
-
+                createPresetStrategies(PRESET_FAST, strategies);
+                preset = PRESET_FAST;
             }
 
             void SelectiveSearchSegmentationImpl::switchToSelectiveSearchQuality(int base_k, int inc_k, float sigma) {
@@ -860,131 +911,129 @@ namespace cv {
                     addGraphSegmentation(gs);
                 }
 
-                Ptr<SelectiveSearchSegmentationStrategyColor> color = createSelectiveSearchSegmentationStrategyColor();
-                Ptr<SelectiveSearchSegmentationStrategyFill> fill = createSelectiveSearchSegmentationStrategyFill();
-                Ptr<SelectiveSearchSegmentationStrategyTexture> texture = createSelectiveSearchSegmentationStrategyTexture();
-                Ptr<SelectiveSearchSegmentationStrategySize> size = createSelectiveSearchSegmentationStrategySize();
-
-                Ptr<SelectiveSearchSegmentationStrategyMultiple> m = createSelectiveSearchSegmentationStrategyMultiple(color, fill, texture, size);
-
-                addStrategy(m);
-
-                Ptr<SelectiveSearchSegmentationStrategyFill> fill2 = createSelectiveSearchSegmentationStrategyFill();
-                Ptr<SelectiveSearchSegmentationStrategyTexture> texture2 = createSelectiveSearchSegmentationStrategyTexture();
-                Ptr<SelectiveSearchSegmentationStrategySize> size2 = createSelectiveSearchSegmentationStrategySize();
-
-                Ptr<SelectiveSearchSegmentationStrategyMultiple> m2 = createSelectiveSearchSegmentationStrategyMultiple(fill2, texture2, size2);
-
-                addStrategy(m2);
-
-                Ptr<SelectiveSearchSegmentationStrategyFill> fill3 = createSelectiveSearchSegmentationStrategyFill();
-                addStrategy(fill3);
-
-                Ptr<SelectiveSearchSegmentationStrategySize> size3 = createSelectiveSearchSegmentationStrategySize();
-                addStrategy(size3);
+                createPresetStrategies(PRESET_QUALITY, strategies);
+                preset = PRESET_QUALITY;
             }
 
             void SelectiveSearchSegmentationImpl::process(std::vector<Rect>& rects) {
 
-                std::vector<Region> all_regions;
+                const int nb_runs = (int)(images.size() * segmentations.size());
+                const size_t nb_strategies = strategies.size();
 
-                int image_id = 0;
+                // Regions of every run and strategy, in the order runs and strategies were added
+                std::vector<std::vector<Region> > run_regions(nb_runs * nb_strategies);
 
-                for(std::vector<Mat>::iterator image = images.begin(); image != images.end(); ++image) {
-                    for(std::vector<Ptr<GraphSegmentation> >::iterator gs = segmentations.begin(); gs != segmentations.end(); ++gs) {
+                if (preset != PRESET_NONE) {
+                    parallel_for_(Range(0, nb_runs), RunInvoker(*this, run_regions, true));
+                } else {
+                    // User strategies are shared between runs
+                    RunInvoker(*this, run_regions, false)(Range(0, nb_runs));
+                }
+
+                std::vector<Region> all_regions;
 
-                        Mat img_regions;
-                        Mat_<char> is_neighbour;
-                        Mat_<int> sizes;
+                for (size_t i = 0; i < run_regions.size(); i++) {
+                    // Compute regions' rank
+                    for(std::vector<Region>::iterator region = run_regions[i].begin(); region != run_regions[i].end(); ++region) {
+                        // Note: this is inverted from the paper, but we keep the lover region first so it's works
+                        (*region).rank = ((double) rand() / (RAND_MAX)) * ((*region).level);
+                        all_regions.push_back(*region);
+                    }
+                }
 
-                        // Compute initial segmentation
-                        (*gs)->processImage(*image, img_regions);
+                std::sort(all_regions.begin(), all_regions.end());
 
-                        // Get number of regions
-                        double min, max;
-                        minMaxLoc(img_regions, &min, &max);
-                        int nb_segs = (int)max + 1;
+                std::map<Rect, char, rectComparator> processed_rect;
 
-                        // Compute bouding rects and neighbours
-                        std::vector<Rect> bounding_rects;
-                        bounding_rects.resize(nb_segs);
+                rects.clear();
 
-                        std::vector<std::vector<cv::Point> > points;
+                // Remove duplicate in rect list
+                for(std::vector<Region>::iterator region = all_regions.begin(); region != all_regions.end(); ++region) {
+                    if (processed_rect.find((*region).bounding_box) == processed_rect.end()) {
+                        processed_rect[(*region).bounding_box] = true;
+                        rects.push_back((*region).bounding_box);
+                    }
+                }
 
-                        points.resize(nb_segs);
+            }
 
-                        is_neighbour = Mat::zeros(nb_segs, nb_segs, CV_8UC1);
-                        sizes = Mat::zeros(nb_segs, 1, CV_32SC1);
+            void SelectiveSearchSegmentationImpl::processRun(int run, const std::vector<Ptr<SelectiveSearchSegmentationStrategy> >& run_strategies, std::vector<std::vector<Region> >& out_regions) {
 
-                        const int* previous_p = NULL;
+                const Mat& image = images[run / segmentations.size()];
+                const Ptr<GraphSegmentation>& gs = segmentations[run % segmentations.size()];
 
-                        for (int i = 0; i < (int)img_regions.rows; i++) {
-                            const int* p = img_regions.ptr<int>(i);
+                Mat img_regions;
 
-                            for (int j = 0; j < (int)img_regions.cols; j++) {
+                // Compute initial segmentation
+                gs->processImage(image, img_regions);
 
-                                points[p[j]].push_back(cv::Point(j, i));
-                                sizes.at<int>(p[j], 0) = sizes.at<int>(p[j], 0) + 1;
+                // Get number of regions
+                double min, max;
+                minMaxLoc(img_regions, &min, &max);
+                int nb_segs = (int)max + 1;
 
-                                if (i > 0 && j > 0) {
+                // Compute bouding rects, sizes and neighbours
+                std::vector<Point> tl(nb_segs, Point(INT_MAX, INT_MAX)), br(nb_segs, Point(INT_MIN, INT_MIN));
+                Mat_<int> sizes = Mat::zeros(nb_segs, 1, CV_32SC1);
+                std::vector<std::pair<int, int> > neighbour_pairs;
 
-                                    is_neighbour.at<char>(p[j], p[j - 1]) = 1;
-                                    is_neighbour.at<char>(p[j], previous_p[j]) = 1;
-                                    is_neighbour.at<char>(p[j], previous_p[j - 1]) = 1;
+                const int* previous_p = NULL;
 
-                                    is_neighbour.at<char>(p[j - 1], p[j]) = 1;
-                                    is_neighbour.at<char>(previous_p[j], p[j]) = 1;
-                                    is_neighbour.at<char>(previous_p[j - 1], p[j]) = 1;
-                                }
-                            }
-                            previous_p = p;
-                        }
+                for (int i = 0; i < (int)img_regions.rows; i++) {
+                    const int* p = img_regions.ptr<int>(i);
 
-                        for(int seg = 0; seg < nb_segs; seg++) {
-                            bounding_rects[seg] = cv::boundingRect(points[seg]);
-                        }
+                    for (int j = 0; j < (int)img_regions.cols; j++) {
 
-                        for(std::vector<Ptr<SelectiveSearchSegmentationStrategy> >::iterator strategy = strategies.begin(); strategy != strategies.end(); ++strategy) {
-                            std::vector<Region> regions;
-                            hierarchicalGrouping(*image, *strategy, img_regions, is_neighbour, sizes, nb_segs, bounding_rects, regions, image_id);
+                        const int r = p[j];
+                        tl[r].x = std::min(tl[r].x, j);
+                        tl[r].y = std::min(tl[r].y, i);
+                        br[r].x = std::max(br[r].x, j);
+                        br[r].y = std::max(br[r].y, i);
+                        sizes(r, 0)++;
 
-                            for(std::vector<Region>::iterator region = regions.begin(); region != regions.end(); ++region) {
-                                all_regions.push_back(*region);
+                        if (i > 0 && j > 0) {
+                            const int others[3] = { p[j - 1], previous_p[j], previous_p[j - 1] };
+                            for (int k = 0; k < 3; k++) {
+                                if (others[k] != r)
+                                    neighbour_pairs.push_back(std::make_pair(std::min(r, others[k]), std::max(r, others[k])));
                             }
                         }
-
-                        image_id++;
                     }
+                    previous_p = p;
                 }
 
-                std::sort(all_regions.begin(), all_regions.end());
-
-                std::map<Rect, char, rectComparator> processed_rect;
-
-                rects.clear();
+                std::sort(neighbour_pairs.begin(), neighbour_pairs.end());
+                neighbour_pairs.erase(std::unique(neighbour_pairs.begin(), neighbour_pairs.end()), neighbour_pairs.end());
 
-                // Remove duplicate in rect list
-                for(std::vector<Region>::iterator region = all_regions.begin(); region != all_regions.end(); ++region) {
-                    if (processed_rect.find((*region).bounding_box) == processed_rect.end()) {
-                        processed_rect[(*region).bounding_box] = true;
-                        rects.push_back((*region).bounding_box);
-                    }
+                std::vector<Rect> bounding_rects(nb_segs);
+                for(int seg = 0; seg < nb_segs; seg++) {
+                    bounding_rects[seg] = Rect(tl[seg], br[seg] + Point(1, 1));
                 }
 
+                for (size_t s = 0; s < run_strategies.size(); s++) {
+                    hierarchicalGrouping(image, run_strategies[s], img_regions, neighbour_pairs, sizes, nb_segs, bounding_rects, out_regions[s], run);
+                }
             }
 
-            void SelectiveSearchSegmentationImpl::hierarchicalGrouping(const Mat& img, Ptr<SelectiveSearchSegmentationStrategy>& s, const Mat& img_regions, const Mat_<char>& is_neighbour, const Mat_<int>& sizes_, int& nb_segs, const std::vector<Rect>& bounding_rects, std::vector<Region>& regions, int image_id) {
+            void SelectiveSearchSegmentationImpl::hierarchicalGrouping(const Mat& img, const Ptr<SelectiveSearchSegmentationStrategy>& s, const Mat& img_regions, const std::vector<std::pair<int, int> >& neighbour_pairs, const Mat_<int>& sizes_, int nb_segs, const std::vector<Rect>& bounding_rects, std::vector<Region>& regions, int image_id) {
 
                 Mat sizes = sizes_.clone();
 
-                std::vector<Neighbour> similarities;
+                // Candidate merges, best first. Entries referring to a region that has been merged
+                // since they were pushed are dropped when they reach the top.
+                std::priority_queue<Neighbour> similarities;
+
+                // Neighbours of each region, merged regions are removed lazily
+                std::vector<std::vector<int> > neighbours(nb_segs);
+                neighbours.reserve(2 * nb_segs);
+
                 regions.clear();
+                regions.reserve(2 * nb_segs);
 
                 /////////////////////////////////////////
 
                 s->setImage(img, img_regions, sizes, image_id);
 
-                // Compute initial similarities
                 for (int i = 0; i < nb_segs; i++) {
                     Region r;
 
@@ -994,29 +1043,29 @@ namespace cv {
                     r.bounding_box = bounding_rects[i];
 
                     regions.push_back(r);
+                }
 
-                    for (int j = i + 1; j < nb_segs; j++) {
-                        if (is_neighbour.at<char>(i, j)) {
-                            Neighbour n;
-                            n.from = i;
-                            n.to = j;
-                            n.similarity = s->get(i, j);
-
-                            similarities.push_back(n);
-                        }
-                    }
+                // Compute initial similarities
+                for (size_t i = 0; i < neighbour_pairs.size(); i++) {
+                    Neighbour n;
+                    n.from = neighbour_pairs[i].first;
+                    n.to = neighbour_pairs[i].second;
+                    n.similarity = s->get(n.from, n.to);
+
+                    similarities.push(n);
+                    neighbours[n.from].push_back(n.to);
+                    neighbours[n.to].push_back(n.from);
                 }
 
-                while(similarities.size() > 0) {
+                std::vector<int> local_neighbours;
 
-                    std::sort(similarities.begin(), similarities.end());
+                while(!similarities.empty()) {
 
-                    // for(std::vector<Neighbour>::iterator similarity = similarities.begin(); similarity != similarities.end(); ++similarity) {
-                    //     std::cout << *similarity << std::endl;
-                    // }
+                    Neighbour p = similarities.top();
+                    similarities.pop();
 
-                    Neighbour p = similarities.back();
-                    similarities.pop_back();
+                    if (regions[p.from].merged_to != -1 || regions[p.to].merged_to != -1)
+                        continue;
 
                     Region region_from = regions[p.from];
                     Region region_to = regions[p.to];
@@ -1029,8 +1078,9 @@ namespace cv {
 
                     regions.push_back(new_r);
 
-                    regions[p.from].merged_to = (int)regions.size() - 1;
-                    regions[p.to].merged_to = (int)regions.size() - 1;
+                    const int new_index = (int)regions.size() - 1;
+                    regions[p.from].merged_to = new_index;
+                    regions[p.to].merged_to = new_index;
 
                     // Merge
                     s->merge(region_from.id, region_to.id);
@@ -1039,53 +1089,40 @@ namespace cv {
                     sizes.at<int>(region_from.id, 0) += sizes.at<int>(region_to.id, 0);
                     sizes.at<int>(region_to.id, 0) = sizes.at<int>(region_from.id, 0);
 
-                    std::vector<int> local_neighbours;
-
-                    for(std::vector<Neighbour>::iterator similarity = similarities.begin(); similarity != similarities.end();) {
-                        if ((*similarity).from == p.from || (*similarity).to == p.from || (*similarity).from == p.to || (*similarity).to == p.to) {
-                            int from = 0;
-
-                            if ((*similarity).from == p.from || (*similarity).from == p.to) {
-                                from = (*similarity).to;
-                            } else {
-                                from = (*similarity).from;
-                            }
-
-                            bool already_neighboor = false;
-
-                            for(std::vector<int>::iterator local_neighbour = local_neighbours.begin(); local_neighbour != local_neighbours.end(); local_neighbour++) {
-                                if (*local_neighbour == from) {
-                                    already_neighboor = true;
-                                }
-                            }
-
-                            if (!already_neighboor) {
-                                local_neighbours.push_back(from);
-                            }
-
-                            similarity = similarities.erase(similarity);
-                        } else {
-                            similarity++;
+                    // The new region neighbours all the regions still alive around the merged ones
+                    local_neighbours.clear();
+                    for (int k = 0; k < 2; k++) {
+                        std::vector<int>& merged = neighbours[k == 0 ? p.from : p.to];
+                        for (size_t i = 0; i < merged.size(); i++) {
+                            if (regions[merged[i]].merged_to == -1)
+                                local_neighbours.push_back(merged[i]);
                         }
+                        std::vector<int>().swap(merged);
                     }
+                    std::sort(local_neighbours.begin(), local_neighbours.end());
+                    local_neighbours.erase(std::unique(local_neighbours.begin(), local_neighbours.end()), local_neighbours.end());
+
+                    neighbours.push_back(local_neighbours);
 
                     for(std::vector<int>::iterator local_neighbour = local_neighbours.begin(); local_neighbour != local_neighbours.end(); local_neighbour++) {
 
+                        std::vector<int>& other = neighbours[*local_neighbour];
+                        size_t alive = 0;
+                        for (size_t i = 0; i < other.size(); i++) {
+                            if (regions[other[i]].merged_to == -1)
+                                other[alive++] = other[i];
+                        }
+                        other.resize(alive);
+                        other.push_back(new_index);
+
                         Neighbour n;
-                        n.from = (int)regions.size() - 1;
+                        n.from = new_index;
                         n.to = *local_neighbour;
                         n.similarity = s->get(regions[n.from].id, regions[n.to].id);
 
-                        similarities.push_back(n);
+                        similarities.push(n);
                     }
                 }
-
-                // Compute regions' rank
-                for(std::vector<Region>::iterator region = regions.begin(); region != regions.end(); ++region) {
-                    // Note: this is inverted from the paper, but we keep the lover region first so it's works
-                    (*region).rank = ((double) rand() / (RAND_MAX)) * ((*region).level);
-                }
-
             }
 
             Ptr<SelectiveSearchSegmentation> createSelectiveSearchSegmentation() {
@@ -36,6 +36,7 @@
 
 #include "precomp.hpp"
 #include <opencv2/imgproc.hpp>
+#include "opencv2/core/hal/intrin.hpp"
 
 using namespace std;
 using namespace cv;
@@ -214,9 +215,9 @@ void int2D_release(int **p)
  * Function: updateBCB
  * Description: maintain the necklace table of BCB
  ***************************************************************/
-inline void updateBCB(int &num,int *f,int *b,int i,int v)
+inline void updateBCB(int &num,int *f,int *b,int i,int v,int &nonEmpty)
 {
-    static int p1,p2;
+    int p1,p2;
 
     if(i)
     {
@@ -227,12 +228,14 @@ inline void updateBCB(int &num,int *f,int *b,int i,int v)
             f[i]=p2;
             b[p2]=i;
             b[i]=0;
+            nonEmpty++;
         }
         else if(!(num+v))
         {// cell is becoming empty
             p1=b[i],p2=f[i];
             f[p1]=p2;
             b[p2]=p1;
+            nonEmpty--;
         }
     }
 
@@ -240,11 +243,53 @@ inline void updateBCB(int &num,int *f,int *b,int i,int v)
     num += v;
 }
 
+/***************************************************************
+ * Function: dotBCB
+ * Description: balance of the BCB against the weights of the current feature index,
+ *                evaluated densely over all cells
+ ***************************************************************/
+inline float dotBCB(const int *BCB, const float *w, int nF)
+{
+    int i = 0;
+    float s = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int vl = VTraits<v_float32>::vlanes();
+    v_float32 acc = vx_setzero_f32();
+    for (; i <= nF - vl; i += vl)
+        acc = v_fma(v_cvt_f32(vx_load(BCB + i)), vx_load(w + i), acc);
+    s = v_reduce_sum(acc);
+#endif
+    for (; i < nF; i++)
+        s += BCB[i]*w[i];
+    return s;
+}
+
+/***************************************************************
+ * Function: featureWeight
+ * Description: weight between two scalar feature values
+ ***************************************************************/
+inline float featureWeight(float a, float b, float nSigmaI, float divider, int weightType)
+{
+    float diff = fabs(a-b);
+    switch(weightType)
+    {
+        case WMF_EXP: return exp(-(diff*diff)*divider);
+        case WMF_IV1: return 1.0f/(diff+nSigmaI);
+        case WMF_IV2: return 1.0f / (diff*diff+nSigmaI*nSigmaI);
+        case WMF_COS: return 1.0f;
+        case WMF_JAC: return (float)(min(a,b)*1.0/max(a,b));
+        case WMF_OFF: return 1.0f;
+        default: return exp(-(diff*diff)*divider);
+    }
+}
+
 /***************************************************************
  * Function: featureIndexing
- * Description: convert uchar feature image "F" to CV_32SC1 type.
+ * Description: convert feature image "F" to CV_32SC1 type.
  *                If F is 3-channel, perform k-means clustering
- *                If F is 1-channel, only perform type-casting
+ *                If F is 1-channel uchar, only perform type-casting
+ *                If F is 1-channel float, perform adaptive quantization and weight
+ *                the clusters by their representative values
  ***************************************************************/
 void featureIndexing(Mat &F, float **&wMap, int &nF, float sigmaI, int weightType){
     // Configuration and Declaration
@@ -253,8 +298,30 @@ void featureIndexing(Mat &F, float **&wMap, int &nF, float sigmaI, int weightTyp
     int alls = cols * rows;
     int KmeansAttempts=1;
 
+    /* For 1 channel feature image (float)*/
+    if(F.channels() == 1 && F.depth() == CV_32F)
+    {
+        // Quantize to at most nF clusters whose error bound adapts to the value distribution,
+        // then weight the clusters by their medians rather than by their indexes.
+        Mat FCont = F.isContinuous() ? F : F.clone();
+        std::vector<float> mapping(nF);
+        from32FTo32S(FCont, FNew, nF, &mapping[0]);
+
+        double maxIndex;
+        minMaxLoc(FNew, NULL, &maxIndex);
+        nF = (int)maxIndex + 1;
+
+        wMap = float2D(nF,nF);
+        float nSigmaI = sigmaI;
+        float divider = (1.0f/(2*nSigmaI*nSigmaI));
+
+        for(int i=0;i<nF;i++)
+            for(int j=i;j<nF;j++)
+                wMap[i][j] = wMap[j][i] = featureWeight(mapping[i], mapping[j], nSigmaI, divider, weightType);
+    }
+
     /* For 1 channel feature image (uchar)*/
-    if(F.channels() == 1)
+    else if(F.channels() == 1)
     {
         nF = 256;
 
@@ -267,26 +334,8 @@ void featureIndexing(Mat &F, float **&wMap, int &nF, float sigmaI, int weightTyp
         float divider = (1.0f/(2*nSigmaI*nSigmaI));
 
         for(int i=0;i<nF;i++)
-        {
             for(int j=i;j<nF;j++)
-            {
-                float diff = fabs((float)(i-j));
-                float val;
-
-                switch(weightType)
-                {
-                    case WMF_EXP: val = exp(-(diff*diff)*divider); break;
-                    case WMF_IV1: val = 1.0f/(diff+nSigmaI); break;
-                    case WMF_IV2: val = 1.0f / (diff*diff+nSigmaI*nSigmaI); break;
-                    case WMF_COS: val = 1.0f; break;
-                    case WMF_JAC: val = (float)(min(i,j)*1.0/max(i,j)); break;
-                    case WMF_OFF: val = 1.0f; break;
-                    default: val = exp(-(diff*diff)*divider);
-                }
-
-                wMap[i][j] = wMap[j][i] = val;
-            }
-        }
+                wMap[i][j] = wMap[j][i] = featureWeight((float)i, (float)j, nSigmaI, divider, weightType);
     }
 
     /* For 3 channel feature image (uchar)*/
@@ -409,41 +458,130 @@ void featureIndexing(Mat &F, float **&wMap, int &nF, float sigmaI, int weightTyp
     F = FNew;
 }
 
-Mat filterCore(Mat &I, Mat &F, float **wMap, int r=20, int nF=256, int nI=256, Mat mask=Mat())
+/***************************************************************
+ * Class: WMFTileInvoker
+ * Description: joint-histogram filtering of a set of tiles. Every column of a tile is scanned
+ *                top-down with its own joint-histogram and BCB, which are initialized from the
+ *                r rows above the tile (halo), so tiles are independent of each other.
+ ***************************************************************/
+class WMFTileInvoker : public ParallelLoopBody
 {
-    // Check validation
-    assert(I.depth() == CV_32S && I.channels()==1);//input image: 32SC1
-    assert(F.depth() == CV_32S && F.channels()==1);//feature image: 32SC1
+public:
+    WMFTileInvoker(const Mat &_I, const Mat &_F, const Mat &_mask, float **_wMap, int _r, int _nF, int _nI,
+                   int _tileW, int _tileH, Mat &_outImg)
+        : I(_I), F(_F), mask(_mask), wMap(_wMap), r(_r), nF(_nF), nI(_nI), tileW(_tileW), tileH(_tileH),
+          tilesX((_I.cols + _tileW - 1) / _tileW), outImg(_outImg)
+    {}
+
+    void operator()(const Range &range) const CV_OVERRIDE
+    {
+        // Allocate memory for joint-histogram and BCB
+        int **H = int2D(nI,nF);
+        int *BCB = new int[nF];
+        memset(H[0], 0, sizeof(int)*nF*nI);
 
-    // Configuration and declaration
-    int rows = I.rows, cols = I.cols;
-    Mat outImg = I.clone();
+        // Allocate links for necklace table
+        int **Hf = int2D(nI,nF);//forward link
+        int **Hb = int2D(nI,nF);//backward link
+        int *BCBf = new int[nF];//forward link
+        int *BCBb = new int[nF];//backward link
 
-    // Handle Mask
-    if(mask.empty())
+        for(int t=range.start; t<range.end; t++)
+        {
+            int x0 = (t % tilesX) * tileW, x1 = min(I.cols, x0 + tileW);
+            int y0 = (t / tilesX) * tileH, y1 = min(I.rows, y0 + tileH);
+            for(int x=x0; x<x1; x++)
+                filterColumn(x, y0, y1, H, Hf, Hb, BCB, BCBf, BCBb);
+        }
+
+        // Deallocate the memory
+        delete []BCB;
+        delete []BCBf;
+        delete []BCBb;
+        int2D_release(H);
+        int2D_release(Hf);
+        int2D_release(Hb);
+    }
+
+private:
+    /* Add or remove the masked pixels of row "rownum" in columns [downX, upX] */
+    void addRow(int rownum, int downX, int upX, int **H, int **Hf, int **Hb,
+                int *BCB, int *BCBf, int *BCBb, int &nonEmpty, int medianVal) const
     {
-        mask = Mat(I.size(),CV_8U);
-        mask = Scalar(1);
+        const int *inputImgPtr = I.ptr<int>(rownum);
+        const int *guideImgPtr = F.ptr<int>(rownum);
+        const uchar *maskPtr = mask.ptr<uchar>(rownum);
+
+        for(int j=downX;j<=upX;j++)
+        {
+            if(!maskPtr[j])continue;
+
+            int fval = inputImgPtr[j];
+            int *curHist = H[fval];
+            int gval = guideImgPtr[j];
+
+            // Maintain necklace table of joint-histogram
+            if(!curHist[gval] && gval)
+            {
+                int *curHf = Hf[fval];
+                int *curHb = Hb[fval];
+
+                int p1=0,p2=curHf[0];
+                curHf[gval]=p2;
+                curHb[gval]=p1;
+                curHf[p1]=curHb[p2]=gval;
+            }
+
+            curHist[gval]++;
+
+            // Maintain necklace table of BCB
+            updateBCB(BCB[gval],BCBf,BCBb,gval,((fval <= medianVal)<<1)-1,nonEmpty);
+        }
     }
 
-    // Allocate memory for joint-histogram and BCB
-    int **H = int2D(nI,nF);
-    int *BCB = new int[nF];
+    void removeRow(int rownum, int downX, int upX, int **H, int **Hf, int **Hb,
+                   int *BCB, int *BCBf, int *BCBb, int &nonEmpty, int medianVal) const
+    {
+        const int *inputImgPtr = I.ptr<int>(rownum);
+        const int *guideImgPtr = F.ptr<int>(rownum);
+        const uchar *maskPtr = mask.ptr<uchar>(rownum);
+
+        for(int j=downX;j<=upX;j++)
+        {
+            if(!maskPtr[j])continue;
+
+            int fval = inputImgPtr[j];
+            int *curHist = H[fval];
+            int gval = guideImgPtr[j];
 
-    // Allocate links for necklace table
-    int **Hf = int2D(nI,nF);//forward link
-    int **Hb = int2D(nI,nF);//backward link
-    int *BCBf = new int[nF];//forward link
-    int *BCBb = new int[nF];//backward link
+            curHist[gval]--;
+
+            // Maintain necklace table of joint-histogram
+            if(!curHist[gval] && gval)
+            {
+                int *curHf = Hf[fval];
+                int *curHb = Hb[fval];
+
+                int p1=curHb[gval],p2=curHf[gval];
+                curHf[p1]=p2;
+                curHb[p2]=p1;
+            }
 
-    // Column Scanning
-    for(int x=0;x<cols;x++)
+            // Maintain necklace table of BCB
+            updateBCB(BCB[gval],BCBf,BCBb,gval,-((fval <= medianVal)<<1)+1,nonEmpty);
+        }
+    }
+
+    void filterColumn(int x, int y0, int y1, int **H, int **Hf, int **Hb,
+                      int *BCB, int *BCBf, int *BCBb) const
     {
-        // Reset histogram and BCB for each column
+        const int rows = I.rows, cols = I.cols;
+
+        // Reset histogram and BCB for each column, H is left all-zero by the previous column
         memset(BCB, 0, sizeof(int)*nF);
-        memset(H[0], 0, sizeof(int)*nF*nI);
         for(int i=0;i<nI;i++)Hf[i][0]=Hb[i][0]=0;
         BCBf[0]=BCBb[0]=0;
+        int nonEmpty = 0;
 
         // Reset cut-point
         int medianVal = -1;
@@ -452,50 +590,26 @@ Mat filterCore(Mat &I, Mat &F, float **wMap, int r=20, int nF=256, int nI=256, M
         int downX = max(0,x-r);
         int upX = min(cols-1,x+r);
 
-        // Initialize joint-histogram and BCB for the first window
-        int upY = min(rows-1,r);
-        for(int i=0;i<=upY;i++)
-        {
-            int *IPtr = I.ptr<int>(i);
-            int *FPtr = F.ptr<int>(i);
-            uchar *maskPtr = mask.ptr<uchar>(i);
-
-            for(int j=downX;j<=upX;j++)
-            {
-                if(!maskPtr[j])continue;
-
-                int fval = IPtr[j];
-                int *curHist = H[fval];
-                int gval = FPtr[j];
-
-                // Maintain necklace table of joint-histogram
-                if(!curHist[gval] && gval)
-                {
-                    int *curHf = Hf[fval];
-                    int *curHb = Hb[fval];
-
-                    int p1=0,p2=curHf[0];
-                    curHf[p1]=gval;
-                    curHf[gval]=p2;
-                    curHb[p2]=gval;
-                    curHb[gval]=p1;
-                }
+        // Initialize joint-histogram and BCB for the first window,
+        // with the cut-point below every value all the pixels count as -1
+        int upY = min(rows-1,y0+r);
+        for(int i=max(0,y0-r);i<=upY;i++)
+            addRow(i, downX, upX, H, Hf, Hb, BCB, BCBf, BCBb, nonEmpty, medianVal);
 
-                curHist[gval]++;
-                // Maintain necklace table of BCB
-                updateBCB(BCB[gval],BCBf,BCBb,gval,-1);
-            }
-        }
-
-        for(int y=0;y<rows;y++)
+        for(int y=y0;y<y1;y++)
         {
             // Find weighted median with help of BCB and joint-histogram
             float balanceWeight = 0;
             int curIndex = F.ptr<int>(y,x)[0];
-            float *fPtr = wMap[curIndex];
+            const float *fPtr = wMap[curIndex];
             int &curMedianVal = medianVal;
 
-            // Compute current balance
+            // Compute current balance, walking the necklace only pays off while it is sparse
+            if(nonEmpty*4 >= nF)
+            {
+                balanceWeight = dotBCB(BCB, fPtr, nF);
+            }
+            else
             {
                 int i=0;
                 do
@@ -521,7 +635,7 @@ Mat filterCore(Mat &I, Mat &F, float **wMap, int r=20, int nF=256, int nI=256, M
                         curWeight += (nextHist[i]<<1)*fPtr[i];
 
                         // Update BCB and maintain the necklace table of BCB
-                        updateBCB(BCB[i],BCBf,BCBb,i,-(nextHist[i]<<1));
+                        updateBCB(BCB[i],BCBf,BCBb,i,-(nextHist[i]<<1),nonEmpty);
 
                         i=nextHf[i];
                     }while(i);
@@ -545,7 +659,7 @@ Mat filterCore(Mat &I, Mat &F, float **wMap, int r=20, int nF=256, int nI=256, M
                         curWeight += (nextHist[i]<<1)*fPtr[i];
 
                         // Update BCB and maintain the necklace table of BCB
-                        updateBCB(BCB[i],BCBf,BCBb,i,nextHist[i]<<1);
+                        updateBCB(BCB[i],BCBf,BCBb,i,nextHist[i]<<1,nonEmpty);
 
                         i=nextHf[i];
                     }while(i);
@@ -563,90 +677,68 @@ Mat filterCore(Mat &I, Mat &F, float **wMap, int r=20, int nF=256, int nI=256, M
             }
 
             // Update joint-histogram and BCB when local window is shifted.
-            int fval,gval,*curHist;
-
             // Add entering pixels into joint-histogram and BCB
             int rownum = y + r + 1;
             if(rownum < rows)
-            {
-                    int *inputImgPtr = I.ptr<int>(rownum);
-                    int *guideImgPtr = F.ptr<int>(rownum);
-                    uchar *maskPtr = mask.ptr<uchar>(rownum);
-
-                    for(int j=downX;j<=upX;j++)
-                    {
-                        if(!maskPtr[j])continue;
-
-                        fval = inputImgPtr[j];
-                        curHist = H[fval];
-                        gval = guideImgPtr[j];
-
-                        // Maintain necklace table of joint-histogram
-                        if(!curHist[gval] && gval)
-                        {
-                            int *curHf = Hf[fval];
-                            int *curHb = Hb[fval];
-
-                            int p1=0,p2=curHf[0];
-                            curHf[gval]=p2;
-                            curHb[gval]=p1;
-                            curHf[p1]=curHb[p2]=gval;
-                        }
+                addRow(rownum, downX, upX, H, Hf, Hb, BCB, BCBf, BCBb, nonEmpty, medianVal);
 
-                        curHist[gval]++;
-
-                        // Maintain necklace table of BCB
-                        updateBCB(BCB[gval],BCBf,BCBb,gval,((fval <= medianVal)<<1)-1);
-                    }
-                }
-
-
-                // Delete leaving pixels into joint-histogram and BCB
-                rownum = y - r;
-                if(rownum >= 0)
-                {
-                    int *inputImgPtr = I.ptr<int>(rownum);
-                    int *guideImgPtr = F.ptr<int>(rownum);
-                    uchar *maskPtr = mask.ptr<uchar>(rownum);
-
-                    for(int j=downX;j<=upX;j++)
-                    {
-                        if(!maskPtr[j])continue;
-
-                        fval = inputImgPtr[j];
-                        curHist = H[fval];
-                        gval = guideImgPtr[j];
+            // Delete leaving pixels into joint-histogram and BCB
+            rownum = y - r;
+            if(rownum >= 0)
+                removeRow(rownum, downX, upX, H, Hf, Hb, BCB, BCBf, BCBb, nonEmpty, medianVal);
+        }
 
-                        curHist[gval]--;
+        // Clear the cells of the last window, which is much cheaper than clearing H as a whole
+        for(int i=max(0,y1-r);i<=min(rows-1,y1+r);i++)
+        {
+            const int *inputImgPtr = I.ptr<int>(i);
+            const int *guideImgPtr = F.ptr<int>(i);
+            for(int j=downX;j<=upX;j++)
+                H[inputImgPtr[j]][guideImgPtr[j]] = 0;
+        }
+    }
 
-                        // Maintain necklace table of joint-histogram
-                        if(!curHist[gval] && gval)
-                        {
-                            int *curHf = Hf[fval];
-                            int *curHb = Hb[fval];
+    const Mat &I;
+    const Mat &F;
+    const Mat &mask;
+    float **wMap;
+    int r, nF, nI;
+    int tileW, tileH, tilesX;
+    Mat &outImg;
+};
 
-                            int p1=curHb[gval],p2=curHf[gval];
-                            curHf[p1]=p2;
-                            curHb[p2]=p1;
-                        }
+Mat filterCore(Mat &I, Mat &F, float **wMap, int r=20, int nF=256, int nI=256, Mat mask=Mat())
+{
+    // Check validation
+    CV_Assert(I.depth() == CV_32S && I.channels()==1);//input image: 32SC1
+    CV_Assert(F.depth() == CV_32S && F.channels()==1);//feature image: 32SC1
 
-                        // Maintain necklace table of BCB
-                        updateBCB(BCB[gval],BCBf,BCBb,gval,-((fval <= medianVal)<<1)+1);
-                    }
-                }
-        }
-    }
+    // Configuration and declaration
+    int rows = I.rows, cols = I.cols;
+    Mat outImg = I.clone();
 
-    // Deallocate the memory
+    // Handle Mask
+    if(mask.empty())
     {
-        delete []BCB;
-        delete []BCBf;
-        delete []BCBb;
-        int2D_release(H);
-        int2D_release(Hf);
-        int2D_release(Hb);
+        mask = Mat(I.size(),CV_8U);
+        mask = Scalar(1);
     }
 
+    // Columns are filtered independently. Narrow column tiles are enough to keep all threads
+    // busy on most images, rows are split into bands with an r-row halo only when they are not.
+    // A band restarts the cut-point search, which may resolve ties differently, so the layout
+    // only depends on the image size and r to keep the result independent of the thread count.
+    const int minTiles = 64;
+    const int tileW = 16;
+    const int tilesX = (cols + tileW - 1) / tileW;
+    int bands = 1;
+    if(tilesX < minTiles)
+        bands = max(1, min((minTiles + tilesX - 1) / tilesX, rows / max(8*r, 32)));
+    const int tileH = (rows + bands - 1) / bands;
+
+    parallel_for_(Range(0, tilesX*bands),
+                  WMFTileInvoker(I, F, mask, wMap, r, nF, nI, tileW, tileH, outImg));
+
     // end of the function
     return outImg;
 }
@@ -673,7 +765,8 @@ void weightedMedianFilter(InputArray joint, InputArray src, OutputArray dst, int
     }
 
     CV_Assert(I.depth() == CV_32F || I.depth() == CV_8U);
-    CV_Assert(F.depth() == CV_8U && (F.channels() == 1 || F.channels() == 3));
+    CV_Assert((F.depth() == CV_8U && (F.channels() == 1 || F.channels() == 3)) ||
+              (F.depth() == CV_32F && F.channels() == 1));
 
     dst.create(src.size(), src.type());
     Mat D = dst.getMat();
@@ -707,7 +800,8 @@ void weightedMedianFilter(InputArray joint, InputArray src, OutputArray dst, int
     //Preprocess F
     //OUTPUT OF THIS STEP: F(new), wMap
     //If "F" is 3-channel image, "clustering feature image" is done in featureIndexing.
-    //If "F" is 1-channel image, featureIndexing only does a type-casting on "F".
+    //If "F" is 1-channel 8-bit image, featureIndexing only does a type-casting on "F".
+    //If "F" is 1-channel floating point image, "adaptive quantization" is done as for "I".
     //The output "F" is CV_32S type, containing indexes of feature values.
     //"wMap" is a 2D array that defines the distance between each pair of feature indexes.
     // wMap[i][j] is the weight between feature index "i" and "j".
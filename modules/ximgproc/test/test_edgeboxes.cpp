@@ -45,4 +45,39 @@ TEST(ximgproc_Edgeboxes, regression)
     EXPECT_EQ(expectedProposal.width, boxes[0].width);
 }
 
+TEST(ximgproc_Edgeboxes, threads_consistency)
+{
+    cv::String testImagePath = cvtest::TS::ptr()->get_data_path() + "cv/ximgproc/" + "pascal_voc_bird.png";
+    Mat testImg = imread(testImagePath);
+    ASSERT_FALSE(testImg.empty()) << "Could not load input image " << testImagePath;
+    cvtColor(testImg, testImg, COLOR_BGR2RGB);
+    testImg.convertTo(testImg, CV_32F, 1.0 / 255.0f);
+
+    cv::String model_path = cvtest::TS::ptr()->get_data_path() + "cv/ximgproc/" + "model.yml.gz";
+    Ptr<StructuredEdgeDetection> sed = createStructuredEdgeDetection(model_path);
+    Mat edgeImage, edgeOrientations;
+    sed->detectEdges(testImg, edgeImage);
+    sed->computeOrientation(edgeImage, edgeOrientations);
+
+    Ptr<EdgeBoxes> edgeboxes = createEdgeBoxes();
+    edgeboxes->setMaxBoxes(50);
+
+    std::vector<Rect> boxes, boxesSerial;
+    std::vector<float> scores, scoresSerial;
+    edgeboxes->getBoundingBoxes(edgeImage, edgeOrientations, boxes, scores);
+
+    int nThreads = getNumThreads();
+    setNumThreads(1);
+    edgeboxes->getBoundingBoxes(edgeImage, edgeOrientations, boxesSerial, scoresSerial);
+    setNumThreads(nThreads);
+
+    ASSERT_FALSE(boxes.empty());
+    ASSERT_EQ(boxesSerial.size(), boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        EXPECT_EQ(boxesSerial[i], boxes[i]) << "box " << i;
+        EXPECT_EQ(scoresSerial[i], scores[i]) << "box " << i;
+    }
+}
+
 }} // namespace
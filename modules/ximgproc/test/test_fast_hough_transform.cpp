@@ -456,6 +456,20 @@ INSTANTIATE_TEST_CASE_P(FullSet, FastHoughTransformTest,
                                 Values(1, 2),
                                 Values(5)));
 
+TEST(FastHoughTransformTest, average_of_constant_image)
+{
+    const int depths[] = { FHT_ALL_DEPTHS };
+    for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); ++i)
+    {
+        // every line of the cyclic image averages equal values, whatever the split of its rows
+        Mat src(37, 50, CV_MAKETYPE(depths[i], 3), Scalar::all(37));
+        Mat fht, diff;
+        FastHoughTransform(src, fht, depths[i], ARO_0_45, FHT_AVE, HDO_RAW);
+        absdiff(fht, Scalar::all(37), diff);
+        EXPECT_EQ(0, countNonZero(diff.reshape(1))) << "depth=" << depths[i];
+    }
+}
+
 #undef FHT_ALL_DEPTHS
 #undef FHT_ALL_CHANNELS
 
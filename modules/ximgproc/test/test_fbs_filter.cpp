@@ -36,8 +36,6 @@
 
 #include "test_precomp.hpp"
 
-#ifdef HAVE_EIGEN
-
 namespace opencv_test { namespace {
 
 using namespace std;
@@ -123,9 +121,28 @@ TEST(FastBilateralSolverTest, ReferenceAccuracy)
 #endif
 }
 
+TEST(FastBilateralSolverTest, ThreadsConsistency)
+{
+    Mat guide(Size(320, 240), CV_8UC3);
+    randu(guide, 0, 255);
+    GaussianBlur(guide, guide, Size(9, 9), 0);
+    Mat src(guide.size(), CV_32FC1), confidence(guide.size(), CV_32FC1);
+    randu(src, 0.f, 1.f);
+    randu(confidence, 0.f, 1.f);
+
+    Ptr<FastBilateralSolverFilter> fbs = createFastBilateralSolverFilter(guide, 8.0, 8.0, 8.0);
+    Mat res, resSingle;
+    fbs->filter(src, confidence, res);
+
+    int numThreads = getNumThreads();
+    setNumThreads(1);
+    fbs->filter(src, confidence, resSingle);
+    setNumThreads(numThreads);
+
+    EXPECT_EQ(0, cvtest::norm(res, resSingle, NORM_INF));
+}
+
 INSTANTIATE_TEST_CASE_P(FullSet, FastBilateralSolverTest,Combine(Values(szODD, szQVGA), SrcTypes::all(), GuideTypes::all()));
 
 }
 }
-
-#endif //HAVE_EIGEN
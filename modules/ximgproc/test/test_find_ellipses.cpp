@@ -40,4 +40,25 @@ TEST(FindEllipsesTest, EllipsesOnly)
         EXPECT_TRUE(has_match) << "Wrong ellipse center:" << Point2f(ell[0], ell[1]);
     }
 }
+
+TEST(FindEllipsesTest, ThreadsConsistency)
+{
+    std::string picture_name = "cv/imgproc/stuff.jpg";
+    std::string filename = cvtest::TS::ptr()->get_data_path() + picture_name;
+    Mat src = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(src.empty()) << "Invalid test image: " << filename;
+
+    int nThreads = getNumThreads();
+    std::vector<Vec6f> ells;
+    ximgproc::findEllipses(src, ells, 0.7f, 0.75f, 0.02f);
+
+    setNumThreads(1);
+    std::vector<Vec6f> ellsSerial;
+    ximgproc::findEllipses(src, ellsSerial, 0.7f, 0.75f, 0.02f);
+    setNumThreads(nThreads);
+
+    ASSERT_EQ(ellsSerial.size(), ells.size());
+    for (size_t i = 0; i < ells.size(); i++)
+        EXPECT_EQ(ellsSerial[i], ells[i]) << "ellipse " << i;
+}
 }}
\ No newline at end of file
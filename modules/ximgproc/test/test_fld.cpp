@@ -328,4 +328,39 @@ TEST_F(ximgproc_ED, detectLinesAndEllipses)
     EXPECT_GE(ellipses.size(), ellipses_size);
     EXPECT_LE(ellipses.size(), ellipses_size + 2);
 }
+
+TEST_F(ximgproc_ED, tiledLinking)
+{
+    Mat gray_image = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(gray_image.empty()) << "Invalid test image: " << filename;
+
+    Mat edges, tiledEdges;
+    vector<Vec4f> tiledLines;
+    detector->detectEdges(gray_image);
+    detector->getEdgeImage(edges);
+    detector->detectLines(lines);
+    size_t segments_size = detector->getSegments().size();
+
+    detector->params.TileSize = 64;
+    detector->detectEdges(gray_image);
+    detector->getEdgeImage(tiledEdges);
+    detector->detectLines(tiledLines);
+    vector<vector<Point> > tiledSegments = detector->getSegments();
+
+    // segments crossing tile borders are stitched, so the tiled result stays close to the untiled one
+    double edgePixels = countNonZero(edges);
+    EXPECT_NEAR(countNonZero(tiledEdges), edgePixels, 0.1 * edgePixels);
+    EXPECT_NEAR((double)tiledSegments.size(), (double)segments_size, 0.2 * segments_size);
+    EXPECT_NEAR((double)tiledLines.size(), (double)lines.size(), 0.15 * lines.size());
+
+    // tiles are linked in a fixed order, so the result does not depend on the number of threads
+    int numThreads = getNumThreads();
+    setNumThreads(1);
+    detector->detectEdges(gray_image);
+    setNumThreads(numThreads);
+    vector<vector<Point> > singleThreadSegments = detector->getSegments();
+    ASSERT_EQ(tiledSegments.size(), singleThreadSegments.size());
+    for (size_t i = 0; i < tiledSegments.size(); i++)
+        EXPECT_TRUE(tiledSegments[i] == singleThreadSegments[i]);
+}
 }} // namespace
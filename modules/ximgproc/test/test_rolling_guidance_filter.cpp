@@ -125,6 +125,27 @@ TEST_P(RollingGuidanceFilterTest, MultiThreadReproducibility)
     }
 }
 
+TEST_P(RollingGuidanceFilterTest, InplaceReproducibility)
+{
+    RGFParams params = GetParam();
+    double sigmaS   = get<0>(params);
+    int depth       = get<1>(params);
+    int srcCn       = get<2>(params);
+
+    RNG rnd(2);
+    Size sz(rnd.uniform(128, 256), rnd.uniform(128, 256));
+    Mat src(sz, CV_MAKE_TYPE(depth, srcCn));
+    randu(src, 0, 255);
+
+    Mat res;
+    rollingGuidanceFilter(src, res, -1, 25.0, sigmaS, 4);
+
+    Mat inplace = src.clone();
+    rollingGuidanceFilter(inplace, inplace, -1, 25.0, sigmaS, 4);
+
+    EXPECT_EQ(0, cvtest::norm(res, inplace, NORM_INF));
+}
+
 INSTANTIATE_TEST_CASE_P(TypicalSet1, RollingGuidanceFilterTest,
     Combine(
     Values(2.0, 5.0),
@@ -245,5 +245,80 @@ TEST_P(RL_Paint, same_result)
 
 INSTANTIATE_TEST_CASE_P(TypicalSET, RL_Paint, Values(CV_8U, CV_16U, CV_16S, CV_32F, CV_64F));
 
+class RL_PaintROI : public RLTestBase, public testing::Test
+{
+public:
+    RL_PaintROI() { }
+protected:
+    virtual void SetUp() { setUp_impl(); }
+};
+
+TEST_F(RL_PaintROI, same_result)
+{
+    Mat full = Mat::zeros(img_size, CV_8UC1);
+    rl::paint(full, test_image_rle[0], Scalar(255.0));
+
+    Rect roi(37, 51, 300, 200);
+    Mat canvas = Mat::zeros(img_size, CV_8UC1);
+    Mat window = canvas(roi);
+    rl::paint(window, test_image_rle[0], Scalar(255.0), roi.tl());
+
+    Mat expected = Mat::zeros(img_size, CV_8UC1);
+    full(roi).copyTo(expected(roi));
+    ASSERT_TRUE(arePixelImagesIdentical(expected, canvas));
+}
+
+typedef tuple<int, int> RLCCParams;
+
+class RL_ConnectedComponents : public RLTestBase, public ::testing::TestWithParam<RLCCParams>
+{
+public:
+    RL_ConnectedComponents() { }
+protected:
+    virtual void SetUp() { setUp_impl(); }
+};
+
+TEST_P(RL_ConnectedComponents, same_result)
+{
+    int image = get<0>(GetParam());
+    int connectivity = get<1>(GetParam());
+
+    Mat labelsPix, statsPix, centroidsPix;
+    int nPix = cv::connectedComponentsWithStats(test_image[image], labelsPix, statsPix, centroidsPix,
+        connectivity, CV_32S);
+
+    Mat labelsRLE, statsRLE, centroidsRLE;
+    int nRLE = rl::connectedComponentsWithStats(test_image_rle[image], labelsRLE, statsRLE, centroidsRLE,
+        connectivity);
+    ASSERT_EQ(nPix, nRLE);
+
+    // the labels may be numbered differently, match them through the first pixel of every run
+    std::vector<int> toPix(nRLE, -1), fromPix(nPix, -1);
+    toPix[0] = fromPix[0] = 0;
+    const Point3i* runs = test_image_rle[image].ptr<Point3i>() + 1;
+    ASSERT_EQ(test_image_rle[image].total() - 1, labelsRLE.total());
+    for (int i = 0; i < (int)labelsRLE.total(); ++i)
+    {
+        int l = labelsRLE.at<int>(i);
+        int lPix = labelsPix.at<int>(runs[i].z, runs[i].x);
+        ASSERT_GT(l, 0);
+        if (toPix[l] < 0)
+        {
+            ASSERT_EQ(-1, fromPix[lPix]);
+            toPix[l] = lPix;
+            fromPix[lPix] = l;
+        }
+        ASSERT_EQ(toPix[l], lPix);
+    }
+
+    for (int l = 0; l < nRLE; ++l)
+    {
+        EXPECT_EQ(0, cvtest::norm(statsRLE.row(l), statsPix.row(toPix[l]), NORM_INF)) << "label " << l;
+        EXPECT_LE(cvtest::norm(centroidsRLE.row(l), centroidsPix.row(toPix[l]), NORM_INF), 1e-6) << "label " << l;
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(TypicalSET, RL_ConnectedComponents, Combine(Values(0, 1), Values(4, 8)));
+
 }
 }
\ No newline at end of file
@@ -0,0 +1,79 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+static Mat loadSeedsImage()
+{
+    Mat img = imread(cvtest::findDataFile("cv/shared/lena.png"), IMREAD_COLOR);
+    Mat hsvImg;
+    if (!img.empty())
+        cvtColor(img, hsvImg, COLOR_BGR2HSV);
+    return hsvImg;
+}
+
+TEST(ximgproc_SuperpixelSEEDS, threads_consistency)
+{
+    Mat img = loadSeedsImage();
+    ASSERT_FALSE(img.empty());
+
+    const int nThreads = getNumThreads();
+    Mat labels[2];
+    for (int i = 0; i < 2; i++)
+    {
+        setNumThreads(i == 0 ? 1 : nThreads);
+        Ptr<SuperpixelSEEDS> seeds = createSuperpixelSEEDS(img.cols, img.rows, img.channels(),
+                                                           400, 4, 2, 5, true);
+        seeds->iterate(img, 4);
+        seeds->getLabels(labels[i]);
+    }
+    setNumThreads(nThreads);
+
+    ASSERT_EQ(labels[0].size(), labels[1].size());
+    EXPECT_EQ(0, cvtest::norm(labels[0], labels[1], NORM_INF));
+}
+
+TEST(ximgproc_SuperpixelSEEDS, warm_start)
+{
+    Mat img = loadSeedsImage();
+    ASSERT_FALSE(img.empty());
+
+    Ptr<SuperpixelSEEDS> seeds = createSuperpixelSEEDS(img.cols, img.rows, img.channels(),
+                                                       400, 4, 2, 5, false);
+    seeds->setWarmStart(true);
+    EXPECT_TRUE(seeds->getWarmStart());
+    seeds->iterate(img, 4);
+    Mat first;
+    seeds->getLabels(first);
+    first = first.clone(); // getLabels() shares the buffer updated by iterate()
+    const int numSuperpixels = seeds->getNumberOfSuperpixels();
+
+    // next "frame": the same scene moved by a few pixels
+    Mat next;
+    Mat shift = (Mat_<double>(2, 3) << 1, 0, 3, 0, 1, 2);
+    warpAffine(img, next, shift, img.size(), INTER_NEAREST, BORDER_REPLICATE);
+    seeds->iterate(next, 2);
+    Mat warm;
+    seeds->getLabels(warm);
+
+    // the same iterations started from the initial grid
+    Ptr<SuperpixelSEEDS> coldSeeds = createSuperpixelSEEDS(img.cols, img.rows, img.channels(),
+                                                           400, 4, 2, 5, false);
+    coldSeeds->iterate(next, 2);
+    Mat cold;
+    coldSeeds->getLabels(cold);
+
+    EXPECT_EQ(numSuperpixels, seeds->getNumberOfSuperpixels());
+    double minVal = 0, maxVal = 0;
+    minMaxLoc(warm, &minVal, &maxVal);
+    EXPECT_GE(minVal, 0);
+    EXPECT_LT(maxVal, numSuperpixels);
+
+    // the labels are refined from the previous frame instead of the initial grid
+    EXPECT_GT(countNonZero(warm != cold), 0);
+    EXPECT_LT(countNonZero(first != warm), (int)first.total() / 4);
+}
+
+}} // namespace
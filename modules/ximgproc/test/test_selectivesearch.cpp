@@ -0,0 +1,99 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+#include "test_precomp.hpp"
+
+namespace opencv_test { namespace {
+
+using namespace cv::ximgproc::segmentation;
+
+TEST(ximgproc_GraphSegmentation, separates_flat_regions)
+{
+    Mat img(120, 160, CV_8UC3, Scalar(40, 40, 40));
+    img(Rect(80, 0, 80, 120)).setTo(Scalar(200, 180, 20));
+
+    Ptr<GraphSegmentation> gs = createGraphSegmentation(0.5, 300, 50);
+    Mat labels;
+    gs->processImage(img, labels);
+
+    ASSERT_EQ(CV_32SC1, labels.type());
+    EXPECT_EQ(labels.at<int>(5, 5), labels.at<int>(115, 70));
+    EXPECT_EQ(labels.at<int>(5, 90), labels.at<int>(115, 155));
+    EXPECT_NE(labels.at<int>(60, 10), labels.at<int>(60, 150));
+}
+
+TEST(ximgproc_GraphSegmentation, bounded_memory_matches_full)
+{
+    Mat img = imread(cvtest::findDataFile("cv/shared/lena.png"), IMREAD_COLOR);
+    ASSERT_FALSE(img.empty());
+    resize(img, img, Size(), 0.5, 0.5, INTER_AREA);
+
+    Ptr<GraphSegmentation> gs = createGraphSegmentation(0.8, 300, 50);
+    Mat full;
+    gs->processImage(img, full);
+
+    gs->setMaxEdgesInMemory(20000);
+    EXPECT_EQ(20000, gs->getMaxEdgesInMemory());
+    Mat bounded;
+    gs->processImage(img, bounded);
+
+    EXPECT_EQ(0, cvtest::norm(full, bounded, NORM_INF));
+
+    const int nThreads = getNumThreads();
+    setNumThreads(1);
+    gs->setMaxEdgesInMemory(0);
+    Mat single;
+    gs->processImage(img, single);
+    setNumThreads(nThreads);
+
+    EXPECT_EQ(0, cvtest::norm(full, single, NORM_INF));
+}
+
+TEST(ximgproc_GraphSegmentation, tied_weights_threads_consistency)
+{
+    // few gray levels and no smoothing, so most of the edges have the same weight
+    RNG rng(0);
+    Mat img(400, 400, CV_8UC1);
+    rng.fill(img, RNG::UNIFORM, 0, 4);
+    img *= 20;
+    cvtColor(img, img, COLOR_GRAY2BGR);
+
+    Ptr<GraphSegmentation> gs = createGraphSegmentation(0.001, 300, 50);
+    const int nThreads = getNumThreads();
+    Mat labels[2];
+    for (int i = 0; i < 2; i++)
+    {
+        setNumThreads(i == 0 ? 1 : nThreads);
+        gs->processImage(img, labels[i]);
+    }
+    setNumThreads(nThreads);
+
+    EXPECT_EQ(0, cvtest::norm(labels[0], labels[1], NORM_INF));
+}
+
+TEST(ximgproc_SelectiveSearchSegmentation, fast_finds_objects)
+{
+    Mat img(120, 160, CV_8UC3, Scalar(90, 120, 60));
+    const Rect object1(20, 30, 40, 50), object2(100, 20, 45, 35);
+    img(object1).setTo(Scalar(10, 10, 230));
+    img(object2).setTo(Scalar(230, 30, 10));
+
+    Ptr<SelectiveSearchSegmentation> ss = createSelectiveSearchSegmentation();
+    ss->setBaseImage(img);
+    ss->switchToSelectiveSearchFast();
+    std::vector<Rect> rects;
+    ss->process(rects);
+
+    ASSERT_FALSE(rects.empty());
+    bool found1 = false, found2 = false;
+    for (size_t i = 0; i < rects.size(); i++)
+    {
+        EXPECT_EQ(rects[i], rects[i] & Rect(0, 0, img.cols, img.rows));
+        found1 = found1 || (rects[i] & object1).area() > 0.8 * (rects[i] | object1).area();
+        found2 = found2 || (rects[i] & object2).area() > 0.8 * (rects[i] | object2).area();
+    }
+    EXPECT_TRUE(found1);
+    EXPECT_TRUE(found2);
+}
+
+}} // namespace
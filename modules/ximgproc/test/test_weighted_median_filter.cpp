@@ -70,6 +70,39 @@ TEST(WeightedMedianFilterTest, mask_zeros_no_crash)
     EXPECT_EQ(cv::norm(img, filtered, NORM_INF), 0.0);
 }
 
+TEST(WeightedMedianFilterTest, float_guide_keeps_subunit_edges)
+{
+    // The two regions differ by less than one 8-bit level in the guide.
+    Mat guide(Size(64, 48), CV_32F, Scalar(0.1f));
+    guide(Rect(0, 0, 31, 48)).setTo(0.3f);
+    Mat src(guide.size(), CV_8U, Scalar(50));
+    src(Rect(0, 0, 31, 48)).setTo(200);
+
+    Mat res;
+    weightedMedianFilter(guide, src, res, 5, 0.02, WMF_EXP);
+
+    EXPECT_EQ(cvtest::norm(src, res, NORM_INF), 0.0);
+}
+
+TEST(WeightedMedianFilterTest, threads_consistency)
+{
+    RNG rnd(0);
+    Mat guide(Size(257, 193), CV_8UC1), src(guide.size(), CV_8UC1);
+    rnd.fill(guide, RNG::UNIFORM, 0, 255);
+    rnd.fill(src, RNG::UNIFORM, 0, 255);
+
+    Mat resSingle, resMulti;
+    int nThreads = getNumThreads();
+    setNumThreads(1);
+    weightedMedianFilter(guide, src, resSingle, 7, 25, WMF_EXP);
+    setNumThreads(nThreads);
+    weightedMedianFilter(guide, src, resMulti, 7, 25, WMF_EXP);
+
+    Mat diff;
+    absdiff(resSingle, resMulti, diff);
+    EXPECT_EQ(0, countNonZero(diff));
+}
+
 INSTANTIATE_TEST_CASE_P(TypicalSET, WeightedMedianFilterTest, Combine(Values(szODD, szQVGA),  Values(WMF_EXP, WMF_IV2, WMF_OFF)));
 
 